@@ -1,19 +1,81 @@
 # create new HLS project for SRCNN
 open_project srcnn_hls
 
-# set top function for synthesis
+# set top function for synthesis (srcnn_dataflow for the dataflow pipeline)
 set_top srcnn
 
 # add source files
 add_files src/srcnn.h
 add_files src/srcnn.cpp
+add_files src/conv_template.h
 add_files src/conv1.cpp
+add_files src/conv2.cpp
+add_files src/conv3.cpp
+add_files src/srcnn_fused.cpp
+add_files src/stream_compat.h
+add_files src/dataflow.h
+add_files src/srcnn_dataflow.cpp
 
 # add testbench files
 set CFLAGS "-I./src"
+
+# native CPU kernels (not synthesised, only used by the testbenches)
+add_files -tb -cflags $CFLAGS ./src/kernels.h
+add_files -tb -cflags $CFLAGS ./src/gemm.h
+add_files -tb -cflags $CFLAGS ./src/gemm.cpp
+add_files -tb -cflags $CFLAGS ./src/conv_gemm.cpp
+add_files -tb -cflags $CFLAGS ./src/conv_fft.cpp
+add_files -tb -cflags $CFLAGS ./src/conv_fused.cpp
+add_files -tb -cflags $CFLAGS ./src/conv_layout.cpp
+add_files -tb -cflags $CFLAGS ./src/conv_sparse.cpp
+add_files -tb -cflags $CFLAGS ./src/frame_diff.cpp
+add_files -tb -cflags $CFLAGS ./src/bicubic.cpp
+add_files -tb -cflags $CFLAGS ./src/conv_direct.cpp
+add_files -tb -cflags $CFLAGS ./src/conv_avx2.cpp
+add_files -tb -cflags $CFLAGS ./src/conv_avx512.cpp
+add_files -tb -cflags $CFLAGS ./src/simd.h
+add_files -tb -cflags $CFLAGS ./src/simd.cpp
+add_files -tb -cflags $CFLAGS ./src/engine.h
+add_files -tb -cflags $CFLAGS ./src/engine.cpp
+add_files -tb -cflags $CFLAGS ./src/thread_pool.h
+add_files -tb -cflags $CFLAGS ./src/thread_pool.cpp
+add_files -tb -cflags $CFLAGS ./src/srcnn_parallel.cpp
+add_files -tb -cflags $CFLAGS ./src/quant.h
+add_files -tb -cflags $CFLAGS ./src/quant.cpp
+add_files -tb -cflags $CFLAGS ./src/quant_avx2.cpp
+add_files -tb -cflags $CFLAGS ./src/quant_avx512.cpp
+add_files -tb -cflags $CFLAGS ./src/model_file.h
+add_files -tb -cflags $CFLAGS ./src/model_file.cpp
+add_files -tb -cflags $CFLAGS ./src/spsc_queue.h
+add_files -tb -cflags $CFLAGS ./src/stream.h
+add_files -tb -cflags $CFLAGS ./src/stream.cpp
+add_files -tb -cflags $CFLAGS ./src/color.h
+add_files -tb -cflags $CFLAGS ./src/color.cpp
+add_files -tb -cflags $CFLAGS ./src/metrics.h
+add_files -tb -cflags $CFLAGS ./src/metrics.cpp
+
 add_files -tb -cflags $CFLAGS ./test/csim.cpp
 add_files -tb -cflags $CFLAGS ./test/tb_srcnn.cpp
 add_files -tb -cflags $CFLAGS ./test/tb_conv1.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_fused.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_gemm.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_fft.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_layout.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_simd.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_parallel.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_context.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_tiled.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_quant.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_half.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_sparse.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_stream.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_incremental.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_adaptive.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_color.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_dataflow.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_metrics.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_model.cpp
+add_files -tb -cflags $CFLAGS ./test/tb_io.cpp
 add_files -tb -cflags $CFLAGS ./test/tb_set14.cpp
 add_files -tb -cflags $CFLAGS ./test/util.h
 add_files -tb -cflags $CFLAGS ./test/util.cpp
@@ -0,0 +1,192 @@
+#include <math.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include "kernels.h"
+#include "simd.h"
+
+// columns of symmetric padding on each side of the intermediate rows, as far
+// as a 4-tap kernel reaches beyond the image
+#define BICUBIC_PAD 2
+
+#define BICUBIC_INLINE static inline __attribute__((always_inline))
+
+// cubic convolution kernel with a = -0.5, as MATLAB's imresize
+static double bicubic_kernel(double x)
+{
+    x = fabs(x);
+    if (x <= 1)
+        return (1.5*x - 2.5)*x*x + 1;
+    if (x < 2)
+        return ((-0.5*x + 2.5)*x - 4)*x + 2;
+    return 0;
+}
+
+// index i of a dimension of size n mirrored at the borders (..., 1, 0, 0,
+// 1, ..., n - 1, n - 1, n - 2, ...), as MATLAB pads for imresize
+static int bicubic_index(int i, int n)
+{
+    int period = 2*n;
+    i %= period;
+    if (i < 0)
+        i += period;
+    return i < n ? i : period - 1 - i;
+}
+
+// output index scale*i + p samples the input at i + (p + 0.5)/scale - 0.5;
+// its four taps start at i + offset[p] with weights[p][0..3]
+struct bicubic_phases_t {
+    int   offset[BICUBIC_MAX_SCALE];
+    float weights[BICUBIC_MAX_SCALE][4];
+};
+
+static bicubic_phases_t bicubic_phases(int scale)
+{
+    bicubic_phases_t phases;
+    for (int p = 0; p < scale; p++) {
+        double u = (p + 0.5)/scale - 0.5;
+        int left = (int) floor(u);
+        phases.offset[p] = left - 1;
+        for (int k = 0; k < 4; k++)
+            phases.weights[p][k] = (float) bicubic_kernel(u - (left - 1 + k));
+    }
+    return phases;
+}
+
+// vertical pass: rows of the input to scale*h rows of w columns, VL columns
+// at a time, into rows of stride columns starting BICUBIC_PAD in; then the
+// padding of each row is mirrored
+template <int VL>
+BICUBIC_INLINE void bicubic_rows(const ftmap_t *input, int h, int w, int scale,
+                                 const bicubic_phases_t &phases, float *rows, int stride)
+{
+    typedef typename simd_vec<VL>::type VEC;
+
+    for (int j = 0; j < h; j++) {
+        for (int p = 0; p < scale; p++) {
+            const float *wt = phases.weights[p];
+            const ftmap_t *in[4];
+            for (int k = 0; k < 4; k++)
+                in[k] = input + (long) bicubic_index(j + phases.offset[p] + k, h)*w;
+            float *out = rows + (long) (j*scale + p)*stride + BICUBIC_PAD;
+
+            int x = 0;
+            for (; x + VL <= w; x += VL) {
+                VEC acc = *(const VEC *) (in[0] + x)*wt[0];
+                acc += *(const VEC *) (in[1] + x)*wt[1];
+                acc += *(const VEC *) (in[2] + x)*wt[2];
+                acc += *(const VEC *) (in[3] + x)*wt[3];
+                *(VEC *) (out + x) = acc;
+            }
+            for (; x < w; x++)
+                out[x] = in[0][x]*wt[0] + in[1][x]*wt[1] + in[2][x]*wt[2] + in[3][x]*wt[3];
+
+            for (int k = 1; k <= BICUBIC_PAD; k++) {
+                out[-k] = out[bicubic_index(-k, w)];
+                out[w - 1 + k] = out[bicubic_index(w - 1 + k, w)];
+            }
+        }
+    }
+}
+
+// horizontal pass: each padded row of w columns to scale*w columns. Each
+// phase reads its four taps from contiguous columns, VL output columns of
+// the phase at a time, and is then interleaved into the output row.
+template <int VL>
+BICUBIC_INLINE void bicubic_cols(const float *rows, int rh, int w, int scale, int stride,
+                                 const bicubic_phases_t &phases, float *phase_row, ftmap_t *output)
+{
+    typedef typename simd_vec<VL>::type VEC;
+
+    int ow = w*scale;
+    for (int y = 0; y < rh; y++) {
+        const float *row = rows + (long) y*stride + BICUBIC_PAD;
+        ftmap_t *out = output + (long) y*ow;
+        for (int p = 0; p < scale; p++) {
+            const float *wt = phases.weights[p];
+            const float *in = row + phases.offset[p];
+            int i = 0;
+            for (; i + VL <= w; i += VL) {
+                VEC acc = *(const VEC *) (in + i)*wt[0];
+                acc += *(const VEC *) (in + i + 1)*wt[1];
+                acc += *(const VEC *) (in + i + 2)*wt[2];
+                acc += *(const VEC *) (in + i + 3)*wt[3];
+                *(VEC *) (phase_row + i) = acc;
+            }
+            for (; i < w; i++)
+                phase_row[i] = in[i]*wt[0] + in[i + 1]*wt[1] + in[i + 2]*wt[2] + in[i + 3]*wt[3];
+            for (i = 0; i < w; i++)
+                out[i*scale + p] = phase_row[i];
+        }
+    }
+}
+
+template <int VL>
+BICUBIC_INLINE void bicubic(const ftmap_t *input, int h, int w, int scale, ftmap_t *output, float *workspace)
+{
+    bicubic_phases_t phases = bicubic_phases(scale);
+    int stride = w + 2*BICUBIC_PAD;
+    float *rows = workspace;
+    float *phase_row = workspace + (long) h*scale*stride;
+
+    bicubic_rows<VL>(input, h, w, scale, phases, rows, stride);
+    bicubic_cols<VL>(rows, h*scale, w, scale, stride, phases, phase_row, output);
+}
+
+// per-target instantiations, see simd_vec
+static void bicubic_default(const ftmap_t *input, int h, int w, int scale, ftmap_t *output, float *workspace)
+{
+    bicubic<4>(input, h, w, scale, output, workspace);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma")))
+static void bicubic_avx2(const ftmap_t *input, int h, int w, int scale, ftmap_t *output, float *workspace)
+{
+    bicubic<8>(input, h, w, scale, output, workspace);
+}
+
+__attribute__((target("avx512f")))
+static void bicubic_avx512(const ftmap_t *input, int h, int w, int scale, ftmap_t *output, float *workspace)
+{
+    bicubic<16>(input, h, w, scale, output, workspace);
+}
+#endif
+
+size_t bicubic_upscale_workspace_size(int h, int w, int scale)
+{
+    return (size_t) h*scale*(w + 2*BICUBIC_PAD) + w;
+}
+
+void bicubic_upscale(const ftmap_t *input,
+                     int            h,
+                     int            w,
+                     int            scale,
+                     ftmap_t       *output,
+                     float         *workspace)
+{
+    if (h <= 0 || w <= 0 || scale < 1 || scale > BICUBIC_MAX_SCALE)
+        throw std::runtime_error("Invalid bicubic upscale dimensions or scale");
+
+    std::vector<float> scratch;
+    if (!workspace) {
+        scratch.resize(bicubic_upscale_workspace_size(h, w, scale));
+        workspace = scratch.data();
+    }
+
+    switch (simd_isa()) {
+#if defined(__x86_64__) || defined(__i386__)
+    case SIMD_ISA_AVX512:
+        bicubic_avx512(input, h, w, scale, output, workspace);
+        break;
+    case SIMD_ISA_AVX2:
+        bicubic_avx2(input, h, w, scale, output, workspace);
+        break;
+#endif
+    default:
+        bicubic_default(input, h, w, scale, output, workspace);
+        break;
+    }
+}
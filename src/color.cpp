@@ -0,0 +1,191 @@
+#include <stdint.h>
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "color.h"
+#include "kernels.h"
+
+// rounds a non-negative value to the nearest integer, saturated to u8
+static inline float round_u8(float v)
+{
+    v = v < 0 ? 0 : (v > 255 ? 255 : v);
+    return (float) (int) (v + 0.5f);
+}
+
+void rgb_to_ycbcr(const uint8_t *rgb,
+                  long           pixels,
+                  ftmap_t       *y,
+                  ftmap_t       *cb,
+                  ftmap_t       *cr)
+{
+    for (long i = 0; i < pixels; i++) {
+        float r = rgb[3*i], g = rgb[3*i + 1], b = rgb[3*i + 2];
+        y[i]  = (ftmap_t) (round_u8( 16 + ( 65.481f*r + 128.553f*g +  24.966f*b)/255)/255);
+        cb[i] = (ftmap_t) (round_u8(128 + (-37.797f*r -  74.203f*g + 112.0f  *b)/255)/255);
+        cr[i] = (ftmap_t) (round_u8(128 + (112.0f  *r -  93.786f*g -  18.214f*b)/255)/255);
+    }
+}
+
+void ycbcr_to_rgb(const ftmap_t *y,
+                  const ftmap_t *cb,
+                  const ftmap_t *cr,
+                  long           pixels,
+                  uint8_t       *rgb)
+{
+    for (long i = 0; i < pixels; i++) {
+        float l = (float) y[i]*255 - 16;
+        float u = (float) cb[i]*255 - 128;
+        float v = (float) cr[i]*255 - 128;
+        rgb[3*i]     = (uint8_t) round_u8(1.164383f*l + 1.596027f*v);
+        rgb[3*i + 1] = (uint8_t) round_u8(1.164383f*l - 0.391762f*u - 0.812968f*v);
+        rgb[3*i + 2] = (uint8_t) round_u8(1.164383f*l + 2.017232f*u);
+    }
+}
+
+struct srcnn_color_t {
+    srcnn_ctx_t          *ctx;
+    int                   h;
+    int                   w;
+    std::vector<ftmap_t>  small;        // Y, Cb, Cr planes of the input
+    std::vector<ftmap_t>  large;        // the same, upscaled
+    std::vector<ftmap_t>  luma;         // network output
+    std::vector<float>    scratch[2];   // bicubic workspaces: luma, chroma worker
+
+    // worker upscaling Cb and Cr while the conv layers run on Y
+    std::thread              chroma;
+    std::mutex               lock;      // guards the fields below
+    std::condition_variable  wake;      // a frame was requested, or stop
+    std::condition_variable  done;      // the worker finished a frame
+    unsigned                 requested; // frames handed to the worker
+    unsigned                 finished;  // frames it has upscaled
+    bool                     stop;
+    std::exception_ptr       error;     // of the last frame, if it failed
+};
+
+static void color_chroma_worker(srcnn_color_t *color)
+{
+    int h = color->h;
+    int w = color->w;
+    long pixels = (long) h*w, upscaled = (long) UP*h*UP*w;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(color->lock);
+            color->wake.wait(guard, [color]() { return color->stop || color->requested != color->finished; });
+            if (color->stop)
+                return;
+        }
+
+        std::exception_ptr error;
+        try {
+            for (int c = 1; c < 3; c++)
+                bicubic_upscale(&color->small[(size_t) c*pixels], h, w, UP, &color->large[(size_t) c*upscaled],
+                                color->scratch[1].data());
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(color->lock);
+            color->error = error;
+            color->finished++;
+        }
+        color->done.notify_one();
+    }
+}
+
+srcnn_color_t *srcnn_color_create(const srcnn_model_t *model,
+                                  int                  h,
+                                  int                  w,
+                                  srcnn_mode_t         mode,
+                                  thread_pool         *pool)
+{
+    if (h <= 0 || w <= 0)
+        throw std::runtime_error("Invalid SRCNN colour image dimensions");
+
+    long pixels = (long) h*w, upscaled = (long) UP*h*UP*w;
+    srcnn_color_t *color = new srcnn_color_t();
+    color->h = h;
+    color->w = w;
+    try {
+        color->small.resize((size_t) 3*pixels);
+        color->large.resize((size_t) 3*upscaled);
+        color->luma.resize((size_t) upscaled);
+        for (int i = 0; i < 2; i++)
+            color->scratch[i].resize(bicubic_upscale_workspace_size(h, w, UP));
+        color->ctx = srcnn_ctx_create(model, UP*h, UP*w, mode, pool);
+        color->chroma = std::thread(color_chroma_worker, color);
+    } catch (...) {
+        srcnn_color_destroy(color);
+        throw;
+    }
+    return color;
+}
+
+void srcnn_color_destroy(srcnn_color_t *color)
+{
+    if (!color)
+        return;
+    if (color->chroma.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(color->lock);
+            color->stop = true;
+        }
+        color->wake.notify_one();
+        color->chroma.join();
+    }
+    srcnn_ctx_destroy(color->ctx);
+    delete color;
+}
+
+srcnn_ctx_t *srcnn_color_ctx(srcnn_color_t *color)
+{
+    return color->ctx;
+}
+
+void srcnn_color_run(srcnn_color_t *color,
+                     const uint8_t *rgb,
+                     uint8_t       *output)
+{
+    int h = color->h;
+    int w = color->w;
+    long pixels = (long) h*w, upscaled = (long) UP*h*UP*w;
+    ftmap_t *small[3], *large[3];
+    for (int c = 0; c < 3; c++) {
+        small[c] = &color->small[(size_t) c*pixels];
+        large[c] = &color->large[(size_t) c*upscaled];
+    }
+
+    rgb_to_ycbcr(rgb, pixels, small[0], small[1], small[2]);
+
+    // chroma upscaling overlaps the luma upscaling and the conv layers
+    {
+        std::lock_guard<std::mutex> guard(color->lock);
+        color->requested++;
+    }
+    color->wake.notify_one();
+
+    std::exception_ptr error;
+    try {
+        bicubic_upscale(small[0], h, w, UP, large[0], color->scratch[0].data());
+        srcnn_ctx_run(color->ctx, large[0], color->luma.data());
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // the worker writes the chroma planes until it is done, even on errors
+    {
+        std::unique_lock<std::mutex> guard(color->lock);
+        color->done.wait(guard, [color]() { return color->finished == color->requested; });
+        if (!error)
+            error = color->error;
+    }
+    if (error)
+        std::rethrow_exception(error);
+
+    ycbcr_to_rgb(color->luma.data(), large[1], large[2], upscaled, output);
+}
@@ -0,0 +1,57 @@
+#ifndef _COLOR_H_
+#define _COLOR_H_
+
+#include <stdint.h>
+
+#include "srcnn.h"
+#include "engine.h"
+
+// Colour front and back end: SRCNN is trained on the luma of bicubic
+// upscaled images, so a raw low-resolution RGB image is converted to YCbCr,
+// all three planes are upscaled by UP with bicubic_upscale(), the network
+// runs on Y only and the result is converted back to RGB with the upscaled
+// chroma. The conversions follow MATLAB's rgb2ycbcr/ycbcr2rgb on uint8
+// images (ITU-R BT.601, studio range), as used to prepare the Set5/Set14
+// _LR_u8.bin files.
+
+// interleaved u8 RGB pixels to planar Y, Cb and Cr, each rounded to u8 as
+// rgb2ycbcr does and normalized to [0, 1]
+void rgb_to_ycbcr(const uint8_t *rgb,
+                  long           pixels,
+                  ftmap_t       *y,
+                  ftmap_t       *cb,
+                  ftmap_t       *cr);
+
+// planar normalized Y, Cb and Cr to interleaved u8 RGB, rounded and saturated
+void ycbcr_to_rgb(const ftmap_t *y,
+                  const ftmap_t *cb,
+                  const ftmap_t *cr,
+                  long           pixels,
+                  uint8_t       *rgb);
+
+// colour upscaler for h x w RGB images, producing (UP*h) x (UP*w) ones. It
+// owns an inference context of the given mode for the upscaled size (pool
+// is passed to srcnn_ctx_create()), every intermediate plane and a worker
+// thread for the chroma, so running it does not allocate.
+struct srcnn_color_t;
+
+srcnn_color_t *srcnn_color_create(const srcnn_model_t *model,
+                                  int                  h,
+                                  int                  w,
+                                  srcnn_mode_t         mode = SRCNN_MODE_SIMD,
+                                  thread_pool         *pool = NULL);
+
+void srcnn_color_destroy(srcnn_color_t *color);
+
+// the context running the luma, e.g. for srcnn_ctx_set_model()
+srcnn_ctx_t *srcnn_color_ctx(srcnn_color_t *color);
+
+// upscales one interleaved RGB image. Cb and Cr are upscaled on the chroma
+// worker while Y is upscaled and run through the network; the back end then
+// converts all three planes to RGB in one pass. An error on either side is
+// rethrown here once both are done.
+void srcnn_color_run(srcnn_color_t *color,
+                     const uint8_t *rgb,
+                     uint8_t       *output);
+
+#endif /* _COLOR_H_ */
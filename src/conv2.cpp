@@ -1,42 +1,22 @@
 #include "srcnn.h"
-#include <math.h>
+#include "conv_template.h"
+
+// implements one output row of the conv2 layer for all output features
+void conv2_row(ftmap_t *input_rows[F2],
+               int      input_feat_stride,
+               param_t  conv2_weights[N2][N1][F2][F2],
+               param_t  conv2_biases[N2],
+               ftmap_t *output_row,
+               int      output_feat_stride)
+{
+	conv_row_template<N1, N2, F2, true, H, W>(input_rows, input_feat_stride, conv2_weights, conv2_biases, output_row, output_feat_stride);
+}
 
-// implements conv1 layer of SRCNN
+// implements conv2 layer of SRCNN
 void conv2(ftmap_t input_ftmap[N1][H][W],
-		   param_t conv2_weights[N2][N1][F2][F2], //F2 = 1 therefore we have 1x1 filter kernel
-		   param_t conv2_biases[N2],
+           param_t conv2_weights[N2][N1][F2][F2],
+           param_t conv2_biases[N2],
            ftmap_t output_ftmap[N2][H][W])
 {
-	int padding = F2/2; //If we pick a coordinate on the top row of a 9 by 9 grid, we need at least 4 pixels surrounding it
-	for (int out_feat = 0; out_feat < N2; out_feat++) { //Loop over every output feature map
-
-			for (int out_feat_y = 0; out_feat_y < H; out_feat_y++) { //Loop over the width of a feature map output
-
-				for (int out_feat_x = 0; out_feat_x < W; out_feat_x++) { //Loop over the height of a feature map to capture a single pixel
-
-
-					/*We have now picked a cell to give output to.
-					 * We must now loop over a kernel and convolve to find the output for this cell
-					 * Remember we must include the bias. each feature map has a single bias
-					 */
-
-				    float feat_bias = conv2_biases[out_feat];
-				    float convolution = 0;
-
-					for (int in_feat = 0; in_feat < N1 ; in_feat++) { //Loop over every input feature map (3 for RGB for example)
-
-						for (int kernel_x = 0; kernel_x < F2; kernel_x++) { //Loop through width of a kernel
-
-							for (int kernel_y = 0; kernel_y < F2; kernel_y++) { //Loop through height of a kernel
-								int new_ftmap_height = fmin(fmax(out_feat_y + kernel_y - padding, 0), H - 1);
-								int new_ftmap_width = fmin(fmax(out_feat_x + kernel_x - padding, 0), W - 1);
-								convolution += conv2_weights[out_feat][in_feat][kernel_y][kernel_x]*input_ftmap[in_feat][new_ftmap_height][new_ftmap_width];
-							}
-						}
-					}
-
-					output_ftmap[out_feat][out_feat_y][out_feat_x] = fmaxf(0, convolution + feat_bias); //activation function (convolve could be negative)
-				}
-			}
-	}
+	conv_template<N1, N2, F2, true, H, W>(input_ftmap, conv2_weights, conv2_biases, output_ftmap);
 }
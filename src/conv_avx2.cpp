@@ -0,0 +1,179 @@
+#include "simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#define AVX2_VL 8   // floats per vector
+
+static inline int clamp_index(int i, int n)
+{
+    return i < 0 ? 0 : (i > n - 1 ? n - 1 : i);
+}
+
+// FB output features x XB vectors of adjacent output columns, all in registers:
+// every input vector is loaded once per tap and reused for FB broadcast weights.
+// With TAIL set only the first lanes columns of the last vector are loaded and
+// stored, so a row tail gets the same FMA sequence as full vectors and results
+// do not depend on where a column range starts.
+template <int FB, int XB, bool TAIL>
+AVX2_TARGET static void conv_block_avx2(const conv_layer_t *layer,
+                                        ftmap_view_t        input,
+                                        int                 h,
+                                        ftmap_view_t        output,
+                                        int                 out_feat,
+                                        int                 y,
+                                        int                 x,
+                                        int                 lanes)
+{
+    int nin = layer->nin;
+    int f = layer->f;
+    int taps = f*f;
+    int padding = f/2;
+    __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(lanes), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256 acc[FB][XB];
+
+    for (int fi = 0; fi < FB; fi++)
+        for (int xi = 0; xi < XB; xi++)
+            acc[fi][xi] = _mm256_setzero_ps();
+
+    for (int in_feat = 0; in_feat < nin; in_feat++) {
+        const param_t *weights = layer->weights + ((long) out_feat*nin + in_feat)*taps;
+        for (int kernel_x = 0; kernel_x < f; kernel_x++) {
+            for (int kernel_y = 0; kernel_y < f; kernel_y++) {
+                const ftmap_t *src = input.data + in_feat*input.plane
+                    + (long) (clamp_index(y + kernel_y - padding, h) - input.y0)*input.stride
+                    + (x + kernel_x - padding - input.x0);
+                __m256 v[XB];
+                for (int xi = 0; xi < XB; xi++)
+                    v[xi] = TAIL && xi == XB - 1 ? _mm256_maskload_ps(src + xi*AVX2_VL, mask)
+                                                 : _mm256_loadu_ps(src + xi*AVX2_VL);
+                for (int fi = 0; fi < FB; fi++) {
+                    __m256 wv = _mm256_broadcast_ss(&weights[(long) fi*nin*taps + kernel_y*f + kernel_x]);
+                    for (int xi = 0; xi < XB; xi++)
+                        acc[fi][xi] = _mm256_fmadd_ps(wv, v[xi], acc[fi][xi]);
+                }
+            }
+        }
+    }
+
+    __m256 zero = _mm256_setzero_ps();
+    for (int fi = 0; fi < FB; fi++) {
+        __m256 bias = _mm256_broadcast_ss(&layer->biases[out_feat + fi]);
+        ftmap_t *dst = output.data + (out_feat + fi)*output.plane
+            + (long) (y - output.y0)*output.stride + (x - output.x0);
+        for (int xi = 0; xi < XB; xi++) {
+            __m256 result = _mm256_max_ps(zero, _mm256_add_ps(acc[fi][xi], bias));
+            if (TAIL && xi == XB - 1)
+                _mm256_maskstore_ps(dst + xi*AVX2_VL, mask, result);
+            else
+                _mm256_storeu_ps(dst + xi*AVX2_VL, result);
+        }
+    }
+}
+
+// runs block kernel over the interior [x_begin, x_end) of one row for features [f0, f1)
+template <int FB, int XB>
+AVX2_TARGET static void conv_row_avx2(const conv_layer_t *layer,
+                                     ftmap_view_t        input,
+                                     int                 h,
+                                     ftmap_view_t        output,
+                                     int                 f0,
+                                     int                 f1,
+                                     int                 y,
+                                     int                 x_begin,
+                                     int                 x_end)
+{
+    int x = x_begin;
+    for (; x + XB*AVX2_VL <= x_end; x += XB*AVX2_VL)
+        for (int out_feat = f0; out_feat < f1; out_feat += FB)
+            conv_block_avx2<FB, XB, false>(layer, input, h, output, out_feat, y, x, AVX2_VL);
+    for (; x + AVX2_VL <= x_end; x += AVX2_VL)
+        for (int out_feat = f0; out_feat < f1; out_feat += FB)
+            conv_block_avx2<FB, 1, false>(layer, input, h, output, out_feat, y, x, AVX2_VL);
+    if (x < x_end)
+        for (int out_feat = f0; out_feat < f1; out_feat += FB)
+            conv_block_avx2<FB, 1, true>(layer, input, h, output, out_feat, y, x, x_end - x);
+}
+
+AVX2_TARGET void conv_direct_avx2(const conv_layer_t *layer,
+                                  ftmap_view_t        input,
+                                  int                 h,
+                                  int                 w,
+                                  ftmap_view_t        output,
+                                  int                 f0,
+                                  int                 f1,
+                                  int                 y0,
+                                  int                 y1,
+                                  int                 x0,
+                                  int                 x1)
+{
+    int padding = layer->f/2;
+    int interior_begin = x0 > padding ? x0 : padding;
+    if (interior_begin > x1)
+        interior_begin = x1;
+    int interior_end = x1 < w - padding ? x1 : w - padding;
+    if (interior_end < interior_begin)
+        interior_end = interior_begin;
+
+    // features in blocks of 4 where possible, the rest one at a time
+    int f_blocked = f0 + (f1 - f0)/4*4;
+
+    for (int y = y0; y < y1; y++) {
+        if (f_blocked > f0)
+            conv_row_avx2<4, 2>(layer, input, h, output, f0, f_blocked, y, interior_begin, interior_end);
+        if (f_blocked < f1)
+            conv_row_avx2<1, 4>(layer, input, h, output, f_blocked, f1, y, interior_begin, interior_end);
+
+        // border columns take the scalar path
+        conv_direct_scalar(layer, input, h, w, output, f0, f1, y, y + 1, x0, interior_begin);
+        conv_direct_scalar(layer, input, h, w, output, f0, f1, y, y + 1, interior_end, x1);
+    }
+}
+
+// 8 x 8 micro-kernel: one B vector and eight broadcast A values per step
+AVX2_TARGET static void gemm_ukernel_avx2(int          kc,
+                                          const float *a,
+                                          const float *b,
+                                          float       *c,
+                                          int          load_c)
+{
+    __m256 acc[8];
+
+    for (int i = 0; i < 8; i++)
+        acc[i] = load_c ? _mm256_loadu_ps(c + i*8) : _mm256_setzero_ps();
+
+    for (int p = 0; p < kc; p++) {
+        __m256 bv = _mm256_loadu_ps(b);
+        for (int i = 0; i < 8; i++)
+            acc[i] = _mm256_fmadd_ps(_mm256_broadcast_ss(a + i), bv, acc[i]);
+        a += 8;
+        b += 8;
+    }
+
+    for (int i = 0; i < 8; i++)
+        _mm256_storeu_ps(c + i*8, acc[i]);
+}
+
+const gemm_kernel_t gemm_kernel_avx2 = { "avx2", 8, 8, gemm_ukernel_avx2 };
+
+#else
+
+// no AVX2 on this architecture: simd_detect() never selects it
+void conv_direct_avx2(const conv_layer_t *layer,
+                      ftmap_view_t        input,
+                      int                 h,
+                      int                 w,
+                      ftmap_view_t        output,
+                      int                 f0,
+                      int                 f1,
+                      int                 y0,
+                      int                 y1,
+                      int                 x0,
+                      int                 x1)
+{
+    conv_direct_scalar(layer, input, h, w, output, f0, f1, y0, y1, x0, x1);
+}
+
+#endif
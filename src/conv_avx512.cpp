@@ -0,0 +1,189 @@
+#include "simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// GCC 12 warns about _mm512_undefined_ps() inside the intrinsic headers (PR 105593)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+#include <immintrin.h>
+
+#define AVX512_TARGET __attribute__((target("avx512f")))
+#define AVX512_VL 16  // floats per vector
+
+static inline int clamp_index(int i, int n)
+{
+    return i < 0 ? 0 : (i > n - 1 ? n - 1 : i);
+}
+
+// FB output features x XB vectors of adjacent output columns, all in registers:
+// every input vector is loaded once per tap and reused for FB broadcast weights.
+// With TAIL set only the first lanes columns of the last vector are loaded and
+// stored, so a row tail gets the same FMA sequence as full vectors and results
+// do not depend on where a column range starts.
+template <int FB, int XB, bool TAIL>
+AVX512_TARGET static void conv_block_avx512(const conv_layer_t *layer,
+                                            ftmap_view_t        input,
+                                            int                 h,
+                                            ftmap_view_t        output,
+                                            int                 out_feat,
+                                            int                 y,
+                                            int                 x,
+                                            int                 lanes)
+{
+    int nin = layer->nin;
+    int f = layer->f;
+    int taps = f*f;
+    int padding = f/2;
+    __mmask16 mask = TAIL ? (__mmask16) ((1u << lanes) - 1) : (__mmask16) 0xffff;
+    __m512 acc[FB][XB];
+
+    for (int fi = 0; fi < FB; fi++)
+        for (int xi = 0; xi < XB; xi++)
+            acc[fi][xi] = _mm512_setzero_ps();
+
+    for (int in_feat = 0; in_feat < nin; in_feat++) {
+        const param_t *weights = layer->weights + ((long) out_feat*nin + in_feat)*taps;
+        for (int kernel_x = 0; kernel_x < f; kernel_x++) {
+            for (int kernel_y = 0; kernel_y < f; kernel_y++) {
+                const ftmap_t *src = input.data + in_feat*input.plane
+                    + (long) (clamp_index(y + kernel_y - padding, h) - input.y0)*input.stride
+                    + (x + kernel_x - padding - input.x0);
+                __m512 v[XB];
+                for (int xi = 0; xi < XB; xi++)
+                    v[xi] = TAIL && xi == XB - 1 ? _mm512_maskz_loadu_ps(mask, src + xi*AVX512_VL)
+                                                 : _mm512_loadu_ps(src + xi*AVX512_VL);
+                for (int fi = 0; fi < FB; fi++) {
+                    __m512 wv = _mm512_set1_ps(weights[(long) fi*nin*taps + kernel_y*f + kernel_x]);
+                    for (int xi = 0; xi < XB; xi++)
+                        acc[fi][xi] = _mm512_fmadd_ps(wv, v[xi], acc[fi][xi]);
+                }
+            }
+        }
+    }
+
+    __m512 zero = _mm512_setzero_ps();
+    for (int fi = 0; fi < FB; fi++) {
+        __m512 bias = _mm512_set1_ps(layer->biases[out_feat + fi]);
+        ftmap_t *dst = output.data + (out_feat + fi)*output.plane
+            + (long) (y - output.y0)*output.stride + (x - output.x0);
+        for (int xi = 0; xi < XB; xi++) {
+            __m512 result = _mm512_max_ps(zero, _mm512_add_ps(acc[fi][xi], bias));
+            if (TAIL && xi == XB - 1)
+                _mm512_mask_storeu_ps(dst + xi*AVX512_VL, mask, result);
+            else
+                _mm512_storeu_ps(dst + xi*AVX512_VL, result);
+        }
+    }
+}
+
+// runs block kernel over the interior [x_begin, x_end) of one row for features [f0, f1)
+template <int FB, int XB>
+AVX512_TARGET static void conv_row_avx512(const conv_layer_t *layer,
+                                         ftmap_view_t        input,
+                                         int                 h,
+                                         ftmap_view_t        output,
+                                         int                 f0,
+                                         int                 f1,
+                                         int                 y,
+                                         int                 x_begin,
+                                         int                 x_end)
+{
+    int x = x_begin;
+    for (; x + XB*AVX512_VL <= x_end; x += XB*AVX512_VL)
+        for (int out_feat = f0; out_feat < f1; out_feat += FB)
+            conv_block_avx512<FB, XB, false>(layer, input, h, output, out_feat, y, x, AVX512_VL);
+    for (; x + AVX512_VL <= x_end; x += AVX512_VL)
+        for (int out_feat = f0; out_feat < f1; out_feat += FB)
+            conv_block_avx512<FB, 1, false>(layer, input, h, output, out_feat, y, x, AVX512_VL);
+    if (x < x_end)
+        for (int out_feat = f0; out_feat < f1; out_feat += FB)
+            conv_block_avx512<FB, 1, true>(layer, input, h, output, out_feat, y, x, x_end - x);
+}
+
+AVX512_TARGET void conv_direct_avx512(const conv_layer_t *layer,
+                                      ftmap_view_t        input,
+                                      int                 h,
+                                      int                 w,
+                                      ftmap_view_t        output,
+                                      int                 f0,
+                                      int                 f1,
+                                      int                 y0,
+                                      int                 y1,
+                                      int                 x0,
+                                      int                 x1)
+{
+    int padding = layer->f/2;
+    int interior_begin = x0 > padding ? x0 : padding;
+    if (interior_begin > x1)
+        interior_begin = x1;
+    int interior_end = x1 < w - padding ? x1 : w - padding;
+    if (interior_end < interior_begin)
+        interior_end = interior_begin;
+
+    // features in blocks of 8 where possible, the rest one at a time
+    int f_blocked = f0 + (f1 - f0)/8*8;
+
+    for (int y = y0; y < y1; y++) {
+        if (f_blocked > f0)
+            conv_row_avx512<8, 2>(layer, input, h, output, f0, f_blocked, y, interior_begin, interior_end);
+        if (f_blocked < f1)
+            conv_row_avx512<1, 4>(layer, input, h, output, f_blocked, f1, y, interior_begin, interior_end);
+
+        // border columns take the scalar path
+        conv_direct_scalar(layer, input, h, w, output, f0, f1, y, y + 1, x0, interior_begin);
+        conv_direct_scalar(layer, input, h, w, output, f0, f1, y, y + 1, interior_end, x1);
+    }
+}
+
+// 8 x 32 micro-kernel: two B vectors and eight broadcast A values per step
+AVX512_TARGET static void gemm_ukernel_avx512(int          kc,
+                                              const float *a,
+                                              const float *b,
+                                              float       *c,
+                                              int          load_c)
+{
+    __m512 acc[8][2];
+
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 2; j++)
+            acc[i][j] = load_c ? _mm512_loadu_ps(c + i*32 + j*16) : _mm512_setzero_ps();
+
+    for (int p = 0; p < kc; p++) {
+        __m512 b0 = _mm512_loadu_ps(b);
+        __m512 b1 = _mm512_loadu_ps(b + 16);
+        for (int i = 0; i < 8; i++) {
+            __m512 av = _mm512_set1_ps(a[i]);
+            acc[i][0] = _mm512_fmadd_ps(av, b0, acc[i][0]);
+            acc[i][1] = _mm512_fmadd_ps(av, b1, acc[i][1]);
+        }
+        a += 8;
+        b += 32;
+    }
+
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 2; j++)
+            _mm512_storeu_ps(c + i*32 + j*16, acc[i][j]);
+}
+
+const gemm_kernel_t gemm_kernel_avx512 = { "avx512", 8, 32, gemm_ukernel_avx512 };
+
+#else
+
+// no AVX-512 on this architecture: simd_detect() never selects it
+void conv_direct_avx512(const conv_layer_t *layer,
+                        ftmap_view_t        input,
+                        int                 h,
+                        int                 w,
+                        ftmap_view_t        output,
+                        int                 f0,
+                        int                 f1,
+                        int                 y0,
+                        int                 y1,
+                        int                 x0,
+                        int                 x1)
+{
+    conv_direct_scalar(layer, input, h, w, output, f0, f1, y0, y1, x0, x1);
+}
+
+#endif
@@ -0,0 +1,104 @@
+#include <math.h>
+
+#include "kernels.h"
+#include "simd.h"
+
+// columns of accumulators kept on the stack per pass
+#define DIRECT_CHUNK 256
+
+static inline int clamp_index(int i, int n)
+{
+    return i < 0 ? 0 : (i > n - 1 ? n - 1 : i);
+}
+
+ftmap_view_t ftmap_view(const ftmap_t *ftmap, int h, int w)
+{
+    ftmap_view_t view = { (ftmap_t *) ftmap, (long) h*w, w, 0, 0 };
+    return view;
+}
+
+// portable direct convolution: same tap order and interior/border split as conv*_row
+void conv_direct_scalar(const conv_layer_t *layer,
+                        ftmap_view_t        input,
+                        int                 h,
+                        int                 w,
+                        ftmap_view_t        output,
+                        int                 f0,
+                        int                 f1,
+                        int                 y0,
+                        int                 y1,
+                        int                 x0,
+                        int                 x1)
+{
+    int nin = layer->nin;
+    int f = layer->f;
+    int padding = f/2;
+    float convolution[DIRECT_CHUNK];
+
+    for (int y = y0; y < y1; y++) {
+        for (int out_feat = f0; out_feat < f1; out_feat++) {
+            const param_t *weights = layer->weights + (long) out_feat*nin*f*f;
+            float feat_bias = layer->biases[out_feat];
+            ftmap_t *output_row = output.data + out_feat*output.plane + (long) (y - output.y0)*output.stride - output.x0;
+
+            for (int cx0 = x0; cx0 < x1; cx0 += DIRECT_CHUNK) {
+                int cx1 = x1 - cx0 < DIRECT_CHUNK ? x1 : cx0 + DIRECT_CHUNK;
+                int interior_begin = cx0 > padding ? cx0 : padding;
+                int interior_end = cx1 < w - padding ? cx1 : w - padding;
+                if (interior_end < interior_begin)
+                    interior_end = interior_begin;
+                float *acc = convolution - cx0;
+
+                for (int x = cx0; x < cx1; x++)
+                    acc[x] = 0;
+
+                for (int in_feat = 0; in_feat < nin; in_feat++) {
+                    for (int kernel_x = 0; kernel_x < f; kernel_x++) {
+                        for (int kernel_y = 0; kernel_y < f; kernel_y++) {
+                            float weight = weights[(in_feat*f + kernel_y)*f + kernel_x];
+                            const ftmap_t *input_row = input.data + in_feat*input.plane
+                                + (long) (clamp_index(y + kernel_y - padding, h) - input.y0)*input.stride - input.x0;
+
+                            // border columns: edge extension in x per tap
+                            for (int x = cx0; x < interior_begin && x < cx1; x++)
+                                acc[x] += weight*input_row[clamp_index(x + kernel_x - padding, w)];
+                            // interior columns
+                            for (int x = interior_begin; x < interior_end; x++)
+                                acc[x] += weight*input_row[x + kernel_x - padding];
+                            for (int x = interior_end > cx0 ? interior_end : cx0; x < cx1; x++)
+                                acc[x] += weight*input_row[clamp_index(x + kernel_x - padding, w)];
+                        }
+                    }
+                }
+
+                for (int x = cx0; x < cx1; x++)
+                    output_row[x] = fmaxf(0, acc[x] + feat_bias);
+            }
+        }
+    }
+}
+
+void conv_direct(const conv_layer_t *layer,
+                 ftmap_view_t        input,
+                 int                 h,
+                 int                 w,
+                 ftmap_view_t        output,
+                 int                 f0,
+                 int                 f1,
+                 int                 y0,
+                 int                 y1,
+                 int                 x0,
+                 int                 x1)
+{
+    switch (simd_isa()) {
+    case SIMD_ISA_AVX512:
+        conv_direct_avx512(layer, input, h, w, output, f0, f1, y0, y1, x0, x1);
+        break;
+    case SIMD_ISA_AVX2:
+        conv_direct_avx2(layer, input, h, w, output, f0, f1, y0, y1, x0, x1);
+        break;
+    default:
+        conv_direct_scalar(layer, input, h, w, output, f0, f1, y0, y1, x0, x1);
+        break;
+    }
+}
@@ -0,0 +1,376 @@
+#include <math.h>
+#include <string.h>
+
+#include <vector>
+
+#include "kernels.h"
+#include "simd.h"
+
+#if N0 != 1 || N1 % 2 != 0
+#error "conv1_fft expects one input feature and an even number of filters"
+#endif
+
+// transform size of a tile (a power of two) and the output rows and columns
+// a tile yields; its other F1 - 1 wrap around in the circular convolution
+#define FFT_SIZE   CONV1_FFT_TILE
+#define FFT_POINTS (FFT_SIZE*FFT_SIZE)
+#define FFT_VALID  (FFT_SIZE - F1 + 1)
+
+// the transform code is written once over simd_vec<VL> and instantiated with
+// the vector width of each target
+typedef simd_vec<4>::type fft_vec4_t;
+
+#if FFT_SIZE % 16 != 0
+#error "the FFT tile must be a multiple of the widest vector"
+#endif
+
+#define FFT_INLINE static inline __attribute__((always_inline))
+
+// exp(-i*pi*j/span) at [span + j], for every butterfly span of the transform
+struct fft_twiddles_t {
+    float re[FFT_SIZE];
+    float im[FFT_SIZE];
+};
+
+static const fft_twiddles_t *fft_twiddles()
+{
+    static const fft_twiddles_t table = []() {
+        fft_twiddles_t t;
+        t.re[0] = 1;
+        t.im[0] = 0;
+        for (int span = 1; span < FFT_SIZE; span *= 2) {
+            for (int j = 0; j < span; j++) {
+                double angle = -M_PI*j/span;
+                t.re[span + j] = (float) cos(angle);
+                t.im[span + j] = (float) sin(angle);
+            }
+        }
+        return t;
+    }();
+    return &table;
+}
+
+static inline int clamp_index(int i, int n)
+{
+    return i < 0 ? 0 : (i > n - 1 ? n - 1 : i);
+}
+
+// FFT_SIZE-point transforms down the columns of a FFT_SIZE x FFT_SIZE
+// split-complex block, one VEC of columns at a time. Decimation in frequency:
+// rows in natural order, results in bit-reversed order.
+template <int VL>
+FFT_INLINE void fft_columns_forward(float *re, float *im, const fft_twiddles_t *tw)
+{
+    typedef typename simd_vec<VL>::type VEC;
+    for (int span = FFT_SIZE/2; span >= 1; span /= 2) {
+        for (int b = 0; b < FFT_SIZE; b += 2*span) {
+            for (int j = 0; j < span; j++) {
+                float wr = tw->re[span + j];
+                float wi = tw->im[span + j];
+                VEC *ar = (VEC *) (re + (b + j)*FFT_SIZE);
+                VEC *ai = (VEC *) (im + (b + j)*FFT_SIZE);
+                VEC *cr = (VEC *) (re + (b + j + span)*FFT_SIZE);
+                VEC *ci = (VEC *) (im + (b + j + span)*FFT_SIZE);
+                for (int v = 0; v < FFT_SIZE/VL; v++) {
+                    VEC dr = ar[v] - cr[v];
+                    VEC di = ai[v] - ci[v];
+                    ar[v] += cr[v];
+                    ai[v] += ci[v];
+                    cr[v] = dr*wr - di*wi;
+                    ci[v] = dr*wi + di*wr;
+                }
+            }
+        }
+    }
+}
+
+// unscaled inverse of fft_columns_forward(): decimation in time with the
+// conjugate twiddles, bit-reversed rows in, natural order out
+template <int VL>
+FFT_INLINE void fft_columns_inverse(float *re, float *im, const fft_twiddles_t *tw)
+{
+    typedef typename simd_vec<VL>::type VEC;
+    for (int span = 1; span < FFT_SIZE; span *= 2) {
+        for (int b = 0; b < FFT_SIZE; b += 2*span) {
+            for (int j = 0; j < span; j++) {
+                float wr = tw->re[span + j];
+                float wi = -tw->im[span + j];
+                VEC *ar = (VEC *) (re + (b + j)*FFT_SIZE);
+                VEC *ai = (VEC *) (im + (b + j)*FFT_SIZE);
+                VEC *cr = (VEC *) (re + (b + j + span)*FFT_SIZE);
+                VEC *ci = (VEC *) (im + (b + j + span)*FFT_SIZE);
+                for (int v = 0; v < FFT_SIZE/VL; v++) {
+                    VEC tr = cr[v]*wr - ci[v]*wi;
+                    VEC ti = cr[v]*wi + ci[v]*wr;
+                    cr[v] = ar[v] - tr;
+                    ci[v] = ai[v] - ti;
+                    ar[v] += tr;
+                    ai[v] += ti;
+                }
+            }
+        }
+    }
+}
+
+// 4 x 4 blocks for the transposes, transposed with in-register shuffles
+typedef int fft_idx4_t __attribute__((vector_size(16)));
+
+// transpose of 4 rows of 4 floats
+FFT_INLINE void fft_transpose4(fft_vec4_t r[4])
+{
+    const fft_idx4_t lo = { 0, 4, 1, 5 }, hi = { 2, 6, 3, 7 };
+    const fft_idx4_t first = { 0, 1, 4, 5 }, second = { 2, 3, 6, 7 };
+    fft_vec4_t t0 = __builtin_shuffle(r[0], r[1], lo);
+    fft_vec4_t t1 = __builtin_shuffle(r[0], r[1], hi);
+    fft_vec4_t t2 = __builtin_shuffle(r[2], r[3], lo);
+    fft_vec4_t t3 = __builtin_shuffle(r[2], r[3], hi);
+    r[0] = __builtin_shuffle(t0, t2, first);
+    r[1] = __builtin_shuffle(t0, t2, second);
+    r[2] = __builtin_shuffle(t1, t3, first);
+    r[3] = __builtin_shuffle(t1, t3, second);
+}
+
+// in-place transpose of a FFT_SIZE x FFT_SIZE block: the 4 x 4 blocks (i, j)
+// and (j, i) are transposed and swapped
+FFT_INLINE void fft_transpose(float *block)
+{
+    for (int i = 0; i < FFT_SIZE; i += 4) {
+        for (int j = i; j < FFT_SIZE; j += 4) {
+            fft_vec4_t *upper = (fft_vec4_t *) (block + i*FFT_SIZE + j);
+            fft_vec4_t *lower = (fft_vec4_t *) (block + j*FFT_SIZE + i);
+            fft_vec4_t u[4], l[4];
+            for (int r = 0; r < 4; r++) {
+                u[r] = upper[r*FFT_SIZE/4];
+                l[r] = lower[r*FFT_SIZE/4];
+            }
+            fft_transpose4(u);
+            fft_transpose4(l);
+            for (int r = 0; r < 4; r++) {
+                upper[r*FFT_SIZE/4] = l[r];
+                lower[r*FFT_SIZE/4] = u[r];
+            }
+        }
+    }
+}
+
+// 2-D transform of a block in [y][x] order into spectrum order: [kx][ky],
+// both bit reversed. Products of two spectra in this order go straight back
+// through fft_inverse().
+template <int VL>
+FFT_INLINE void fft_forward(float *re, float *im, const fft_twiddles_t *tw)
+{
+    fft_columns_forward<VL>(re, im, tw);
+    fft_transpose(re);
+    fft_transpose(im);
+    fft_columns_forward<VL>(re, im, tw);
+}
+
+// unscaled 2-D inverse of fft_forward(), back to [y][x] order
+template <int VL>
+FFT_INLINE void fft_inverse(float *re, float *im, const fft_twiddles_t *tw)
+{
+    fft_columns_inverse<VL>(re, im, tw);
+    fft_transpose(re);
+    fft_transpose(im);
+    fft_columns_inverse<VL>(re, im, tw);
+}
+
+// overlap-save tile at (y0, x0): pixel (i, j) of the tile is input pixel
+// (y0 + i - F1/2, x0 + j - F1/2), edge extended like the direct kernels
+FFT_INLINE void fft_load_tile(ftmap_view_t input, int h, int w, int y0, int x0, float *re, float *im)
+{
+    int xs = x0 - F1/2;
+    bool inside = xs >= 0 && xs + FFT_SIZE <= w;
+    for (int i = 0; i < FFT_SIZE; i++) {
+        int y = clamp_index(y0 + i - F1/2, h);
+        const ftmap_t *row = input.data + (long) (y - input.y0)*input.stride - input.x0;
+        float *dst = re + i*FFT_SIZE;
+        if (inside) {
+            memcpy(dst, row + xs, FFT_SIZE*sizeof(float));
+        } else {
+            for (int j = 0; j < FFT_SIZE; j++)
+                dst[j] = row[clamp_index(xs + j, w)];
+        }
+    }
+    memset(im, 0, FFT_POINTS*sizeof(float));
+}
+
+// every tile of the image: one forward transform of the tile, then per
+// filter pair a pointwise product with the pair's spectrum and one inverse
+// transform whose real part is the first filter and imaginary part the second
+template <int VL>
+FFT_INLINE void conv1_fft_tiles(ftmap_view_t   input,
+                                const float   *spectra,
+                                const param_t *conv1_biases,
+                                int            h,
+                                int            w,
+                                ftmap_view_t   output,
+                                float         *workspace)
+{
+    typedef typename simd_vec<VL>::type VEC;
+    const fft_twiddles_t *tw = fft_twiddles();
+    float *tile_re = workspace;
+    float *tile_im = workspace + FFT_POINTS;
+    float *prod_re = workspace + 2*FFT_POINTS;
+    float *prod_im = workspace + 3*FFT_POINTS;
+    const VEC zero = {};
+
+    for (int y0 = 0; y0 < h; y0 += FFT_VALID) {
+        int rows = h - y0 < FFT_VALID ? h - y0 : FFT_VALID;
+        for (int x0 = 0; x0 < w; x0 += FFT_VALID) {
+            int cols = w - x0 < FFT_VALID ? w - x0 : FFT_VALID;
+
+            fft_load_tile(input, h, w, y0, x0, tile_re, tile_im);
+            fft_forward<VL>(tile_re, tile_im, tw);
+
+            for (int pair = 0; pair < N1/2; pair++) {
+                const VEC *xr = (const VEC *) tile_re;
+                const VEC *xi = (const VEC *) tile_im;
+                const VEC *hr = (const VEC *) (spectra + (long) pair*2*FFT_POINTS);
+                const VEC *hi = (const VEC *) (spectra + (long) pair*2*FFT_POINTS + FFT_POINTS);
+                VEC *pr = (VEC *) prod_re;
+                VEC *pi = (VEC *) prod_im;
+                for (int v = 0; v < FFT_POINTS/VL; v++) {
+                    pr[v] = xr[v]*hr[v] - xi[v]*hi[v];
+                    pi[v] = xr[v]*hi[v] + xi[v]*hr[v];
+                }
+                fft_inverse<VL>(prod_re, prod_im, tw);
+
+                for (int half = 0; half < 2; half++) {
+                    int out_feat = 2*pair + half;
+                    const float *src = half ? prod_im : prod_re;
+                    float bias = conv1_biases[out_feat];
+                    ftmap_t *dst = output.data + out_feat*output.plane
+                                 + (long) (y0 - output.y0)*output.stride + (x0 - output.x0);
+                    for (int p = 0; p < rows; p++) {
+                        const float *src_row = src + p*FFT_SIZE;
+                        ftmap_t *dst_row = dst + (long) p*output.stride;
+                        int q = 0;
+                        for (; q + VL <= cols; q += VL) {
+                            VEC result = *(const VEC *) (src_row + q) + bias;
+                            *(VEC *) (dst_row + q) = result > zero ? result : zero;
+                        }
+                        for (; q < cols; q++) {
+                            float result = src_row[q] + bias;
+                            dst_row[q] = result > 0 ? result : 0;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void conv1_fft_default(ftmap_view_t   input,
+                              const float   *spectra,
+                              const param_t *conv1_biases,
+                              int            h,
+                              int            w,
+                              ftmap_view_t   output,
+                              float         *workspace)
+{
+    conv1_fft_tiles<4>(input, spectra, conv1_biases, h, w, output, workspace);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma")))
+static void conv1_fft_avx2(ftmap_view_t   input,
+                           const float   *spectra,
+                           const param_t *conv1_biases,
+                           int            h,
+                           int            w,
+                           ftmap_view_t   output,
+                           float         *workspace)
+{
+    conv1_fft_tiles<8>(input, spectra, conv1_biases, h, w, output, workspace);
+}
+
+__attribute__((target("avx512f")))
+static void conv1_fft_avx512(ftmap_view_t   input,
+                             const float   *spectra,
+                             const param_t *conv1_biases,
+                             int            h,
+                             int            w,
+                             ftmap_view_t   output,
+                             float         *workspace)
+{
+    conv1_fft_tiles<16>(input, spectra, conv1_biases, h, w, output, workspace);
+}
+#endif
+
+size_t conv1_fft_spectra_size()
+{
+    return (size_t) N1*FFT_POINTS;
+}
+
+size_t conv1_fft_workspace_size()
+{
+    return (size_t) 4*FFT_POINTS;
+}
+
+// conv1_preferred() picks the FFT for images at least FFT_MIN_SIDE rows and
+// columns in size, and GEMM below. A tile costs the same however little of
+// it lies inside the image, so strips a few rows high are cheaper with GEMM.
+// In the tb_fft crossover table the FFT wins from 16 rows on the scalar and
+// AVX2 kernels, but the AVX-512 GEMM micro-kernel stays ahead up to 24x24
+// and ties at 16 rows. GEMM also beats the direct kernel at every size of
+// that table, so direct is never picked.
+#define FFT_MIN_SIDE        16
+#define FFT_MIN_SIDE_AVX512 32
+
+conv1_kernel_t conv1_preferred(int h, int w)
+{
+    int side = simd_isa() == SIMD_ISA_AVX512 ? FFT_MIN_SIDE_AVX512 : FFT_MIN_SIDE;
+    return h >= side && w >= side ? CONV1_FFT : CONV1_GEMM;
+}
+
+void conv1_fft_prepare(const param_t *conv1_weights, float *spectra)
+{
+    const fft_twiddles_t *tw = fft_twiddles();
+    for (int pair = 0; pair < N1/2; pair++) {
+        float *re = spectra + (long) pair*2*FFT_POINTS;
+        float *im = re + FFT_POINTS;
+        memset(re, 0, 2*FFT_POINTS*sizeof(float));
+
+        // correlation as a circular convolution: tap (ky, kx) goes to
+        // (-ky, -kx) mod FFT_SIZE, the 1/FFT_POINTS of the inverse folded in
+        for (int half = 0; half < 2; half++) {
+            const param_t *weights = conv1_weights + (2*pair + half)*F1*F1;
+            float *dst = half ? im : re;
+            for (int ky = 0; ky < F1; ky++)
+                for (int kx = 0; kx < F1; kx++)
+                    dst[((FFT_SIZE - ky) % FFT_SIZE)*FFT_SIZE + (FFT_SIZE - kx) % FFT_SIZE] =
+                        weights[ky*F1 + kx]/FFT_POINTS;
+        }
+        fft_forward<4>(re, im, tw);
+    }
+}
+
+void conv1_fft(ftmap_view_t   input,
+               const float   *spectra,
+               const param_t *conv1_biases,
+               int            h,
+               int            w,
+               ftmap_view_t   output,
+               float         *workspace)
+{
+    std::vector<float> scratch;
+    if (!workspace) {
+        scratch.resize(conv1_fft_workspace_size());
+        workspace = scratch.data();
+    }
+
+    switch (simd_isa()) {
+#if defined(__x86_64__) || defined(__i386__)
+    case SIMD_ISA_AVX512:
+        conv1_fft_avx512(input, spectra, conv1_biases, h, w, output, workspace);
+        break;
+    case SIMD_ISA_AVX2:
+        conv1_fft_avx2(input, spectra, conv1_biases, h, w, output, workspace);
+        break;
+#endif
+    default:
+        conv1_fft_default(input, spectra, conv1_biases, h, w, output, workspace);
+        break;
+    }
+}
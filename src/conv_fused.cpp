@@ -0,0 +1,221 @@
+#include <string.h>
+
+#include <vector>
+
+#include "kernels.h"
+#include "simd.h"
+
+#if F2 != 1 || N3 != 1
+#error "conv23_fused expects a 1x1 conv2 and a single conv3 output feature"
+#endif
+
+// conv3 taps per pixel and the columns each ring row is edge extended by
+#define FUSED_TAPS (F3*F3)
+#define FUSED_PAD  (F3/2)
+
+#define FUSED_INLINE static inline __attribute__((always_inline))
+
+static inline int clamp_index(int i, int n)
+{
+    return i < 0 ? 0 : (i > n - 1 ? n - 1 : i);
+}
+
+// floats per ring row: the image row, its edge extension and room for the
+// full-vector store of the last columns
+static int fused_row_length(int w)
+{
+    return (w + 2*FUSED_PAD + 16 + 15)/16*16;
+}
+
+size_t conv23_fused_workspace_size(int w)
+{
+    return (size_t) F3*FUSED_TAPS*fused_row_length(w);
+}
+
+// conv2 of VL adjacent pixels of row y, reduced on the spot to conv3's tap
+// partial sums: taps[t][x] = sum over c of conv3_weights[c][t]*relu(conv2)[c][x].
+// The N2 activations of each pixel only live in registers.
+template <int VL>
+FUSED_INLINE void conv23_pixels(ftmap_view_t   input,
+                                const param_t *conv2_weights,
+                                const param_t *conv2_biases,
+                                const param_t *conv3_weights,
+                                int            y,
+                                int            x,
+                                int            lanes,
+                                float         *taps,
+                                int            row_length)
+{
+    typedef typename simd_vec<VL>::type VEC;
+    const ftmap_t *src = input.data + (long) (y - input.y0)*input.stride + (x - input.x0);
+    VEC act[N2];
+
+    for (int c = 0; c < N2; c++) {
+        VEC bias = {};
+        act[c] = bias + conv2_biases[c];
+    }
+    for (int i = 0; i < N1; i++) {
+        VEC v = {};
+        if (lanes == VL)
+            v = *(const VEC *) (src + i*input.plane);
+        else
+            memcpy(&v, src + i*input.plane, lanes*sizeof(float));
+        for (int c = 0; c < N2; c++)
+            act[c] += conv2_weights[c*N1 + i]*v;
+    }
+
+    const VEC zero = {};
+    for (int c = 0; c < N2; c++)
+        act[c] = act[c] > zero ? act[c] : zero;
+
+    // lanes past the row end land in the ring row's slack and are overwritten
+    // by the edge extension
+    for (int t = 0; t < FUSED_TAPS; t++) {
+        VEC sum = zero;
+        for (int c = 0; c < N2; c++)
+            sum += conv3_weights[c*FUSED_TAPS + t]*act[c];
+        *(VEC *) (taps + (long) t*row_length + FUSED_PAD + x) = sum;
+    }
+}
+
+// output row y from the ring rows of the F3 conv2 rows around it: the sum
+// over taps (ky, kx) of the partials of pixel (y + ky - F3/2, x + kx - F3/2)
+template <int VL>
+FUSED_INLINE void conv23_gather(float *const   rows[F3],
+                                int            row_length,
+                                param_t        bias,
+                                int            w,
+                                ftmap_t       *dst)
+{
+    typedef typename simd_vec<VL>::type VEC;
+    const VEC zero = {};
+    for (int x = 0; x < w; x += VL) {
+        VEC sum = zero + bias;
+        for (int ky = 0; ky < F3; ky++)
+            for (int kx = 0; kx < F3; kx++)
+                sum += *(const VEC *) (rows[ky] + (long) (ky*F3 + kx)*row_length + x + kx);
+        sum = sum > zero ? sum : zero;
+        if (x + VL <= w)
+            *(VEC *) (dst + x) = sum;
+        else
+            memcpy(dst + x, &sum, (w - x)*sizeof(float));
+    }
+}
+
+// conv2 rows are produced top to bottom into a ring of F3 slots; output row
+// y is gathered once conv2 row min(y + F3/2, h - 1) is in the ring, by which
+// time the oldest row it needs, max(y - F3/2, 0), is still there
+template <int VL>
+FUSED_INLINE void conv23_rows(ftmap_view_t   input,
+                              const param_t *conv2_weights,
+                              const param_t *conv2_biases,
+                              const param_t *conv3_weights,
+                              const param_t *conv3_biases,
+                              int            h,
+                              int            w,
+                              ftmap_view_t   output,
+                              float         *ring)
+{
+    int row_length = fused_row_length(w);
+    long slot_size = (long) FUSED_TAPS*row_length;
+    int produced = 0;   // conv2 rows [0, produced) have been through the ring
+
+    for (int y = 0; y < h; y++) {
+        int last = y + FUSED_PAD < h ? y + FUSED_PAD : h - 1;
+        for (; produced <= last; produced++) {
+            float *taps = ring + (produced % F3)*slot_size;
+            for (int x = 0; x < w; x += VL)
+                conv23_pixels<VL>(input, conv2_weights, conv2_biases, conv3_weights, produced, x,
+                                  w - x < VL ? w - x : VL, taps, row_length);
+            // edge extension in x
+            for (int t = 0; t < FUSED_TAPS; t++) {
+                float *row = taps + (long) t*row_length;
+                for (int p = 0; p < FUSED_PAD; p++) {
+                    row[p] = row[FUSED_PAD];
+                    row[FUSED_PAD + w + p] = row[FUSED_PAD + w - 1];
+                }
+            }
+        }
+
+        // edge extension in y
+        float *rows[F3];
+        for (int ky = 0; ky < F3; ky++)
+            rows[ky] = ring + (clamp_index(y + ky - FUSED_PAD, h) % F3)*slot_size;
+        conv23_gather<VL>(rows, row_length, conv3_biases[0], w,
+                          output.data + (long) (y - output.y0)*output.stride - output.x0);
+    }
+}
+
+static void conv23_fused_default(ftmap_view_t   input,
+                                 const param_t *conv2_weights,
+                                 const param_t *conv2_biases,
+                                 const param_t *conv3_weights,
+                                 const param_t *conv3_biases,
+                                 int            h,
+                                 int            w,
+                                 ftmap_view_t   output,
+                                 float         *ring)
+{
+    conv23_rows<4>(input, conv2_weights, conv2_biases, conv3_weights, conv3_biases, h, w, output, ring);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma")))
+static void conv23_fused_avx2(ftmap_view_t   input,
+                              const param_t *conv2_weights,
+                              const param_t *conv2_biases,
+                              const param_t *conv3_weights,
+                              const param_t *conv3_biases,
+                              int            h,
+                              int            w,
+                              ftmap_view_t   output,
+                              float         *ring)
+{
+    conv23_rows<8>(input, conv2_weights, conv2_biases, conv3_weights, conv3_biases, h, w, output, ring);
+}
+
+__attribute__((target("avx512f")))
+static void conv23_fused_avx512(ftmap_view_t   input,
+                                const param_t *conv2_weights,
+                                const param_t *conv2_biases,
+                                const param_t *conv3_weights,
+                                const param_t *conv3_biases,
+                                int            h,
+                                int            w,
+                                ftmap_view_t   output,
+                                float         *ring)
+{
+    conv23_rows<16>(input, conv2_weights, conv2_biases, conv3_weights, conv3_biases, h, w, output, ring);
+}
+#endif
+
+void conv23_fused(ftmap_view_t   input,
+                  const param_t *conv2_weights,
+                  const param_t *conv2_biases,
+                  const param_t *conv3_weights,
+                  const param_t *conv3_biases,
+                  int            h,
+                  int            w,
+                  ftmap_view_t   output,
+                  float         *workspace)
+{
+    std::vector<float> scratch;
+    if (!workspace) {
+        scratch.resize(conv23_fused_workspace_size(w));
+        workspace = scratch.data();
+    }
+
+    switch (simd_isa()) {
+#if defined(__x86_64__) || defined(__i386__)
+    case SIMD_ISA_AVX512:
+        conv23_fused_avx512(input, conv2_weights, conv2_biases, conv3_weights, conv3_biases, h, w, output, workspace);
+        break;
+    case SIMD_ISA_AVX2:
+        conv23_fused_avx2(input, conv2_weights, conv2_biases, conv3_weights, conv3_biases, h, w, output, workspace);
+        break;
+#endif
+    default:
+        conv23_fused_default(input, conv2_weights, conv2_biases, conv3_weights, conv3_biases, h, w, output, workspace);
+        break;
+    }
+}
@@ -0,0 +1,336 @@
+#include <vector>
+
+#include "kernels.h"
+#include "gemm.h"
+
+// L2 budget for one band of the implicit patch matrix (K x band pixels)
+#define GEMM_BAND_BYTES (256*1024)
+
+// sub-buffers of a workspace start on cache-line boundaries
+#define GEMM_WORKSPACE_ALIGN 16
+
+#if F2 != 1
+#error "conv2_gemm expects a 1x1 conv2 kernel"
+#endif
+
+static size_t align_floats(size_t count)
+{
+    return (count + GEMM_WORKSPACE_ALIGN - 1)/GEMM_WORKSPACE_ALIGN*GEMM_WORKSPACE_ALIGN;
+}
+
+size_t conv2_gemm_workspace_size(int h, int w)
+{
+    (void) h;
+    (void) w;
+    return align_floats(conv2_gemm_weights_size()) + gemm_workspace_size(NULL);
+}
+
+size_t conv2_gemm_weights_size()
+{
+    return gemm_packed_a_size(NULL, N2, N1);
+}
+
+conv_gemm_weights_t conv2_gemm_pack(const param_t *conv2_weights, float *panels)
+{
+    const gemm_kernel_t *kernel = gemm_kernel();
+    gemm_matrix_t weights = { conv2_weights, N1*F2*F2, F2*F2 };
+    gemm_pack_a(kernel, weights, N2, N1, panels);
+
+    conv_gemm_weights_t packed = { kernel, panels };
+    return packed;
+}
+
+// runs conv2 as C[N2][pixels] = weights[N2][N1] * B[N1][pixels] with the
+// given input view and output strides
+static void conv2_sgemm(gemm_matrix_t              input,
+                        const param_t             *conv2_weights,
+                        const param_t             *conv2_biases,
+                        int                        pixels,
+                        ftmap_t                   *output_ftmap,
+                        long                       rs_c,
+                        long                       cs_c,
+                        float                     *workspace,
+                        const conv_gemm_weights_t *packed)
+{
+    const gemm_kernel_t *kernel = gemm_kernel();
+
+    std::vector<float> scratch;
+    if (!workspace) {
+        scratch.resize(conv2_gemm_workspace_size(0, 0));
+        workspace = scratch.data();
+    }
+    float *gemm_workspace = workspace + align_floats(conv2_gemm_weights_size());
+
+    // weights packed for another ISA are packed again
+    const float *packed_a = packed && packed->kernel == kernel ? packed->panels : NULL;
+    if (!packed_a)
+        packed_a = conv2_gemm_pack(conv2_weights, workspace).panels;
+
+    sgemm(kernel, N2, pixels, N1,
+          packed_a, gemm_pack_b_matrix, &input,
+          output_ftmap, rs_c, cs_c,
+          conv2_biases, 1, gemm_workspace);
+}
+
+// implements conv2 on planar maps: every input channel is one contiguous row of B
+void conv2_gemm(const ftmap_t             *input_ftmap,
+                const param_t             *conv2_weights,
+                const param_t             *conv2_biases,
+                int                        h,
+                int                        w,
+                ftmap_t                   *output_ftmap,
+                float                     *workspace,
+                const conv_gemm_weights_t *packed)
+{
+    gemm_matrix_t input = { input_ftmap, (long) h*w, 1 };
+    conv2_sgemm(input, conv2_weights, conv2_biases, h*w, output_ftmap, (long) h*w, 1, workspace, packed);
+}
+
+// implements conv2 on channel-last maps: every pixel is one contiguous column of B
+void conv2_gemm_nhwc(const ftmap_t             *input_ftmap,
+                     const param_t             *conv2_weights,
+                     const param_t             *conv2_biases,
+                     int                        h,
+                     int                        w,
+                     ftmap_t                   *output_ftmap,
+                     float                     *workspace,
+                     const conv_gemm_weights_t *packed)
+{
+    gemm_matrix_t input = { input_ftmap, 1, N1 };
+    conv2_sgemm(input, conv2_weights, conv2_biases, h*w, output_ftmap, 1, N2, workspace, packed);
+}
+
+// implicit im2col source: B[k][n] is tap k of pixel n of a band of output rows,
+// with k = (in_feat*f + kernel_x)*f + kernel_y to match the reference tap order.
+// The input is pre-padded with replicated edges, so every tap of a row of
+// output pixels is a contiguous run of a padded input row.
+struct conv_patch_src_t {
+    const ftmap_t *padded_ftmap;  // [nin][h + f - 1][w + f - 1]
+    int            h;
+    int            w;
+    int            f;
+    int            y0;
+};
+
+static inline int clamp_index(int i, int n)
+{
+    return i < 0 ? 0 : (i > n - 1 ? n - 1 : i);
+}
+
+// copies planar maps into a buffer padded by f/2 replicated pixels on each side
+static void conv_pad_input(const ftmap_t *input_ftmap,
+                           int            nin,
+                           int            h,
+                           int            w,
+                           int            f,
+                           ftmap_t       *padded_ftmap)
+{
+    int padding = f/2;
+    int ph = h + 2*padding;
+    int pw = w + 2*padding;
+
+    for (int in_feat = 0; in_feat < nin; in_feat++) {
+        for (int y = 0; y < ph; y++) {
+            const ftmap_t *src = input_ftmap + ((long) in_feat*h + clamp_index(y - padding, h))*w;
+            ftmap_t *dst = padded_ftmap + ((long) in_feat*ph + y)*pw;
+            for (int x = 0; x < pw; x++)
+                dst[x] = src[clamp_index(x - padding, w)];
+        }
+    }
+}
+
+// gathers patches from the padded input into packed B panels
+static void conv_pack_patches(const void *b_src,
+                              int         k0,
+                              int         kc,
+                              int         n0,
+                              int         nc,
+                              int         nr,
+                              float      *dst)
+{
+    const conv_patch_src_t *src = (const conv_patch_src_t *) b_src;
+    int w = src->w;
+    int f = src->f;
+    int ph = src->h + f - 1;
+    int pw = w + f - 1;
+    int padded_nc = (nc + nr - 1)/nr*nr;
+
+    for (int p = 0; p < kc; p++) {
+        int k = k0 + p;
+        int in_feat = k/(f*f);
+        int kernel_x = k/f%f;
+        int kernel_y = k%f;
+        const ftmap_t *plane = src->padded_ftmap + (long) in_feat*ph*pw + kernel_x;
+
+        // copy runs that are contiguous in both the padded row and the micro-panel
+        int y = src->y0 + n0/w;
+        int x = n0%w;
+        for (int n = 0; n < nc; ) {
+            const ftmap_t *input_row = plane + (long) (y + kernel_y)*pw;
+            int j = n%nr;
+            int run = w - x;
+            if (run > nr - j)
+                run = nr - j;
+            if (run > nc - n)
+                run = nc - n;
+
+            float *col = dst + ((long) (n/nr)*kc + p)*nr + j;
+            for (int i = 0; i < run; i++)
+                col[i] = input_row[x + i];
+
+            n += run;
+            x += run;
+            if (x == w) {
+                x = 0;
+                y++;
+            }
+        }
+        for (int n = nc; n < padded_nc; n++)
+            dst[((long) (n/nr)*kc + p)*nr + n%nr] = 0;
+    }
+}
+
+// scratch of conv_implicit_gemm: tap-ordered weights, packed weights, SGEMM
+// workspace and the padded input, in that order
+static size_t conv_implicit_gemm_workspace_size(int nin, int nout, int f, int h, int w)
+{
+    int k = nin*f*f;
+    return align_floats((size_t) nout*k)
+         + align_floats(gemm_packed_a_size(NULL, nout, k))
+         + align_floats(gemm_workspace_size(NULL))
+         + (size_t) nin*(h + f - 1)*(w + f - 1);
+}
+
+// packs weights[nout][nin*f*f] for the implicit GEMM, with the taps reordered
+// to (in_feat, kernel_x, kernel_y) so accumulation order matches conv*_row
+static conv_gemm_weights_t conv_implicit_gemm_pack(const param_t *weights,
+                                                   int            nin,
+                                                   int            nout,
+                                                   int            f,
+                                                   float         *tap_weights,
+                                                   float         *panels)
+{
+    const gemm_kernel_t *kernel = gemm_kernel();
+    int k = nin*f*f;
+
+    for (int out_feat = 0; out_feat < nout; out_feat++)
+        for (int in_feat = 0; in_feat < nin; in_feat++)
+            for (int kernel_x = 0; kernel_x < f; kernel_x++)
+                for (int kernel_y = 0; kernel_y < f; kernel_y++)
+                    tap_weights[(size_t) out_feat*k + (in_feat*f + kernel_x)*f + kernel_y] =
+                        weights[((out_feat*nin + in_feat)*f + kernel_y)*f + kernel_x];
+
+    gemm_matrix_t a = { tap_weights, k, 1 };
+    gemm_pack_a(kernel, a, nout, k, panels);
+
+    conv_gemm_weights_t packed = { kernel, panels };
+    return packed;
+}
+
+// implements a KxK convolution as an implicit GEMM over bands of output rows:
+// weights[nout][nin*f*f] times the patch matrix of the band, never unfolded
+// beyond one packed KC x NC panel
+static void conv_implicit_gemm(const ftmap_t             *input_ftmap,
+                               const param_t             *weights,
+                               const param_t             *biases,
+                               int                        nin,
+                               int                        nout,
+                               int                        f,
+                               int                        h,
+                               int                        w,
+                               ftmap_t                   *output_ftmap,
+                               float                     *workspace,
+                               const conv_gemm_weights_t *packed)
+{
+    const gemm_kernel_t *kernel = gemm_kernel();
+    int k = nin*f*f;
+
+    std::vector<float> scratch;
+    if (!workspace) {
+        scratch.resize(conv_implicit_gemm_workspace_size(nin, nout, f, h, w));
+        workspace = scratch.data();
+    }
+    float *tap_weights = workspace;
+    float *panels = tap_weights + align_floats((size_t) nout*k);
+    float *gemm_workspace = panels + align_floats(gemm_packed_a_size(NULL, nout, k));
+    ftmap_t *padded_ftmap = gemm_workspace + align_floats(gemm_workspace_size(NULL));
+
+    // weights packed for another ISA are packed again
+    const float *packed_a = packed && packed->kernel == kernel ? packed->panels : NULL;
+    if (!packed_a)
+        packed_a = conv_implicit_gemm_pack(weights, nin, nout, f, tap_weights, panels).panels;
+
+    // edge extension is done once here instead of per tap
+    conv_pad_input(input_ftmap, nin, h, w, f, padded_ftmap);
+
+    int band_rows = GEMM_BAND_BYTES/((long) k*w*sizeof(float));
+    if (band_rows < 1)
+        band_rows = 1;
+
+    for (int y0 = 0; y0 < h; y0 += band_rows) {
+        int rows = h - y0 < band_rows ? h - y0 : band_rows;
+        conv_patch_src_t patches = { padded_ftmap, h, w, f, y0 };
+        sgemm(kernel, nout, rows*w, k,
+              packed_a, conv_pack_patches, &patches,
+              output_ftmap + (long) y0*w, (long) h*w, 1,
+              biases, 1, gemm_workspace);
+    }
+}
+
+// implements conv1 as an implicit GEMM
+void conv1_gemm(const ftmap_t             *input_ftmap,
+                const param_t             *conv1_weights,
+                const param_t             *conv1_biases,
+                int                        h,
+                int                        w,
+                ftmap_t                   *output_ftmap,
+                float                     *workspace,
+                const conv_gemm_weights_t *packed)
+{
+    conv_implicit_gemm(input_ftmap, conv1_weights, conv1_biases, N0, N1, F1, h, w, output_ftmap, workspace, packed);
+}
+
+size_t conv1_gemm_weights_size()
+{
+    return gemm_packed_a_size(NULL, N1, N0*F1*F1);
+}
+
+conv_gemm_weights_t conv1_gemm_pack(const param_t *conv1_weights, float *panels)
+{
+    std::vector<float> tap_weights((size_t) N1*N0*F1*F1);
+    return conv_implicit_gemm_pack(conv1_weights, N0, N1, F1, tap_weights.data(), panels);
+}
+
+size_t conv1_gemm_workspace_size(int h, int w)
+{
+    return conv_implicit_gemm_workspace_size(N0, N1, F1, h, w);
+}
+
+// implements conv3 as an implicit GEMM
+void conv3_gemm(const ftmap_t             *input_ftmap,
+                const param_t             *conv3_weights,
+                const param_t             *conv3_biases,
+                int                        h,
+                int                        w,
+                ftmap_t                   *output_ftmap,
+                float                     *workspace,
+                const conv_gemm_weights_t *packed)
+{
+    conv_implicit_gemm(input_ftmap, conv3_weights, conv3_biases, N2, N3, F3, h, w, output_ftmap, workspace, packed);
+}
+
+size_t conv3_gemm_weights_size()
+{
+    return gemm_packed_a_size(NULL, N3, N2*F3*F3);
+}
+
+conv_gemm_weights_t conv3_gemm_pack(const param_t *conv3_weights, float *panels)
+{
+    std::vector<float> tap_weights((size_t) N3*N2*F3*F3);
+    return conv_implicit_gemm_pack(conv3_weights, N2, N3, F3, tap_weights.data(), panels);
+}
+
+size_t conv3_gemm_workspace_size(int h, int w)
+{
+    return conv_implicit_gemm_workspace_size(N2, N3, F3, h, w);
+}
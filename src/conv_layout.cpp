@@ -0,0 +1,944 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <stdexcept>
+
+#include "kernels.h"
+#include "simd.h"
+
+#if N0 != 1 || N3 != 1 || F2 != 1
+#error "the layout kernels expect single-channel images and a 1x1 conv2"
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define LAYOUT_INLINE static inline __attribute__((always_inline))
+
+static const char *ftmap_format_names[FTMAP_FORMAT_COUNT] = {
+    "fp32",
+    "fp16",
+    "bf16",
+};
+
+const char *ftmap_format_name(ftmap_format_t format)
+{
+    return format >= 0 && format < FTMAP_FORMAT_COUNT ? ftmap_format_names[format] : "unknown";
+}
+
+size_t ftmap_format_bytes(ftmap_format_t format)
+{
+    return format == FTMAP_FP32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+static const char *ftmap_layout_names[FTMAP_LAYOUT_COUNT] = {
+    "nchw",
+    "nchw8c",
+    "nchw16c",
+    "nhwc",
+};
+
+const char *ftmap_layout_name(ftmap_layout_t layout)
+{
+    return layout >= 0 && layout < FTMAP_LAYOUT_COUNT ? ftmap_layout_names[layout] : "unknown";
+}
+
+int ftmap_layout_block(ftmap_layout_t layout, int channels)
+{
+    switch (layout) {
+    case FTMAP_NCHW8C:
+        return 8;
+    case FTMAP_NCHW16C:
+        return 16;
+    case FTMAP_NHWC:
+        return channels;
+    default:
+        return 1;
+    }
+}
+
+// channel block of a map, checking the channels fill whole blocks
+static int layout_block(ftmap_layout_t layout, int channels)
+{
+    int cb = ftmap_layout_block(layout, channels);
+    if (layout < 0 || layout >= FTMAP_LAYOUT_COUNT || channels % cb != 0)
+        throw std::runtime_error("Feature map channels do not fill the blocks of its layout");
+    return cb;
+}
+
+void ftmap_to_layout(const ftmap_t  *planar,
+                     int             channels,
+                     int             h,
+                     int             w,
+                     ftmap_layout_t  layout,
+                     ftmap_t        *output_ftmap)
+{
+    int cb = layout_block(layout, channels);
+    long pixels = (long) h*w;
+    for (int c0 = 0; c0 < channels; c0 += cb)
+        for (long p = 0; p < pixels; p++)
+            for (int c = 0; c < cb; c++)
+                output_ftmap[(c0*pixels + p*cb) + c] = planar[(c0 + c)*pixels + p];
+}
+
+void ftmap_from_layout(const ftmap_t  *input_ftmap,
+                       ftmap_layout_t  layout,
+                       int             channels,
+                       int             h,
+                       int             w,
+                       ftmap_t        *planar)
+{
+    int cb = layout_block(layout, channels);
+    long pixels = (long) h*w;
+    for (int c0 = 0; c0 < channels; c0 += cb)
+        for (long p = 0; p < pixels; p++)
+            for (int c = 0; c < cb; c++)
+                planar[(c0 + c)*pixels + p] = input_ftmap[(c0*pixels + p*cb) + c];
+}
+
+void ftmap_to_nhwc(const ftmap_t *planar,
+                   int            channels,
+                   int            h,
+                   int            w,
+                   ftmap_t       *channel_last)
+{
+    ftmap_to_layout(planar, channels, h, w, FTMAP_NHWC, channel_last);
+}
+
+void ftmap_to_nchw(const ftmap_t *channel_last,
+                   int            channels,
+                   int            h,
+                   int            w,
+                   ftmap_t       *planar)
+{
+    ftmap_from_layout(channel_last, FTMAP_NHWC, channels, h, w, planar);
+}
+
+// IEEE half from float, rounded to nearest even, with overflow to infinity
+static inline uint16_t fp16_from_float(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    x &= 0x7fffffff;
+    if (x >= 0x47800000)    // 65536 and above, infinity, NaN
+        return sign | (x > 0x7f800000 ? 0x7e00 : 0x7c00);
+    if (x < 0x38800000) {   // below the smallest normal half: let the FPU round
+        float denormal;
+        memcpy(&denormal, &x, sizeof(denormal));
+        denormal += 0.5f;
+        memcpy(&x, &denormal, sizeof(x));
+        return sign | (x - 0x3f000000);
+    }
+    // rebias the exponent and round the 13 dropped mantissa bits
+    x += 0xc8000fff + ((x >> 13) & 1);
+    return sign | (x >> 13);
+}
+
+static inline float fp16_to_float(uint16_t h)
+{
+    uint32_t x = (uint32_t) (h & 0x7fff) << 13;
+    uint32_t exponent = x & 0x0f800000;
+    x += 0x38000000;
+    if (exponent == 0x0f800000) {           // infinity, NaN
+        x += 0x38000000;
+    } else if (exponent == 0) {             // denormal
+        float f, magic = 6.103515625e-05f;  // 2^-14
+        x += 0x00800000;
+        memcpy(&f, &x, sizeof(f));
+        f -= magic;
+        memcpy(&x, &f, sizeof(x));
+    }
+    x |= (uint32_t) (h & 0x8000) << 16;
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+// bfloat16 from float: the upper half of the bits, rounded to nearest even
+static inline uint16_t bf16_from_float(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    return (uint16_t) ((x + 0x7fff + ((x >> 16) & 1)) >> 16);
+}
+
+static inline float bf16_to_float(uint16_t b)
+{
+    uint32_t x = (uint32_t) b << 16;
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+void ftmap_to_format(const ftmap_t  *input_ftmap,
+                     long            count,
+                     ftmap_format_t  format,
+                     void           *output)
+{
+    if (format == FTMAP_FP32) {
+        memmove(output, input_ftmap, count*sizeof(float));
+        return;
+    }
+    uint16_t *dst = (uint16_t *) output;
+    for (long i = 0; i < count; i++)
+        dst[i] = format == FTMAP_FP16 ? fp16_from_float(input_ftmap[i]) : bf16_from_float(input_ftmap[i]);
+}
+
+void ftmap_from_format(const void     *input,
+                       ftmap_format_t  format,
+                       long            count,
+                       ftmap_t        *output_ftmap)
+{
+    if (format == FTMAP_FP32) {
+        memmove(output_ftmap, input, count*sizeof(float));
+        return;
+    }
+    const uint16_t *src = (const uint16_t *) input;
+    for (long i = 0; i < count; i++)
+        output_ftmap[i] = format == FTMAP_FP16 ? fp16_to_float(src[i]) : bf16_to_float(src[i]);
+}
+
+static inline int clamp_index(int i, int n)
+{
+    return i < 0 ? 0 : (i > n - 1 ? n - 1 : i);
+}
+
+// element formats of the kernels' maps: ftmap_format_t, plus bfloat16
+// rounded by the AVX512-BF16 instruction rather than integer arithmetic
+enum { MAP_FP32, MAP_FP16, MAP_BF16, MAP_BF16_NATIVE };
+
+template <int FMT> struct map_elem { typedef uint16_t type; };
+template <> struct map_elem<MAP_FP32> { typedef float type; };
+
+// N consecutive map elements to a vector of N floats and back. fp16 uses the
+// F16C (AVX-512F for 16 lanes) conversions, or the scalar ones on the
+// default target; bfloat16 is a shift one way and integer rounding the other.
+// The target-specific members are only inline, not always_inline: the
+// generic kernels calling them are compiled on the default target first and
+// could not take them, and once inlined into their ISA wrapper they can.
+template <int N> struct map_bits;
+template <> struct map_bits<16> {
+    typedef uint32_t wide __attribute__((vector_size(64)));
+    typedef uint16_t half __attribute__((vector_size(32)));
+};
+template <> struct map_bits<8> {
+    typedef uint32_t wide __attribute__((vector_size(32)));
+    typedef uint16_t half __attribute__((vector_size(16)));
+};
+template <> struct map_bits<4> {
+    typedef uint32_t wide __attribute__((vector_size(16)));
+    typedef uint16_t half __attribute__((vector_size(8)));
+};
+
+template <int FMT, int N>
+struct map_convert {
+    typedef typename simd_vec<N>::type VEC;
+    typedef typename map_bits<N>::wide UVEC;
+    typedef typename map_bits<N>::half HVEC;
+
+    LAYOUT_INLINE void load(const uint16_t *src, VEC &v)
+    {
+        HVEC h;
+        memcpy(&h, src, sizeof(h));
+        v = (VEC) (__builtin_convertvector(h, UVEC) << 16);
+    }
+
+    LAYOUT_INLINE void store(uint16_t *dst, const VEC &v)
+    {
+        UVEC x = (UVEC) v;
+        HVEC h = __builtin_convertvector((x + 0x7fff + ((x >> 16) & 1)) >> 16, HVEC);
+        memcpy(dst, &h, sizeof(h));
+    }
+};
+
+template <int N>
+struct map_convert<MAP_FP32, N> {
+    typedef typename simd_vec<N>::type VEC;
+
+    LAYOUT_INLINE void load(const float *src, VEC &v) { v = *(const VEC *) src; }
+    LAYOUT_INLINE void store(float *dst, const VEC &v) { *(VEC *) dst = v; }
+};
+
+template <>
+struct map_convert<MAP_FP16, 4> {
+    typedef simd_vec<4>::type VEC;
+
+    LAYOUT_INLINE void load(const uint16_t *src, VEC &v)
+    {
+        for (int k = 0; k < 4; k++)
+            v[k] = fp16_to_float(src[k]);
+    }
+
+    LAYOUT_INLINE void store(uint16_t *dst, const VEC &v)
+    {
+        for (int k = 0; k < 4; k++)
+            dst[k] = fp16_from_float(v[k]);
+    }
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+template <>
+struct map_convert<MAP_FP16, 8> {
+    typedef simd_vec<8>::type VEC;
+
+    __attribute__((target("f16c")))
+    static inline void load(const uint16_t *src, VEC &v)
+    {
+        v = (VEC) _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) src));
+    }
+
+    __attribute__((target("f16c")))
+    static inline void store(uint16_t *dst, const VEC &v)
+    {
+        _mm_storeu_si128((__m128i *) dst, _mm256_cvtps_ph((__m256) v, _MM_FROUND_TO_NEAREST_INT));
+    }
+};
+
+template <>
+struct map_convert<MAP_FP16, 16> {
+    typedef simd_vec<16>::type VEC;
+
+    __attribute__((target("avx512f")))
+    static inline void load(const uint16_t *src, VEC &v)
+    {
+        v = (VEC) _mm512_maskz_cvtph_ps(0xffff, _mm256_loadu_si256((const __m256i *) src));
+    }
+
+    __attribute__((target("avx512f")))
+    static inline void store(uint16_t *dst, const VEC &v)
+    {
+        _mm256_storeu_si256((__m256i *) dst, _mm512_maskz_cvtps_ph(0xffff, (__m512) v, _MM_FROUND_TO_NEAREST_INT));
+    }
+};
+
+template <int N>
+struct map_convert<MAP_BF16_NATIVE, N> : map_convert<MAP_BF16, N> {
+};
+
+template <>
+struct map_convert<MAP_BF16_NATIVE, 16> : map_convert<MAP_BF16, 16> {
+    typedef simd_vec<16>::type VEC;
+
+    __attribute__((target("avx512f,avx512bf16")))
+    static inline void store(uint16_t *dst, const VEC &v)
+    {
+        _mm256_storeu_si256((__m256i *) dst, (__m256i) _mm512_cvtneps_pbh((__m512) v));
+    }
+};
+#endif
+
+// stores channels [c0, c0 + VL) of pixel p to a map with channel block CB
+// and planes of the given number of pixels: one vector inside a block, or
+// VL/CB pieces in consecutive blocks
+template <int VL, int CB, int FMT>
+LAYOUT_INLINE void layout_store(typename map_elem<FMT>::type *map, int c0, long p, long plane,
+                                const typename simd_vec<VL>::type &v)
+{
+    typedef typename map_elem<FMT>::type ELEM;
+    if (CB >= VL) {
+        map_convert<FMT, VL>::store(map + ((c0/CB)*plane + p)*CB + c0%CB, v);
+        return;
+    }
+    ELEM converted[VL];
+    map_convert<FMT, VL>::store(converted, v);
+    for (int k = 0; k < VL/CB; k++)
+        memcpy(map + ((c0/CB + k)*plane + p)*CB, converted + k*CB, CB*sizeof(ELEM));
+}
+
+// the N1 input channels of PX pixels of conv2 as floats: read in place from
+// fp32 maps, converted a vector of up to VL channels at a time otherwise
+template <int VL, int CBI, int FMT, int PX>
+struct conv2_inputs {
+    static const int VC = CBI < VL ? CBI : VL;
+    typedef typename simd_vec<VC>::type VEC;
+    float values[PX][N1];
+
+    __attribute__((always_inline)) void gather(const uint16_t *input, const long pixel[PX], long plane)
+    {
+        for (int k = 0; k < PX; k++) {
+            for (int c = 0; c < N1; c += VC) {
+                VEC v;
+                map_convert<FMT, VC>::load(input + ((c/CBI)*plane + pixel[k])*CBI + c%CBI, v);
+                *(VEC *) &values[k][c] = v;
+            }
+        }
+    }
+
+    __attribute__((always_inline)) float get(int k, int i) const { return values[k][i]; }
+};
+
+template <int VL, int CBI, int PX>
+struct conv2_inputs<VL, CBI, MAP_FP32, PX> {
+    const float *input;
+    long         offset[PX];
+    long         plane;
+
+    __attribute__((always_inline)) void gather(const float *map, const long pixel[PX], long map_plane)
+    {
+        input = map;
+        plane = map_plane;
+        for (int k = 0; k < PX; k++)
+            offset[k] = pixel[k]*CBI;
+    }
+
+    __attribute__((always_inline)) float get(int k, int i) const
+    {
+        return input[(i/CBI)*plane*CBI + offset[k] + i%CBI];
+    }
+};
+
+// conv1 with the N1 outputs of a pixel in vectors: each input tap is
+// broadcast against the tap's weight vectors, which are loaded once for a
+// block of PX adjacent pixels whose accumulators fill about 16 registers
+template <int VL, int CBO, int FMT>
+LAYOUT_INLINE void conv1_layout_rows(ftmap_view_t                  input,
+                                     const param_t                *packed,
+                                     const param_t                *conv1_biases,
+                                     int                           h,
+                                     int                           w,
+                                     typename map_elem<FMT>::type *output)
+{
+    typedef typename simd_vec<VL>::type VEC;
+    const int PX = 16*VL/N1 > 1 ? 16*VL/N1 : 1;
+    const int pad = F1/2;
+    long plane = (long) h*w;
+    const VEC zero = {};
+
+    for (int y = 0; y < h; y++) {
+        const ftmap_t *rows[F1];
+        for (int ky = 0; ky < F1; ky++)
+            rows[ky] = input.data + (long) (clamp_index(y + ky - pad, h) - input.y0)*input.stride - input.x0;
+
+        for (int x = 0; x < w; x += PX) {
+            int lanes = w - x < PX ? w - x : PX;
+            bool interior = x >= pad && x + PX - 1 + pad < w;
+            VEC acc[PX][N1/VL];
+            #pragma GCC unroll 16
+            for (int k = 0; k < PX; k++)
+                #pragma GCC unroll 16
+                for (int j = 0; j < N1/VL; j++)
+                    acc[k][j] = *(const VEC *) (conv1_biases + j*VL);
+            for (int ky = 0; ky < F1; ky++) {
+                for (int kx = 0; kx < F1; kx++) {
+                    const param_t *tap = packed + (ky*F1 + kx)*N1;
+                    VEC weights[N1/VL];
+                    #pragma GCC unroll 16
+                    for (int j = 0; j < N1/VL; j++)
+                        weights[j] = *(const VEC *) (tap + j*VL);
+                    #pragma GCC unroll 16
+                    for (int k = 0; k < PX; k++) {
+                        int sx = x + k + kx - pad;
+                        float v = rows[ky][interior ? sx : clamp_index(sx, w)];
+                        #pragma GCC unroll 16
+                        for (int j = 0; j < N1/VL; j++)
+                            acc[k][j] += weights[j]*v;
+                    }
+                }
+            }
+            #pragma GCC unroll 16
+            for (int k = 0; k < PX; k++) {
+                #pragma GCC unroll 16
+                for (int j = 0; j < N1/VL && k < lanes; j++) {
+                    acc[k][j] = acc[k][j] > zero ? acc[k][j] : zero;
+                    layout_store<VL, CBO, FMT>(output, j*VL, (long) y*w + x + k, plane, acc[k][j]);
+                }
+            }
+        }
+    }
+}
+
+// conv2 with the N2 outputs of a pixel in vectors: the N1 inputs of each of
+// PX pixels are broadcast in turn against the input's weight vectors
+template <int VL, int CBI, int CBO, int FMT>
+LAYOUT_INLINE void conv2_layout_pixels(const typename map_elem<FMT>::type *input,
+                                       const param_t                      *packed,
+                                       const param_t                      *conv2_biases,
+                                       int                                 h,
+                                       int                                 w,
+                                       typename map_elem<FMT>::type       *output)
+{
+    typedef typename simd_vec<VL>::type VEC;
+    const int PX = 16*VL/N2 > 1 ? 16*VL/N2 : 1;
+    long plane = (long) h*w;
+    const VEC zero = {};
+    conv2_inputs<VL, CBI, FMT, PX> inputs;
+
+    for (long p = 0; p < plane; p += PX) {
+        int lanes = plane - p < PX ? (int) (plane - p) : PX;
+        long pixel[PX];
+        for (int k = 0; k < PX; k++)
+            pixel[k] = k < lanes ? p + k : p;
+        inputs.gather(input, pixel, plane);
+        VEC acc[PX][N2/VL];
+        #pragma GCC unroll 16
+        for (int k = 0; k < PX; k++)
+            #pragma GCC unroll 16
+            for (int j = 0; j < N2/VL; j++)
+                acc[k][j] = *(const VEC *) (conv2_biases + j*VL);
+        for (int i = 0; i < N1; i++) {
+            VEC weights[N2/VL];
+            #pragma GCC unroll 16
+            for (int j = 0; j < N2/VL; j++)
+                weights[j] = *(const VEC *) (packed + i*N2 + j*VL);
+            #pragma GCC unroll 16
+            for (int k = 0; k < PX; k++) {
+                float v = inputs.get(k, i);
+                #pragma GCC unroll 16
+                for (int j = 0; j < N2/VL; j++)
+                    acc[k][j] += weights[j]*v;
+            }
+        }
+        #pragma GCC unroll 16
+        for (int k = 0; k < PX; k++) {
+            #pragma GCC unroll 16
+            for (int j = 0; j < N2/VL && k < lanes; j++) {
+                acc[k][j] = acc[k][j] > zero ? acc[k][j] : zero;
+                layout_store<VL, CBO, FMT>(output, j*VL, p + k, plane, acc[k][j]);
+            }
+        }
+    }
+}
+
+// conv3 with the N2 input channels of each tap pixel in vectors of VC lanes,
+// no wider than a channel block, multiplied by the tap weights; the lanes
+// are reduced once per output pixel
+template <int VL, int CBI, int FMT>
+LAYOUT_INLINE void conv3_layout_rows(const typename map_elem<FMT>::type *input,
+                                     const param_t                      *packed,
+                                     const param_t                      *conv3_biases,
+                                     int                                 h,
+                                     int                                 w,
+                                     ftmap_view_t                        output)
+{
+    const int VC = CBI < VL ? CBI : VL;
+    typedef typename simd_vec<VC>::type VEC;
+    const int pad = F3/2;
+    long plane = (long) h*w;
+
+    for (int y = 0; y < h; y++) {
+        long rows[F3];
+        for (int ky = 0; ky < F3; ky++)
+            rows[ky] = (long) clamp_index(y + ky - pad, h)*w;
+        ftmap_t *dst = output.data + (long) (y - output.y0)*output.stride - output.x0;
+
+        for (int x = 0; x < w; x++) {
+            VEC acc[N2/VC] = {};
+            for (int ky = 0; ky < F3; ky++) {
+                for (int kx = 0; kx < F3; kx++) {
+                    long q = rows[ky] + clamp_index(x + kx - pad, w);
+                    const param_t *tap = packed + (ky*F3 + kx)*N2;
+                    for (int j = 0; j < N2/VC; j++) {
+                        int c = j*VC;
+                        VEC v;
+                        map_convert<FMT, VC>::load(input + ((c/CBI)*plane + q)*CBI + c%CBI, v);
+                        acc[j] += *(const VEC *) (tap + c)*v;
+                    }
+                }
+            }
+            for (int j = 1; j < N2/VC; j++)
+                acc[0] += acc[j];
+            float sum = conv3_biases[0];
+            for (int k = 0; k < VC; k++)
+                sum += acc[0][k];
+            dst[x] = sum > 0 ? sum : 0;
+        }
+    }
+}
+
+// per-target instantiations of the kernels, see simd_vec. The x86 targets
+// include F16C, which every AVX2 and AVX-512 CPU has, for the fp16 maps.
+template <int CBO, int FMT>
+static void conv1_layout_default(ftmap_view_t input, const param_t *packed, const param_t *biases,
+                                 int h, int w, void *output)
+{
+    conv1_layout_rows<4, CBO, FMT>(input, packed, biases, h, w, (typename map_elem<FMT>::type *) output);
+}
+
+template <int CBI, int CBO, int FMT>
+static void conv2_layout_default(const void *input, const param_t *packed, const param_t *biases,
+                                 int h, int w, void *output)
+{
+    conv2_layout_pixels<4, CBI, CBO, FMT>((const typename map_elem<FMT>::type *) input, packed, biases,
+                                          h, w, (typename map_elem<FMT>::type *) output);
+}
+
+template <int CBI, int FMT>
+static void conv3_layout_default(const void *input, const param_t *packed, const param_t *biases,
+                                 int h, int w, ftmap_view_t output)
+{
+    conv3_layout_rows<4, CBI, FMT>((const typename map_elem<FMT>::type *) input, packed, biases, h, w, output);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template <int CBO, int FMT>
+__attribute__((target("avx2,fma,f16c")))
+static void conv1_layout_avx2(ftmap_view_t input, const param_t *packed, const param_t *biases,
+                              int h, int w, void *output)
+{
+    conv1_layout_rows<8, CBO, FMT>(input, packed, biases, h, w, (typename map_elem<FMT>::type *) output);
+}
+
+template <int CBI, int CBO, int FMT>
+__attribute__((target("avx2,fma,f16c")))
+static void conv2_layout_avx2(const void *input, const param_t *packed, const param_t *biases,
+                              int h, int w, void *output)
+{
+    conv2_layout_pixels<8, CBI, CBO, FMT>((const typename map_elem<FMT>::type *) input, packed, biases,
+                                          h, w, (typename map_elem<FMT>::type *) output);
+}
+
+template <int CBI, int FMT>
+__attribute__((target("avx2,fma,f16c")))
+static void conv3_layout_avx2(const void *input, const param_t *packed, const param_t *biases,
+                              int h, int w, ftmap_view_t output)
+{
+    conv3_layout_rows<8, CBI, FMT>((const typename map_elem<FMT>::type *) input, packed, biases, h, w, output);
+}
+
+template <int CBO, int FMT>
+__attribute__((target("avx512f,f16c")))
+static void conv1_layout_avx512(ftmap_view_t input, const param_t *packed, const param_t *biases,
+                                int h, int w, void *output)
+{
+    conv1_layout_rows<16, CBO, FMT>(input, packed, biases, h, w, (typename map_elem<FMT>::type *) output);
+}
+
+template <int CBI, int CBO, int FMT>
+__attribute__((target("avx512f,f16c")))
+static void conv2_layout_avx512(const void *input, const param_t *packed, const param_t *biases,
+                                int h, int w, void *output)
+{
+    conv2_layout_pixels<16, CBI, CBO, FMT>((const typename map_elem<FMT>::type *) input, packed, biases,
+                                           h, w, (typename map_elem<FMT>::type *) output);
+}
+
+template <int CBI, int FMT>
+__attribute__((target("avx512f,f16c")))
+static void conv3_layout_avx512(const void *input, const param_t *packed, const param_t *biases,
+                                int h, int w, ftmap_view_t output)
+{
+    conv3_layout_rows<16, CBI, FMT>((const typename map_elem<FMT>::type *) input, packed, biases, h, w, output);
+}
+
+// AVX-512 kernels on CPUs with AVX512-BF16: bfloat16 maps are stored
+// through vcvtneps2bf16 (conv3 only loads them, so it keeps the AVX-512
+// kernel) and every other format forwards to the AVX-512 kernels
+template <int FMT>
+struct layout_avx512bf16 {
+    template <int CBO>
+    static void conv1(ftmap_view_t input, const param_t *packed, const param_t *biases,
+                      int h, int w, void *output)
+    {
+        conv1_layout_avx512<CBO, FMT>(input, packed, biases, h, w, output);
+    }
+
+    template <int CBI, int CBO>
+    static void conv2(const void *input, const param_t *packed, const param_t *biases,
+                      int h, int w, void *output)
+    {
+        conv2_layout_avx512<CBI, CBO, FMT>(input, packed, biases, h, w, output);
+    }
+};
+
+template <>
+struct layout_avx512bf16<MAP_BF16> {
+    template <int CBO>
+    __attribute__((target("avx512f,f16c,avx512bf16")))
+    static void conv1(ftmap_view_t input, const param_t *packed, const param_t *biases,
+                      int h, int w, void *output)
+    {
+        conv1_layout_rows<16, CBO, MAP_BF16_NATIVE>(input, packed, biases, h, w, (uint16_t *) output);
+    }
+
+    template <int CBI, int CBO>
+    __attribute__((target("avx512f,f16c,avx512bf16")))
+    static void conv2(const void *input, const param_t *packed, const param_t *biases,
+                      int h, int w, void *output)
+    {
+        conv2_layout_pixels<16, CBI, CBO, MAP_BF16_NATIVE>((const uint16_t *) input, packed, biases, h, w,
+                                                           (uint16_t *) output);
+    }
+};
+#endif
+
+// instruction set a kernel for maps of format FMT runs on: fp16 needs F16C
+// on x86, and AVX-512 bfloat16 stores use AVX512-BF16 when the CPU has it
+enum { LAYOUT_DEFAULT, LAYOUT_AVX2, LAYOUT_AVX512, LAYOUT_AVX512BF16 };
+
+template <int FMT>
+static int layout_target()
+{
+    switch (simd_isa()) {
+    case SIMD_ISA_AVX512:
+        if (FMT == MAP_FP16 && !simd_f16c())
+            return LAYOUT_DEFAULT;
+        return FMT == MAP_BF16 && simd_bf16() ? LAYOUT_AVX512BF16 : LAYOUT_AVX512;
+    case SIMD_ISA_AVX2:
+        return FMT == MAP_FP16 && !simd_f16c() ? LAYOUT_DEFAULT : LAYOUT_AVX2;
+    default:
+        return LAYOUT_DEFAULT;
+    }
+}
+
+template <int CBO, int FMT>
+static void conv1_layout_isa(ftmap_view_t input, const param_t *packed, const param_t *biases,
+                             int h, int w, void *output)
+{
+    switch (layout_target<FMT>()) {
+#if defined(__x86_64__) || defined(__i386__)
+    case LAYOUT_AVX512BF16:
+        layout_avx512bf16<FMT>::template conv1<CBO>(input, packed, biases, h, w, output);
+        break;
+    case LAYOUT_AVX512:
+        conv1_layout_avx512<CBO, FMT>(input, packed, biases, h, w, output);
+        break;
+    case LAYOUT_AVX2:
+        conv1_layout_avx2<CBO, FMT>(input, packed, biases, h, w, output);
+        break;
+#endif
+    default:
+        conv1_layout_default<CBO, FMT>(input, packed, biases, h, w, output);
+        break;
+    }
+}
+
+template <int CBI, int CBO, int FMT>
+static void conv2_layout_isa(const void *input, const param_t *packed, const param_t *biases,
+                             int h, int w, void *output)
+{
+    switch (layout_target<FMT>()) {
+#if defined(__x86_64__) || defined(__i386__)
+    case LAYOUT_AVX512BF16:
+        layout_avx512bf16<FMT>::template conv2<CBI, CBO>(input, packed, biases, h, w, output);
+        break;
+    case LAYOUT_AVX512:
+        conv2_layout_avx512<CBI, CBO, FMT>(input, packed, biases, h, w, output);
+        break;
+    case LAYOUT_AVX2:
+        conv2_layout_avx2<CBI, CBO, FMT>(input, packed, biases, h, w, output);
+        break;
+#endif
+    default:
+        conv2_layout_default<CBI, CBO, FMT>(input, packed, biases, h, w, output);
+        break;
+    }
+}
+
+template <int CBI, int FMT>
+static void conv3_layout_isa(const void *input, const param_t *packed, const param_t *biases,
+                             int h, int w, ftmap_view_t output)
+{
+    switch (layout_target<FMT>()) {
+#if defined(__x86_64__) || defined(__i386__)
+    case LAYOUT_AVX512BF16:
+    case LAYOUT_AVX512:
+        conv3_layout_avx512<CBI, FMT>(input, packed, biases, h, w, output);
+        break;
+    case LAYOUT_AVX2:
+        conv3_layout_avx2<CBI, FMT>(input, packed, biases, h, w, output);
+        break;
+#endif
+    default:
+        conv3_layout_default<CBI, FMT>(input, packed, biases, h, w, output);
+        break;
+    }
+}
+
+// conv1 with the map format fixed, dispatched on the output layout
+template <int FMT>
+static void conv1_layout_to(ftmap_view_t input, const param_t *packed, const param_t *biases,
+                            int h, int w, void *output, ftmap_layout_t output_layout)
+{
+    switch (output_layout) {
+    case FTMAP_NCHW8C:
+        conv1_layout_isa<8, FMT>(input, packed, biases, h, w, output);
+        break;
+    case FTMAP_NCHW16C:
+        conv1_layout_isa<16, FMT>(input, packed, biases, h, w, output);
+        break;
+    default:
+        conv1_layout_isa<N1, FMT>(input, packed, biases, h, w, output);
+        break;
+    }
+}
+
+// conv2 with the map format and input block fixed, dispatched on the output
+// layout; planar maps are fp32 only
+template <int CBI, int FMT>
+static void conv2_layout_to(const void *input, const param_t *packed, const param_t *biases,
+                            int h, int w, void *output, ftmap_layout_t output_layout)
+{
+    switch (output_layout) {
+    case FTMAP_NCHW8C:
+        conv2_layout_isa<CBI, 8, FMT>(input, packed, biases, h, w, output);
+        break;
+    case FTMAP_NCHW16C:
+        conv2_layout_isa<CBI, 16, FMT>(input, packed, biases, h, w, output);
+        break;
+    case FTMAP_NHWC:
+        conv2_layout_isa<CBI, N2, FMT>(input, packed, biases, h, w, output);
+        break;
+    default:
+        conv2_layout_isa<CBI, 1, MAP_FP32>(input, packed, biases, h, w, output);
+        break;
+    }
+}
+
+template <int FMT>
+static void conv2_layout_from(const void *input, ftmap_layout_t input_layout, const param_t *packed,
+                              const param_t *biases, int h, int w, void *output, ftmap_layout_t output_layout)
+{
+    switch (input_layout) {
+    case FTMAP_NCHW8C:
+        conv2_layout_to<8, FMT>(input, packed, biases, h, w, output, output_layout);
+        break;
+    case FTMAP_NCHW16C:
+        conv2_layout_to<16, FMT>(input, packed, biases, h, w, output, output_layout);
+        break;
+    case FTMAP_NHWC:
+        conv2_layout_to<N1, FMT>(input, packed, biases, h, w, output, output_layout);
+        break;
+    default:
+        conv2_layout_to<1, MAP_FP32>(input, packed, biases, h, w, output, output_layout);
+        break;
+    }
+}
+
+template <int FMT>
+static void conv3_layout_from(const void *input, ftmap_layout_t input_layout, const param_t *packed,
+                              const param_t *biases, int h, int w, ftmap_view_t output)
+{
+    switch (input_layout) {
+    case FTMAP_NCHW8C:
+        conv3_layout_isa<8, FMT>(input, packed, biases, h, w, output);
+        break;
+    case FTMAP_NCHW16C:
+        conv3_layout_isa<16, FMT>(input, packed, biases, h, w, output);
+        break;
+    default:
+        conv3_layout_isa<N2, FMT>(input, packed, biases, h, w, output);
+        break;
+    }
+}
+
+// weights as [tap][in][out] for the kernels above: a vector of output
+// features per input tap for conv1 and conv2, of input channels per tap for
+// conv3
+static void layout_pack(const param_t *weights, int nin, int nout, int f, param_t *packed)
+{
+    for (int o = 0; o < nout; o++)
+        for (int i = 0; i < nin; i++)
+            for (int t = 0; t < f*f; t++)
+                packed[(t*nin + i)*nout + o] = weights[(o*nin + i)*f*f + t];
+}
+
+// 16-bit maps are converted a vector of at least 8 channels at a time
+static void layout_check_format(ftmap_layout_t layout, ftmap_format_t format)
+{
+    if (format < 0 || format >= FTMAP_FORMAT_COUNT)
+        throw std::runtime_error("Invalid feature map format");
+    if (format != FTMAP_FP32 && layout == FTMAP_NCHW)
+        throw std::runtime_error("16-bit feature maps need a blocked or channel-last layout");
+}
+
+void conv1_layout(ftmap_view_t    input,
+                  const param_t  *conv1_weights,
+                  const param_t  *conv1_biases,
+                  int             h,
+                  int             w,
+                  void           *output,
+                  ftmap_layout_t  output_layout,
+                  ftmap_format_t  format)
+{
+    layout_block(output_layout, N1);
+    layout_check_format(output_layout, format);
+    if (output_layout == FTMAP_NCHW) {
+        conv_layer_t layer = { N0, N1, F1, conv1_weights, conv1_biases };
+        conv_direct(&layer, input, h, w, ftmap_view((ftmap_t *) output, h, w), 0, N1, 0, h, 0, w);
+        return;
+    }
+
+    param_t packed[F1*F1*N1];
+    layout_pack(conv1_weights, N0, N1, F1, packed);
+    switch (format) {
+    case FTMAP_FP16:
+        conv1_layout_to<MAP_FP16>(input, packed, conv1_biases, h, w, output, output_layout);
+        break;
+    case FTMAP_BF16:
+        conv1_layout_to<MAP_BF16>(input, packed, conv1_biases, h, w, output, output_layout);
+        break;
+    default:
+        conv1_layout_to<MAP_FP32>(input, packed, conv1_biases, h, w, output, output_layout);
+        break;
+    }
+}
+
+void conv2_layout(const void     *input,
+                  ftmap_layout_t  input_layout,
+                  const param_t  *conv2_weights,
+                  const param_t  *conv2_biases,
+                  int             h,
+                  int             w,
+                  void           *output,
+                  ftmap_layout_t  output_layout,
+                  ftmap_format_t  format)
+{
+    layout_block(input_layout, N1);
+    layout_block(output_layout, N2);
+    layout_check_format(input_layout, format);
+    layout_check_format(output_layout, format);
+    if (input_layout == FTMAP_NCHW && output_layout == FTMAP_NCHW) {
+        conv_layer_t layer = { N1, N2, F2, conv2_weights, conv2_biases };
+        conv_direct(&layer, ftmap_view((const ftmap_t *) input, h, w), h, w, ftmap_view((ftmap_t *) output, h, w),
+                    0, N2, 0, h, 0, w);
+        return;
+    }
+
+    param_t packed[N1*N2];
+    layout_pack(conv2_weights, N1, N2, F2, packed);
+    switch (format) {
+    case FTMAP_FP16:
+        conv2_layout_from<MAP_FP16>(input, input_layout, packed, conv2_biases, h, w, output, output_layout);
+        break;
+    case FTMAP_BF16:
+        conv2_layout_from<MAP_BF16>(input, input_layout, packed, conv2_biases, h, w, output, output_layout);
+        break;
+    default:
+        conv2_layout_from<MAP_FP32>(input, input_layout, packed, conv2_biases, h, w, output, output_layout);
+        break;
+    }
+}
+
+void conv3_layout(const void     *input,
+                  ftmap_layout_t  input_layout,
+                  const param_t  *conv3_weights,
+                  const param_t  *conv3_biases,
+                  int             h,
+                  int             w,
+                  ftmap_view_t    output,
+                  ftmap_format_t  format)
+{
+    layout_block(input_layout, N2);
+    layout_check_format(input_layout, format);
+    if (input_layout == FTMAP_NCHW) {
+        conv_layer_t layer = { N2, N3, F3, conv3_weights, conv3_biases };
+        conv_direct(&layer, ftmap_view((const ftmap_t *) input, h, w), h, w, output, 0, N3, 0, h, 0, w);
+        return;
+    }
+
+    param_t packed[F3*F3*N2];
+    layout_pack(conv3_weights, N2, N3, F3, packed);
+    switch (format) {
+    case FTMAP_FP16:
+        conv3_layout_from<MAP_FP16>(input, input_layout, packed, conv3_biases, h, w, output);
+        break;
+    case FTMAP_BF16:
+        conv3_layout_from<MAP_BF16>(input, input_layout, packed, conv3_biases, h, w, output);
+        break;
+    default:
+        conv3_layout_from<MAP_FP32>(input, input_layout, packed, conv3_biases, h, w, output);
+        break;
+    }
+}
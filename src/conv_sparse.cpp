@@ -0,0 +1,388 @@
+#include <string.h>
+#include <math.h>
+
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "kernels.h"
+#include "simd.h"
+
+#if F2 != 1 || N3 != 1 || N1 > 64 || N2 > 64
+#error "the sparse kernels expect a 1x1 conv2, a single conv3 output feature and at most 64 channels"
+#endif
+
+// conv3 taps per pixel and the pixels each ring row is edge extended by
+#define SPARSE_TAPS CONV_SPARSE_TAPS
+#define SPARSE_PAD  (F3/2)
+
+#define SPARSE_INLINE static inline __attribute__((always_inline))
+
+static inline int clamp_index(int i, int n)
+{
+    return i < 0 ? 0 : (i > n - 1 ? n - 1 : i);
+}
+
+void ftmap_nonzero_masks(const ftmap_t *channel_last,
+                         int            channels,
+                         long           pixels,
+                         ftmap_mask_t  *masks)
+{
+    if (channels > 64)
+        throw std::runtime_error("Feature map masks hold at most 64 channels");
+    for (long p = 0; p < pixels; p++) {
+        const ftmap_t *x = channel_last + p*channels;
+        ftmap_mask_t mask = 0;
+        for (int c = 0; c < channels; c++)
+            mask |= (ftmap_mask_t) (x[c] != 0) << c;
+        masks[p] = mask;
+    }
+}
+
+double ftmap_mask_density(const ftmap_mask_t *masks, int channels, long pixels)
+{
+    long count = 0;
+    for (long p = 0; p < pixels; p++)
+        count += __builtin_popcountll(masks[p]);
+    return pixels > 0 ? (double) count/((double) channels*pixels) : 0;
+}
+
+void conv_sparse_pack(const param_t          *conv2_weights,
+                      const param_t          *conv3_weights,
+                      float                   tolerance,
+                      conv_sparse_weights_t  *packed)
+{
+    packed->live2 = 0;
+    packed->live3 = 0;
+    packed->pruned = 0;
+    for (int i = 0; i < N1; i++) {
+        for (int o = 0; o < N2; o++) {
+            float v = conv2_weights[o*N1 + i];
+            if (v != 0 && fabsf(v) <= tolerance) {
+                v = 0;
+                packed->pruned++;
+            }
+            packed->conv2[i*N2 + o] = v;
+            if (v != 0)
+                packed->live2 |= (ftmap_mask_t) 1 << i;
+        }
+    }
+    for (int c = 0; c < N2; c++) {
+        for (int t = 0; t < SPARSE_TAPS; t++) {
+            float v = t < F3*F3 ? conv3_weights[c*F3*F3 + t] : 0;
+            if (v != 0 && fabsf(v) <= tolerance) {
+                v = 0;
+                packed->pruned++;
+            }
+            packed->conv3[c*SPARSE_TAPS + t] = v;
+            if (v != 0)
+                packed->live3 |= (ftmap_mask_t) 1 << c;
+        }
+    }
+}
+
+// bits of the nonzero lanes of a vector of N floats. The x86 members are
+// only inline, as in conv_layout.cpp: the generic kernels calling them are
+// compiled on the default target first and take them once inlined into
+// their ISA wrapper.
+template <int N>
+struct sparse_bits {
+    typedef typename simd_vec<N>::type VEC;
+
+    static inline ftmap_mask_t get(const VEC &v)
+    {
+        ftmap_mask_t mask = 0;
+        for (int k = 0; k < N; k++)
+            mask |= (ftmap_mask_t) (v[k] != 0) << k;
+        return mask;
+    }
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+template <>
+struct sparse_bits<4> {
+    typedef simd_vec<4>::type VEC;
+
+    static inline ftmap_mask_t get(const VEC &v)
+    {
+        return _mm_movemask_ps(_mm_cmpneq_ps((__m128) v, _mm_setzero_ps()));
+    }
+};
+
+template <>
+struct sparse_bits<8> {
+    typedef simd_vec<8>::type VEC;
+
+    __attribute__((target("avx")))
+    static inline ftmap_mask_t get(const VEC &v)
+    {
+        return _mm256_movemask_ps(_mm256_cmp_ps((__m256) v, _mm256_setzero_ps(), _CMP_NEQ_OQ));
+    }
+};
+
+template <>
+struct sparse_bits<16> {
+    typedef simd_vec<16>::type VEC;
+
+    __attribute__((target("avx512f")))
+    static inline ftmap_mask_t get(const VEC &v)
+    {
+        return _mm512_cmp_ps_mask((__m512) v, _mm512_setzero_ps(), _CMP_NEQ_OQ);
+    }
+};
+#endif
+
+// mask of the C channels of a channel-last pixel
+template <int VL, int C>
+SPARSE_INLINE ftmap_mask_t sparse_pixel_mask(const float *x)
+{
+    typedef typename simd_vec<VL>::type VEC;
+    ftmap_mask_t mask = 0;
+#pragma GCC unroll 16
+    for (int c = 0; c < C; c += VL)
+        mask |= sparse_bits<VL>::get(*(const VEC *) (x + c)) << c;
+    return mask;
+}
+
+// sum over the channels set in mask of x[c] times row c of weights, rows of
+// R floats, into acc[R/VL] plus the initial acc. The mask is expanded to a
+// list of channels first, so the FMA loop has no dependent branches, and
+// successive channels go to SETS sets of accumulators, enough for about 8
+// independent FMA chains.
+template <int VL, int R>
+SPARSE_INLINE void sparse_rows(const float                  *x,
+                               ftmap_mask_t                  mask,
+                               const float                  *weights,
+                               typename simd_vec<VL>::type   acc[R/VL])
+{
+    typedef typename simd_vec<VL>::type VEC;
+    enum { SETS = R/VL >= 8 ? 1 : 8/(R/VL) };
+    const VEC zero = {};
+    int list[64];
+    int n = 0;
+    for (; mask; mask &= mask - 1)
+        list[n++] = __builtin_ctzll(mask);
+
+    VEC part[SETS][R/VL];
+#pragma GCC unroll 16
+    for (int s = 0; s < SETS; s++)
+#pragma GCC unroll 16
+        for (int j = 0; j < R/VL; j++)
+            part[s][j] = s ? zero : acc[j];
+
+    int k = 0;
+    for (; k + SETS <= n; k += SETS) {
+#pragma GCC unroll 16
+        for (int s = 0; s < SETS; s++) {
+            const float *row = weights + list[k + s]*R;
+#pragma GCC unroll 16
+            for (int j = 0; j < R/VL; j++)
+                part[s][j] += x[list[k + s]]*(*(const VEC *) (row + j*VL));
+        }
+    }
+    for (; k < n; k++) {
+        const float *row = weights + list[k]*R;
+#pragma GCC unroll 16
+        for (int j = 0; j < R/VL; j++)
+            part[0][j] += x[list[k]]*(*(const VEC *) (row + j*VL));
+    }
+
+#pragma GCC unroll 16
+    for (int j = 0; j < R/VL; j++) {
+        acc[j] = part[0][j];
+#pragma GCC unroll 16
+        for (int s = 1; s < SETS; s++)
+            acc[j] += part[s][j];
+    }
+}
+
+template <int VL>
+SPARSE_INLINE void conv2_sparse_pixels(const ftmap_t               *input,
+                                       const conv_sparse_weights_t *packed,
+                                       const param_t               *biases,
+                                       long                         pixels,
+                                       ftmap_t                     *output,
+                                       ftmap_mask_t                *output_masks)
+{
+    typedef typename simd_vec<VL>::type VEC;
+    const VEC zero = {};
+
+    for (long p = 0; p < pixels; p++) {
+        const float *x = input + p*N1;
+        VEC acc[N2/VL];
+#pragma GCC unroll 16
+        for (int j = 0; j < N2/VL; j++)
+            acc[j] = *(const VEC *) (biases + j*VL);
+        sparse_rows<VL, N2>(x, sparse_pixel_mask<VL, N1>(x) & packed->live2, packed->conv2, acc);
+
+        ftmap_mask_t mask = 0;
+#pragma GCC unroll 16
+        for (int j = 0; j < N2/VL; j++) {
+            VEC v = acc[j] > zero ? acc[j] : zero;
+            *(VEC *) (output + p*N2 + j*VL) = v;
+            mask |= sparse_bits<VL>::get(v) << (j*VL);
+        }
+        output_masks[p] = mask;
+    }
+}
+
+size_t conv3_sparse_workspace_size(int w)
+{
+    return (size_t) F3*(w + 2*SPARSE_PAD)*SPARSE_TAPS;
+}
+
+// conv3 rows are reduced top to bottom into a ring of F3 slots of tap
+// partials, pixel-major and edge extended in x; output row y is gathered
+// once row min(y + F3/2, h - 1) is in the ring, see conv23_rows()
+template <int VL>
+SPARSE_INLINE void conv3_sparse_rows(const ftmap_t               *input,
+                                     const ftmap_mask_t          *masks,
+                                     const conv_sparse_weights_t *packed,
+                                     param_t                      bias,
+                                     int                          h,
+                                     int                          w,
+                                     ftmap_view_t                 output,
+                                     float                       *ring)
+{
+    typedef typename simd_vec<VL>::type VEC;
+    const VEC zero = {};
+    long slot_size = (long) (w + 2*SPARSE_PAD)*SPARSE_TAPS;
+    int produced = 0;   // rows [0, produced) have been through the ring
+
+    for (int y = 0; y < h; y++) {
+        int last = y + SPARSE_PAD < h ? y + SPARSE_PAD : h - 1;
+        for (; produced <= last; produced++) {
+            float *slot = ring + (produced % F3)*slot_size;
+            long p = (long) produced*w;
+            for (int x = 0; x < w; x++) {
+                VEC taps[SPARSE_TAPS/VL];
+#pragma GCC unroll 16
+                for (int j = 0; j < SPARSE_TAPS/VL; j++)
+                    taps[j] = zero;
+                sparse_rows<VL, SPARSE_TAPS>(input + (p + x)*N2, masks[p + x] & packed->live3, packed->conv3, taps);
+#pragma GCC unroll 16
+                for (int j = 0; j < SPARSE_TAPS/VL; j++)
+                    *(VEC *) (slot + (SPARSE_PAD + x)*SPARSE_TAPS + j*VL) = taps[j];
+            }
+            // edge extension in x
+            for (int e = 0; e < SPARSE_PAD; e++) {
+                memcpy(slot + e*SPARSE_TAPS, slot + SPARSE_PAD*SPARSE_TAPS, SPARSE_TAPS*sizeof(float));
+                memcpy(slot + (SPARSE_PAD + w + e)*SPARSE_TAPS, slot + (SPARSE_PAD + w - 1)*SPARSE_TAPS,
+                       SPARSE_TAPS*sizeof(float));
+            }
+        }
+
+        // edge extension in y
+        const float *rows[F3];
+        for (int ky = 0; ky < F3; ky++)
+            rows[ky] = ring + (clamp_index(y + ky - SPARSE_PAD, h) % F3)*slot_size;
+        ftmap_t *dst = output.data + (long) (y - output.y0)*output.stride - output.x0;
+        for (int x = 0; x < w; x++) {
+            float sum = bias;
+            for (int ky = 0; ky < F3; ky++)
+                for (int kx = 0; kx < F3; kx++)
+                    sum += rows[ky][(x + kx)*SPARSE_TAPS + ky*F3 + kx];
+            dst[x] = sum > 0 ? sum : 0;
+        }
+    }
+}
+
+// per-target instantiations of the kernels, see simd_vec
+static void conv2_sparse_default(const ftmap_t *input, const conv_sparse_weights_t *packed, const param_t *biases,
+                                 long pixels, ftmap_t *output, ftmap_mask_t *output_masks)
+{
+    conv2_sparse_pixels<4>(input, packed, biases, pixels, output, output_masks);
+}
+
+static void conv3_sparse_default(const ftmap_t *input, const ftmap_mask_t *masks, const conv_sparse_weights_t *packed,
+                                 param_t bias, int h, int w, ftmap_view_t output, float *ring)
+{
+    conv3_sparse_rows<4>(input, masks, packed, bias, h, w, output, ring);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma")))
+static void conv2_sparse_avx2(const ftmap_t *input, const conv_sparse_weights_t *packed, const param_t *biases,
+                              long pixels, ftmap_t *output, ftmap_mask_t *output_masks)
+{
+    conv2_sparse_pixels<8>(input, packed, biases, pixels, output, output_masks);
+}
+
+__attribute__((target("avx2,fma")))
+static void conv3_sparse_avx2(const ftmap_t *input, const ftmap_mask_t *masks, const conv_sparse_weights_t *packed,
+                              param_t bias, int h, int w, ftmap_view_t output, float *ring)
+{
+    conv3_sparse_rows<8>(input, masks, packed, bias, h, w, output, ring);
+}
+
+__attribute__((target("avx512f")))
+static void conv2_sparse_avx512(const ftmap_t *input, const conv_sparse_weights_t *packed, const param_t *biases,
+                                long pixels, ftmap_t *output, ftmap_mask_t *output_masks)
+{
+    conv2_sparse_pixels<16>(input, packed, biases, pixels, output, output_masks);
+}
+
+__attribute__((target("avx512f")))
+static void conv3_sparse_avx512(const ftmap_t *input, const ftmap_mask_t *masks, const conv_sparse_weights_t *packed,
+                                param_t bias, int h, int w, ftmap_view_t output, float *ring)
+{
+    conv3_sparse_rows<16>(input, masks, packed, bias, h, w, output, ring);
+}
+#endif
+
+void conv2_sparse(const ftmap_t               *input_ftmap,
+                  const conv_sparse_weights_t *packed,
+                  const param_t               *conv2_biases,
+                  int                          h,
+                  int                          w,
+                  ftmap_t                     *output_ftmap,
+                  ftmap_mask_t                *output_masks)
+{
+    long pixels = (long) h*w;
+    switch (simd_isa()) {
+#if defined(__x86_64__) || defined(__i386__)
+    case SIMD_ISA_AVX512:
+        conv2_sparse_avx512(input_ftmap, packed, conv2_biases, pixels, output_ftmap, output_masks);
+        break;
+    case SIMD_ISA_AVX2:
+        conv2_sparse_avx2(input_ftmap, packed, conv2_biases, pixels, output_ftmap, output_masks);
+        break;
+#endif
+    default:
+        conv2_sparse_default(input_ftmap, packed, conv2_biases, pixels, output_ftmap, output_masks);
+        break;
+    }
+}
+
+void conv3_sparse(const ftmap_t               *input_ftmap,
+                  const ftmap_mask_t          *input_masks,
+                  const conv_sparse_weights_t *packed,
+                  const param_t               *conv3_biases,
+                  int                          h,
+                  int                          w,
+                  ftmap_view_t                 output,
+                  float                       *workspace)
+{
+    std::vector<float> scratch;
+    if (!workspace) {
+        scratch.resize(conv3_sparse_workspace_size(w));
+        workspace = scratch.data();
+    }
+
+    switch (simd_isa()) {
+#if defined(__x86_64__) || defined(__i386__)
+    case SIMD_ISA_AVX512:
+        conv3_sparse_avx512(input_ftmap, input_masks, packed, conv3_biases[0], h, w, output, workspace);
+        break;
+    case SIMD_ISA_AVX2:
+        conv3_sparse_avx2(input_ftmap, input_masks, packed, conv3_biases[0], h, w, output, workspace);
+        break;
+#endif
+    default:
+        conv3_sparse_default(input_ftmap, input_masks, packed, conv3_biases[0], h, w, output, workspace);
+        break;
+    }
+}
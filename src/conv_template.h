@@ -0,0 +1,117 @@
+#ifndef _CONV_TEMPLATE_H_
+#define _CONV_TEMPLATE_H_
+
+#include <math.h>
+
+#include "srcnn.h"
+
+// Convolution shared by conv1, conv2 and conv3: NIN input features, NOUT
+// output features, K x K kernel, optional ReLU, IMG_H x IMG_W maps (H and W
+// are macros in srcnn.h, hence the longer names). Every loop bound is a
+// template constant, so each layer gets its own code: the tap loops of the
+// small kernels unroll, and for K = 1 the padding is zero and the border
+// paths compile away.
+//
+// Each pixel accumulates its taps in the order in_feat, kernel_x, kernel_y and
+// adds the bias last, as the original per-layer loops did, so results are
+// bit-identical to them.
+
+// edge-extended index into a row or column of length n
+static inline int conv_clamp_index(int i, int n)
+{
+	return i < 0 ? 0 : (i > n - 1 ? n - 1 : i);
+}
+
+// convolution of one border pixel, edge extended in x per tap
+template <int NIN, int NOUT, int K, int IMG_W>
+float conv_border_pixel(ftmap_t *input_rows[K],
+                        int      input_feat_stride,
+                        param_t  weights[NOUT][NIN][K][K],
+                        int      out_feat,
+                        int      out_feat_x)
+{
+	const int padding = K/2;
+	float convolution = 0;
+	for (int in_feat = 0; in_feat < NIN; in_feat++) {
+		for (int kernel_x = 0; kernel_x < K; kernel_x++) {
+			int new_ftmap_width = conv_clamp_index(out_feat_x + kernel_x - padding, IMG_W);
+			for (int kernel_y = 0; kernel_y < K; kernel_y++) {
+				convolution += weights[out_feat][in_feat][kernel_y][kernel_x]*input_rows[kernel_y][in_feat*input_feat_stride + new_ftmap_width];
+			}
+		}
+	}
+	return convolution;
+}
+
+// implements one output row of a layer for all output features
+//   input_rows[kernel_y] points at input row (y + kernel_y - K/2), already edge
+//   extended in y, input feature i at input_rows[kernel_y][i*input_feat_stride]
+//   output_row[f*output_feat_stride + x] receives output feature f
+//
+// Interior columns accumulate one tap at a time across the row without edge
+// extension (plain strided loads the compiler can vectorise); only the K/2
+// border columns on each side clamp per tap.
+template <int NIN, int NOUT, int K, bool RELU, int IMG_H, int IMG_W>
+void conv_row_template(ftmap_t *input_rows[K],
+                       int      input_feat_stride,
+                       param_t  weights[NOUT][NIN][K][K],
+                       param_t  biases[NOUT],
+                       ftmap_t *output_row,
+                       int      output_feat_stride)
+{
+	const int padding = K/2;
+	const int interior_begin = padding < IMG_W ? padding : IMG_W;
+	const int interior_end = IMG_W - padding > interior_begin ? IMG_W - padding : interior_begin;
+
+	for (int out_feat = 0; out_feat < NOUT; out_feat++) {
+
+		float feat_bias = biases[out_feat];
+		float convolution[IMG_W];
+
+		// interior columns: no edge extension needed in x
+		for (int out_feat_x = interior_begin; out_feat_x < interior_end; out_feat_x++)
+			convolution[out_feat_x] = 0;
+
+		for (int in_feat = 0; in_feat < NIN; in_feat++) {
+			for (int kernel_x = 0; kernel_x < K; kernel_x++) {
+				for (int kernel_y = 0; kernel_y < K; kernel_y++) {
+					float weight = weights[out_feat][in_feat][kernel_y][kernel_x];
+					ftmap_t *input_row = input_rows[kernel_y] + in_feat*input_feat_stride + kernel_x - padding;
+					for (int out_feat_x = interior_begin; out_feat_x < interior_end; out_feat_x++)
+						convolution[out_feat_x] += weight*input_row[out_feat_x];
+				}
+			}
+		}
+
+		// border columns: edge extension in x per tap
+		for (int out_feat_x = 0; out_feat_x < interior_begin; out_feat_x++)
+			convolution[out_feat_x] = conv_border_pixel<NIN, NOUT, K, IMG_W>(input_rows, input_feat_stride, weights, out_feat, out_feat_x);
+		for (int out_feat_x = interior_end; out_feat_x < IMG_W; out_feat_x++)
+			convolution[out_feat_x] = conv_border_pixel<NIN, NOUT, K, IMG_W>(input_rows, input_feat_stride, weights, out_feat, out_feat_x);
+
+		for (int out_feat_x = 0; out_feat_x < IMG_W; out_feat_x++) {
+			float result = convolution[out_feat_x] + feat_bias;
+			output_row[out_feat*output_feat_stride + out_feat_x] = RELU ? fmaxf(0, result) : result;
+		}
+	}
+}
+
+// implements a whole layer, one output row at a time
+template <int NIN, int NOUT, int K, bool RELU, int IMG_H, int IMG_W>
+void conv_template(ftmap_t input_ftmap[NIN][IMG_H][IMG_W],
+                   param_t weights[NOUT][NIN][K][K],
+                   param_t biases[NOUT],
+                   ftmap_t output_ftmap[NOUT][IMG_H][IMG_W])
+{
+	const int padding = K/2;
+	ftmap_t *input_rows[K];
+	for (int out_feat_y = 0; out_feat_y < IMG_H; out_feat_y++) {
+		// edge extension in y, resolved once for the whole row
+		for (int kernel_y = 0; kernel_y < K; kernel_y++)
+			input_rows[kernel_y] = &input_ftmap[0][conv_clamp_index(out_feat_y + kernel_y - padding, IMG_H)][0];
+		conv_row_template<NIN, NOUT, K, RELU, IMG_H, IMG_W>(input_rows, IMG_H*IMG_W, weights, biases,
+		                                                    &output_ftmap[0][out_feat_y][0], IMG_H*IMG_W);
+	}
+}
+
+#endif /* _CONV_TEMPLATE_H_ */
@@ -0,0 +1,75 @@
+#ifndef _DATAFLOW_H_
+#define _DATAFLOW_H_
+
+#include "srcnn.h"
+
+// Throughput model of srcnn_dataflow(), for estimating before synthesis
+// what initiation interval a set of per-stage loop IIs and FIFO depths can
+// sustain. srcnn_dataflow_profile() runs the same loop bodies as
+// srcnn_dataflow() (so it produces the same output) but interleaves the
+// stages cycle by cycle: a stage starts an iteration every ii cycles
+// unless its input FIFO is empty (starved) or its output FIFO holds depth
+// tokens (blocked). The model assumes each loop is pipelined at its ii and
+// ignores pipeline fill and memory ports.
+
+enum srcnn_df_stage_id_t {
+    SRCNN_DF_READ,      // input array to pixel stream
+    SRCNN_DF_CONV1,     // 9x9 window over a line buffer of F1 rows
+    SRCNN_DF_CONV2,     // 1x1, pixel by pixel
+    SRCNN_DF_CONV3,     // 5x5 window over a line buffer of F3 rows
+    SRCNN_DF_WRITE,     // pixel stream to output array
+    SRCNN_DF_STAGES
+};
+
+// FIFO f links stage f to stage f + 1
+#define SRCNN_DF_FIFOS (SRCNN_DF_STAGES - 1)
+
+const char *srcnn_df_stage_name(srcnn_df_stage_id_t stage);
+
+struct srcnn_df_config_t {
+    int ii[SRCNN_DF_STAGES];        // cycles between loop iterations
+    int depth[SRCNN_DF_FIFOS];      // FIFO depths in tokens (pixels)
+};
+
+// an FPGA with macs_per_cycle floating-point multiply-accumulate units,
+// shared by the conv stages in proportion to their MACs per pixel so that
+// their loops take about as long, with FIFOs of depth (2 by default in HLS)
+srcnn_df_config_t srcnn_df_balanced_config(int macs_per_cycle,
+                                           int depth = 2);
+
+struct srcnn_df_stage_t {
+    long iterations;
+    long first;         // cycle of the first iteration
+    long last;          // cycle of the last iteration
+    long starved;       // cycles ready to start an iteration but waiting for input
+    long blocked;       // cycles ready to start an iteration but waiting for space
+};
+
+struct srcnn_df_fifo_t {
+    long   tokens;      // written over the frame
+    int    max;         // peak occupancy
+    double mean;        // mean occupancy per cycle
+    long   full;        // cycles at depth
+};
+
+struct srcnn_df_profile_t {
+    long             latency;       // cycles from the first input to the last output
+    long             interval;      // estimated frame initiation interval, in cycles
+    int              bottleneck;    // stage whose loop sets the interval
+    srcnn_df_stage_t stage[SRCNN_DF_STAGES];
+    srcnn_df_fifo_t  fifo[SRCNN_DF_FIFOS];
+};
+
+// srcnn_dataflow() under the throughput model of config
+void srcnn_dataflow_profile(ftmap_t                  input_ftmap[N0][H][W],
+                            param_t                  conv1_weights[N1][N0][F1][F1],
+                            param_t                  conv1_biases[N1],
+                            param_t                  conv2_weights[N2][N1][F2][F2],
+                            param_t                  conv2_biases[N2],
+                            param_t                  conv3_weights[N3][N2][F3][F3],
+                            param_t                  conv3_biases[N3],
+                            ftmap_t                  output_ftmap[N3][H][W],
+                            const srcnn_df_config_t *config,
+                            srcnn_df_profile_t      *profile);
+
+#endif /* _DATAFLOW_H_ */
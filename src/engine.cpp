@@ -0,0 +1,1027 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include "engine.h"
+#include "gemm.h"
+#include "kernels.h"
+#include "metrics.h"
+#include "model_file.h"
+#include "simd.h"
+
+// alignment of the workspace and of every buffer carved from it (a cache line)
+#define SRCNN_WORKSPACE_ALIGN 64
+
+// output rows per band of the fused pipeline
+#define FUSED_BAND_ROWS 8
+
+// output tile of the tiled mode; with its halo the conv1 and conv2 maps of
+// a tile take about 3.4 MB
+#define TILE_ROWS 64
+#define TILE_COLS 128
+
+// conv1/conv2 rows and columns a conv3 output tile reads beyond its edges;
+// conv1 reads its own F1/2 halo straight from the input image
+#define TILE_HALO (F3/2 + F2/2)
+
+// output rows conv3 writes before a scored run of the simd mode scores them
+#define SCORE_BAND_ROWS 16
+
+// blocks the incremental and adaptive modes decide per. An input pixel
+// reaches output pixels up to REGION_REACH away, so as long as that is at
+// most a block, the blocks a changed block affects are itself and its
+// neighbours.
+#define REGION_BLOCK 16
+#define REGION_REACH (F1/2 + F2/2 + F3/2)
+
+#if REGION_REACH > REGION_BLOCK
+#error "the incremental engine mode expects a receptive field radius of at most REGION_BLOCK"
+#endif
+
+// layout of both intermediate maps in the blocked mode: the fastest pair
+// of tb_layout's table on AVX-512, and close to it on AVX2
+#define BLOCKED_LAYOUT FTMAP_NCHW16C
+
+#if F2 != 1
+#error "the fused engine mode expects a 1x1 conv2 kernel"
+#endif
+
+static const char *srcnn_mode_names[SRCNN_MODE_COUNT] = {
+    "reference",
+    "fused",
+    "gemm",
+    "simd",
+    "parallel",
+    "tiled",
+    "fft",
+    "fused23",
+    "blocked",
+    "fp16",
+    "bf16",
+    "sparse",
+    "incremental",
+    "adaptive",
+};
+
+const char *srcnn_mode_name(srcnn_mode_t mode)
+{
+    return mode >= 0 && mode < SRCNN_MODE_COUNT ? srcnn_mode_names[mode] : "unknown";
+}
+
+bool srcnn_mode_parse(const char *name, srcnn_mode_t *mode)
+{
+    for (int m = 0; m < SRCNN_MODE_COUNT; m++) {
+        if (strcmp(name, srcnn_mode_names[m]) == 0) {
+            *mode = (srcnn_mode_t) m;
+            return true;
+        }
+    }
+    return false;
+}
+
+// bump allocator over the workspace; with a NULL base it only measures, so
+// srcnn_workspace_bytes() and srcnn_ctx_create() share one layout function
+struct arena_t {
+    char   *base;
+    size_t  used;
+};
+
+static ftmap_t *arena_alloc(arena_t *arena, size_t count)
+{
+    size_t offset = (arena->used + SRCNN_WORKSPACE_ALIGN - 1)/SRCNN_WORKSPACE_ALIGN*SRCNN_WORKSPACE_ALIGN;
+    arena->used = offset + count*sizeof(ftmap_t);
+    return arena->base ? (ftmap_t *) (arena->base + offset) : NULL;
+}
+
+// intermediate buffers of one mode
+struct srcnn_buffers_t {
+    ftmap_t *layer1;    // conv1 output: full map, or a band of rows (fused)
+    ftmap_t *layer2;    // conv2 output: full map, or a window of rows (fused)
+    float   *scratch;   // GEMM packing workspace, FFT tile transforms, fused23 ring
+    float   *panels[3]; // GEMM weights of each layer, packed once per model
+    float   *spectra;   // FFT conv1 filter spectra, computed once per model
+    ftmap_mask_t          *masks;   // sparse mode: nonzero channels of each conv2 output pixel
+    conv_sparse_weights_t *sparse;  // sparse mode: conv2/conv3 weights, packed once per model
+    ftmap_t *previous[2];           // incremental mode: last input and output frame
+    uint8_t *blocks;                // incremental, adaptive modes: flags of each block
+    double  *integral;              // adaptive mode: input statistics along the edges of the block rows
+};
+
+// rows (or columns) of conv1/conv2 output a tile reads along a dimension of size n
+static int tile_region(int n, int tile)
+{
+    return tile + 2*TILE_HALO < n ? tile + 2*TILE_HALO : n;
+}
+
+static srcnn_buffers_t srcnn_layout(int h, int w, srcnn_mode_t mode, arena_t *arena)
+{
+    srcnn_buffers_t buffers = { NULL, NULL, NULL, { NULL, NULL, NULL }, NULL, NULL, NULL, { NULL, NULL }, NULL, NULL };
+    long pixels = (long) h*w;
+
+    switch (mode) {
+    case SRCNN_MODE_FUSED:
+        buffers.layer1 = arena_alloc(arena, (size_t) N1*(FUSED_BAND_ROWS + F3/2)*w);
+        buffers.layer2 = arena_alloc(arena, (size_t) N2*(FUSED_BAND_ROWS + F3 - 1)*w);
+        break;
+    case SRCNN_MODE_GEMM: {
+        size_t scratch = conv1_gemm_workspace_size(h, w);
+        if (scratch < conv2_gemm_workspace_size(h, w))
+            scratch = conv2_gemm_workspace_size(h, w);
+        if (scratch < conv3_gemm_workspace_size(h, w))
+            scratch = conv3_gemm_workspace_size(h, w);
+        buffers.layer1 = arena_alloc(arena, (size_t) N1*pixels);
+        buffers.layer2 = arena_alloc(arena, (size_t) N2*pixels);
+        buffers.scratch = arena_alloc(arena, scratch);
+        buffers.panels[0] = arena_alloc(arena, conv1_gemm_weights_size());
+        buffers.panels[1] = arena_alloc(arena, conv2_gemm_weights_size());
+        buffers.panels[2] = arena_alloc(arena, conv3_gemm_weights_size());
+        break;
+    }
+    case SRCNN_MODE_FFT:
+        buffers.layer1 = arena_alloc(arena, (size_t) N1*pixels);
+        buffers.layer2 = arena_alloc(arena, (size_t) N2*pixels);
+        if (conv1_preferred(h, w) == CONV1_FFT) {
+            buffers.scratch = arena_alloc(arena, conv1_fft_workspace_size());
+            buffers.spectra = arena_alloc(arena, conv1_fft_spectra_size());
+        } else {
+            buffers.scratch = arena_alloc(arena, conv1_gemm_workspace_size(h, w));
+            buffers.panels[0] = arena_alloc(arena, conv1_gemm_weights_size());
+        }
+        break;
+    case SRCNN_MODE_FUSED23:
+        buffers.layer1 = arena_alloc(arena, (size_t) N1*pixels);
+        buffers.scratch = arena_alloc(arena, conv23_fused_workspace_size(w));
+        break;
+    case SRCNN_MODE_FP16:
+    case SRCNN_MODE_BF16:
+        // 16-bit maps, rounded up to whole floats
+        buffers.layer1 = arena_alloc(arena, (size_t) (N1*pixels + 1)/2);
+        buffers.layer2 = arena_alloc(arena, (size_t) (N2*pixels + 1)/2);
+        break;
+    case SRCNN_MODE_SPARSE:
+        buffers.layer1 = arena_alloc(arena, (size_t) N1*pixels);
+        buffers.layer2 = arena_alloc(arena, (size_t) N2*pixels);
+        buffers.scratch = arena_alloc(arena, conv3_sparse_workspace_size(w));
+        buffers.masks = (ftmap_mask_t *) arena_alloc(arena, pixels*sizeof(ftmap_mask_t)/sizeof(ftmap_t));
+        buffers.sparse = (conv_sparse_weights_t *) arena_alloc(arena,
+            (sizeof(conv_sparse_weights_t) + sizeof(ftmap_t) - 1)/sizeof(ftmap_t));
+        break;
+    case SRCNN_MODE_TILED:
+    case SRCNN_MODE_INCREMENTAL:
+    case SRCNN_MODE_ADAPTIVE: {
+        long region = (long) tile_region(h, TILE_ROWS)*tile_region(w, TILE_COLS);
+        buffers.layer1 = arena_alloc(arena, (size_t) N1*region);
+        buffers.layer2 = arena_alloc(arena, (size_t) N2*region);
+        if (mode == SRCNN_MODE_INCREMENTAL) {
+            long blocks = (long) ((h + REGION_BLOCK - 1)/REGION_BLOCK)*((w + REGION_BLOCK - 1)/REGION_BLOCK);
+            buffers.previous[0] = arena_alloc(arena, pixels);
+            buffers.previous[1] = arena_alloc(arena, pixels);
+            buffers.blocks = (uint8_t *) arena_alloc(arena, (2*blocks + sizeof(ftmap_t) - 1)/sizeof(ftmap_t));
+        }
+        if (mode == SRCNN_MODE_ADAPTIVE) {
+            long blocks = (long) ((h + REGION_BLOCK - 1)/REGION_BLOCK)*((w + REGION_BLOCK - 1)/REGION_BLOCK);
+            buffers.blocks = (uint8_t *) arena_alloc(arena, (blocks + sizeof(ftmap_t) - 1)/sizeof(ftmap_t));
+            long cuts = 2*w + (long) 2*((h + REGION_BLOCK - 1)/REGION_BLOCK)*2*(w + 1);
+            buffers.integral = (double *) arena_alloc(arena, (size_t) cuts*sizeof(double)/sizeof(ftmap_t));
+        }
+        break;
+    }
+    default:
+        buffers.layer1 = arena_alloc(arena, (size_t) N1*pixels);
+        buffers.layer2 = arena_alloc(arena, (size_t) N2*pixels);
+        break;
+    }
+    return buffers;
+}
+
+struct srcnn_ctx_t {
+    srcnn_model_t        model;
+    int                  h;
+    int                  w;
+    srcnn_mode_t         mode;
+    thread_pool         *pool;      // parallel mode only, NULL otherwise
+    void                *block;     // allocation holding the workspace
+    srcnn_buffers_t      buffers;
+    conv_gemm_weights_t  packed[3]; // GEMM mode: weights in buffers.panels
+    float                prune;     // sparse mode: tolerance of the packed weights
+    float                flat;      // adaptive mode: deviation below which a block is flat
+    bool                 primed;    // incremental mode: buffers.previous holds a frame
+    double               recomputed; // fraction of the output the last run recomputed
+    metrics_state_t     *metrics;   // quality of the output of a scored run
+    const ftmap_t       *reference; // reference image while a scored run is in progress
+};
+
+size_t srcnn_workspace_bytes(int h, int w, srcnn_mode_t mode)
+{
+    arena_t arena = { NULL, 0 };
+    srcnn_layout(h, w, mode, &arena);
+    return arena.used;
+}
+
+srcnn_ctx_t *srcnn_ctx_create(const srcnn_model_t *model,
+                              int                  h,
+                              int                  w,
+                              srcnn_mode_t         mode,
+                              thread_pool         *pool)
+{
+    if (h <= 0 || w <= 0 || mode < 0 || mode >= SRCNN_MODE_COUNT)
+        throw std::runtime_error("Invalid SRCNN context dimensions or mode");
+
+    srcnn_ctx_t *ctx = new srcnn_ctx_t();
+    ctx->h = h;
+    ctx->w = w;
+    ctx->mode = mode;
+    // only the parallel mode runs on a pool; resolving the default pool
+    // for the others would start threads they never use
+    if (mode == SRCNN_MODE_PARALLEL)
+        ctx->pool = pool ? pool : &thread_pool_default();
+    try {
+        // over-allocate so the workspace can start on an aligned address
+        size_t bytes = srcnn_workspace_bytes(h, w, mode);
+        ctx->block = malloc(bytes + SRCNN_WORKSPACE_ALIGN);
+        if (!ctx->block)
+            throw std::runtime_error("Cannot allocate SRCNN workspace");
+        uintptr_t base = (uintptr_t) ctx->block + SRCNN_WORKSPACE_ALIGN - 1;
+        base -= base % SRCNN_WORKSPACE_ALIGN;
+        ctx->metrics = metrics_create(h, w);
+
+        arena_t arena = { (char *) base, 0 };
+        ctx->buffers = srcnn_layout(h, w, mode, &arena);
+        srcnn_ctx_set_model(ctx, model);
+    } catch (...) {
+        srcnn_ctx_destroy(ctx);
+        throw;
+    }
+    return ctx;
+}
+
+// packs the GEMM weights of the layers with panels for the current micro-kernel
+static void srcnn_ctx_pack(srcnn_ctx_t *ctx)
+{
+    if (ctx->buffers.panels[0])
+        ctx->packed[0] = conv1_gemm_pack(ctx->model.conv1_weights, ctx->buffers.panels[0]);
+    if (ctx->buffers.panels[1])
+        ctx->packed[1] = conv2_gemm_pack(ctx->model.conv2_weights, ctx->buffers.panels[1]);
+    if (ctx->buffers.panels[2])
+        ctx->packed[2] = conv3_gemm_pack(ctx->model.conv3_weights, ctx->buffers.panels[2]);
+}
+
+void srcnn_ctx_set_model(srcnn_ctx_t *ctx, const srcnn_model_t *model)
+{
+    ctx->model = *model;
+    ctx->primed = false;
+    if (ctx->buffers.panels[0])
+        srcnn_ctx_pack(ctx);
+    if (ctx->buffers.spectra)
+        conv1_fft_prepare(model->conv1_weights, ctx->buffers.spectra);
+    if (ctx->buffers.sparse)
+        conv_sparse_pack(model->conv2_weights, model->conv3_weights, ctx->prune, ctx->buffers.sparse);
+}
+
+long srcnn_ctx_set_prune(srcnn_ctx_t *ctx, float tolerance)
+{
+    ctx->prune = tolerance;
+    if (!ctx->buffers.sparse)
+        return 0;
+    conv_sparse_pack(ctx->model.conv2_weights, ctx->model.conv3_weights, tolerance, ctx->buffers.sparse);
+    return ctx->buffers.sparse->pruned;
+}
+
+void srcnn_ctx_set_flat(srcnn_ctx_t *ctx, float threshold)
+{
+    ctx->flat = threshold;
+}
+
+double srcnn_ctx_recomputed(const srcnn_ctx_t *ctx)
+{
+    return ctx->recomputed;
+}
+
+void srcnn_ctx_destroy(srcnn_ctx_t *ctx)
+{
+    if (!ctx)
+        return;
+    free(ctx->block);
+    metrics_destroy(ctx->metrics);
+    delete ctx;
+}
+
+// planar view with the given row stride
+static ftmap_view_t ftmap_view_strided(const ftmap_t *ftmap, int h, int stride)
+{
+    ftmap_view_t view = { (ftmap_t *) ftmap, (long) h*stride, stride, 0, 0 };
+    return view;
+}
+
+// copies the rows of a single-channel h x w image between two views
+static void ftmap_copy_rows(ftmap_view_t src, ftmap_view_t dst, int h, int w)
+{
+    for (int y = 0; y < h; y++)
+        memcpy(dst.data + (long) y*dst.stride, src.data + (long) y*src.stride, w*sizeof(ftmap_t));
+}
+
+// feeds rows [y0, y1) of the output of a scored run to its metrics
+static void srcnn_score_rows(const srcnn_ctx_t *ctx, ftmap_view_t output, int y0, int y1)
+{
+    metrics_rows(ctx->metrics, output.data + (long) y0*output.stride, output.stride,
+                 ctx->reference + (long) y0*ctx->w, ctx->w, y1 - y0);
+}
+
+// layer-by-layer over whole feature maps, on the scalar kernel if exact is
+// set (bit-identical to srcnn()) or the dispatched SIMD kernel otherwise. A
+// scored run writes conv3 a band of rows at a time and scores each band
+// while it is still in cache.
+static void srcnn_run_layers(const srcnn_ctx_t *ctx,
+                             const conv_layer_t layers[3],
+                             ftmap_view_t       input,
+                             ftmap_view_t       output,
+                             bool               exact)
+{
+    int h = ctx->h;
+    int w = ctx->w;
+    ftmap_view_t maps[4] = {
+        input,
+        ftmap_view(ctx->buffers.layer1, h, w),
+        ftmap_view(ctx->buffers.layer2, h, w),
+        output,
+    };
+
+    for (int l = 0; l < 3; l++) {
+        if (exact) {
+            conv_direct_scalar(&layers[l], maps[l], h, w, maps[l + 1], 0, layers[l].nout, 0, h, 0, w);
+        } else if (l == 2 && ctx->reference) {
+            for (int y0 = 0; y0 < h; y0 += SCORE_BAND_ROWS) {
+                int y1 = y0 + SCORE_BAND_ROWS < h ? y0 + SCORE_BAND_ROWS : h;
+                conv_direct(&layers[l], maps[l], h, w, maps[l + 1], 0, layers[l].nout, y0, y1, 0, w);
+                srcnn_score_rows(ctx, output, y0, y1);
+            }
+        } else {
+            conv_direct(&layers[l], maps[l], h, w, maps[l + 1], 0, layers[l].nout, 0, h, 0, w);
+        }
+    }
+}
+
+// row-band streaming pipeline: conv1/conv2 rows are produced once, just
+// before conv3's F3-row window first needs them, and conv2 rows stay in a
+// sliding window until no output band reads them any more. The working set
+// is (FUSED_BAND_ROWS + F3/2) conv1 rows plus (FUSED_BAND_ROWS + F3 - 1)
+// conv2 rows instead of two full feature maps.
+static void srcnn_run_fused(const srcnn_ctx_t *ctx,
+                            const conv_layer_t layers[3],
+                            ftmap_view_t       input,
+                            ftmap_view_t       output)
+{
+    int h = ctx->h;
+    int w = ctx->w;
+    int window_rows = FUSED_BAND_ROWS + F3 - 1;
+    ftmap_view_t band = { ctx->buffers.layer1, (long) (FUSED_BAND_ROWS + F3/2)*w, w, 0, 0 };
+    ftmap_view_t window = { ctx->buffers.layer2, (long) window_rows*w, w, 0, 0 };
+
+    int window_end = 0;  // conv2 rows [window.y0, window_end) are in the window
+    for (int y0 = 0; y0 < h; y0 += FUSED_BAND_ROWS) {
+        int y1 = y0 + FUSED_BAND_ROWS < h ? y0 + FUSED_BAND_ROWS : h;
+        int need_begin = y0 - F3/2 > 0 ? y0 - F3/2 : 0;
+        int need_end = y1 + F3/2 < h ? y1 + F3/2 : h;
+
+        // slide the window down to the first row this band still reads
+        if (need_begin > window.y0) {
+            int shift = need_begin - window.y0;
+            for (int feat = 0; feat < N2; feat++) {
+                ftmap_t *plane = window.data + feat*window.plane;
+                memmove(plane, plane + (long) shift*w, (size_t) (window_end - need_begin)*w*sizeof(ftmap_t));
+            }
+            window.y0 = need_begin;
+        }
+
+        // produce the missing conv1/conv2 rows
+        if (window_end < need_end) {
+            band.y0 = window_end;
+            conv_direct_scalar(&layers[0], input, h, w, band, 0, N1, window_end, need_end, 0, w);
+            conv_direct_scalar(&layers[1], band, h, w, window, 0, N2, window_end, need_end, 0, w);
+            window_end = need_end;
+        }
+
+        conv_direct_scalar(&layers[2], window, h, w, output, 0, N3, y0, y1, 0, w);
+    }
+}
+
+// the GEMM layers work on packed maps: strided images are staged through the
+// intermediate buffer that is free at that point
+static void srcnn_run_gemm(srcnn_ctx_t  *ctx,
+                           ftmap_view_t  input,
+                           ftmap_view_t  output)
+{
+    const srcnn_model_t *model = &ctx->model;
+    int h = ctx->h;
+    int w = ctx->w;
+
+    // the ISA was switched since the weights were packed
+    if (ctx->packed[0].kernel != gemm_kernel())
+        srcnn_ctx_pack(ctx);
+
+    const ftmap_t *input_ftmap = input.data;
+    if (input.stride != w) {
+        ftmap_copy_rows(input, ftmap_view(ctx->buffers.layer2, h, w), h, w);
+        input_ftmap = ctx->buffers.layer2;
+    }
+    ftmap_t *output_ftmap = output.stride != w ? ctx->buffers.layer1 : output.data;
+
+    conv1_gemm(input_ftmap, model->conv1_weights, model->conv1_biases, h, w,
+               ctx->buffers.layer1, ctx->buffers.scratch, &ctx->packed[0]);
+    conv2_gemm(ctx->buffers.layer1, model->conv2_weights, model->conv2_biases, h, w,
+               ctx->buffers.layer2, ctx->buffers.scratch, &ctx->packed[1]);
+    conv3_gemm(ctx->buffers.layer2, model->conv3_weights, model->conv3_biases, h, w,
+               output_ftmap, ctx->buffers.scratch, &ctx->packed[2]);
+
+    if (output_ftmap != output.data)
+        ftmap_copy_rows(ftmap_view(output_ftmap, h, w), output, h, w);
+}
+
+static void srcnn_run_parallel(const srcnn_ctx_t *ctx,
+                               const conv_layer_t layers[3],
+                               ftmap_view_t       input,
+                               ftmap_view_t       output)
+{
+    int h = ctx->h;
+    int w = ctx->w;
+    ftmap_view_t layer1 = ftmap_view(ctx->buffers.layer1, h, w);
+    ftmap_view_t layer2 = ftmap_view(ctx->buffers.layer2, h, w);
+
+    conv_parallel(*ctx->pool, &layers[0], input, layer1, h, w);
+    conv_parallel(*ctx->pool, &layers[1], layer1, layer2, h, w);
+    conv_parallel(*ctx->pool, &layers[2], layer2, output, h, w);
+}
+
+// runs the network on the output tile [ty0, ty1) x [tx0, tx1). conv1 and
+// conv2 are computed over the tile grown by TILE_HALO on each side (clipped
+// to the image) into tile-sized buffers; conv1 reads its own halo from the
+// input image. Pixels are addressed in image coordinates and edge extension
+// only happens at the image border, so every pixel sees the same inputs as
+// in whole-image processing and the seams are exact.
+static void srcnn_run_tile(const srcnn_ctx_t *ctx,
+                           const conv_layer_t layers[3],
+                           ftmap_view_t       input,
+                           ftmap_view_t       output,
+                           int                ty0,
+                           int                ty1,
+                           int                tx0,
+                           int                tx1)
+{
+    int h = ctx->h;
+    int w = ctx->w;
+    long plane = (long) tile_region(h, TILE_ROWS)*tile_region(w, TILE_COLS);
+    int ry0 = ty0 - TILE_HALO > 0 ? ty0 - TILE_HALO : 0;
+    int ry1 = ty1 + TILE_HALO < h ? ty1 + TILE_HALO : h;
+    int rx0 = tx0 - TILE_HALO > 0 ? tx0 - TILE_HALO : 0;
+    int rx1 = tx1 + TILE_HALO < w ? tx1 + TILE_HALO : w;
+
+    ftmap_view_t layer1 = { ctx->buffers.layer1, plane, rx1 - rx0, ry0, rx0 };
+    ftmap_view_t layer2 = { ctx->buffers.layer2, plane, rx1 - rx0, ry0, rx0 };
+    conv_direct(&layers[0], input, h, w, layer1, 0, N1, ry0, ry1, rx0, rx1);
+    conv_direct(&layers[1], layer1, h, w, layer2, 0, N2, ry0, ry1, rx0, rx1);
+    conv_direct(&layers[2], layer2, h, w, output, 0, N3, ty0, ty1, tx0, tx1);
+}
+
+// runs the network on the rectangle [y0, y1) x [x0, x1) of the output, one
+// TILE_ROWS x TILE_COLS tile at a time. The halo rows and columns are
+// recomputed by each neighbouring tile.
+static void srcnn_run_tiles(const srcnn_ctx_t *ctx,
+                            const conv_layer_t layers[3],
+                            ftmap_view_t       input,
+                            ftmap_view_t       output,
+                            int                y0,
+                            int                y1,
+                            int                x0,
+                            int                x1)
+{
+    for (int ty0 = y0; ty0 < y1; ty0 += TILE_ROWS) {
+        int ty1 = ty0 + TILE_ROWS < y1 ? ty0 + TILE_ROWS : y1;
+        for (int tx0 = x0; tx0 < x1; tx0 += TILE_COLS) {
+            int tx1 = tx0 + TILE_COLS < x1 ? tx0 + TILE_COLS : x1;
+            srcnn_run_tile(ctx, layers, input, output, ty0, ty1, tx0, tx1);
+        }
+    }
+}
+
+// the whole image one row of tiles at a time; a scored run scores each row
+// of tiles once it is complete
+static void srcnn_run_tiled(const srcnn_ctx_t *ctx,
+                            const conv_layer_t layers[3],
+                            ftmap_view_t       input,
+                            ftmap_view_t       output)
+{
+    if (!ctx->reference) {
+        srcnn_run_tiles(ctx, layers, input, output, 0, ctx->h, 0, ctx->w);
+        return;
+    }
+    for (int y0 = 0; y0 < ctx->h; y0 += TILE_ROWS) {
+        int y1 = y0 + TILE_ROWS < ctx->h ? y0 + TILE_ROWS : ctx->h;
+        srcnn_run_tiles(ctx, layers, input, output, y0, y1, 0, ctx->w);
+        srcnn_score_rows(ctx, output, y0, y1);
+    }
+}
+
+// runs the network on the flagged blocks of the output, merged into
+// rectangles: runs of flagged blocks along a block row, extended down over
+// the rows where the same blocks are flagged. Clears the flags and returns
+// the number of output pixels computed.
+static long srcnn_run_blocks(const srcnn_ctx_t *ctx,
+                             const conv_layer_t layers[3],
+                             ftmap_view_t       input,
+                             ftmap_view_t       output,
+                             uint8_t           *flags)
+{
+    int h = ctx->h;
+    int w = ctx->w;
+    int bh = (h + REGION_BLOCK - 1)/REGION_BLOCK;
+    int bw = (w + REGION_BLOCK - 1)/REGION_BLOCK;
+
+    long area = 0;
+    for (int by = 0; by < bh; by++)
+        for (int bx0 = 0; bx0 < bw; bx0++) {
+            if (!flags[by*bw + bx0])
+                continue;
+            int bx1 = bx0 + 1;
+            while (bx1 < bw && flags[by*bw + bx1])
+                bx1++;
+            int by1 = by + 1;
+            while (by1 < bh && memchr(&flags[by1*bw + bx0], 0, bx1 - bx0) == NULL)
+                by1++;
+            for (int y = by; y < by1; y++)
+                memset(&flags[y*bw + bx0], 0, bx1 - bx0);
+
+            int y0 = by*REGION_BLOCK, y1 = by1*REGION_BLOCK < h ? by1*REGION_BLOCK : h;
+            int x0 = bx0*REGION_BLOCK, x1 = bx1*REGION_BLOCK < w ? bx1*REGION_BLOCK : w;
+            srcnn_run_tiles(ctx, layers, input, output, y0, y1, x0, x1);
+            area += (long) (y1 - y0)*(x1 - x0);
+            bx0 = bx1;
+        }
+    return area;
+}
+
+// diffs the input against the previous frame, marks the changed blocks and
+// their neighbours dirty and recomputes the dirty blocks into the previous
+// output, then copies the output from it, recomputed pixels and all
+static void srcnn_run_incremental(srcnn_ctx_t        *ctx,
+                                  const conv_layer_t  layers[3],
+                                  ftmap_view_t        input,
+                                  ftmap_view_t        output)
+{
+    int h = ctx->h;
+    int w = ctx->w;
+    int bh = (h + REGION_BLOCK - 1)/REGION_BLOCK;
+    int bw = (w + REGION_BLOCK - 1)/REGION_BLOCK;
+    uint8_t *changed = ctx->buffers.blocks;
+    uint8_t *dirty = changed + (long) bh*bw;
+    ftmap_view_t previous = ftmap_view(ctx->buffers.previous[0], h, w);
+    ftmap_view_t stored = ftmap_view(ctx->buffers.previous[1], h, w);
+
+    if (ctx->primed) {
+        ftmap_diff_update(input, previous, h, w, REGION_BLOCK, changed);
+    } else {
+        ftmap_copy_rows(input, previous, h, w);
+        memset(changed, 1, (size_t) bh*bw);
+    }
+    for (int by = 0; by < bh; by++)
+        for (int bx = 0; bx < bw; bx++) {
+            uint8_t d = 0;
+            for (int y = by - 1 > 0 ? by - 1 : 0; y <= by + 1 && y < bh; y++)
+                for (int x = bx - 1 > 0 ? bx - 1 : 0; x <= bx + 1 && x < bw; x++)
+                    d |= changed[y*bw + x];
+            dirty[by*bw + bx] = d;
+        }
+
+    long area = srcnn_run_blocks(ctx, layers, input, stored, dirty);
+    ftmap_copy_rows(stored, output, h, w);
+    ctx->primed = true;
+    ctx->recomputed = (double) area/((double) h*w);
+}
+
+// first and last + 1 input rows the outputs of block row by read
+static int region_top(int by)
+{
+    return by*REGION_BLOCK - REGION_REACH > 0 ? by*REGION_BLOCK - REGION_REACH : 0;
+}
+
+static int region_bottom(int by, int h)
+{
+    return (by + 1)*REGION_BLOCK + REGION_REACH < h ? (by + 1)*REGION_BLOCK + REGION_REACH : h;
+}
+
+// row of the integral images at cut c: the top (2*by) or the bottom
+// (2*by + 1) edge of block row by, the sums w + 1 entries then the squares
+static double *region_cut(double *integral, int w, int c)
+{
+    return integral + 2*w + (long) c*2*(w + 1);
+}
+
+// fills the integral images of the input and of its squares along the top
+// and bottom edges of every grown block row: entry x of the cut at row y
+// sums the pixels [0, y) x [0, x). One pass over the input adds each row to
+// per-column sums, vectorised along the row; at a cut those are summed
+// across, so the whole image costs about one read of the input.
+static void region_integral(ftmap_view_t input, int h, int w, double *integral)
+{
+    int bh = (h + REGION_BLOCK - 1)/REGION_BLOCK;
+    double *col = integral, *col2 = integral + w;
+    memset(integral, 0, 2*w*sizeof(double));
+
+    int top = 0, bottom = 0;    // next block rows whose region starts, ends
+    for (int y = 0; y <= h; y++) {
+        while ((top < bh && region_top(top) == y) || (bottom < bh && region_bottom(bottom, h) == y)) {
+            bool first = top < bh && region_top(top) == y;
+            double *s = region_cut(integral, w, first ? 2*top++ : 2*bottom++ + 1), *s2 = s + w + 1;
+            double run = 0, run2 = 0;
+            s[0] = s2[0] = 0;
+            for (int x = 0; x < w; x++) {
+                run += col[x];
+                run2 += col2[x];
+                s[x + 1] = run;
+                s2[x + 1] = run2;
+            }
+        }
+        if (y == h)
+            break;
+        const ftmap_t *row = input.data + (long) (y - input.y0)*input.stride - input.x0;
+        for (int x = 0; x < w; x++) {
+            double v = row[x];
+            col[x] += v;
+            col2[x] += v*v;
+        }
+    }
+}
+
+// standard deviation of the input pixels of block row by's grown region in
+// columns [x0, x1), from the cuts region_integral() filled
+static double region_deviation(double *integral, int h, int w, int by, int x0, int x1)
+{
+    const double *top = region_cut(integral, w, 2*by), *bottom = region_cut(integral, w, 2*by + 1);
+    double s = bottom[x1] - bottom[x0] - top[x1] + top[x0];
+    double s2 = bottom[w + 1 + x1] - bottom[w + 1 + x0] - top[w + 1 + x1] + top[w + 1 + x0];
+    double n = (double) (region_bottom(by, h) - region_top(by))*(x1 - x0);
+    double var = s2/n - (s/n)*(s/n);
+    return var > 0 ? sqrt(var) : 0;
+}
+
+// runs the network only on textured blocks: a block is flat if the input
+// pixels its outputs read (the block grown by REGION_REACH) deviate by less
+// than ctx->flat, and flat blocks pass the input through to the output
+static void srcnn_run_adaptive(srcnn_ctx_t        *ctx,
+                               const conv_layer_t  layers[3],
+                               ftmap_view_t        input,
+                               ftmap_view_t        output)
+{
+    int h = ctx->h;
+    int w = ctx->w;
+    int bw = (w + REGION_BLOCK - 1)/REGION_BLOCK;
+    uint8_t *textured = ctx->buffers.blocks;
+    double *integral = ctx->buffers.integral;
+
+    // a threshold of 0 leaves no block flat, so skip the statistics
+    if (ctx->flat > 0)
+        region_integral(input, h, w, integral);
+    for (int y0 = 0; y0 < h; y0 += REGION_BLOCK) {
+        int y1 = y0 + REGION_BLOCK < h ? y0 + REGION_BLOCK : h;
+        for (int x0 = 0; x0 < w; x0 += REGION_BLOCK) {
+            int x1 = x0 + REGION_BLOCK < w ? x0 + REGION_BLOCK : w;
+            int rx0 = x0 - REGION_REACH > 0 ? x0 - REGION_REACH : 0;
+            int rx1 = x1 + REGION_REACH < w ? x1 + REGION_REACH : w;
+            bool flat = ctx->flat > 0 && region_deviation(integral, h, w, y0/REGION_BLOCK, rx0, rx1) < ctx->flat;
+            textured[(y0/REGION_BLOCK)*bw + x0/REGION_BLOCK] = !flat;
+            if (flat)
+                for (int y = y0; y < y1; y++)
+                    memcpy(output.data + (long) y*output.stride + x0, input.data + (long) y*input.stride + x0,
+                           (x1 - x0)*sizeof(ftmap_t));
+        }
+    }
+
+    long area = srcnn_run_blocks(ctx, layers, input, output, textured);
+    ctx->recomputed = (double) area/((double) h*w);
+}
+
+// the simd layers, with conv1 as an FFT convolution on images large enough
+// to fill its tiles
+static void srcnn_run_fft(srcnn_ctx_t        *ctx,
+                          const conv_layer_t  layers[3],
+                          ftmap_view_t        input,
+                          ftmap_view_t        output)
+{
+    int h = ctx->h;
+    int w = ctx->w;
+    ftmap_view_t layer1 = ftmap_view(ctx->buffers.layer1, h, w);
+    ftmap_view_t layer2 = ftmap_view(ctx->buffers.layer2, h, w);
+
+    if (ctx->buffers.spectra) {
+        conv1_fft(input, ctx->buffers.spectra, layers[0].biases, h, w, layer1, ctx->buffers.scratch);
+    } else {
+        // thin strips: GEMM, on a packed copy of a strided input
+        if (ctx->packed[0].kernel != gemm_kernel())
+            srcnn_ctx_pack(ctx);
+        const ftmap_t *input_ftmap = input.data;
+        if (input.stride != w) {
+            ftmap_copy_rows(input, layer2, h, w);
+            input_ftmap = layer2.data;
+        }
+        conv1_gemm(input_ftmap, layers[0].weights, layers[0].biases, h, w,
+                   layer1.data, ctx->buffers.scratch, &ctx->packed[0]);
+    }
+    conv_direct(&layers[1], layer1, h, w, layer2, 0, N2, 0, h, 0, w);
+    conv_direct(&layers[2], layer2, h, w, output, 0, N3, 0, h, 0, w);
+}
+
+// simd conv1 into a whole map, then conv2 and conv3 in one pass over it
+static void srcnn_run_fused23(const srcnn_ctx_t *ctx,
+                              const conv_layer_t layers[3],
+                              ftmap_view_t       input,
+                              ftmap_view_t       output)
+{
+    int h = ctx->h;
+    int w = ctx->w;
+    ftmap_view_t layer1 = ftmap_view(ctx->buffers.layer1, h, w);
+
+    conv_direct(&layers[0], input, h, w, layer1, 0, N1, 0, h, 0, w);
+    conv23_fused(layer1, layers[1].weights, layers[1].biases, layers[2].weights, layers[2].biases,
+                 h, w, output, ctx->buffers.scratch);
+}
+
+// the layout kernels: conv1 writes its map in BLOCKED_LAYOUT straight from
+// the planar image, conv2 keeps it and conv3 writes the planar image, so the
+// intermediate maps never go through NCHW. Both maps are stored in format,
+// the layers still accumulate in float.
+static void srcnn_run_blocked(const srcnn_ctx_t *ctx,
+                              ftmap_view_t       input,
+                              ftmap_view_t       output,
+                              ftmap_format_t     format)
+{
+    const srcnn_model_t *model = &ctx->model;
+    int h = ctx->h;
+    int w = ctx->w;
+
+    conv1_layout(input, model->conv1_weights, model->conv1_biases, h, w,
+                 ctx->buffers.layer1, BLOCKED_LAYOUT, format);
+    conv2_layout(ctx->buffers.layer1, BLOCKED_LAYOUT, model->conv2_weights, model->conv2_biases, h, w,
+                 ctx->buffers.layer2, BLOCKED_LAYOUT, format);
+    conv3_layout(ctx->buffers.layer2, BLOCKED_LAYOUT, model->conv3_weights, model->conv3_biases, h, w,
+                 output, format);
+}
+
+// conv1 writes a channel-last map, conv2 skips the zero channels of each
+// of its pixels and hands the masks of its own outputs to conv3, which
+// skips theirs
+static void srcnn_run_sparse(const srcnn_ctx_t *ctx,
+                             ftmap_view_t       input,
+                             ftmap_view_t       output)
+{
+    const srcnn_model_t *model = &ctx->model;
+    int h = ctx->h;
+    int w = ctx->w;
+
+    conv1_layout(input, model->conv1_weights, model->conv1_biases, h, w, ctx->buffers.layer1, FTMAP_NHWC);
+    conv2_sparse(ctx->buffers.layer1, ctx->buffers.sparse, model->conv2_biases, h, w,
+                 ctx->buffers.layer2, ctx->buffers.masks);
+    conv3_sparse(ctx->buffers.layer2, ctx->buffers.masks, ctx->buffers.sparse, model->conv3_biases, h, w,
+                 output, ctx->buffers.scratch);
+}
+
+void srcnn_ctx_run_strided(srcnn_ctx_t   *ctx,
+                           const ftmap_t *input_ftmap,
+                           int            input_stride,
+                           ftmap_t       *output_ftmap,
+                           int            output_stride)
+{
+    if (input_stride < ctx->w || output_stride < ctx->w)
+        throw std::runtime_error("SRCNN image stride is smaller than its width");
+
+    const srcnn_model_t *model = &ctx->model;
+    conv_layer_t layers[3] = {
+        { N0, N1, F1, model->conv1_weights, model->conv1_biases },
+        { N1, N2, F2, model->conv2_weights, model->conv2_biases },
+        { N2, N3, F3, model->conv3_weights, model->conv3_biases },
+    };
+    ftmap_view_t input = ftmap_view_strided(input_ftmap, ctx->h, input_stride);
+    ftmap_view_t output = ftmap_view_strided(output_ftmap, ctx->h, output_stride);
+
+    ctx->recomputed = 1;
+    switch (ctx->mode) {
+    case SRCNN_MODE_FUSED:
+        srcnn_run_fused(ctx, layers, input, output);
+        break;
+    case SRCNN_MODE_GEMM:
+        srcnn_run_gemm(ctx, input, output);
+        break;
+    case SRCNN_MODE_SIMD:
+        srcnn_run_layers(ctx, layers, input, output, false);
+        break;
+    case SRCNN_MODE_PARALLEL:
+        srcnn_run_parallel(ctx, layers, input, output);
+        break;
+    case SRCNN_MODE_TILED:
+        srcnn_run_tiled(ctx, layers, input, output);
+        break;
+    case SRCNN_MODE_FFT:
+        srcnn_run_fft(ctx, layers, input, output);
+        break;
+    case SRCNN_MODE_FUSED23:
+        srcnn_run_fused23(ctx, layers, input, output);
+        break;
+    case SRCNN_MODE_BLOCKED:
+        srcnn_run_blocked(ctx, input, output, FTMAP_FP32);
+        break;
+    case SRCNN_MODE_FP16:
+        srcnn_run_blocked(ctx, input, output, FTMAP_FP16);
+        break;
+    case SRCNN_MODE_BF16:
+        srcnn_run_blocked(ctx, input, output, FTMAP_BF16);
+        break;
+    case SRCNN_MODE_SPARSE:
+        srcnn_run_sparse(ctx, input, output);
+        break;
+    case SRCNN_MODE_INCREMENTAL:
+        srcnn_run_incremental(ctx, layers, input, output);
+        break;
+    case SRCNN_MODE_ADAPTIVE:
+        srcnn_run_adaptive(ctx, layers, input, output);
+        break;
+    default:
+        srcnn_run_layers(ctx, layers, input, output, true);
+        break;
+    }
+}
+
+void srcnn_ctx_run(srcnn_ctx_t   *ctx,
+                   const ftmap_t *input_ftmap,
+                   ftmap_t       *output_ftmap)
+{
+    srcnn_ctx_run_strided(ctx, input_ftmap, ctx->w, output_ftmap, ctx->w);
+}
+
+void srcnn_ctx_run_scored(srcnn_ctx_t     *ctx,
+                          const ftmap_t   *input_ftmap,
+                          ftmap_t         *output_ftmap,
+                          const ftmap_t   *reference,
+                          image_metrics_t *metrics)
+{
+    metrics_begin(ctx->metrics);
+    ctx->reference = reference;
+    try {
+        srcnn_ctx_run(ctx, input_ftmap, output_ftmap);
+    } catch (...) {
+        ctx->reference = NULL;
+        throw;
+    }
+    ctx->reference = NULL;
+
+    // the other modes are scored in one pass after the run
+    if (ctx->mode != SRCNN_MODE_SIMD && ctx->mode != SRCNN_MODE_TILED)
+        metrics_rows(ctx->metrics, output_ftmap, ctx->w, reference, ctx->w, ctx->h);
+    *metrics = metrics_end(ctx->metrics);
+}
+
+struct srcnn_batch_t {
+    thread_pool                *pool;
+    std::vector<srcnn_ctx_t *>  ctx;    // one per pool thread
+};
+
+srcnn_batch_t *srcnn_batch_create(const srcnn_model_t *model,
+                                  int                  h,
+                                  int                  w,
+                                  srcnn_mode_t         mode,
+                                  thread_pool         *pool)
+{
+    // the batch already keeps every thread busy with its own image
+    if (mode == SRCNN_MODE_PARALLEL)
+        mode = SRCNN_MODE_SIMD;
+
+    srcnn_batch_t *batch = new srcnn_batch_t;
+    batch->pool = pool ? pool : &thread_pool_default();
+    try {
+        for (int i = 0; i < batch->pool->size(); i++)
+            batch->ctx.push_back(srcnn_ctx_create(model, h, w, mode, batch->pool));
+    } catch (...) {
+        srcnn_batch_destroy(batch);
+        throw;
+    }
+    return batch;
+}
+
+void srcnn_batch_destroy(srcnn_batch_t *batch)
+{
+    if (!batch)
+        return;
+    for (srcnn_ctx_t *ctx : batch->ctx)
+        srcnn_ctx_destroy(ctx);
+    delete batch;
+}
+
+// arguments shared by the tasks of one srcnn_batch_run() call
+struct srcnn_batch_job_t {
+    srcnn_batch_t        *batch;
+    const ftmap_t *const *inputs;
+    ftmap_t *const       *outputs;
+    const ftmap_t *const *references;
+    image_metrics_t      *metrics;
+    double               *latency_ms;
+};
+
+void srcnn_batch_run(srcnn_batch_t        *batch,
+                     int                   count,
+                     const ftmap_t *const  inputs[],
+                     ftmap_t *const        outputs[],
+                     double               *latency_ms)
+{
+    srcnn_batch_run_scored(batch, count, inputs, outputs, NULL, NULL, latency_ms);
+}
+
+void srcnn_batch_run_scored(srcnn_batch_t        *batch,
+                            int                   count,
+                            const ftmap_t *const  inputs[],
+                            ftmap_t *const        outputs[],
+                            const ftmap_t *const  references[],
+                            image_metrics_t       metrics[],
+                            double               *latency_ms)
+{
+    srcnn_batch_job_t job = { batch, inputs, outputs, references, metrics, latency_ms };
+    const srcnn_batch_job_t *args = &job;
+
+    batch->pool->parallel_for_worker(count, [args](int image, int worker) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (args->references)
+            srcnn_ctx_run_scored(args->batch->ctx[worker], args->inputs[image], args->outputs[image],
+                                 args->references[image], &args->metrics[image]);
+        else
+            srcnn_ctx_run(args->batch->ctx[worker], args->inputs[image], args->outputs[image]);
+        if (args->latency_ms)
+            args->latency_ms[image] = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+    });
+}
+
+// contexts behind srcnn_run(), one per mode and thread, created on first use,
+// with the checksum of the weights each was last given
+struct srcnn_run_contexts_t {
+    srcnn_ctx_t *ctx[SRCNN_MODE_COUNT];
+    uint64_t     sum[SRCNN_MODE_COUNT];
+
+    srcnn_run_contexts_t() { memset(ctx, 0, sizeof(ctx)); memset(sum, 0, sizeof(sum)); }
+    ~srcnn_run_contexts_t()
+    {
+        for (int m = 0; m < SRCNN_MODE_COUNT; m++)
+            srcnn_ctx_destroy(ctx[m]);
+    }
+};
+
+static thread_local srcnn_run_contexts_t srcnn_run_contexts;
+
+// checksum of the contents of every weight and bias array of model
+static uint64_t srcnn_model_sum(const srcnn_model_t *model)
+{
+    const param_t *arrays[6] = {
+        model->conv1_weights, model->conv1_biases, model->conv2_weights,
+        model->conv2_biases, model->conv3_weights, model->conv3_biases,
+    };
+    const size_t counts[6] = { N1*N0*F1*F1, N1, N2*N1*F2*F2, N2, N3*N2*F3*F3, N3 };
+    uint64_t sum = 0;
+    for (int i = 0; i < 6; i++)
+        sum = sum*1099511628211ull ^ srcnn_model_checksum(arrays[i], counts[i]*sizeof(param_t));
+    return sum;
+}
+
+void srcnn_run(srcnn_mode_t mode,
+               ftmap_t      input_ftmap[N0][H][W],
+               param_t      conv1_weights[N1][N0][F1][F1],
+               param_t      conv1_biases[N1],
+               param_t      conv2_weights[N2][N1][F2][F2],
+               param_t      conv2_biases[N2],
+               param_t      conv3_weights[N3][N2][F3][F3],
+               param_t      conv3_biases[N3],
+               ftmap_t      output_ftmap[N3][H][W])
+{
+    srcnn_model_t model = {
+        &conv1_weights[0][0][0][0], conv1_biases,
+        &conv2_weights[0][0][0][0], conv2_biases,
+        &conv3_weights[0][0][0][0], conv3_biases,
+    };
+
+    if (mode < 0 || mode >= SRCNN_MODE_COUNT)
+        mode = SRCNN_MODE_REFERENCE;
+    srcnn_ctx_t *&ctx = srcnn_run_contexts.ctx[mode];
+    uint64_t &sum = srcnn_run_contexts.sum[mode];
+
+    // the weights may differ from call to call, in place or in new arrays,
+    // the buffers do not; the packed forms of the weights (GEMM panels, FFT
+    // spectra, sparse lists) are rebuilt when either changes
+    uint64_t model_sum = srcnn_model_sum(&model);
+    if (!ctx) {
+        ctx = srcnn_ctx_create(&model, H, W, mode);
+        sum = model_sum;
+    } else if (memcmp(&ctx->model, &model, sizeof(model)) != 0 || sum != model_sum) {
+        srcnn_ctx_set_model(ctx, &model);
+        sum = model_sum;
+    }
+    srcnn_ctx_run(ctx, &input_ftmap[0][0][0], &output_ftmap[0][0][0]);
+}
@@ -0,0 +1,172 @@
+#ifndef _ENGINE_H_
+#define _ENGINE_H_
+
+#include <stddef.h>
+
+#include "srcnn.h"
+#include "metrics.h"
+#include "thread_pool.h"
+
+// execution modes of the native SRCNN engine
+enum srcnn_mode_t {
+    SRCNN_MODE_REFERENCE = 0,   // layer-by-layer direct loops, bit-identical to srcnn()
+    SRCNN_MODE_FUSED,           // row-band streaming pipeline, bit-identical to srcnn()
+    SRCNN_MODE_GEMM,            // implicit GEMM conv1/conv3, blocked SGEMM conv2
+    SRCNN_MODE_SIMD,            // direct kernels vectorised over output columns
+    SRCNN_MODE_PARALLEL,        // simd kernels split across a thread_pool
+    SRCNN_MODE_TILED,           // simd kernels over cache-sized tiles, bit-identical to simd
+    SRCNN_MODE_FFT,             // simd kernels with conv1 by FFT, or GEMM on thin strips (conv1_preferred())
+    SRCNN_MODE_FUSED23,         // simd conv1, then conv2 and conv3 fused per pixel without a conv2 map
+    SRCNN_MODE_BLOCKED,         // layer kernels on channel-blocked (NCHW16c) intermediate maps
+    SRCNN_MODE_FP16,            // blocked, with the intermediate maps stored as IEEE half
+    SRCNN_MODE_BF16,            // blocked, with the intermediate maps stored as bfloat16
+    SRCNN_MODE_SPARSE,          // channel-last maps, conv2 and conv3 skipping zero activations
+    SRCNN_MODE_INCREMENTAL,     // tiled, recomputing only what changed since the previous frame
+    SRCNN_MODE_ADAPTIVE,        // tiled, passing flat regions of the input through
+    SRCNN_MODE_COUNT
+};
+
+// short lower-case name of a mode ("reference", "fused", ...)
+const char *srcnn_mode_name(srcnn_mode_t mode);
+
+// looks up a mode by name, returns false if there is none
+bool srcnn_mode_parse(const char *name, srcnn_mode_t *mode);
+
+// network parameters, laid out as in the *_3x_flp.bin files. The model only
+// points at them; they must outlive every context created from it, and
+// contexts have to be told with srcnn_ctx_set_model() when they change.
+struct srcnn_model_t {
+    const param_t *conv1_weights;   // [N1][N0][F1][F1]
+    const param_t *conv1_biases;    // [N1]
+    const param_t *conv2_weights;   // [N2][N1][F2][F2]
+    const param_t *conv2_biases;    // [N2]
+    const param_t *conv3_weights;   // [N3][N2][F3][F3]
+    const param_t *conv3_biases;    // [N3]
+};
+
+// inference context: a model, an image size, a mode and one aligned workspace
+// holding every intermediate buffer of that mode. Running a context does not
+// allocate, and contexts share no mutable state, so each thread can run its
+// own context concurrently with the others.
+struct srcnn_ctx_t;
+
+// bytes of workspace a context needs to run mode on h x w images. The
+// layer-by-layer modes hold two whole intermediate maps (N1 + N2 planes);
+// SRCNN_MODE_FUSED23 holds the conv1 map and a few rows of conv3 partial
+// sums; the fp16 and bf16 modes hold both maps at half the bytes;
+// SRCNN_MODE_FUSED holds bands of rows of both maps; the tiled mode
+// only holds the maps of one tile plus its halo, so its workspace stops
+// growing once the image is larger than a tile. The incremental mode adds
+// the previous input and output frames to the tiled workspace, the adaptive
+// mode a flag per block and the input statistics along its block rows.
+size_t srcnn_workspace_bytes(int h, int w, srcnn_mode_t mode);
+
+// creates a context for h x w images; SRCNN_MODE_PARALLEL runs on pool, or on
+// thread_pool_default() if pool is NULL. The other modes ignore pool and never
+// start the default pool's threads. Throws std::runtime_error on invalid
+// dimensions or if the workspace cannot be allocated.
+srcnn_ctx_t *srcnn_ctx_create(const srcnn_model_t *model,
+                              int                  h,
+                              int                  w,
+                              srcnn_mode_t         mode,
+                              thread_pool         *pool = NULL);
+
+void srcnn_ctx_destroy(srcnn_ctx_t *ctx);
+
+// points the context at new (or modified) parameters; the GEMM mode packs
+// its weights and the FFT mode transforms its conv1 filters here once
+// instead of on every frame
+void srcnn_ctx_set_model(srcnn_ctx_t *ctx, const srcnn_model_t *model);
+
+// SRCNN_MODE_SPARSE: prunes conv2/conv3 weights of magnitude at most
+// tolerance (0 by default, which keeps every weight) and repacks them;
+// returns the number of weights pruned. Other modes ignore it.
+long srcnn_ctx_set_prune(srcnn_ctx_t *ctx, float tolerance);
+
+// SRCNN_MODE_INCREMENTAL keeps the previous input and output frame. Each run
+// diffs the input against the previous one in blocks of pixels, grows the
+// changed blocks by the network's receptive field, recomputes only those
+// regions with the tiled kernels and copies the rest of the output from the
+// previous frame; the output is bit-identical to the tiled mode. The first
+// run, and the first after srcnn_ctx_set_model(), recomputes everything.
+//
+// SRCNN_MODE_ADAPTIVE: blocks whose output reads input pixels of standard
+// deviation below threshold (on the [0, 1] scale) are flat and get the input
+// passed through; the others run the tiled kernels. The default threshold
+// of 0 treats every block as textured, which matches the tiled mode bit for
+// bit. tb_adaptive sweeps it against PSNR on Set14. Other modes ignore it.
+void srcnn_ctx_set_flat(srcnn_ctx_t *ctx, float threshold);
+
+// fraction of the output pixels the last run recomputed: 1 for every other
+// mode, 0 for an incremental run on an unchanged frame or an adaptive run
+// on a flat image
+double srcnn_ctx_recomputed(const srcnn_ctx_t *ctx);
+
+// implements end-to-end SRCNN on one planar h x w image
+void srcnn_ctx_run(srcnn_ctx_t   *ctx,
+                   const ftmap_t *input_ftmap,
+                   ftmap_t       *output_ftmap);
+
+// as srcnn_ctx_run(), for images whose rows are input_stride and
+// output_stride elements apart (both at least w), e.g. a window of a frame
+void srcnn_ctx_run_strided(srcnn_ctx_t   *ctx,
+                           const ftmap_t *input_ftmap,
+                           int            input_stride,
+                           ftmap_t       *output_ftmap,
+                           int            output_stride);
+
+// as srcnn_ctx_run(), also returning the metrics (metrics.h) of the output
+// against reference, an h x w image. The simd and tiled modes score each
+// band of rows right after conv3 writes it, while it is still in cache; the
+// other modes score the output in one pass after the run.
+void srcnn_ctx_run_scored(srcnn_ctx_t     *ctx,
+                          const ftmap_t   *input_ftmap,
+                          ftmap_t         *output_ftmap,
+                          const ftmap_t   *reference,
+                          image_metrics_t *metrics);
+
+// batch runner: one context per thread of a pool, each thread taking whole
+// images, so the weights are loaded and packed once per thread for the
+// whole batch. SRCNN_MODE_PARALLEL batches use simd contexts since the
+// images already run in parallel.
+struct srcnn_batch_t;
+
+srcnn_batch_t *srcnn_batch_create(const srcnn_model_t *model,
+                                  int                  h,
+                                  int                  w,
+                                  srcnn_mode_t         mode,
+                                  thread_pool         *pool = NULL);
+
+void srcnn_batch_destroy(srcnn_batch_t *batch);
+
+// implements end-to-end SRCNN on count planar h x w images, inputs[i] into
+// outputs[i]; if latency_ms is not NULL it receives each image's run time
+void srcnn_batch_run(srcnn_batch_t        *batch,
+                     int                   count,
+                     const ftmap_t *const  inputs[],
+                     ftmap_t *const        outputs[],
+                     double               *latency_ms = NULL);
+
+// as srcnn_batch_run(), also scoring outputs[i] against references[i] into
+// metrics[i] (see srcnn_ctx_run_scored())
+void srcnn_batch_run_scored(srcnn_batch_t        *batch,
+                            int                   count,
+                            const ftmap_t *const  inputs[],
+                            ftmap_t *const        outputs[],
+                            const ftmap_t *const  references[],
+                            image_metrics_t       metrics[],
+                            double               *latency_ms = NULL);
+
+// implements end-to-end SRCNN with the selected execution mode, through a
+// context per mode owned by the calling thread
+void srcnn_run(srcnn_mode_t mode,
+               ftmap_t      input_ftmap[N0][H][W],
+               param_t      conv1_weights[N1][N0][F1][F1],
+               param_t      conv1_biases[N1],
+               param_t      conv2_weights[N2][N1][F2][F2],
+               param_t      conv2_biases[N2],
+               param_t      conv3_weights[N3][N2][F3][F3],
+               param_t      conv3_biases[N3],
+               ftmap_t      output_ftmap[N3][H][W]);
+
+#endif /* _ENGINE_H_ */
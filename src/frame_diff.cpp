@@ -0,0 +1,106 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <stdexcept>
+
+#include "kernels.h"
+#include "simd.h"
+
+#define DIFF_INLINE static inline __attribute__((always_inline))
+
+// GCC vector of VL 32-bit integers, looked up as simd_vec is
+template <int VL> struct diff_bits;
+template <> struct diff_bits<16> { typedef int32_t type __attribute__((vector_size(64), aligned(4), may_alias)); };
+template <> struct diff_bits<8>  { typedef int32_t type __attribute__((vector_size(32), aligned(4), may_alias)); };
+template <> struct diff_bits<4>  { typedef int32_t type __attribute__((vector_size(16), aligned(4), may_alias)); };
+
+// compares the pixels [y0, y1) x [x0, x1) of image with previous bit for
+// bit, VL pixels at a time, and copies them over; returns whether any
+// pixel differed. Bits are compared rather than values so that any change
+// the layers could see counts, including -0.0 against 0.0.
+template <int VL>
+DIFF_INLINE bool diff_block(ftmap_view_t image, ftmap_view_t previous, int y0, int y1, int x0, int x1)
+{
+    typedef typename diff_bits<VL>::type VBITS;
+
+    VBITS acc = {};
+    int32_t tail = 0;
+    for (int y = y0; y < y1; y++) {
+        const ftmap_t *a = image.data + (long) (y - image.y0)*image.stride - image.x0;
+        ftmap_t *b = previous.data + (long) (y - previous.y0)*previous.stride - previous.x0;
+        int x = x0;
+        for (; x + VL <= x1; x += VL) {
+            VBITS va = *(const VBITS *) (a + x);
+            acc |= va ^ *(const VBITS *) (b + x);
+            *(VBITS *) (b + x) = va;
+        }
+        for (; x < x1; x++) {
+            int32_t ia, ib;
+            memcpy(&ia, a + x, sizeof(ia));
+            memcpy(&ib, b + x, sizeof(ib));
+            tail |= ia ^ ib;
+            b[x] = a[x];
+        }
+    }
+    for (int k = 0; k < VL; k++)
+        tail |= acc[k];
+    return tail != 0;
+}
+
+template <int VL>
+DIFF_INLINE void diff_blocks(ftmap_view_t image, ftmap_view_t previous, int h, int w, int block, uint8_t *changed)
+{
+    int bw = (w + block - 1)/block;
+    for (int y0 = 0; y0 < h; y0 += block) {
+        int y1 = y0 + block < h ? y0 + block : h;
+        for (int x0 = 0; x0 < w; x0 += block) {
+            int x1 = x0 + block < w ? x0 + block : w;
+            changed[(y0/block)*bw + x0/block] = diff_block<VL>(image, previous, y0, y1, x0, x1);
+        }
+    }
+}
+
+// per-target instantiations, see simd_vec
+static void diff_blocks_default(ftmap_view_t image, ftmap_view_t previous, int h, int w, int block, uint8_t *changed)
+{
+    diff_blocks<4>(image, previous, h, w, block, changed);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void diff_blocks_avx2(ftmap_view_t image, ftmap_view_t previous, int h, int w, int block, uint8_t *changed)
+{
+    diff_blocks<8>(image, previous, h, w, block, changed);
+}
+
+__attribute__((target("avx512f")))
+static void diff_blocks_avx512(ftmap_view_t image, ftmap_view_t previous, int h, int w, int block, uint8_t *changed)
+{
+    diff_blocks<16>(image, previous, h, w, block, changed);
+}
+#endif
+
+void ftmap_diff_update(ftmap_view_t  image,
+                       ftmap_view_t  previous,
+                       int           h,
+                       int           w,
+                       int           block,
+                       uint8_t      *changed)
+{
+    if (block <= 0)
+        throw std::runtime_error("Invalid frame difference block size");
+
+    switch (simd_isa()) {
+#if defined(__x86_64__) || defined(__i386__)
+    case SIMD_ISA_AVX512:
+        diff_blocks_avx512(image, previous, h, w, block, changed);
+        break;
+    case SIMD_ISA_AVX2:
+        diff_blocks_avx2(image, previous, h, w, block, changed);
+        break;
+#endif
+    default:
+        diff_blocks_default(image, previous, h, w, block, changed);
+        break;
+    }
+}
@@ -0,0 +1,199 @@
+#include "gemm.h"
+#include "simd.h"
+#include <math.h>
+
+// portable micro-kernel tile, small enough that the accumulators stay in
+// SSE/NEON registers once the compiler vectorises the nr loop
+#define GEMM_REF_MR 4
+#define GEMM_REF_NR 8
+
+static void gemm_ukernel_ref(int          kc,
+                             const float *a,
+                             const float *b,
+                             float       *c,
+                             int          load_c)
+{
+    float acc[GEMM_REF_MR][GEMM_REF_NR];
+
+    for (int i = 0; i < GEMM_REF_MR; i++)
+        for (int j = 0; j < GEMM_REF_NR; j++)
+            acc[i][j] = load_c ? c[i*GEMM_REF_NR + j] : 0;
+
+    for (int p = 0; p < kc; p++) {
+        for (int i = 0; i < GEMM_REF_MR; i++) {
+            float a_ip = a[i];
+            for (int j = 0; j < GEMM_REF_NR; j++)
+                acc[i][j] += a_ip*b[j];
+        }
+        a += GEMM_REF_MR;
+        b += GEMM_REF_NR;
+    }
+
+    for (int i = 0; i < GEMM_REF_MR; i++)
+        for (int j = 0; j < GEMM_REF_NR; j++)
+            c[i*GEMM_REF_NR + j] = acc[i][j];
+}
+
+static const gemm_kernel_t gemm_kernel_ref = {
+    "scalar", GEMM_REF_MR, GEMM_REF_NR, gemm_ukernel_ref
+};
+
+const gemm_kernel_t *gemm_kernel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    switch (simd_isa()) {
+    case SIMD_ISA_AVX512:
+        return &gemm_kernel_avx512;
+    case SIMD_ISA_AVX2:
+        return &gemm_kernel_avx2;
+    default:
+        break;
+    }
+#endif
+    return &gemm_kernel_ref;
+}
+
+static int round_up(int x, int to)
+{
+    return (x + to - 1)/to*to;
+}
+
+size_t gemm_packed_a_size(const gemm_kernel_t *kernel, int m, int k)
+{
+    int mr = kernel ? kernel->mr : GEMM_MR_MAX;
+    return (size_t) round_up(m, mr)*k;
+}
+
+void gemm_pack_a(const gemm_kernel_t *kernel,
+                 gemm_matrix_t        a,
+                 int                  m,
+                 int                  k,
+                 float               *packed_a)
+{
+    int mr = kernel->mr;
+
+    for (int i0 = 0; i0 < m; i0 += mr) {
+        for (int p = 0; p < k; p++) {
+            for (int i = 0; i < mr; i++)
+                packed_a[i] = i0 + i < m ? a.data[(i0 + i)*a.rs + p*a.cs] : 0;
+            packed_a += mr;
+        }
+    }
+}
+
+void gemm_pack_b_matrix(const void *b_src,
+                        int         k0,
+                        int         kc,
+                        int         n0,
+                        int         nc,
+                        int         nr,
+                        float      *dst)
+{
+    const gemm_matrix_t *b = (const gemm_matrix_t *) b_src;
+    int nc_full = nc/nr*nr;
+
+    if (b->cs == 1) {
+        // rows of B are contiguous (e.g. planar feature maps): stream each row once
+        for (int p = 0; p < kc; p++) {
+            const float *src = b->data + (k0 + p)*b->rs + n0;
+            float *row = dst + p*nr;
+            for (int j0 = 0; j0 < nc_full; j0 += nr)
+                for (int j = 0; j < nr; j++)
+                    row[j0*kc + j] = src[j0 + j];
+            if (nc_full < nc)
+                for (int j = 0; j < nr; j++)
+                    row[nc_full*kc + j] = nc_full + j < nc ? src[nc_full + j] : 0;
+        }
+    } else {
+        // columns of B are contiguous (e.g. channel-last feature maps)
+        for (int j = 0; j < nc; j++) {
+            const float *src = b->data + k0*b->rs + (n0 + j)*b->cs;
+            float *col = dst + (j/nr)*kc*nr + j%nr;
+            for (int p = 0; p < kc; p++)
+                col[p*nr] = src[p*b->rs];
+        }
+        for (int j = nc; j < (nc + nr - 1)/nr*nr; j++) {
+            float *col = dst + (j/nr)*kc*nr + j%nr;
+            for (int p = 0; p < kc; p++)
+                col[p*nr] = 0;
+        }
+    }
+}
+
+size_t gemm_workspace_size(const gemm_kernel_t *kernel)
+{
+    int mr = kernel ? kernel->mr : GEMM_MR_MAX;
+    int nr = kernel ? kernel->nr : GEMM_NR_MAX;
+
+    // packed B panel plus one C tile
+    return (size_t) GEMM_KC*round_up(GEMM_NC, nr) + mr*nr;
+}
+
+void sgemm(const gemm_kernel_t *kernel,
+           int                  m,
+           int                  n,
+           int                  k,
+           const float         *packed_a,
+           gemm_pack_b_t        pack_b,
+           const void          *b_src,
+           float               *c,
+           long                 rs_c,
+           long                 cs_c,
+           const float         *bias,
+           int                  relu,
+           float               *workspace)
+{
+    int mr = kernel->mr;
+    int nr = kernel->nr;
+    float *packed_b = workspace;
+    float *tile = workspace + (size_t) GEMM_KC*round_up(GEMM_NC, nr);
+
+    for (int jc = 0; jc < n; jc += GEMM_NC) {
+        int nc = n - jc < GEMM_NC ? n - jc : GEMM_NC;
+
+        for (int pc = 0; pc < k; pc += GEMM_KC) {
+            int kc = k - pc < GEMM_KC ? k - pc : GEMM_KC;
+            int first = pc == 0;
+            int last = pc + kc == k;
+
+            pack_b(b_src, pc, kc, jc, nc, nr, packed_b);
+
+            for (int ic = 0; ic < m; ic += GEMM_MC) {
+                int mc = m - ic < GEMM_MC ? m - ic : GEMM_MC;
+
+                for (int jr = 0; jr < nc; jr += nr) {
+                    int nb = nc - jr < nr ? nc - jr : nr;
+                    const float *b_panel = packed_b + (size_t) jr*kc;
+
+                    for (int ir = 0; ir < mc; ir += mr) {
+                        int mb = mc - ir < mr ? mc - ir : mr;
+                        const float *a_panel = packed_a + (size_t) (ic + ir)*k + (size_t) pc*mr;
+                        float *c_tile = c + (ic + ir)*rs_c + (jc + jr)*cs_c;
+
+                        // partial sums of earlier K panels continue from C
+                        if (!first)
+                            for (int i = 0; i < mb; i++)
+                                for (int j = 0; j < nb; j++)
+                                    tile[i*nr + j] = c_tile[i*rs_c + j*cs_c];
+
+                        kernel->ukernel(kc, a_panel, b_panel, tile, !first);
+
+                        for (int i = 0; i < mb; i++) {
+                            float b_i = bias && last ? bias[ic + ir + i] : 0;
+                            for (int j = 0; j < nb; j++) {
+                                float v = tile[i*nr + j];
+                                if (last) {
+                                    if (bias)
+                                        v += b_i;
+                                    if (relu)
+                                        v = fmaxf(0, v);
+                                }
+                                c_tile[i*rs_c + j*cs_c] = v;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef _GEMM_H_
+#define _GEMM_H_
+
+#include <stddef.h>
+
+// cache blocking of the SGEMM driver (in elements)
+#define GEMM_KC 256     // depth of a packed panel, sized so one A and B micro-panel stay in L1
+#define GEMM_MC 96      // rows of A swept per packed B panel
+#define GEMM_NC 1024    // columns of B per packed panel, sized so the panel stays in L2
+
+// largest micro-kernel tile of any ISA, used to size buffers that must
+// outlive an ISA switch (see simd_set_isa())
+#define GEMM_MR_MAX 8
+#define GEMM_NR_MAX 32
+
+// register-blocked micro-kernel: computes an mr x nr tile of C
+//   c:      mr x nr tile, row-major with stride nr
+//   a:      kc steps of mr packed A values
+//   b:      kc steps of nr packed B values
+//   load_c: continue accumulating from c instead of starting at zero
+typedef void (*gemm_ukernel_t)(int          kc,
+                               const float *a,
+                               const float *b,
+                               float       *c,
+                               int          load_c);
+
+struct gemm_kernel_t {
+    const char     *name;
+    int             mr;
+    int             nr;
+    gemm_ukernel_t  ukernel;
+};
+
+// packs columns [n0, n0+nc) of rows [k0, k0+kc) of B into nr-wide micro-panels
+typedef void (*gemm_pack_b_t)(const void *b_src,
+                              int         k0,
+                              int         kc,
+                              int         n0,
+                              int         nc,
+                              int         nr,
+                              float      *dst);
+
+// strided matrix view, element (i, j) at data[i*rs + j*cs]
+struct gemm_matrix_t {
+    const float *data;
+    long         rs;
+    long         cs;
+};
+
+// returns the micro-kernel used by the SGEMM driver
+const gemm_kernel_t *gemm_kernel();
+
+// number of floats needed to hold A (m x k) packed for kernel, or for any
+// kernel if kernel is NULL
+size_t gemm_packed_a_size(const gemm_kernel_t *kernel, int m, int k);
+
+// packs A (m x k) into mr-row micro-panels spanning the full depth k
+void gemm_pack_a(const gemm_kernel_t *kernel,
+                 gemm_matrix_t        a,
+                 int                  m,
+                 int                  k,
+                 float               *packed_a);
+
+// B packer for a gemm_matrix_t source
+void gemm_pack_b_matrix(const void *b_src,
+                        int         k0,
+                        int         kc,
+                        int         n0,
+                        int         nc,
+                        int         nr,
+                        float      *dst);
+
+// number of floats of scratch the driver needs for kernel, or for any
+// kernel if kernel is NULL
+size_t gemm_workspace_size(const gemm_kernel_t *kernel);
+
+// C (m x n) = act(A (m x k) * B (k x n) + bias)
+//
+// C element (i, j) lives at c[i*rs_c + j*cs_c]. Each element is accumulated
+// over k in order starting from zero and the bias is added last, matching
+// the reference convolution loops. bias may be NULL; relu clamps at zero.
+void sgemm(const gemm_kernel_t *kernel,
+           int                  m,
+           int                  n,
+           int                  k,
+           const float         *packed_a,
+           gemm_pack_b_t        pack_b,
+           const void          *b_src,
+           float               *c,
+           long                 rs_c,
+           long                 cs_c,
+           const float         *bias,
+           int                  relu,
+           float               *workspace);
+
+#endif /* _GEMM_H_ */
@@ -0,0 +1,396 @@
+#ifndef _KERNELS_H_
+#define _KERNELS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "srcnn.h"
+
+// Native (non-HLS) layer kernels. Unlike the HLS entry points in srcnn.h these
+// take flat pointers and runtime image dimensions:
+//   planar (NCHW) maps:       element (c, y, x) at ftmap[(c*h + y)*w + x]
+//   channel-last (NHWC) maps: element (c, y, x) at ftmap[(y*w + x)*channels + c]
+//   blocked maps (NCHW8c, NCHW16c): see ftmap_layout_t
+//   weights keep the [out][in][ky][kx] layout of the *_3x_flp.bin files
+
+// window of a planar feature map: element (c, y, x) of the image lives at
+// data[c*plane + (y - y0)*stride + (x - x0)], so a view can cover the whole
+// image (y0 = x0 = 0) or just the rows/tile a kernel needs
+struct ftmap_view_t {
+    ftmap_t *data;
+    long     plane;
+    int      stride;
+    int      y0;
+    int      x0;
+};
+
+// shape and parameters of one convolutional layer (all three end in a ReLU)
+struct conv_layer_t {
+    int            nin;
+    int            nout;
+    int            f;
+    const param_t *weights;     // [nout][nin][f][f]
+    const param_t *biases;      // [nout]
+};
+
+// direct convolution of output features [f0, f1) over the output rectangle
+// [y0, y1) x [x0, x1) of an h x w image, edge extended at the image border.
+// Dispatches to the widest SIMD kernel the CPU supports (see simd.h), which
+// vectorises over adjacent output x positions; the scalar kernel matches the
+// reference loops bit for bit, the FMA kernels to within rounding. Each kernel
+// computes a pixel the same way however the output is split into rectangles,
+// so bands and tiles reproduce the whole-image result exactly.
+void conv_direct(const conv_layer_t *layer,
+                 ftmap_view_t        input,
+                 int                 h,
+                 int                 w,
+                 ftmap_view_t        output,
+                 int                 f0,
+                 int                 f1,
+                 int                 y0,
+                 int                 y1,
+                 int                 x0,
+                 int                 x1);
+
+// whole-image view of a planar map with the given number of rows and columns
+ftmap_view_t ftmap_view(const ftmap_t *ftmap, int h, int w);
+
+class thread_pool;
+
+// conv_direct() of a whole h x w layer, split across the pool as (feature
+// block x row band) tasks; bit-identical to the single-threaded call for any
+// thread count
+void conv_parallel(thread_pool        &pool,
+                   const conv_layer_t *layer,
+                   ftmap_view_t        input,
+                   ftmap_view_t        output,
+                   int                 h,
+                   int                 w);
+
+struct gemm_kernel_t;
+
+// weights of a GEMM layer packed ahead of time by conv*_gemm_pack()
+struct conv_gemm_weights_t {
+    const gemm_kernel_t *kernel;    // micro-kernel the panels were packed for
+    const float         *panels;
+};
+
+// The GEMM layers take conv*_gemm_workspace_size(h, w) floats of scratch
+// (packed weights, packed panels, padded input). The size holds for every
+// ISA, so one workspace can be reused for all calls on h x w images; with a
+// NULL workspace the layer allocates its own for the call.
+size_t conv1_gemm_workspace_size(int h, int w);
+size_t conv2_gemm_workspace_size(int h, int w);
+size_t conv3_gemm_workspace_size(int h, int w);
+
+// Callers running many images can pack the weights once into
+// conv*_gemm_weights_size() floats and pass them to every call; weights
+// packed for another micro-kernel (after simd_set_isa()) are ignored and
+// packed per call again.
+size_t conv1_gemm_weights_size();
+size_t conv2_gemm_weights_size();
+size_t conv3_gemm_weights_size();
+conv_gemm_weights_t conv1_gemm_pack(const param_t *conv1_weights, float *panels);
+conv_gemm_weights_t conv2_gemm_pack(const param_t *conv2_weights, float *panels);
+conv_gemm_weights_t conv3_gemm_pack(const param_t *conv3_weights, float *panels);
+
+// conv1 (9x9) as an implicit GEMM over bands of rows, using the shared SGEMM
+// driver with a packer that gathers edge-extended patches from the input
+void conv1_gemm(const ftmap_t             *input_ftmap,
+                const param_t             *conv1_weights,
+                const param_t             *conv1_biases,
+                int                        h,
+                int                        w,
+                ftmap_t                   *output_ftmap,
+                float                     *workspace = NULL,
+                const conv_gemm_weights_t *packed = NULL);
+
+// conv2 (1x1) as a blocked SGEMM: [N2 x N1] weights times [N1 x h*w] pixels
+void conv2_gemm(const ftmap_t             *input_ftmap,
+                const param_t             *conv2_weights,
+                const param_t             *conv2_biases,
+                int                        h,
+                int                        w,
+                ftmap_t                   *output_ftmap,
+                float                     *workspace = NULL,
+                const conv_gemm_weights_t *packed = NULL);
+
+// conv2 (1x1) as a blocked SGEMM on channel-last maps, so each pixel's
+// N1 input channels are contiguous
+void conv2_gemm_nhwc(const ftmap_t             *input_ftmap,
+                     const param_t             *conv2_weights,
+                     const param_t             *conv2_biases,
+                     int                        h,
+                     int                        w,
+                     ftmap_t                   *output_ftmap,
+                     float                     *workspace = NULL,
+                     const conv_gemm_weights_t *packed = NULL);
+
+// conv3 (5x5) as an implicit GEMM, see conv1_gemm
+void conv3_gemm(const ftmap_t             *input_ftmap,
+                const param_t             *conv3_weights,
+                const param_t             *conv3_biases,
+                int                        h,
+                int                        w,
+                ftmap_t                   *output_ftmap,
+                float                     *workspace = NULL,
+                const conv_gemm_weights_t *packed = NULL);
+
+// transform size of the FFT conv1 tiles; each tile yields
+// (CONV1_FFT_TILE - F1 + 1)^2 output pixels
+#define CONV1_FFT_TILE 64
+
+// conv1 (9x9) in the frequency domain with overlap-save tiling: the
+// edge-extended input is cut into CONV1_FFT_TILE^2 tiles overlapping by
+// F1 - 1, each tile is transformed once, multiplied by the filter spectra and
+// transformed back two filters at a time (one as the real part, one as the
+// imaginary part). The spectra, conv1_fft_spectra_size() floats, depend only
+// on the weights and are computed once by conv1_fft_prepare(). The workspace
+// of conv1_fft_workspace_size() floats does not depend on the image size;
+// with a NULL workspace the layer allocates its own for the call. Results
+// match conv_direct() to within rounding.
+size_t conv1_fft_spectra_size();
+size_t conv1_fft_workspace_size();
+void conv1_fft_prepare(const param_t *conv1_weights, float *spectra);
+void conv1_fft(ftmap_view_t   input,
+               const float   *spectra,
+               const param_t *conv1_biases,
+               int            h,
+               int            w,
+               ftmap_view_t   output,
+               float         *workspace = NULL);
+
+// conv1 kernels the FFT engine mode chooses between
+enum conv1_kernel_t {
+    CONV1_DIRECT = 0,
+    CONV1_GEMM,
+    CONV1_FFT,
+};
+
+// conv1 kernel expected to be fastest on h x w images with the current ISA:
+// conv1_fft() on all but thin strips and small images, where most of each
+// tile would be wasted, and conv1_gemm() on those (see the crossover table
+// of tb_fft). The FFT mode picks it when its context is created.
+conv1_kernel_t conv1_preferred(int h, int w);
+
+// conv2 (1x1) and conv3 (5x5) fused per pixel over the conv1 map in input:
+// the N2 conv2 activations of a pixel stay in registers and are reduced at
+// once to its F3*F3 conv3 tap partial sums, and a ring of F3 rows of those
+// partials replaces the N2-plane conv2 map. The ring takes
+// conv23_fused_workspace_size(w) floats (about 140 KB at w = 255); with a
+// NULL workspace the layer allocates its own for the call. Results match the
+// layer-by-layer kernels to within rounding.
+size_t conv23_fused_workspace_size(int w);
+void conv23_fused(ftmap_view_t   input,
+                  const param_t *conv2_weights,
+                  const param_t *conv2_biases,
+                  const param_t *conv3_weights,
+                  const param_t *conv3_biases,
+                  int            h,
+                  int            w,
+                  ftmap_view_t   output,
+                  float         *workspace = NULL);
+
+// bicubic upscaling of a planar h x w image by an integer scale into a
+// (scale*h) x (scale*w) image, as MATLAB's imresize(image, scale, 'bicubic'):
+// the a = -0.5 cubic kernel, pixel centres aligned, borders mirrored, rows
+// before columns. Both passes are separable 4-tap filters vectorised over
+// contiguous pixels, one phase of the scale at a time. The workspace takes
+// bicubic_upscale_workspace_size(h, w, scale) floats; with a NULL workspace
+// the call allocates its own.
+#define BICUBIC_MAX_SCALE 8
+
+size_t bicubic_upscale_workspace_size(int h, int w, int scale);
+void bicubic_upscale(const ftmap_t *input,
+                     int            h,
+                     int            w,
+                     int            scale,
+                     ftmap_t       *output,
+                     float         *workspace = NULL);
+
+// compares a single-channel h x w image with the previous frame in blocks of
+// block x block pixels, bit for bit, and stores the image over previous in
+// the same pass. changed[by*((w + block - 1)/block) + bx] is set to 1 for
+// every block that differs and to 0 for the others.
+void ftmap_diff_update(ftmap_view_t  image,
+                       ftmap_view_t  previous,
+                       int           h,
+                       int           w,
+                       int           block,
+                       uint8_t      *changed);
+
+// feature-map layouts of the native kernels. A layout groups the channels
+// of a map into blocks of cb: element (c, y, x) lives at
+//   ftmap[(((c/cb)*h + y)*w + x)*cb + c%cb]
+// so planar NCHW is cb = 1, channel-last NHWC is cb = channels and the
+// blocked NCHW8c/NCHW16c layouts keep 8 or 16 channels of a pixel together,
+// one AVX2 or AVX-512 vector
+enum ftmap_layout_t {
+    FTMAP_NCHW = 0,
+    FTMAP_NCHW8C,
+    FTMAP_NCHW16C,
+    FTMAP_NHWC,
+    FTMAP_LAYOUT_COUNT
+};
+
+// short lower-case name of a layout ("nchw", "nchw8c", ...)
+const char *ftmap_layout_name(ftmap_layout_t layout);
+
+// channel block size cb of a layout for a map of the given channels
+int ftmap_layout_block(ftmap_layout_t layout, int channels);
+
+// layout transforms between planar maps and any layout; the channels must
+// be a multiple of the block size, std::runtime_error otherwise
+void ftmap_to_layout(const ftmap_t  *planar,
+                     int             channels,
+                     int             h,
+                     int             w,
+                     ftmap_layout_t  layout,
+                     ftmap_t        *output_ftmap);
+void ftmap_from_layout(const ftmap_t  *input_ftmap,
+                       ftmap_layout_t  layout,
+                       int             channels,
+                       int             h,
+                       int             w,
+                       ftmap_t        *planar);
+
+// ftmap_to_layout()/ftmap_from_layout() for channel-last maps
+void ftmap_to_nhwc(const ftmap_t *planar,
+                   int            channels,
+                   int            h,
+                   int            w,
+                   ftmap_t       *channel_last);
+void ftmap_to_nchw(const ftmap_t *channel_last,
+                   int            channels,
+                   int            h,
+                   int            w,
+                   ftmap_t       *planar);
+
+// element formats of feature maps: float, or 16 bits (IEEE half or
+// bfloat16) rounded to nearest even on every store and widened to float on
+// every load, so only storage and bandwidth shrink while layers keep
+// accumulating in float
+enum ftmap_format_t {
+    FTMAP_FP32 = 0,
+    FTMAP_FP16,
+    FTMAP_BF16,
+    FTMAP_FORMAT_COUNT
+};
+
+// short lower-case name of a format ("fp32", "fp16", "bf16")
+const char *ftmap_format_name(ftmap_format_t format);
+
+// bytes per element of a format
+size_t ftmap_format_bytes(ftmap_format_t format);
+
+// conversions of count elements between float and a format, rounding as the
+// layer kernels do
+void ftmap_to_format(const ftmap_t  *input_ftmap,
+                     long            count,
+                     ftmap_format_t  format,
+                     void           *output);
+void ftmap_from_format(const void     *input,
+                       ftmap_format_t  format,
+                       long            count,
+                       ftmap_t        *output_ftmap);
+
+// the three layers on h x w maps in any layout, so a pipeline only changes
+// layout inside its first and last layer: conv1 reads the planar image and
+// writes its map in output_layout, conv2 converts between layouts as it
+// goes and conv3 writes the planar image. Planar to planar runs
+// conv_direct(); every other combination keeps a pixel's features in
+// vectors over the output channels (conv1, conv2) or input channels (conv3),
+// dispatched on simd_isa(). Results match conv_direct() to within rounding.
+// The intermediate maps are stored in format; 16-bit maps need a blocked or
+// channel-last layout (std::runtime_error otherwise) and use the F16C and
+// AVX512-BF16 conversions where the CPU has them.
+void conv1_layout(ftmap_view_t    input,
+                  const param_t  *conv1_weights,
+                  const param_t  *conv1_biases,
+                  int             h,
+                  int             w,
+                  void           *output,
+                  ftmap_layout_t  output_layout,
+                  ftmap_format_t  format = FTMAP_FP32);
+void conv2_layout(const void     *input,
+                  ftmap_layout_t  input_layout,
+                  const param_t  *conv2_weights,
+                  const param_t  *conv2_biases,
+                  int             h,
+                  int             w,
+                  void           *output,
+                  ftmap_layout_t  output_layout,
+                  ftmap_format_t  format = FTMAP_FP32);
+void conv3_layout(const void     *input,
+                  ftmap_layout_t  input_layout,
+                  const param_t  *conv3_weights,
+                  const param_t  *conv3_biases,
+                  int             h,
+                  int             w,
+                  ftmap_view_t    output,
+                  ftmap_format_t  format = FTMAP_FP32);
+
+// Sparse kernels on channel-last maps. conv2 and conv3 both read ReLU
+// outputs, often more than half zeros, so they skip zero activations: each
+// pixel's nonzero channels form a bitmask (bit c for channel c, at most 64
+// channels) and only the weight rows of the set bits are read.
+typedef uint64_t ftmap_mask_t;
+
+// masks of the nonzero channels of pixels channel-last pixels
+void ftmap_nonzero_masks(const ftmap_t *channel_last,
+                         int            channels,
+                         long           pixels,
+                         ftmap_mask_t  *masks);
+
+// fraction of the channels x pixels activations set in masks
+double ftmap_mask_density(const ftmap_mask_t *masks, int channels, long pixels);
+
+// conv3 tap partial sums per pixel, padded to whole vectors
+#define CONV_SPARSE_TAPS ((F3*F3 + 15)/16*16)
+
+// conv2/conv3 weights packed by conv_sparse_pack(): one row of output
+// features (conv2) or taps (conv3) per input channel. Weights of magnitude
+// at most the pack tolerance are zeroed, and input channels left with only
+// zero weights are cleared from the live masks, so they are skipped like
+// zero activations.
+struct conv_sparse_weights_t {
+    ftmap_mask_t live2;                      // conv2 input channels with a nonzero weight
+    ftmap_mask_t live3;                      // conv3 input channels with a nonzero weight
+    long         pruned;                     // nonzero weights zeroed by the tolerance
+    float        conv2[N1*N2];               // [in][out]
+    float        conv3[N2*CONV_SPARSE_TAPS]; // [in][tap]
+};
+
+void conv_sparse_pack(const param_t          *conv2_weights,
+                      const param_t          *conv3_weights,
+                      float                   tolerance,
+                      conv_sparse_weights_t  *packed);
+
+// conv2 (1x1) on channel-last maps: each pixel's input mask is taken as its
+// N1 activations are loaded, and the masks of its N2 outputs come out of
+// the ReLU into output_masks for conv3_sparse()
+void conv2_sparse(const ftmap_t               *input_ftmap,
+                  const conv_sparse_weights_t *packed,
+                  const param_t               *conv2_biases,
+                  int                          h,
+                  int                          w,
+                  ftmap_t                     *output_ftmap,
+                  ftmap_mask_t                *output_masks);
+
+// conv3 (5x5) on a channel-last map and its masks: the nonzero channels of
+// each pixel are reduced to its F3*F3 tap partial sums, and each output
+// pixel adds its window of partials from a ring of F3 rows, as
+// conv23_fused() does. The ring takes conv3_sparse_workspace_size(w)
+// floats; with a NULL workspace the layer allocates its own for the call.
+// Results match the dense kernels to within rounding.
+size_t conv3_sparse_workspace_size(int w);
+void conv3_sparse(const ftmap_t               *input_ftmap,
+                  const ftmap_mask_t          *input_masks,
+                  const conv_sparse_weights_t *packed,
+                  const param_t               *conv3_biases,
+                  int                          h,
+                  int                          w,
+                  ftmap_view_t                 output,
+                  float                       *workspace = NULL);
+
+#endif /* _KERNELS_H_ */
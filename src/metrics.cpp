@@ -0,0 +1,323 @@
+#include <math.h>
+#include <stdint.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include "metrics.h"
+#include "simd.h"
+
+#define METRICS_INLINE static inline __attribute__((always_inline))
+
+// SSIM constants on the u8 scale: (K1*255)^2 and (K2*255)^2
+#define METRICS_C1 6.5025f
+#define METRICS_C2 58.5225f
+
+// statistics per pixel of a row: x, y, x^2, y^2 and xy
+#define METRICS_STATS 5
+
+// rows of statistics are padded to whole vectors of the widest ISA (and
+// start on a cache line), so the filters need no scalar tails
+#define METRICS_PAD 16
+
+struct metrics_state_t {
+    int                 h;
+    int                 w;
+    int                 rows;       // fed so far
+    double              se;         // squared error of the [0, 1] values
+    double              qse;        // squared error of the u8 values
+    double              ssim;       // sum of the SSIM map
+    long                windows;    // SSIM windows summed
+    float               gauss[METRICS_WINDOW];
+    int                 stride;     // padded SSIM map row: w - METRICS_WINDOW + 1 windows
+    int                 stats_stride; // padded row of statistics, zero beyond w
+    std::vector<float>  buffer;
+    float              *stats;      // [METRICS_STATS][stats_stride] of the current row
+    float              *ring;       // [METRICS_STATS][METRICS_WINDOW][stride], filtered along x
+};
+
+// GCC vector of VL 32-bit integers, looked up as simd_vec is
+template <int VL> struct metrics_int;
+template <> struct metrics_int<16> { typedef int32_t type __attribute__((vector_size(64), aligned(4), may_alias)); };
+template <> struct metrics_int<8>  { typedef int32_t type __attribute__((vector_size(32), aligned(4), may_alias)); };
+template <> struct metrics_int<4>  { typedef int32_t type __attribute__((vector_size(16), aligned(4), may_alias)); };
+
+METRICS_INLINE int32_t quantize_u8(float v)
+{
+    v *= 255;
+    return (int32_t) (v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+#define METRICS_HALF (METRICS_WINDOW/2)
+
+// one pass over each row: squared errors and the per-pixel statistics, then
+// the statistics filtered along x into the ring, and once METRICS_WINDOW
+// rows are in it, filtered along y into one row of the SSIM map, VL pixels
+// at a time. The Gaussian is symmetric, so taps t and METRICS_WINDOW - 1 - t
+// share a multiply.
+template <int VL>
+METRICS_INLINE void metrics_rows_simd(metrics_state_t *state,
+                                      const ftmap_t   *image,
+                                      int              image_stride,
+                                      const ftmap_t   *reference,
+                                      int              reference_stride,
+                                      int              rows)
+{
+    typedef typename simd_vec<VL>::type VEC;
+    typedef typename metrics_int<VL>::type VINT;
+
+    int w = state->w;
+    int ow = w - METRICS_WINDOW + 1;
+    int stride = state->stride;
+    const float *g = state->gauss;
+    float *st[METRICS_STATS];
+    for (int k = 0; k < METRICS_STATS; k++)
+        st[k] = state->stats + (size_t) k*state->stats_stride;
+
+    for (int r = 0; r < rows; r++) {
+        const ftmap_t *a = image + (long) r*image_stride;
+        const ftmap_t *b = reference + (long) r*reference_stride;
+
+        VEC se = {};
+        VINT qse = {};
+        int x = 0;
+        for (; x + VL <= w; x += VL) {
+            VEC va = *(const VEC *) (a + x), vb = *(const VEC *) (b + x);
+            VEC d = va - vb;
+            se += d*d;
+            va *= 255;
+            vb *= 255;
+            va = va < 0.0f ? 0.0f : va;
+            va = va > 255.0f ? 255.0f : va;
+            vb = vb < 0.0f ? 0.0f : vb;
+            vb = vb > 255.0f ? 255.0f : vb;
+            VINT ia = __builtin_convertvector(va, VINT), ib = __builtin_convertvector(vb, VINT);
+            VINT dq = ia - ib;
+            qse += dq*dq;
+            VEC qa = __builtin_convertvector(ia, VEC), qb = __builtin_convertvector(ib, VEC);
+            *(VEC *) (st[0] + x) = qa;
+            *(VEC *) (st[1] + x) = qb;
+            *(VEC *) (st[2] + x) = qa*qa;
+            *(VEC *) (st[3] + x) = qb*qb;
+            *(VEC *) (st[4] + x) = qa*qb;
+        }
+        double row_se = 0;
+        long row_qse = 0;
+        for (int k = 0; k < VL; k++) {
+            row_se += se[k];
+            row_qse += qse[k];
+        }
+        for (; x < w; x++) {
+            float d = a[x] - b[x];
+            row_se += d*d;
+            int32_t ia = quantize_u8(a[x]), ib = quantize_u8(b[x]);
+            row_qse += (ia - ib)*(ia - ib);
+            float qa = (float) ia, qb = (float) ib;
+            st[0][x] = qa;
+            st[1][x] = qb;
+            st[2][x] = qa*qa;
+            st[3][x] = qb*qb;
+            st[4][x] = qa*qb;
+        }
+        state->se += row_se;
+        state->qse += row_qse;
+
+        int y = state->rows++;
+        if (ow <= 0)
+            continue;
+
+        // along x into the ring slot of this row
+        for (int k = 0; k < METRICS_STATS; k++) {
+            const float *s = st[k];
+            float *out = state->ring + ((size_t) k*METRICS_WINDOW + y % METRICS_WINDOW)*stride;
+            for (int i = 0; i < stride; i += VL) {
+                VEC acc = *(const VEC *) (s + i + METRICS_HALF)*g[METRICS_HALF];
+                for (int t = 0; t < METRICS_HALF; t++)
+                    acc += (*(const VEC *) (s + i + t) + *(const VEC *) (s + i + METRICS_WINDOW - 1 - t))*g[t];
+                *(VEC *) (out + i) = acc;
+            }
+        }
+        if (y < METRICS_WINDOW - 1)
+            continue;
+
+        // along y over the last METRICS_WINDOW rows, into the SSIM map
+        const float *ring[METRICS_STATS][METRICS_WINDOW];
+        for (int k = 0; k < METRICS_STATS; k++)
+            for (int t = 0; t < METRICS_WINDOW; t++)
+                ring[k][t] = state->ring + ((size_t) k*METRICS_WINDOW + (y + 1 + t) % METRICS_WINDOW)*stride;
+
+        // the padding windows are finite (all-zero statistics give 1) and
+        // left out of the last vector's sum
+        VEC sum = {};
+        double row_ssim = 0;
+        for (int i = 0; i < ow; i += VL) {
+            VEC m[METRICS_STATS];
+            for (int k = 0; k < METRICS_STATS; k++) {
+                m[k] = *(const VEC *) (ring[k][METRICS_HALF] + i)*g[METRICS_HALF];
+                for (int t = 0; t < METRICS_HALF; t++)
+                    m[k] += (*(const VEC *) (ring[k][t] + i) + *(const VEC *) (ring[k][METRICS_WINDOW - 1 - t] + i))*g[t];
+            }
+            VEC sx = m[2] - m[0]*m[0], sy = m[3] - m[1]*m[1], sxy = m[4] - m[0]*m[1];
+            VEC ssim = (2*m[0]*m[1] + METRICS_C1)*(2*sxy + METRICS_C2)/
+                       ((m[0]*m[0] + m[1]*m[1] + METRICS_C1)*(sx + sy + METRICS_C2));
+            if (i + VL <= ow) {
+                sum += ssim;
+            } else {
+                for (int k = 0; k < ow - i; k++)
+                    row_ssim += ssim[k];
+            }
+        }
+        for (int k = 0; k < VL; k++)
+            row_ssim += sum[k];
+        state->ssim += row_ssim;
+        state->windows += ow;
+    }
+}
+
+// per-target instantiations, see simd_vec
+static void metrics_rows_default(metrics_state_t *state, const ftmap_t *image, int image_stride,
+                                 const ftmap_t *reference, int reference_stride, int rows)
+{
+    metrics_rows_simd<4>(state, image, image_stride, reference, reference_stride, rows);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma")))
+static void metrics_rows_avx2(metrics_state_t *state, const ftmap_t *image, int image_stride,
+                              const ftmap_t *reference, int reference_stride, int rows)
+{
+    metrics_rows_simd<8>(state, image, image_stride, reference, reference_stride, rows);
+}
+
+__attribute__((target("avx512f")))
+static void metrics_rows_avx512(metrics_state_t *state, const ftmap_t *image, int image_stride,
+                                const ftmap_t *reference, int reference_stride, int rows)
+{
+    metrics_rows_simd<16>(state, image, image_stride, reference, reference_stride, rows);
+}
+#endif
+
+metrics_state_t *metrics_create(int h, int w)
+{
+    if (h <= 0 || w <= 0)
+        throw std::runtime_error("Invalid metrics image dimensions");
+
+    metrics_state_t *state = new metrics_state_t();
+    state->h = h;
+    state->w = w;
+    double sum = 0, gauss[METRICS_WINDOW];
+    for (int t = 0; t < METRICS_WINDOW; t++) {
+        double d = t - METRICS_WINDOW/2;
+        gauss[t] = exp(-d*d/(2*1.5*1.5));
+        sum += gauss[t];
+    }
+    for (int t = 0; t < METRICS_WINDOW; t++)
+        state->gauss[t] = (float) (gauss[t]/sum);
+
+    int ow = w - METRICS_WINDOW + 1;
+    state->stride = ow > 0 ? (ow + METRICS_PAD - 1)/METRICS_PAD*METRICS_PAD : 0;
+    state->stats_stride = (state->stride + METRICS_WINDOW - 1 > w ? state->stride + METRICS_WINDOW - 1 : w);
+    state->stats_stride = (state->stats_stride + METRICS_PAD - 1)/METRICS_PAD*METRICS_PAD;
+    size_t stats = (size_t) METRICS_STATS*state->stats_stride;
+    state->buffer.resize(stats + (size_t) METRICS_STATS*METRICS_WINDOW*state->stride + METRICS_PAD);
+    uintptr_t base = ((uintptr_t) state->buffer.data() + METRICS_PAD*sizeof(float) - 1)/(METRICS_PAD*sizeof(float))*(METRICS_PAD*sizeof(float));
+    state->stats = (float *) base;
+    state->ring = state->stats + stats;
+    metrics_begin(state);
+    return state;
+}
+
+void metrics_destroy(metrics_state_t *state)
+{
+    delete state;
+}
+
+void metrics_begin(metrics_state_t *state)
+{
+    state->rows = 0;
+    state->se = 0;
+    state->qse = 0;
+    state->ssim = 0;
+    state->windows = 0;
+}
+
+void metrics_rows(metrics_state_t *state,
+                  const ftmap_t   *image,
+                  int              image_stride,
+                  const ftmap_t   *reference,
+                  int              reference_stride,
+                  int              rows)
+{
+    if (rows < 0 || state->rows + rows > state->h)
+        throw std::runtime_error("More metrics rows than the image has");
+
+    switch (simd_isa()) {
+#if defined(__x86_64__) || defined(__i386__)
+    case SIMD_ISA_AVX512:
+        metrics_rows_avx512(state, image, image_stride, reference, reference_stride, rows);
+        break;
+    case SIMD_ISA_AVX2:
+        metrics_rows_avx2(state, image, image_stride, reference, reference_stride, rows);
+        break;
+#endif
+    default:
+        metrics_rows_default(state, image, image_stride, reference, reference_stride, rows);
+        break;
+    }
+}
+
+image_metrics_t metrics_end(metrics_state_t *state)
+{
+    if (state->rows != state->h)
+        throw std::runtime_error("Metrics are missing rows of the image");
+
+    double pixels = (double) state->h*state->w;
+    image_metrics_t metrics;
+    metrics.mse = state->se/pixels;
+    metrics.psnr = 20*log10(255.0/sqrt(state->qse/pixels));
+    metrics.ssim = state->windows ? state->ssim/state->windows : NAN;
+    return metrics;
+}
+
+image_metrics_t image_metrics(const ftmap_t *image,
+                              const ftmap_t *reference,
+                              int            h,
+                              int            w)
+{
+    metrics_state_t *state = metrics_create(h, w);
+    metrics_rows(state, image, w, reference, w, h);
+    image_metrics_t metrics = metrics_end(state);
+    metrics_destroy(state);
+    return metrics;
+}
+
+void image_metrics_batch(int                   count,
+                         const ftmap_t *const  images[],
+                         const ftmap_t *const  references[],
+                         int                   h,
+                         int                   w,
+                         image_metrics_t       metrics[],
+                         thread_pool          *pool)
+{
+    if (!pool)
+        pool = &thread_pool_default();
+
+    // one state per worker, so the images of a batch do not allocate
+    std::vector<metrics_state_t *> states(pool->size(), (metrics_state_t *) NULL);
+    try {
+        for (metrics_state_t *&state : states)
+            state = metrics_create(h, w);
+        metrics_state_t *const *s = states.data();
+        pool->parallel_for_worker(count, [=](int image, int worker) {
+            metrics_begin(s[worker]);
+            metrics_rows(s[worker], images[image], w, references[image], w, h);
+            metrics[image] = metrics_end(s[worker]);
+        });
+    } catch (...) {
+        for (metrics_state_t *state : states)
+            metrics_destroy(state);
+        throw;
+    }
+    for (metrics_state_t *state : states)
+        metrics_destroy(state);
+}
@@ -0,0 +1,63 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include "srcnn.h"
+#include "thread_pool.h"
+
+// Image quality metrics of an image against a reference, all three from one
+// vectorised pass over the rows:
+//   mse   mean squared error of the [0, 1] values (as calculate_mse())
+//   psnr  PSNR of both images quantized to u8 by truncating value*255 (as
+//         calculate_PSNR(), whose MATLAB tables it is compared with), but
+//         saturating values outside [0, 1] instead of wrapping them
+//   ssim  mean SSIM of the same u8 values, over the 11x11 windows inside
+//         the image, with a Gaussian of sigma 1.5, K1 = 0.01, K2 = 0.03
+//         (Wang et al. 2004); NAN for images smaller than a window
+struct image_metrics_t {
+    double mse;
+    double psnr;
+    double ssim;
+};
+
+#define METRICS_WINDOW 11
+
+// streaming state for h x w images fed a band of rows at a time, in order,
+// e.g. right after a layer writes them. It keeps the SSIM statistics of the
+// last METRICS_WINDOW rows, so feeding rows does not allocate.
+struct metrics_state_t;
+
+metrics_state_t *metrics_create(int h, int w);
+
+void metrics_destroy(metrics_state_t *state);
+
+// starts a new image
+void metrics_begin(metrics_state_t *state);
+
+// feeds the next rows of the image and the reference, rows stride elements apart
+void metrics_rows(metrics_state_t *state,
+                  const ftmap_t   *image,
+                  int              image_stride,
+                  const ftmap_t   *reference,
+                  int              reference_stride,
+                  int              rows);
+
+// the metrics once all h rows have been fed; throws std::runtime_error otherwise
+image_metrics_t metrics_end(metrics_state_t *state);
+
+// metrics of one planar h x w image
+image_metrics_t image_metrics(const ftmap_t *image,
+                              const ftmap_t *reference,
+                              int            h,
+                              int            w);
+
+// metrics of count images against their references, one image per thread of
+// pool (thread_pool_default() if NULL), into metrics[i]
+void image_metrics_batch(int                   count,
+                         const ftmap_t *const  images[],
+                         const ftmap_t *const  references[],
+                         int                   h,
+                         int                   w,
+                         image_metrics_t       metrics[],
+                         thread_pool          *pool = NULL);
+
+#endif /* _METRICS_H_ */
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "model_file.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "model files are little-endian and mapped as is"
+#endif
+
+// the mapped float32 arrays are used as param_t directly
+static_assert(sizeof(param_t) == sizeof(float), "param_t must be float to map model files");
+
+struct srcnn_model_file_t {
+    void          *data;
+    size_t         size;
+    srcnn_model_t  model;
+};
+
+static uint64_t srcnn_model_align(uint64_t bytes)
+{
+    return (bytes + SRCNN_MODEL_ALIGN - 1)/SRCNN_MODEL_ALIGN*SRCNN_MODEL_ALIGN;
+}
+
+// header of a model of this build's shapes, with the array offsets laid out
+static void srcnn_model_layout(srcnn_model_header_t *header)
+{
+    const uint32_t shapes[SRCNN_MODEL_LAYERS][3] = { { N0, N1, F1 }, { N1, N2, F2 }, { N2, N3, F3 } };
+
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, SRCNN_MODEL_MAGIC, sizeof(header->magic));
+    header->version = SRCNN_MODEL_VERSION;
+    header->header_size = (uint32_t) srcnn_model_align(sizeof(*header));
+    header->upscale = UP;
+    header->layers = SRCNN_MODEL_LAYERS;
+
+    uint64_t offset = header->header_size;
+    for (int l = 0; l < SRCNN_MODEL_LAYERS; l++) {
+        srcnn_model_layer_t *layer = &header->layer[l];
+        layer->nin = shapes[l][0];
+        layer->nout = shapes[l][1];
+        layer->f = shapes[l][2];
+        layer->weights_offset = offset;
+        offset += srcnn_model_align((uint64_t) layer->nout*layer->nin*layer->f*layer->f*sizeof(float));
+        layer->biases_offset = offset;
+        offset += srcnn_model_align((uint64_t) layer->nout*sizeof(float));
+    }
+    header->file_size = offset;
+}
+
+uint64_t srcnn_model_checksum(const void *data, size_t bytes)
+{
+    const unsigned char *p = (const unsigned char *) data;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < bytes; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+void srcnn_model_write(const char *path, const srcnn_model_t *model)
+{
+    srcnn_model_header_t header;
+    srcnn_model_layout(&header);
+
+    const param_t *weights[SRCNN_MODEL_LAYERS] = { model->conv1_weights, model->conv2_weights, model->conv3_weights };
+    const param_t *biases[SRCNN_MODEL_LAYERS] = { model->conv1_biases, model->conv2_biases, model->conv3_biases };
+    std::vector<char> buffer(header.file_size, 0);
+    for (int l = 0; l < SRCNN_MODEL_LAYERS; l++) {
+        const srcnn_model_layer_t *layer = &header.layer[l];
+        float *w = (float *) &buffer[layer->weights_offset];
+        float *b = (float *) &buffer[layer->biases_offset];
+        for (uint32_t i = 0; i < layer->nout*layer->nin*layer->f*layer->f; i++)
+            w[i] = (float) weights[l][i];
+        for (uint32_t i = 0; i < layer->nout; i++)
+            b[i] = (float) biases[l][i];
+    }
+    header.checksum = srcnn_model_checksum(&buffer[header.header_size], header.file_size - header.header_size);
+    memcpy(&buffer[0], &header, sizeof(header));
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+        throw std::runtime_error(std::string("Cannot create model file ") + path);
+    size_t written = fwrite(&buffer[0], 1, buffer.size(), fp);
+    if (fclose(fp) != 0 || written != buffer.size())
+        throw std::runtime_error(std::string("Cannot write model file ") + path);
+}
+
+// throws unless the mapped header describes a model of this build
+static void srcnn_model_validate(const srcnn_model_file_t *file, const char *path, bool verify)
+{
+    std::string name(path);
+    const srcnn_model_header_t *header = (const srcnn_model_header_t *) file->data;
+    srcnn_model_header_t expected;
+    srcnn_model_layout(&expected);
+
+    if (file->size < sizeof(*header) || memcmp(header->magic, SRCNN_MODEL_MAGIC, sizeof(header->magic)) != 0)
+        throw std::runtime_error("Not a model file: " + name);
+    if (header->version != SRCNN_MODEL_VERSION)
+        throw std::runtime_error("Unsupported model file version: " + name);
+    if (header->upscale != expected.upscale)
+        throw std::runtime_error("Model file is for a different upscale factor: " + name);
+    if (header->header_size != expected.header_size || header->layers != expected.layers ||
+        memcmp(header->layer, expected.layer, sizeof(expected.layer)) != 0)
+        throw std::runtime_error("Model file layer shapes do not match this build: " + name);
+    if (header->file_size != file->size || file->size != expected.file_size)
+        throw std::runtime_error("Model file is truncated: " + name);
+    if (verify && srcnn_model_checksum((const char *) file->data + header->header_size,
+                                       file->size - header->header_size) != header->checksum)
+        throw std::runtime_error("Model file checksum mismatch: " + name);
+}
+
+srcnn_model_file_t *srcnn_model_open(const char *path, bool verify)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error(std::string("File not found: ") + path);
+
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps the file referenced
+    close(fd);
+    if (data == MAP_FAILED)
+        throw std::runtime_error(std::string("Cannot map model file ") + path);
+
+    srcnn_model_file_t *file = new srcnn_model_file_t();
+    file->data = data;
+    file->size = (size_t) st.st_size;
+    try {
+        srcnn_model_validate(file, path, verify);
+    } catch (...) {
+        srcnn_model_close(file);
+        throw;
+    }
+
+    const srcnn_model_header_t *header = (const srcnn_model_header_t *) data;
+    const char *base = (const char *) data;
+    file->model.conv1_weights = (const param_t *) (base + header->layer[0].weights_offset);
+    file->model.conv1_biases = (const param_t *) (base + header->layer[0].biases_offset);
+    file->model.conv2_weights = (const param_t *) (base + header->layer[1].weights_offset);
+    file->model.conv2_biases = (const param_t *) (base + header->layer[1].biases_offset);
+    file->model.conv3_weights = (const param_t *) (base + header->layer[2].weights_offset);
+    file->model.conv3_biases = (const param_t *) (base + header->layer[2].biases_offset);
+    return file;
+}
+
+void srcnn_model_close(srcnn_model_file_t *file)
+{
+    if (!file)
+        return;
+    munmap(file->data, file->size);
+    delete file;
+}
+
+const srcnn_model_t *srcnn_model_get(const srcnn_model_file_t *file)
+{
+    return &file->model;
+}
+
+const srcnn_model_header_t *srcnn_model_header(const srcnn_model_file_t *file)
+{
+    return (const srcnn_model_header_t *) file->data;
+}
@@ -0,0 +1,70 @@
+#ifndef _MODEL_FILE_H_
+#define _MODEL_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "srcnn.h"
+#include "engine.h"
+
+// Packed SRCNN model container: one file holding a header and the weights and
+// biases of all three layers, replacing the six *_3x_flp.bin files.
+//
+//   header   srcnn_model_header_t, padded to SRCNN_MODEL_ALIGN bytes
+//   payload  per layer: weights [nout][nin][f][f], then biases [nout], each
+//            little-endian float32 starting on a SRCNN_MODEL_ALIGN boundary
+//
+// The arrays are in the layout the direct and SIMD kernels read and aligned
+// for vector loads, so a model is used straight from a read-only mapping of
+// the file: opening it costs one mmap, and processes opening the same file
+// share one page-cache copy. GEMM panels depend on the micro-kernel picked at
+// run time (see simd_set_isa()), so contexts still pack those themselves.
+
+#define SRCNN_MODEL_MAGIC   "SRCNNMDL"
+#define SRCNN_MODEL_VERSION 1
+#define SRCNN_MODEL_ALIGN   64      // bytes, alignment of the header and every array
+#define SRCNN_MODEL_LAYERS  3
+
+struct srcnn_model_layer_t {
+    uint32_t nin;
+    uint32_t nout;
+    uint32_t f;
+    uint32_t reserved;
+    uint64_t weights_offset;        // bytes from the start of the file
+    uint64_t biases_offset;
+};
+
+struct srcnn_model_header_t {
+    char                magic[8];   // SRCNN_MODEL_MAGIC, not NUL terminated
+    uint32_t            version;    // SRCNN_MODEL_VERSION
+    uint32_t            header_size;
+    uint32_t            upscale;    // upscaling factor the model was trained for
+    uint32_t            layers;     // SRCNN_MODEL_LAYERS
+    uint64_t            file_size;
+    uint64_t            checksum;   // FNV-1a of every byte after the header
+    srcnn_model_layer_t layer[SRCNN_MODEL_LAYERS];
+};
+
+// writes model (shapes N0..F3, upscale UP) to path; throws std::runtime_error
+// if the file cannot be written
+void srcnn_model_write(const char *path, const srcnn_model_t *model);
+
+// read-only mapping of a model file
+struct srcnn_model_file_t;
+
+// maps path and validates it against this build: magic, version, layer
+// shapes, upscale factor, size and (if verify is set) checksum. Throws
+// std::runtime_error if the file cannot be mapped or does not match.
+srcnn_model_file_t *srcnn_model_open(const char *path, bool verify = true);
+
+void srcnn_model_close(srcnn_model_file_t *file);
+
+// model pointing into the mapping, valid until srcnn_model_close()
+const srcnn_model_t *srcnn_model_get(const srcnn_model_file_t *file);
+
+const srcnn_model_header_t *srcnn_model_header(const srcnn_model_file_t *file);
+
+// FNV-1a hash used for the checksum
+uint64_t srcnn_model_checksum(const void *data, size_t bytes);
+
+#endif /* _MODEL_FILE_H_ */
@@ -0,0 +1,368 @@
+#include <math.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include "quant.h"
+#include "kernels.h"
+#include "simd.h"
+
+#if N1 % 4 != 0 || N2 % 4 != 0
+#error "quantized maps need channel counts that are a multiple of 4"
+#endif
+#if F2 != 1
+#error "quantized conv2 assumes a 1x1 kernel"
+#endif
+
+#define QUANT_CONV1_QUADS ((F1 + 3)/4)  // quad taps per conv1 kernel row
+
+#if F1*QUANT_CONV1_QUADS > QUANT_MAX_TAPS || N1/4 > QUANT_MAX_TAPS || N2/4*F3*F3 > QUANT_MAX_TAPS
+#error "QUANT_MAX_TAPS too small for the network"
+#endif
+
+#define QUANT_ALIGN 64                  // bytes, start of each map in the workspace
+
+// input taps of a quantized layer: quad plane, row and column of the window
+struct quant_tap_t {
+    int plane;
+    int y;
+    int x;
+};
+
+struct quant_params_t {
+    std::vector<quant_tap_t> taps;
+    std::vector<int32_t>     weights;
+    std::vector<int32_t>     biases;
+    std::vector<float>       scales;
+    quant_layer_t            layer;
+};
+
+struct quant_model_t {
+    quant_params_t conv1;
+    quant_params_t conv2;
+    quant_params_t conv3;
+};
+
+void quant_calib_init(quant_calib_t *calib)
+{
+    memset(calib, 0, sizeof(*calib));
+}
+
+void quant_calibrate(quant_calib_t       *calib,
+                     const srcnn_model_t *model,
+                     const ftmap_t       *input_ftmap,
+                     int                  h,
+                     int                  w)
+{
+    conv_layer_t conv1 = { N0, N1, F1, model->conv1_weights, model->conv1_biases };
+    conv_layer_t conv2 = { N1, N2, F2, model->conv2_weights, model->conv2_biases };
+    std::vector<ftmap_t> layer1((size_t) N1*h*w);
+    std::vector<ftmap_t> layer2((size_t) N2*h*w);
+
+    conv_direct(&conv1, ftmap_view(input_ftmap, h, w), h, w, ftmap_view(&layer1[0], h, w), 0, N1, 0, h, 0, w);
+    conv_direct(&conv2, ftmap_view(&layer1[0], h, w), h, w, ftmap_view(&layer2[0], h, w), 0, N2, 0, h, 0, w);
+
+    for (int c = 0; c < N1; c++)
+        for (long i = 0; i < (long) h*w; i++)
+            calib->conv1_max[c] = fmaxf(calib->conv1_max[c], layer1[c*(long) h*w + i]);
+    for (int c = 0; c < N2; c++)
+        for (long i = 0; i < (long) h*w; i++)
+            calib->conv2_max[c] = fmaxf(calib->conv2_max[c], layer2[c*(long) h*w + i]);
+}
+
+// activation scale of a channel; channels that never fired get any positive scale
+static float quant_act_scale(float max)
+{
+    return max > 0 ? max/QUANT_ACT_MAX : 1.0f;
+}
+
+// quantizes float weights [nout][taps][4] (input scales already folded in) to
+// 8 bits per output channel; out_scales are the output activation scales, or
+// NULL to dequantize the outputs to float
+static void quant_params(quant_params_t     *params,
+                         int                 nout,
+                         const float        *weights,
+                         const param_t      *biases,
+                         const float        *out_scales)
+{
+    int taps = (int) params->taps.size();
+    params->weights.resize((size_t) nout*taps);
+    params->biases.resize(nout);
+    params->scales.resize(nout);
+
+    for (int oc = 0; oc < nout; oc++) {
+        const float *wf = weights + (size_t) oc*taps*4;
+        float max = 0;
+        for (int i = 0; i < taps*4; i++)
+            max = fmaxf(max, fabsf(wf[i]));
+        float scale = max > 0 ? max/QUANT_WEIGHT_MAX : 1.0f;
+
+        for (int t = 0; t < taps; t++) {
+            uint32_t quad = 0;
+            for (int i = 0; i < 4; i++) {
+                int q = (int) nearbyintf(wf[t*4 + i]/scale);
+                q = q > QUANT_WEIGHT_MAX ? QUANT_WEIGHT_MAX : (q < -QUANT_WEIGHT_MAX ? -QUANT_WEIGHT_MAX : q);
+                quad |= (uint32_t) (uint8_t) (int8_t) q << 8*i;
+            }
+            params->weights[(size_t) oc*taps + t] = (int32_t) quad;
+        }
+
+        // the bias plus the largest possible dot product must fit in 32 bits
+        double bias = nearbyint(biases[oc]/scale);
+        if (fabs(bias) + (double) taps*4*QUANT_ACT_MAX*QUANT_WEIGHT_MAX > 2147483647.0)
+            throw std::runtime_error("quantized accumulator overflows 32 bits");
+        params->biases[oc] = (int32_t) bias;
+        params->scales[oc] = out_scales ? scale/out_scales[oc] : scale;
+    }
+
+    params->layer.nout = nout;
+    params->layer.taps = taps;
+    params->layer.weights = &params->weights[0];
+    params->layer.biases = &params->biases[0];
+    params->layer.scales = &params->scales[0];
+}
+
+quant_model_t *quant_model_create(const srcnn_model_t *model, const quant_calib_t *calib)
+{
+    quant_model_t *qmodel = new quant_model_t();
+    float scales1[N1], scales2[N2];
+    for (int c = 0; c < N1; c++)
+        scales1[c] = quant_act_scale(calib->conv1_max[c]);
+    for (int c = 0; c < N2; c++)
+        scales2[c] = quant_act_scale(calib->conv2_max[c]);
+
+    try {
+        // conv1: each quad holds four adjacent input pixels, so a kernel row is
+        // QUANT_CONV1_QUADS taps, zero weights past the kernel edge. The input
+        // is u8/255, hence the 1/255 input scale.
+        std::vector<float> weights;
+        for (int oc = 0; oc < N1; oc++)
+            for (int ky = 0; ky < F1; ky++)
+                for (int j = 0; j < QUANT_CONV1_QUADS; j++)
+                    for (int i = 0; i < 4; i++) {
+                        int kx = 4*j + i;
+                        weights.push_back(kx < F1 ? model->conv1_weights[(oc*F1 + ky)*F1 + kx]/QUANT_ACT_MAX : 0);
+                    }
+        for (int ky = 0; ky < F1; ky++)
+            for (int j = 0; j < QUANT_CONV1_QUADS; j++) {
+                quant_tap_t tap = { 0, ky, 4*j };
+                qmodel->conv1.taps.push_back(tap);
+            }
+        quant_params(&qmodel->conv1, N1, &weights[0], model->conv1_biases, scales1);
+
+        // conv2: one tap per quad of input channels
+        weights.clear();
+        for (int oc = 0; oc < N2; oc++)
+            for (int ic = 0; ic < N1; ic++)
+                weights.push_back(model->conv2_weights[oc*N1 + ic]*scales1[ic]);
+        for (int p = 0; p < N1/4; p++) {
+            quant_tap_t tap = { p, 0, 0 };
+            qmodel->conv2.taps.push_back(tap);
+        }
+        quant_params(&qmodel->conv2, N2, &weights[0], model->conv2_biases, scales2);
+
+        // conv3: one tap per quad of input channels and kernel position,
+        // dequantized to float
+        weights.clear();
+        for (int oc = 0; oc < N3; oc++)
+            for (int p = 0; p < N2/4; p++)
+                for (int ky = 0; ky < F3; ky++)
+                    for (int kx = 0; kx < F3; kx++)
+                        for (int i = 0; i < 4; i++) {
+                            int ic = 4*p + i;
+                            weights.push_back(model->conv3_weights[((oc*N2 + ic)*F3 + ky)*F3 + kx]*scales2[ic]);
+                        }
+        for (int p = 0; p < N2/4; p++)
+            for (int ky = 0; ky < F3; ky++)
+                for (int kx = 0; kx < F3; kx++) {
+                    quant_tap_t tap = { p, ky, kx };
+                    qmodel->conv3.taps.push_back(tap);
+                }
+        quant_params(&qmodel->conv3, N3, &weights[0], model->conv3_biases, NULL);
+    } catch (...) {
+        delete qmodel;
+        throw;
+    }
+    return qmodel;
+}
+
+void quant_model_destroy(quant_model_t *qmodel)
+{
+    delete qmodel;
+}
+
+// word offsets of the taps of params in a map with the given plane and row sizes
+static void quant_offsets(const quant_params_t *params, long plane, int stride, int *offsets)
+{
+    for (size_t t = 0; t < params->taps.size(); t++)
+        offsets[t] = (int) (params->taps[t].plane*plane + (long) params->taps[t].y*stride + params->taps[t].x);
+}
+
+static size_t quant_align(size_t bytes)
+{
+    return (bytes + QUANT_ALIGN - 1)/QUANT_ALIGN*QUANT_ALIGN;
+}
+
+// quad maps in the workspace: the padded conv1 input, the conv1 output and
+// the edge-extended conv2 output
+struct quant_maps_t {
+    uint32_t *input;
+    uint32_t *layer1;
+    uint32_t *layer2;
+};
+
+static size_t quant_layout(int h, int w, char *base, quant_maps_t *maps)
+{
+    size_t sizes[3] = {
+        (size_t) (h + F1 - 1)*(w + F1 - 1)*sizeof(uint32_t),
+        (size_t) N1/4*h*w*sizeof(uint32_t),
+        (size_t) N2/4*(h + F3 - 1)*(w + F3 - 1)*sizeof(uint32_t),
+    };
+    uint32_t **ptrs[3] = { &maps->input, &maps->layer1, &maps->layer2 };
+    char *start = (char *) (((size_t) base + QUANT_ALIGN - 1)/QUANT_ALIGN*QUANT_ALIGN);
+    size_t used = 0;
+    for (int i = 0; i < 3; i++) {
+        *ptrs[i] = (uint32_t *) (start + used);
+        used += quant_align(sizes[i]);
+    }
+    // slack for aligning the start of an unaligned workspace
+    return used + QUANT_ALIGN - 1;
+}
+
+size_t quant_workspace_bytes(int h, int w)
+{
+    quant_maps_t maps;
+    return quant_layout(h, w, NULL, &maps);
+}
+
+static inline int clamp_index(int i, int n)
+{
+    return i < 0 ? 0 : (i > n - 1 ? n - 1 : i);
+}
+
+void quant_run(const quant_model_t *qmodel,
+               const ftmap_t       *input_ftmap,
+               int                  h,
+               int                  w,
+               ftmap_t             *output_ftmap,
+               void                *workspace)
+{
+    quant_maps_t maps;
+    quant_layout(h, w, (char *) workspace, &maps);
+    int offsets[QUANT_MAX_TAPS];
+
+    // conv1 input: edge-extended 8-bit pixels, four adjacent ones per word
+    int pad1 = F1/2;
+    int stride1 = w + F1 - 1;
+    for (int py = 0; py < h + F1 - 1; py++) {
+        const ftmap_t *src = input_ftmap + (long) clamp_index(py - pad1, h)*w;
+        uint32_t *dst = maps.input + (long) py*stride1;
+        for (int px = 0; px < stride1; px++) {
+            float v = fminf(fmaxf(src[clamp_index(px - pad1, w)], 0.0f), 1.0f);
+            dst[px] = (uint32_t) nearbyintf(v*QUANT_ACT_MAX);
+        }
+        // in place, left to right: dst[px + 3] still holds a single pixel
+        for (int px = 0; px < stride1; px++)
+            for (int i = 1; i < 4 && px + i < stride1; i++)
+                dst[px] |= (dst[px + i] & 0xff) << 8*i;
+    }
+
+    quant_offsets(&qmodel->conv1, 0, stride1, offsets);
+    quant_output_t out1 = { maps.layer1, NULL, (long) h*w, w };
+    quant_conv(&qmodel->conv1.layer, maps.input, stride1, offsets, out1, 0, h, 0, w);
+
+    // conv2 writes the interior of its edge-extended output
+    int pad3 = F3/2;
+    int stride3 = w + F3 - 1;
+    long plane3 = (long) (h + F3 - 1)*stride3;
+    quant_offsets(&qmodel->conv2, (long) h*w, w, offsets);
+    quant_output_t out2 = { maps.layer2 + pad3*stride3 + pad3, NULL, plane3, stride3 };
+    quant_conv(&qmodel->conv2.layer, maps.layer1, w, offsets, out2, 0, h, 0, w);
+
+    for (int p = 0; p < N2/4; p++) {
+        uint32_t *plane = maps.layer2 + p*plane3;
+        for (int y = pad3; y < pad3 + h; y++)
+            for (int x = 0; x < pad3; x++) {
+                plane[(long) y*stride3 + x] = plane[(long) y*stride3 + pad3];
+                plane[(long) y*stride3 + pad3 + w + x] = plane[(long) y*stride3 + pad3 + w - 1];
+            }
+        for (int y = 0; y < pad3; y++) {
+            memcpy(plane + (long) y*stride3, plane + (long) pad3*stride3, stride3*sizeof(uint32_t));
+            memcpy(plane + (long) (pad3 + h + y)*stride3, plane + (long) (pad3 + h - 1)*stride3, stride3*sizeof(uint32_t));
+        }
+    }
+
+    quant_offsets(&qmodel->conv3, plane3, stride3, offsets);
+    quant_output_t out3 = { NULL, output_ftmap, (long) h*w, w };
+    quant_conv(&qmodel->conv3.layer, maps.layer2, stride3, offsets, out3, 0, h, 0, w);
+}
+
+// dot product of four unsigned 8-bit activations and four signed 8-bit weights
+static inline int32_t quant_dot(uint32_t a, int32_t w)
+{
+    int32_t sum = 0;
+    for (int i = 0; i < 4; i++)
+        sum += (int32_t) ((a >> 8*i) & 0xff)*(int8_t) ((uint32_t) w >> 8*i);
+    return sum;
+}
+
+void quant_conv_scalar(const quant_layer_t *layer,
+                       const uint32_t      *input,
+                       int                  input_stride,
+                       const int           *offsets,
+                       quant_output_t       output,
+                       int                  y0,
+                       int                  y1,
+                       int                  x0,
+                       int                  x1)
+{
+    int taps = layer->taps;
+    for (int y = y0; y < y1; y++)
+        for (int x = x0; x < x1; x++) {
+            const uint32_t *src = input + (long) y*input_stride + x;
+            long index = (long) y*output.stride + x;
+            uint32_t quad = 0;
+            for (int oc = 0; oc < layer->nout; oc++) {
+                const int32_t *weights = layer->weights + (long) oc*taps;
+                int32_t acc = 0;
+                for (int t = 0; t < taps; t++)
+                    acc += quant_dot(src[offsets[t]], weights[t]);
+                acc += layer->biases[oc];
+
+                if (output.real) {
+                    output.real[oc*output.plane + index] = fmaxf(0.0f, (float) acc*layer->scales[oc]);
+                } else {
+                    quad |= quant_requantize(acc, layer->scales[oc]) << 8*(oc % 4);
+                    if (oc % 4 == 3) {
+                        output.quads[oc/4*output.plane + index] = quad;
+                        quad = 0;
+                    }
+                }
+            }
+        }
+}
+
+void quant_conv(const quant_layer_t *layer,
+                const uint32_t      *input,
+                int                  input_stride,
+                const int           *offsets,
+                quant_output_t       output,
+                int                  y0,
+                int                  y1,
+                int                  x0,
+                int                  x1)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    simd_isa_t isa = simd_isa();
+    if (isa >= SIMD_ISA_AVX512 && simd_vnni()) {
+        quant_conv_avx512(layer, input, input_stride, offsets, output, y0, y1, x0, x1);
+        return;
+    }
+    if (isa >= SIMD_ISA_AVX2) {
+        quant_conv_avx2(layer, input, input_stride, offsets, output, y0, y1, x0, x1);
+        return;
+    }
+#endif
+    quant_conv_scalar(layer, input, input_stride, offsets, output, y0, y1, x0, x1);
+}
@@ -0,0 +1,137 @@
+#ifndef _QUANT_H_
+#define _QUANT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "srcnn.h"
+#include "engine.h"
+
+// Quantized SRCNN: unsigned 8-bit activations, signed 8-bit weights and
+// 32-bit accumulators.
+//
+// Weights get one scale per output channel. Activations get one scale per
+// channel, calibrated from the float model. Each input channel's activation
+// scale is folded into the next layer's float weights before those are
+// quantized, so a layer is a plain integer dot product followed by one
+// multiplier per output channel that requantizes the accumulator to the
+// next layer's 8-bit range. conv3 dequantizes straight to float.
+//
+// Activations are stored as channel quads: the 8-bit values of channels
+// 4q..4q+3 of one pixel share a 32-bit word, so one 512-bit load holds four
+// channels of 16 pixels, which is the operand layout of AVX-512 VNNI
+// (vpdpbusd). conv1 has a single input channel and instead packs four
+// horizontally adjacent pixels into each word.
+
+#define QUANT_ACT_MAX    255    // largest 8-bit activation
+#define QUANT_WEIGHT_MAX 127    // largest 8-bit weight magnitude
+#define QUANT_MAX_TAPS   256    // largest number of quad taps per output value
+
+// per-channel activation maxima of the float model over calibration images
+struct quant_calib_t {
+    float conv1_max[N1];
+    float conv2_max[N2];
+};
+
+void quant_calib_init(quant_calib_t *calib);
+
+// runs the float model on one planar h x w image and widens the maxima
+void quant_calibrate(quant_calib_t       *calib,
+                     const srcnn_model_t *model,
+                     const ftmap_t       *input_ftmap,
+                     int                  h,
+                     int                  w);
+
+// quantized weights, biases and requantization multipliers of all layers
+struct quant_model_t;
+
+// quantizes model with the given calibration. Throws std::runtime_error if
+// a quantized bias or accumulator could overflow 32 bits.
+quant_model_t *quant_model_create(const srcnn_model_t *model, const quant_calib_t *calib);
+
+void quant_model_destroy(quant_model_t *qmodel);
+
+// bytes of workspace quant_run() needs for h x w images
+size_t quant_workspace_bytes(int h, int w);
+
+// implements end-to-end quantized SRCNN on one planar h x w image; the input
+// must lie in [0, 1] (u8 images divided by 255)
+void quant_run(const quant_model_t *qmodel,
+               const ftmap_t       *input_ftmap,
+               int                  h,
+               int                  w,
+               ftmap_t             *output_ftmap,
+               void                *workspace);
+
+// one quantized layer over a map of channel quads:
+//   input:  output (y, x) reads quad words input[y*stride + x + offsets[t]]
+//   weights: four 8-bit weights per tap, in the same byte order as the quads
+struct quant_layer_t {
+    int            nout;
+    int            taps;
+    const int32_t *weights;     // [nout][taps]
+    const int32_t *biases;      // [nout], in accumulator units
+    const float   *scales;      // [nout], accumulator to output units
+};
+
+// output of a quantized layer: 8-bit channel quads for the next layer, or
+// dequantized float planes (element (c, y, x) at real[c*plane + y*stride + x])
+struct quant_output_t {
+    uint32_t *quads;            // quad q of (y, x) at quads[q*plane + y*stride + x]
+    float    *real;
+    long      plane;
+    int       stride;
+};
+
+// computes the output rectangle [y0, y1) x [x0, x1) of layer; dispatches
+// like conv_direct() to the widest kernel the CPU supports. All kernels are
+// exact integer arithmetic, so they agree bit for bit.
+void quant_conv(const quant_layer_t *layer,
+                const uint32_t      *input,
+                int                  input_stride,
+                const int           *offsets,
+                quant_output_t       output,
+                int                  y0,
+                int                  y1,
+                int                  x0,
+                int                  x1);
+
+// per-ISA implementations behind quant_conv()
+void quant_conv_scalar(const quant_layer_t *layer,
+                       const uint32_t      *input,
+                       int                  input_stride,
+                       const int           *offsets,
+                       quant_output_t       output,
+                       int                  y0,
+                       int                  y1,
+                       int                  x0,
+                       int                  x1);
+void quant_conv_avx2(const quant_layer_t *layer,
+                     const uint32_t      *input,
+                     int                  input_stride,
+                     const int           *offsets,
+                     quant_output_t       output,
+                     int                  y0,
+                     int                  y1,
+                     int                  x0,
+                     int                  x1);
+void quant_conv_avx512(const quant_layer_t *layer,
+                       const uint32_t      *input,
+                       int                  input_stride,
+                       const int           *offsets,
+                       quant_output_t       output,
+                       int                  y0,
+                       int                  y1,
+                       int                  x0,
+                       int                  x1);
+
+// 8-bit requantization shared by all kernels: ReLU, scale, round to nearest
+// even (the default rounding mode, as vcvtps2dq) and saturate
+static inline uint32_t quant_requantize(int32_t acc, float scale)
+{
+    float v = (float) (acc > 0 ? acc : 0)*scale;
+    int q = (int) __builtin_nearbyintf(v);
+    return q > QUANT_ACT_MAX ? QUANT_ACT_MAX : (uint32_t) q;
+}
+
+#endif /* _QUANT_H_ */
@@ -0,0 +1,162 @@
+#include <math.h>
+
+#include "quant.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define AVX2_VL 8   // quads per vector
+
+// FB output channels x XB vectors of adjacent output columns. AVX2 has no
+// u8 x s8 dot product without saturation (vpmaddubsw saturates to 16 bits), so
+// the even and odd bytes of activations and weights are widened to 16 bits
+// and summed by two vpmaddwd, which is exact and matches the VNNI kernel.
+// With TAIL set only the first lanes columns of the last vector are loaded
+// and stored.
+template <int FB, int XB, bool TAIL>
+AVX2_TARGET static void quant_block_avx2(const quant_layer_t *layer,
+                                         const uint32_t      *src,
+                                         const int           *offsets,
+                                         quant_output_t       output,
+                                         int                  oc0,
+                                         long                 index,
+                                         int                  lanes)
+{
+    int taps = layer->taps;
+    __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(lanes), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256i even_bytes = _mm256_set1_epi32(0x00ff00ff);
+    __m256i acc[FB][XB];
+
+    for (int fi = 0; fi < FB; fi++)
+        for (int xi = 0; xi < XB; xi++)
+            acc[fi][xi] = _mm256_setzero_si256();
+
+    const int32_t *weights = layer->weights + (long) oc0*taps;
+    for (int t = 0; t < taps; t++) {
+        const uint32_t *p = src + offsets[t];
+        __m256i even[XB], odd[XB];
+        for (int xi = 0; xi < XB; xi++) {
+            __m256i v = TAIL && xi == XB - 1 ? _mm256_maskload_epi32((const int *) p + xi*AVX2_VL, mask)
+                                             : _mm256_loadu_si256((const __m256i *) (p + xi*AVX2_VL));
+            even[xi] = _mm256_and_si256(v, even_bytes);
+            odd[xi] = _mm256_srli_epi16(v, 8);
+        }
+        for (int fi = 0; fi < FB; fi++) {
+            __m256i wv = _mm256_set1_epi32(weights[(long) fi*taps + t]);
+            __m256i w_even = _mm256_srai_epi16(_mm256_slli_epi16(wv, 8), 8);
+            __m256i w_odd = _mm256_srai_epi16(wv, 8);
+            for (int xi = 0; xi < XB; xi++) {
+                acc[fi][xi] = _mm256_add_epi32(acc[fi][xi], _mm256_madd_epi16(even[xi], w_even));
+                acc[fi][xi] = _mm256_add_epi32(acc[fi][xi], _mm256_madd_epi16(odd[xi], w_odd));
+            }
+        }
+    }
+
+    if (output.real) {
+        __m256 zero = _mm256_setzero_ps();
+        for (int fi = 0; fi < FB; fi++) {
+            __m256i bias = _mm256_set1_epi32(layer->biases[oc0 + fi]);
+            __m256 scale = _mm256_set1_ps(layer->scales[oc0 + fi]);
+            float *dst = output.real + (oc0 + fi)*output.plane + index;
+            for (int xi = 0; xi < XB; xi++) {
+                __m256 result = _mm256_cvtepi32_ps(_mm256_add_epi32(acc[fi][xi], bias));
+                result = _mm256_max_ps(zero, _mm256_mul_ps(result, scale));
+                if (TAIL && xi == XB - 1)
+                    _mm256_maskstore_ps(dst + xi*AVX2_VL, mask, result);
+                else
+                    _mm256_storeu_ps(dst + xi*AVX2_VL, result);
+            }
+        }
+        return;
+    }
+
+    // requantize as quant_requantize() and pack four channels per word
+    __m256i zero = _mm256_setzero_si256();
+    __m256i max = _mm256_set1_epi32(QUANT_ACT_MAX);
+    for (int g = 0; g < FB/4; g++) {
+        uint32_t *dst = output.quads + (oc0/4 + g)*output.plane + index;
+        for (int xi = 0; xi < XB; xi++) {
+            __m256i quad = zero;
+            for (int i = 0; i < 4; i++) {
+                int fi = 4*g + i;
+                __m256i v = _mm256_max_epi32(_mm256_add_epi32(acc[fi][xi], _mm256_set1_epi32(layer->biases[oc0 + fi])), zero);
+                __m256 real = _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(layer->scales[oc0 + fi]));
+                v = _mm256_min_epi32(_mm256_cvtps_epi32(real), max);
+                quad = _mm256_or_si256(quad, _mm256_slli_epi32(v, 8*i));
+            }
+            if (TAIL && xi == XB - 1)
+                _mm256_maskstore_epi32((int *) dst + xi*AVX2_VL, mask, quad);
+            else
+                _mm256_storeu_si256((__m256i *) (dst + xi*AVX2_VL), quad);
+        }
+    }
+}
+
+// runs block kernel over columns [x0, x1) of one row for channels [oc0, oc1)
+template <int FB, int XB>
+AVX2_TARGET static void quant_row_avx2(const quant_layer_t *layer,
+                                       const uint32_t      *input,
+                                       int                  input_stride,
+                                       const int           *offsets,
+                                       quant_output_t       output,
+                                       int                  oc0,
+                                       int                  oc1,
+                                       int                  y,
+                                       int                  x0,
+                                       int                  x1)
+{
+    const uint32_t *src = input + (long) y*input_stride;
+    long index = (long) y*output.stride;
+    int x = x0;
+    for (; x + XB*AVX2_VL <= x1; x += XB*AVX2_VL)
+        for (int oc = oc0; oc < oc1; oc += FB)
+            quant_block_avx2<FB, XB, false>(layer, src + x, offsets, output, oc, index + x, AVX2_VL);
+    for (; x + AVX2_VL <= x1; x += AVX2_VL)
+        for (int oc = oc0; oc < oc1; oc += FB)
+            quant_block_avx2<FB, 1, false>(layer, src + x, offsets, output, oc, index + x, AVX2_VL);
+    if (x < x1)
+        for (int oc = oc0; oc < oc1; oc += FB)
+            quant_block_avx2<FB, 1, true>(layer, src + x, offsets, output, oc, index + x, x1 - x);
+}
+
+AVX2_TARGET void quant_conv_avx2(const quant_layer_t *layer,
+                                 const uint32_t      *input,
+                                 int                  input_stride,
+                                 const int           *offsets,
+                                 quant_output_t       output,
+                                 int                  y0,
+                                 int                  y1,
+                                 int                  x0,
+                                 int                  x1)
+{
+    // quad outputs in blocks of 4 channels, float outputs one at a time
+    int nout = layer->nout;
+    int oc_blocked = output.quads ? nout : 0;
+
+    for (int y = y0; y < y1; y++) {
+        if (oc_blocked > 0)
+            quant_row_avx2<4, 2>(layer, input, input_stride, offsets, output, 0, oc_blocked, y, x0, x1);
+        if (oc_blocked < nout)
+            quant_row_avx2<1, 4>(layer, input, input_stride, offsets, output, oc_blocked, nout, y, x0, x1);
+    }
+}
+
+#else
+
+// no AVX2 on this architecture: simd_isa() never selects it
+void quant_conv_avx2(const quant_layer_t *layer,
+                     const uint32_t      *input,
+                     int                  input_stride,
+                     const int           *offsets,
+                     quant_output_t       output,
+                     int                  y0,
+                     int                  y1,
+                     int                  x0,
+                     int                  x1)
+{
+    quant_conv_scalar(layer, input, input_stride, offsets, output, y0, y1, x0, x1);
+}
+
+#endif
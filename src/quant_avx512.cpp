@@ -0,0 +1,160 @@
+#include <math.h>
+
+#include "quant.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// GCC 12 warns about _mm512_undefined_ps() inside the intrinsic headers (PR 105593)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+#include <immintrin.h>
+
+#define VNNI_TARGET __attribute__((target("avx512f,avx512bw,avx512vnni")))
+#define VNNI_VL 16  // quads per vector
+
+// FB output channels x XB vectors of adjacent output columns: every input
+// vector is loaded once per tap and multiplied with FB broadcast weight quads
+// by vpdpbusd, which adds four u8 x s8 products into each 32-bit lane without
+// intermediate saturation. With TAIL set only the first lanes columns of the
+// last vector are loaded and stored.
+template <int FB, int XB, bool TAIL>
+VNNI_TARGET static void quant_block_avx512(const quant_layer_t *layer,
+                                           const uint32_t      *src,
+                                           const int           *offsets,
+                                           quant_output_t       output,
+                                           int                  oc0,
+                                           long                 index,
+                                           int                  lanes)
+{
+    int taps = layer->taps;
+    __mmask16 mask = TAIL ? (__mmask16) ((1u << lanes) - 1) : (__mmask16) 0xffff;
+    __m512i acc[FB][XB];
+
+    for (int fi = 0; fi < FB; fi++)
+        for (int xi = 0; xi < XB; xi++)
+            acc[fi][xi] = _mm512_setzero_si512();
+
+    const int32_t *weights = layer->weights + (long) oc0*taps;
+    for (int t = 0; t < taps; t++) {
+        const uint32_t *p = src + offsets[t];
+        __m512i v[XB];
+        for (int xi = 0; xi < XB; xi++)
+            v[xi] = TAIL && xi == XB - 1 ? _mm512_maskz_loadu_epi32(mask, p + xi*VNNI_VL)
+                                         : _mm512_loadu_si512(p + xi*VNNI_VL);
+        for (int fi = 0; fi < FB; fi++) {
+            __m512i wv = _mm512_set1_epi32(weights[(long) fi*taps + t]);
+            for (int xi = 0; xi < XB; xi++)
+                acc[fi][xi] = _mm512_dpbusd_epi32(acc[fi][xi], v[xi], wv);
+        }
+    }
+
+    if (output.real) {
+        __m512 zero = _mm512_setzero_ps();
+        for (int fi = 0; fi < FB; fi++) {
+            __m512i bias = _mm512_set1_epi32(layer->biases[oc0 + fi]);
+            __m512 scale = _mm512_set1_ps(layer->scales[oc0 + fi]);
+            float *dst = output.real + (oc0 + fi)*output.plane + index;
+            for (int xi = 0; xi < XB; xi++) {
+                __m512 result = _mm512_cvtepi32_ps(_mm512_add_epi32(acc[fi][xi], bias));
+                result = _mm512_max_ps(zero, _mm512_mul_ps(result, scale));
+                if (TAIL && xi == XB - 1)
+                    _mm512_mask_storeu_ps(dst + xi*VNNI_VL, mask, result);
+                else
+                    _mm512_storeu_ps(dst + xi*VNNI_VL, result);
+            }
+        }
+        return;
+    }
+
+    // requantize as quant_requantize() and pack four channels per word
+    __m512i zero = _mm512_setzero_si512();
+    __m512i max = _mm512_set1_epi32(QUANT_ACT_MAX);
+    for (int g = 0; g < FB/4; g++) {
+        uint32_t *dst = output.quads + (oc0/4 + g)*output.plane + index;
+        for (int xi = 0; xi < XB; xi++) {
+            __m512i quad = zero;
+            for (int i = 0; i < 4; i++) {
+                int fi = 4*g + i;
+                __m512i v = _mm512_max_epi32(_mm512_add_epi32(acc[fi][xi], _mm512_set1_epi32(layer->biases[oc0 + fi])), zero);
+                __m512 real = _mm512_mul_ps(_mm512_cvtepi32_ps(v), _mm512_set1_ps(layer->scales[oc0 + fi]));
+                v = _mm512_min_epi32(_mm512_cvtps_epi32(real), max);
+                quad = _mm512_or_si512(quad, _mm512_slli_epi32(v, 8*i));
+            }
+            if (TAIL && xi == XB - 1)
+                _mm512_mask_storeu_epi32(dst + xi*VNNI_VL, mask, quad);
+            else
+                _mm512_storeu_si512(dst + xi*VNNI_VL, quad);
+        }
+    }
+}
+
+// runs block kernel over columns [x0, x1) of one row for channels [oc0, oc1)
+template <int FB, int XB>
+VNNI_TARGET static void quant_row_avx512(const quant_layer_t *layer,
+                                         const uint32_t      *input,
+                                         int                  input_stride,
+                                         const int           *offsets,
+                                         quant_output_t       output,
+                                         int                  oc0,
+                                         int                  oc1,
+                                         int                  y,
+                                         int                  x0,
+                                         int                  x1)
+{
+    const uint32_t *src = input + (long) y*input_stride;
+    long index = (long) y*output.stride;
+    int x = x0;
+    for (; x + XB*VNNI_VL <= x1; x += XB*VNNI_VL)
+        for (int oc = oc0; oc < oc1; oc += FB)
+            quant_block_avx512<FB, XB, false>(layer, src + x, offsets, output, oc, index + x, VNNI_VL);
+    for (; x + VNNI_VL <= x1; x += VNNI_VL)
+        for (int oc = oc0; oc < oc1; oc += FB)
+            quant_block_avx512<FB, 1, false>(layer, src + x, offsets, output, oc, index + x, VNNI_VL);
+    if (x < x1)
+        for (int oc = oc0; oc < oc1; oc += FB)
+            quant_block_avx512<FB, 1, true>(layer, src + x, offsets, output, oc, index + x, x1 - x);
+}
+
+VNNI_TARGET void quant_conv_avx512(const quant_layer_t *layer,
+                                   const uint32_t      *input,
+                                   int                  input_stride,
+                                   const int           *offsets,
+                                   quant_output_t       output,
+                                   int                  y0,
+                                   int                  y1,
+                                   int                  x0,
+                                   int                  x1)
+{
+    // channels in blocks of 8 where possible; quad outputs come in whole
+    // quads, float outputs one channel at a time
+    int nout = layer->nout;
+    int oc_blocked = nout/8*8;
+
+    for (int y = y0; y < y1; y++) {
+        if (oc_blocked > 0)
+            quant_row_avx512<8, 2>(layer, input, input_stride, offsets, output, 0, oc_blocked, y, x0, x1);
+        if (oc_blocked < nout && output.quads)
+            quant_row_avx512<4, 2>(layer, input, input_stride, offsets, output, oc_blocked, nout, y, x0, x1);
+        else if (oc_blocked < nout)
+            quant_row_avx512<1, 4>(layer, input, input_stride, offsets, output, oc_blocked, nout, y, x0, x1);
+    }
+}
+
+#else
+
+// no AVX-512 on this architecture: simd_vnni() is always false
+void quant_conv_avx512(const quant_layer_t *layer,
+                       const uint32_t      *input,
+                       int                  input_stride,
+                       const int           *offsets,
+                       quant_output_t       output,
+                       int                  y0,
+                       int                  y1,
+                       int                  x0,
+                       int                  x1)
+{
+    quant_conv_scalar(layer, input, input_stride, offsets, output, y0, y1, x0, x1);
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "simd.h"
+
+static const char *simd_isa_names[SIMD_ISA_COUNT] = {
+    "scalar",
+    "avx2",
+    "avx512",
+};
+
+// selected ISA, SIMD_ISA_COUNT until first use; atomic so that contexts on
+// different threads can dispatch concurrently
+static std::atomic<int> simd_isa_override(SIMD_ISA_COUNT);
+
+#if defined(__x86_64__) || defined(__i386__)
+static simd_isa_t simd_detect_cpu()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SIMD_ISA_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return SIMD_ISA_AVX2;
+    return SIMD_ISA_SCALAR;
+}
+#endif
+
+simd_isa_t simd_detect()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const simd_isa_t detected = simd_detect_cpu();
+    return detected;
+#else
+    return SIMD_ISA_SCALAR;
+#endif
+}
+
+bool simd_vnni()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool vnni = simd_detect() == SIMD_ISA_AVX512 &&
+                             __builtin_cpu_supports("avx512bw") &&
+                             __builtin_cpu_supports("avx512vnni");
+    return vnni;
+#else
+    return false;
+#endif
+}
+
+bool simd_f16c()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool f16c = simd_detect() != SIMD_ISA_SCALAR && __builtin_cpu_supports("f16c");
+    return f16c;
+#else
+    return false;
+#endif
+}
+
+bool simd_bf16()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool bf16 = simd_detect() == SIMD_ISA_AVX512 && __builtin_cpu_supports("avx512bf16");
+    return bf16;
+#else
+    return false;
+#endif
+}
+
+simd_isa_t simd_isa()
+{
+    int current = simd_isa_override.load();
+    if (current == SIMD_ISA_COUNT) {
+        simd_isa_t isa = simd_detect();
+        const char *env = getenv("SRCNN_ISA");
+        if (env) {
+            for (int i = 0; i < SIMD_ISA_COUNT; i++)
+                if (strcmp(env, simd_isa_names[i]) == 0 && i < isa)
+                    isa = (simd_isa_t) i;
+        }
+        // a concurrent simd_set_isa() wins over the default
+        if (simd_isa_override.compare_exchange_strong(current, isa))
+            current = isa;
+    }
+    return (simd_isa_t) current;
+}
+
+void simd_set_isa(simd_isa_t isa)
+{
+    simd_isa_t detected = simd_detect();
+    simd_isa_override.store(isa < detected ? isa : detected);
+}
+
+const char *simd_isa_name(simd_isa_t isa)
+{
+    return isa >= 0 && isa < SIMD_ISA_COUNT ? simd_isa_names[isa] : "unknown";
+}
@@ -0,0 +1,86 @@
+#ifndef _SIMD_H_
+#define _SIMD_H_
+
+#include "kernels.h"
+#include "gemm.h"
+
+// instruction sets with hand-vectorised kernels, narrowest first
+enum simd_isa_t {
+    SIMD_ISA_SCALAR = 0,    // portable C++, matches the reference loops bit for bit
+    SIMD_ISA_AVX2,          // AVX2 + FMA, 8 floats per vector
+    SIMD_ISA_AVX512,        // AVX-512F, 16 floats per vector
+    SIMD_ISA_COUNT
+};
+
+// widest instruction set supported by this CPU (and OS), detected once via cpuid
+simd_isa_t simd_detect();
+
+// instruction set the kernels dispatch to: the detected one unless overridden
+// by simd_set_isa() or the SRCNN_ISA environment variable ("scalar", "avx2", "avx512")
+simd_isa_t simd_isa();
+
+// forces the kernels onto isa, clamped to what the CPU supports
+void simd_set_isa(simd_isa_t isa);
+
+const char *simd_isa_name(simd_isa_t isa);
+
+// whether the CPU has the AVX-512 BW and VNNI extensions used by the 8-bit
+// kernels of quant.h on top of SIMD_ISA_AVX512
+bool simd_vnni();
+
+// whether the CPU has the F16C half-precision conversions (every AVX2 CPU
+// in practice) and the AVX512-BF16 conversions, used for 16-bit feature maps
+bool simd_f16c();
+bool simd_bf16();
+
+// GCC vector of VL floats for kernels written once and instantiated per
+// target: 16 for AVX-512, 8 for AVX2 and 4 (SSE) otherwise. Loads and stores
+// through it may be unaligned and alias float arrays. The type is looked up
+// through simd_vec<VL> because attributes of a typedef are dropped when it is
+// passed as a template argument.
+template <int VL> struct simd_vec;
+template <> struct simd_vec<16> { typedef float type __attribute__((vector_size(64), aligned(4), may_alias)); };
+template <> struct simd_vec<8>  { typedef float type __attribute__((vector_size(32), aligned(4), may_alias)); };
+template <> struct simd_vec<4>  { typedef float type __attribute__((vector_size(16), aligned(4), may_alias)); };
+
+// per-ISA implementations behind conv_direct() and gemm_kernel()
+void conv_direct_scalar(const conv_layer_t *layer,
+                        ftmap_view_t        input,
+                        int                 h,
+                        int                 w,
+                        ftmap_view_t        output,
+                        int                 f0,
+                        int                 f1,
+                        int                 y0,
+                        int                 y1,
+                        int                 x0,
+                        int                 x1);
+void conv_direct_avx2(const conv_layer_t *layer,
+                      ftmap_view_t        input,
+                      int                 h,
+                      int                 w,
+                      ftmap_view_t        output,
+                      int                 f0,
+                      int                 f1,
+                      int                 y0,
+                      int                 y1,
+                      int                 x0,
+                      int                 x1);
+void conv_direct_avx512(const conv_layer_t *layer,
+                        ftmap_view_t        input,
+                        int                 h,
+                        int                 w,
+                        ftmap_view_t        output,
+                        int                 f0,
+                        int                 f1,
+                        int                 y0,
+                        int                 y1,
+                        int                 x0,
+                        int                 x1);
+
+#if defined(__x86_64__) || defined(__i386__)
+extern const gemm_kernel_t gemm_kernel_avx2;
+extern const gemm_kernel_t gemm_kernel_avx512;
+#endif
+
+#endif /* _SIMD_H_ */
@@ -0,0 +1,55 @@
+#ifndef _SPSC_QUEUE_H_
+#define _SPSC_QUEUE_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <vector>
+
+// bounded lock-free single-producer single-consumer queue
+//
+// One thread may push and one other thread may pop, concurrently, without
+// locks: the producer only writes tail_, the consumer only writes head_, and
+// each publishes its slot with a release store the other side reads with an
+// acquire load. The two indices sit on separate cache lines so the threads
+// do not false-share. Neither call blocks; callers decide how to wait.
+template <typename T>
+class spsc_queue {
+public:
+    explicit spsc_queue(size_t capacity) : slots_(capacity + 1), head_(0), tail_(0) {}
+
+    spsc_queue(const spsc_queue &) = delete;
+    spsc_queue &operator=(const spsc_queue &) = delete;
+
+    size_t capacity() const { return slots_.size() - 1; }
+
+    // producer side: returns false if the queue is full
+    bool try_push(const T &value)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t next = tail + 1 == slots_.size() ? 0 : tail + 1;
+        if (next == head_.load(std::memory_order_acquire))
+            return false;
+        slots_[tail] = value;
+        tail_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side: returns false if the queue is empty
+    bool try_pop(T *value)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        *value = slots_[head];
+        head_.store(head + 1 == slots_.size() ? 0 : head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T>                   slots_;    // one slot more than the capacity tells full from empty
+    alignas(64) std::atomic<size_t>  head_;     // next slot to pop, written by the consumer
+    alignas(64) std::atomic<size_t>  tail_;     // next slot to push, written by the producer
+};
+
+#endif /* _SPSC_QUEUE_H_ */
@@ -1,5 +1,9 @@
 #include "srcnn.h"
 
+#ifndef __SYNTHESIS__
+#include <vector>
+#endif
+
 void srcnn(ftmap_t input_ftmap[N0][H][W],
            param_t conv1_weights[N1][N0][F1][F1],
            param_t conv1_biases[N1],
@@ -10,8 +14,19 @@ void srcnn(ftmap_t input_ftmap[N0][H][W],
            ftmap_t output_ftmap[N3][H][W])
 {
     // Implement end-to-end SRCNN here
+#ifdef __SYNTHESIS__
 	static ftmap_t layer1_output[N1][H][W];
 	static ftmap_t layer2_output[N2][H][W];
+#else
+	// C simulation keeps the intermediate maps per thread so srcnn() stays
+	// reentrant across threads without allocating on every call; they are
+	// allocated on the first call of each thread (a std::vector rather than
+	// a thread_local array, which every thread would reserve up front)
+	static thread_local std::vector<ftmap_t> layer1_buffer(N1*H*W);
+	static thread_local std::vector<ftmap_t> layer2_buffer(N2*H*W);
+	ftmap_t (*layer1_output)[H][W] = (ftmap_t (*)[H][W]) layer1_buffer.data();
+	ftmap_t (*layer2_output)[H][W] = (ftmap_t (*)[H][W]) layer2_buffer.data();
+#endif
 	conv1(input_ftmap, conv1_weights, conv1_biases, layer1_output);
 	conv2(layer1_output, conv2_weights, conv2_biases, layer2_output);
 	conv3(layer2_output, conv3_weights, conv3_biases, output_ftmap);
@@ -29,18 +29,64 @@ void srcnn(ftmap_t input_ftmap[N0][H][W],
            param_t conv3_biases[N3],
            ftmap_t output_ftmap[N3][H][W]);
 
-// implements first convolutional layer of SRCNN
+// implements end-to-end SRCNN as a fused row-streaming pipeline
+// (bit-identical to srcnn(), but only keeps line buffers of conv1/conv2 rows)
+void srcnn_fused(ftmap_t input_ftmap[N0][H][W],
+                 param_t conv1_weights[N1][N0][F1][F1],
+                 param_t conv1_biases[N1],
+                 param_t conv2_weights[N2][N1][F2][F2],
+                 param_t conv2_biases[N2],
+                 param_t conv3_weights[N3][N2][F3][F3],
+                 param_t conv3_biases[N3],
+                 ftmap_t output_ftmap[N3][H][W]);
+
+// implements end-to-end SRCNN as a dataflow pipeline of layer processes
+// linked by pixel FIFOs (hls::stream, see stream_compat.h) with line buffers
+// (bit-identical to srcnn(); see dataflow.h for its throughput model)
+void srcnn_dataflow(ftmap_t input_ftmap[N0][H][W],
+                    param_t conv1_weights[N1][N0][F1][F1],
+                    param_t conv1_biases[N1],
+                    param_t conv2_weights[N2][N1][F2][F2],
+                    param_t conv2_biases[N2],
+                    param_t conv3_weights[N3][N2][F3][F3],
+                    param_t conv3_biases[N3],
+                    ftmap_t output_ftmap[N3][H][W]);
+
+// implements the convolutional layers of SRCNN (instantiations of
+// conv_template() in conv_template.h)
 void conv1(ftmap_t input_ftmap[N0][H][W],
            param_t conv1_weights[N1][N0][F1][F1],
            param_t conv1_biases[N1],
            ftmap_t output_ftmap[N1][H][W]);
 void conv2(ftmap_t input_ftmap[N1][H][W],
-		   param_t conv2_weights[N2][N1][F2][F2], //F2 = 1 therefore we have 1x1 filter kernel
-		   param_t conv2_biases[N2],
+           param_t conv2_weights[N2][N1][F2][F2],   // F2 = 1, a 1x1 kernel
+           param_t conv2_biases[N2],
            ftmap_t output_ftmap[N2][H][W]);
 void conv3(ftmap_t input_ftmap[N2][H][W],
-		   param_t conv3_weights[N3][N2][F3][F3], //F2 = 1 therefore we have 1x1 filter kernel
-		   param_t conv3_biases[N3],
+           param_t conv3_weights[N3][N2][F3][F3],   // F3 = 5, a 5x5 kernel
+           param_t conv3_biases[N3],
            ftmap_t output_ftmap[N3][H][W]);
 
+// row kernels shared by the layer-by-layer and fused pipelines
+//   output_row[f*output_feat_stride + x] receives output feature f of the row
+//   input_rows[ky] points at edge-extended input row (y + ky - F/2), feature i at input_rows[ky][i*input_feat_stride]
+void conv1_row(ftmap_t  input_ftmap[N0][H][W],
+               param_t  conv1_weights[N1][N0][F1][F1],
+               param_t  conv1_biases[N1],
+               int      out_feat_y,
+               ftmap_t *output_row,
+               int      output_feat_stride);
+void conv2_row(ftmap_t *input_rows[F2],
+               int      input_feat_stride,
+               param_t  conv2_weights[N2][N1][F2][F2],
+               param_t  conv2_biases[N2],
+               ftmap_t *output_row,
+               int      output_feat_stride);
+void conv3_row(ftmap_t *input_rows[F3],
+               int      input_feat_stride,
+               param_t  conv3_weights[N3][N2][F3][F3],
+               param_t  conv3_biases[N3],
+               ftmap_t *output_row,
+               int      output_feat_stride);
+
 #endif /* _SRCNN_H_ */
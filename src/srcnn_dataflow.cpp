@@ -0,0 +1,319 @@
+#include <math.h>
+
+#include "srcnn.h"
+#include "stream_compat.h"
+
+#ifndef __SYNTHESIS__
+#include <vector>
+
+#include "dataflow.h"
+#endif
+
+// HLS directives, left out for other compilers (which would warn about them)
+#if defined(__SYNTHESIS__) || defined(__VITIS_HLS__)
+#define HLS_PRAGMA(directive) _Pragma(#directive)
+#else
+#define HLS_PRAGMA(directive)
+#endif
+
+// one pixel of a feature map, all features, as a FIFO token
+template <int N>
+struct df_pixel_t {
+	ftmap_t feat[N];
+};
+
+typedef df_pixel_t<N0> df_input_t;
+typedef df_pixel_t<N1> df_layer1_t;
+typedef df_pixel_t<N2> df_layer2_t;
+typedef df_pixel_t<N3> df_output_t;
+
+// edge-extended index into a row or column of length n
+static int df_clamp(int i, int n)
+{
+	return i < 0 ? 0 : (i > n - 1 ? n - 1 : i);
+}
+
+// Loop bodies of the stages, one iteration each. A K x K stage iterates over
+// (H + K/2) x (W + K/2) positions (r, c) in raster order: it reads input
+// pixel (r, c) into its line buffer of K rows while there is one, and writes
+// output pixel (r - K/2, c - K/2) once its whole window has arrived, edge
+// extended in both directions by clamping into the line buffer. Every output
+// accumulates its taps in the order in_feat, kernel_x, kernel_y and adds the
+// bias last, as conv_template() does, so results are bit-identical to srcnn().
+
+// iterations of a K x K stage and whether iteration it reads or writes
+template <int K>
+static long df_iterations()
+{
+	return (long) (H + K/2)*(W + K/2);
+}
+
+template <int K>
+static bool df_reads(long it)
+{
+	return it/(W + K/2) < H && it%(W + K/2) < W;
+}
+
+template <int K>
+static bool df_writes(long it)
+{
+	return it/(W + K/2) >= K/2 && it%(W + K/2) >= K/2;
+}
+
+template <int NIN, int NOUT, int K, bool RELU>
+static void df_conv_iteration(hls::stream<df_pixel_t<NIN> >  &input,
+                              hls::stream<df_pixel_t<NOUT> > &output,
+                              df_pixel_t<NIN>                 lines[K][W],
+                              param_t                         weights[NOUT][NIN][K][K],
+                              param_t                         biases[NOUT],
+                              long                            it)
+{
+	const int padding = K/2;
+	int r = it/(W + padding);
+	int c = it%(W + padding);
+	if (r < H && c < W)
+		lines[r % K][c] = input.read();
+	if (r < padding || c < padding)
+		return;
+
+	int y = r - padding;
+	int x = c - padding;
+	df_pixel_t<NOUT> pixel;
+	for (int out_feat = 0; out_feat < NOUT; out_feat++) {
+		float convolution = 0;
+		for (int in_feat = 0; in_feat < NIN; in_feat++)
+			for (int kernel_x = 0; kernel_x < K; kernel_x++)
+				for (int kernel_y = 0; kernel_y < K; kernel_y++)
+					convolution += weights[out_feat][in_feat][kernel_y][kernel_x]*
+					               lines[df_clamp(y + kernel_y - padding, H) % K][df_clamp(x + kernel_x - padding, W)].feat[in_feat];
+		float result = convolution + biases[out_feat];
+		pixel.feat[out_feat] = RELU ? fmaxf(0, result) : result;
+	}
+	output.write(pixel);
+}
+
+static void df_read_iteration(ftmap_t input_ftmap[N0][H][W], hls::stream<df_input_t> &output, long it)
+{
+	df_input_t pixel;
+	for (int feat = 0; feat < N0; feat++)
+		pixel.feat[feat] = input_ftmap[feat][it/W][it%W];
+	output.write(pixel);
+}
+
+static void df_write_iteration(hls::stream<df_output_t> &input, ftmap_t output_ftmap[N3][H][W], long it)
+{
+	df_output_t pixel = input.read();
+	for (int feat = 0; feat < N3; feat++)
+		output_ftmap[feat][it/W][it%W] = pixel.feat[feat];
+}
+
+// the dataflow processes
+static void df_read(ftmap_t input_ftmap[N0][H][W], hls::stream<df_input_t> &output)
+{
+	for (long it = 0; it < (long) H*W; it++) {
+		HLS_PRAGMA(HLS PIPELINE II=1)
+		df_read_iteration(input_ftmap, output, it);
+	}
+}
+
+template <int NIN, int NOUT, int K, bool RELU>
+static void df_conv(hls::stream<df_pixel_t<NIN> >  &input,
+                    hls::stream<df_pixel_t<NOUT> > &output,
+                    param_t                         weights[NOUT][NIN][K][K],
+                    param_t                         biases[NOUT])
+{
+	static df_pixel_t<NIN> lines[K][W];     // line buffer of the last K input rows
+	for (long it = 0; it < df_iterations<K>(); it++) {
+		HLS_PRAGMA(HLS PIPELINE)
+		df_conv_iteration<NIN, NOUT, K, RELU>(input, output, lines, weights, biases, it);
+	}
+}
+
+static void df_write(hls::stream<df_output_t> &input, ftmap_t output_ftmap[N3][H][W])
+{
+	for (long it = 0; it < (long) H*W; it++) {
+		HLS_PRAGMA(HLS PIPELINE II=1)
+		df_write_iteration(input, output_ftmap, it);
+	}
+}
+
+// implements end-to-end SRCNN as a dataflow pipeline
+//
+// The layers run as concurrent processes linked by FIFOs of pixels (all
+// features of one pixel per token) in raster order: conv1 and conv3 keep
+// line buffers of F1 and F3 input rows, conv2 (1x1) keeps nothing, so the
+// layers overlap in hardware and no feature map is ever stored whole. In C
+// simulation the processes run one after the other over unbounded FIFOs.
+void srcnn_dataflow(ftmap_t input_ftmap[N0][H][W],
+                    param_t conv1_weights[N1][N0][F1][F1],
+                    param_t conv1_biases[N1],
+                    param_t conv2_weights[N2][N1][F2][F2],
+                    param_t conv2_biases[N2],
+                    param_t conv3_weights[N3][N2][F3][F3],
+                    param_t conv3_biases[N3],
+                    ftmap_t output_ftmap[N3][H][W])
+{
+	HLS_PRAGMA(HLS DATAFLOW)
+
+	hls::stream<df_input_t>  input("input");
+	hls::stream<df_layer1_t> layer1("layer1");
+	hls::stream<df_layer2_t> layer2("layer2");
+	hls::stream<df_output_t> output("output");
+	HLS_PRAGMA(HLS STREAM variable=layer1 depth=2)
+	HLS_PRAGMA(HLS STREAM variable=layer2 depth=2)
+
+	df_read(input_ftmap, input);
+	df_conv<N0, N1, F1, true>(input, layer1, conv1_weights, conv1_biases);
+	df_conv<N1, N2, F2, true>(layer1, layer2, conv2_weights, conv2_biases);
+	df_conv<N2, N3, F3, true>(layer2, output, conv3_weights, conv3_biases);
+	df_write(output, output_ftmap);
+}
+
+#ifndef __SYNTHESIS__
+
+static const char *srcnn_df_stage_names[SRCNN_DF_STAGES] = {
+	"read", "conv1", "conv2", "conv3", "write",
+};
+
+const char *srcnn_df_stage_name(srcnn_df_stage_id_t stage)
+{
+	return stage >= 0 && stage < SRCNN_DF_STAGES ? srcnn_df_stage_names[stage] : "unknown";
+}
+
+srcnn_df_config_t srcnn_df_balanced_config(int macs_per_cycle,
+                                           int depth)
+{
+	const long macs[3] = { (long) N1*N0*F1*F1, (long) N2*N1*F2*F2, (long) N3*N2*F3*F3 };
+	long total = macs[0] + macs[1] + macs[2];
+
+	srcnn_df_config_t config;
+	config.ii[SRCNN_DF_READ] = 1;
+	config.ii[SRCNN_DF_WRITE] = 1;
+	for (int l = 0; l < 3; l++) {
+		long units = macs_per_cycle*macs[l]/total;
+		units = units < 1 ? 1 : units;
+		config.ii[SRCNN_DF_CONV1 + l] = (int) ((macs[l] + units - 1)/units);
+	}
+	for (int f = 0; f < SRCNN_DF_FIFOS; f++)
+		config.depth[f] = depth;
+	return config;
+}
+
+void srcnn_dataflow_profile(ftmap_t                  input_ftmap[N0][H][W],
+                            param_t                  conv1_weights[N1][N0][F1][F1],
+                            param_t                  conv1_biases[N1],
+                            param_t                  conv2_weights[N2][N1][F2][F2],
+                            param_t                  conv2_biases[N2],
+                            param_t                  conv3_weights[N3][N2][F3][F3],
+                            param_t                  conv3_biases[N3],
+                            ftmap_t                  output_ftmap[N3][H][W],
+                            const srcnn_df_config_t *config,
+                            srcnn_df_profile_t      *profile)
+{
+	hls::stream<df_input_t>  input("input");
+	hls::stream<df_layer1_t> layer1("layer1");
+	hls::stream<df_layer2_t> layer2("layer2");
+	hls::stream<df_output_t> output("output");
+	std::vector<df_input_t>  lines1((size_t) F1*W);
+	std::vector<df_layer1_t> lines2((size_t) F2*W);
+	std::vector<df_layer2_t> lines3((size_t) F3*W);
+
+	const long iterations[SRCNN_DF_STAGES] = {
+		(long) H*W, df_iterations<F1>(), df_iterations<F2>(), df_iterations<F3>(), (long) H*W,
+	};
+	size_t occupancy[SRCNN_DF_FIFOS];
+	double occupancy_sum[SRCNN_DF_FIFOS] = {};
+	long it[SRCNN_DF_STAGES] = {};
+	long next[SRCNN_DF_STAGES] = {};    // earliest cycle of the next iteration
+	auto measure = [&]() {
+		occupancy[0] = input.size();
+		occupancy[1] = layer1.size();
+		occupancy[2] = layer2.size();
+		occupancy[3] = output.size();
+	};
+
+	*profile = srcnn_df_profile_t();
+	long cycle = 0;
+	for (; it[SRCNN_DF_WRITE] < iterations[SRCNN_DF_WRITE]; cycle++) {
+
+		// downstream first, so a token written this cycle is read the next
+		// one while space freed this cycle can be refilled right away
+		for (int s = SRCNN_DF_STAGES - 1; s >= 0; s--) {
+			if (it[s] == iterations[s] || cycle < next[s])
+				continue;
+
+			bool reads = false, writes = false;
+			switch (s) {
+			case SRCNN_DF_READ:  writes = true; break;
+			case SRCNN_DF_CONV1: reads = df_reads<F1>(it[s]); writes = df_writes<F1>(it[s]); break;
+			case SRCNN_DF_CONV2: reads = df_reads<F2>(it[s]); writes = df_writes<F2>(it[s]); break;
+			case SRCNN_DF_CONV3: reads = df_reads<F3>(it[s]); writes = df_writes<F3>(it[s]); break;
+			case SRCNN_DF_WRITE: reads = true; break;
+			}
+			measure();
+
+			srcnn_df_stage_t &stage = profile->stage[s];
+			if (reads && occupancy[s - 1] == 0) {
+				stage.starved++;
+				continue;
+			}
+			if (writes && occupancy[s] >= (size_t) config->depth[s]) {
+				stage.blocked++;
+				continue;
+			}
+
+			switch (s) {
+			case SRCNN_DF_READ:
+				df_read_iteration(input_ftmap, input, it[s]);
+				break;
+			case SRCNN_DF_CONV1:
+				df_conv_iteration<N0, N1, F1, true>(input, layer1, (df_input_t (*)[W]) &lines1[0],
+				                                    conv1_weights, conv1_biases, it[s]);
+				break;
+			case SRCNN_DF_CONV2:
+				df_conv_iteration<N1, N2, F2, true>(layer1, layer2, (df_layer1_t (*)[W]) &lines2[0],
+				                                    conv2_weights, conv2_biases, it[s]);
+				break;
+			case SRCNN_DF_CONV3:
+				df_conv_iteration<N2, N3, F3, true>(layer2, output, (df_layer2_t (*)[W]) &lines3[0],
+				                                     conv3_weights, conv3_biases, it[s]);
+				break;
+			case SRCNN_DF_WRITE:
+				df_write_iteration(output, output_ftmap, it[s]);
+				break;
+			}
+			if (it[s] == 0)
+				stage.first = cycle;
+			stage.last = cycle;
+			next[s] = cycle + config->ii[s];
+			it[s]++;
+		}
+
+		measure();
+		for (int f = 0; f < SRCNN_DF_FIFOS; f++) {
+			srcnn_df_fifo_t &fifo = profile->fifo[f];
+			occupancy_sum[f] += occupancy[f];
+			fifo.max = (int) occupancy[f] > fifo.max ? (int) occupancy[f] : fifo.max;
+			fifo.full += occupancy[f] >= (size_t) config->depth[f];
+		}
+	}
+
+	// a stage can start the next frame once its loop is done, so the
+	// longest loop, stalls included, bounds the frame interval
+	profile->latency = cycle;
+	for (int s = 0; s < SRCNN_DF_STAGES; s++) {
+		srcnn_df_stage_t &stage = profile->stage[s];
+		stage.iterations = iterations[s];
+		long span = stage.last - stage.first + config->ii[s];
+		if (span > profile->interval) {
+			profile->interval = span;
+			profile->bottleneck = s;
+		}
+	}
+	for (int f = 0; f < SRCNN_DF_FIFOS; f++) {
+		profile->fifo[f].tokens = (long) H*W;
+		profile->fifo[f].mean = occupancy_sum[f]/cycle;
+	}
+}
+
+#endif
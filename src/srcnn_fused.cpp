@@ -0,0 +1,60 @@
+#include "srcnn.h"
+
+// edge-extended row index
+static int clamp_row(int y)
+{
+	return y < 0 ? 0 : (y > H - 1 ? H - 1 : y);
+}
+
+// implements end-to-end SRCNN as a fused row-streaming pipeline
+//
+// conv1 and conv2 rows are produced only when conv3's F3-row window (and
+// conv2's F2-row window) first needs them, and are kept in rolling line
+// buffers indexed by (row % depth). Every output pixel is computed by the
+// same row kernels as the layer-by-layer path, so results are bit-identical
+// to srcnn(), while the working set drops from two full feature maps
+// (~25 MB) to (F2*N1 + F3*N2) rows of W floats (~228 KB).
+void srcnn_fused(ftmap_t input_ftmap[N0][H][W],
+                 param_t conv1_weights[N1][N0][F1][F1],
+                 param_t conv1_biases[N1],
+                 param_t conv2_weights[N2][N1][F2][F2],
+                 param_t conv2_biases[N2],
+                 param_t conv3_weights[N3][N2][F3][F3],
+                 param_t conv3_biases[N3],
+                 ftmap_t output_ftmap[N3][H][W])
+{
+	static ftmap_t layer1_lines[F2][N1][W];  // rolling window of conv1 output rows
+	static ftmap_t layer2_lines[F3][N2][W];  // rolling window of conv2 output rows
+
+	ftmap_t *conv2_rows[F2];
+	ftmap_t *conv3_rows[F3];
+
+	int layer1_next = 0;  // next conv1 row to produce
+	int layer2_next = 0;  // next conv2 row to produce
+
+	for (int out_feat_y = 0; out_feat_y < H; out_feat_y++) {
+
+		// produce the conv2 rows needed by conv3's window around out_feat_y
+		int layer2_last = clamp_row(out_feat_y + F3/2);
+		while (layer2_next <= layer2_last) {
+
+			// produce the conv1 rows needed by conv2's window around layer2_next
+			int layer1_last = clamp_row(layer2_next + F2/2);
+			while (layer1_next <= layer1_last) {
+				conv1_row(input_ftmap, conv1_weights, conv1_biases, layer1_next,
+				          &layer1_lines[layer1_next % F2][0][0], W);
+				layer1_next++;
+			}
+
+			for (int kernel_y = 0; kernel_y < F2; kernel_y++)
+				conv2_rows[kernel_y] = &layer1_lines[clamp_row(layer2_next + kernel_y - F2/2) % F2][0][0];
+			conv2_row(conv2_rows, W, conv2_weights, conv2_biases,
+			          &layer2_lines[layer2_next % F3][0][0], W);
+			layer2_next++;
+		}
+
+		for (int kernel_y = 0; kernel_y < F3; kernel_y++)
+			conv3_rows[kernel_y] = &layer2_lines[clamp_row(out_feat_y + kernel_y - F3/2) % F3][0][0];
+		conv3_row(conv3_rows, W, conv3_weights, conv3_biases, &output_ftmap[0][out_feat_y][0], H*W);
+	}
+}
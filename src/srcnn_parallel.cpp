@@ -0,0 +1,42 @@
+#include "kernels.h"
+#include "thread_pool.h"
+
+// task granularity: output rows per band and output features per block
+#define PARALLEL_BAND_ROWS  8
+#define PARALLEL_FEAT_BLOCK 8
+
+// arguments shared by the tasks of one conv_parallel() call
+struct conv_parallel_job_t {
+    const conv_layer_t *layer;
+    ftmap_view_t        input;
+    ftmap_view_t        output;
+    int                 h;
+    int                 w;
+    int                 feat_blocks;
+};
+
+// Each output element is written by exactly one task with the same kernel as
+// the serial path, so the result does not depend on scheduling or thread
+// count. Bands read their F/2-row halo straight from the complete input map.
+void conv_parallel(thread_pool        &pool,
+                   const conv_layer_t *layer,
+                   ftmap_view_t        input,
+                   ftmap_view_t        output,
+                   int                 h,
+                   int                 w)
+{
+    int feat_blocks = (layer->nout + PARALLEL_FEAT_BLOCK - 1)/PARALLEL_FEAT_BLOCK;
+    int bands = (h + PARALLEL_BAND_ROWS - 1)/PARALLEL_BAND_ROWS;
+    conv_parallel_job_t job = { layer, input, output, h, w, feat_blocks };
+
+    // capturing a single pointer keeps the std::function from allocating
+    const conv_parallel_job_t *args = &job;
+    pool.parallel_for(feat_blocks*bands, [args](int task) {
+        const conv_layer_t *layer = args->layer;
+        int f0 = task%args->feat_blocks*PARALLEL_FEAT_BLOCK;
+        int f1 = f0 + PARALLEL_FEAT_BLOCK < layer->nout ? f0 + PARALLEL_FEAT_BLOCK : layer->nout;
+        int y0 = task/args->feat_blocks*PARALLEL_BAND_ROWS;
+        int y1 = y0 + PARALLEL_BAND_ROWS < args->h ? y0 + PARALLEL_BAND_ROWS : args->h;
+        conv_direct(layer, args->input, args->h, args->w, args->output, f0, f1, y0, y1, 0, args->w);
+    });
+}
@@ -0,0 +1,262 @@
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "stream.h"
+#include "spsc_queue.h"
+
+static const char *srcnn_stream_stage_names[SRCNN_STREAM_STAGES] = {
+    "read",
+    "infer",
+    "write",
+};
+
+const char *srcnn_stream_stage_name(srcnn_stream_stage_id_t stage)
+{
+    return stage >= 0 && stage < SRCNN_STREAM_STAGES ? srcnn_stream_stage_names[stage] : "unknown";
+}
+
+// a frame buffer on its way between two stages; the end of the stream is a
+// frame without data
+struct stream_frame_t {
+    ftmap_t *data;
+    long     index;
+};
+
+// one link between two stages: full frames go downstream, emptied buffers
+// come back upstream. Each queue can hold every buffer plus the end marker,
+// so pushes never wait.
+struct stream_link_t {
+    spsc_queue<stream_frame_t> full;
+    spsc_queue<stream_frame_t> empty;
+
+    explicit stream_link_t(int depth) : full(depth + 1), empty(depth) {}
+};
+
+// a stage that finds its queue empty sleeps on wake; pushes only take the
+// lock to notify while some stage is asleep
+struct stream_state_t {
+    std::atomic<bool>       abort;      // set by the first stage to fail
+    std::atomic<int>        sleeping;   // stages waiting on wake
+    std::mutex              lock;
+    std::condition_variable wake;
+    std::exception_ptr      error[SRCNN_STREAM_STAGES];
+};
+
+typedef std::chrono::steady_clock stream_clock;
+
+static double elapsed_ms(stream_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(stream_clock::now() - start).count();
+}
+
+static void stream_wake(stream_state_t *state)
+{
+    std::lock_guard<std::mutex> hold(state->lock);
+    state->wake.notify_all();
+}
+
+// pops from queue, sleeping as long as it is empty so a waiting stage leaves
+// the core to the others. The wait is added to *wait_ms; returns false if
+// the stream is aborted.
+static bool stream_pop(spsc_queue<stream_frame_t> &queue,
+                       stream_frame_t             *frame,
+                       stream_state_t             *state,
+                       double                     *wait_ms,
+                       long                       *stalls)
+{
+    if (queue.try_pop(frame))
+        return true;
+    stream_clock::time_point start = stream_clock::now();
+    (*stalls)++;
+    bool popped;
+    {
+        // counted as sleeping before the queue is checked again under the
+        // lock, so a push either lands before that check or sees the count
+        std::unique_lock<std::mutex> hold(state->lock);
+        state->sleeping.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!(popped = queue.try_pop(frame)) && !state->abort.load())
+            state->wake.wait(hold);
+        state->sleeping.fetch_sub(1);
+    }
+    *wait_ms += elapsed_ms(start);
+    return popped;
+}
+
+static void stream_push(spsc_queue<stream_frame_t> &queue, const stream_frame_t &frame,
+                        stream_state_t *state)
+{
+    if (!queue.try_push(frame))
+        throw std::logic_error("SRCNN stream queue overflow");
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (state->sleeping.load())
+        stream_wake(state);
+}
+
+// reads frames, normalizing u8 pixels to [0, 1] as load_image() does
+static void stream_read(FILE *input, long pixels, stream_link_t *out,
+                        stream_state_t *state, srcnn_stream_stage_t *stats)
+{
+    std::vector<uint8_t> bytes(pixels);
+    for (long index = 0;; index++) {
+        stream_frame_t frame;
+        if (!stream_pop(out->empty, &frame, state, &stats->blocked_ms, &stats->stalls))
+            return;
+
+        stream_clock::time_point start = stream_clock::now();
+        size_t got = fread(&bytes[0], 1, pixels, input);
+        if (got != (size_t) pixels) {
+            // end the stream either way, so the frames read so far get written
+            stats->busy_ms += elapsed_ms(start);
+            frame.data = NULL;
+            stream_push(out->full, frame, state);
+            if (ferror(input))
+                throw std::runtime_error("Cannot read SRCNN stream input");
+            if (got != 0)
+                throw std::runtime_error("SRCNN stream input ends in a partial frame");
+            return;
+        }
+        for (long i = 0; i < pixels; i++)
+            frame.data[i] = (ftmap_t) (((float) bytes[i])/255);
+        frame.index = index;
+        stats->frames++;
+        stats->busy_ms += elapsed_ms(start);
+        stream_push(out->full, frame, state);
+    }
+}
+
+static void stream_infer(srcnn_ctx_t *ctx, stream_link_t *in, stream_link_t *out,
+                         stream_state_t *state, srcnn_stream_stage_t *stats)
+{
+    for (;;) {
+        stream_frame_t frame, result;
+        if (!stream_pop(in->full, &frame, state, &stats->starved_ms, &stats->stalls))
+            return;
+        if (!frame.data) {
+            stream_push(out->full, frame, state);
+            return;
+        }
+        if (!stream_pop(out->empty, &result, state, &stats->blocked_ms, &stats->stalls))
+            return;
+
+        stream_clock::time_point start = stream_clock::now();
+        srcnn_ctx_run(ctx, frame.data, result.data);
+        result.index = frame.index;
+        stats->frames++;
+        stats->busy_ms += elapsed_ms(start);
+        stream_push(in->empty, frame, state);
+        stream_push(out->full, result, state);
+    }
+}
+
+// quantizes frames to u8 (truncating value*255, saturated) and writes them
+static void stream_write(FILE *output, long pixels, stream_link_t *in,
+                         stream_state_t *state, srcnn_stream_stage_t *stats)
+{
+    std::vector<uint8_t> bytes(pixels);
+    for (;;) {
+        stream_frame_t frame;
+        if (!stream_pop(in->full, &frame, state, &stats->starved_ms, &stats->stalls))
+            return;
+        if (!frame.data)
+            return;
+
+        stream_clock::time_point start = stream_clock::now();
+        if (output) {
+            for (long i = 0; i < pixels; i++) {
+                float v = (float) frame.data[i]*255;
+                bytes[i] = (uint8_t) (v < 0 ? 0 : (v > 255 ? 255 : v));
+            }
+            if (fwrite(&bytes[0], 1, pixels, output) != (size_t) pixels)
+                throw std::runtime_error("Cannot write SRCNN stream output");
+        }
+        stats->frames++;
+        stats->busy_ms += elapsed_ms(start);
+        stream_push(in->empty, frame, state);
+    }
+}
+
+// runs one stage, turning its exception into an abort of the others; the
+// reader has already ended the stream when it fails, so the frames before
+// the error still drain
+template <typename F>
+static void stream_stage(stream_state_t *state, srcnn_stream_stage_id_t id, F body)
+{
+    try {
+        body();
+    } catch (...) {
+        state->error[id] = std::current_exception();
+        if (id != SRCNN_STREAM_READ) {
+            state->abort.store(true);
+            stream_wake(state);
+        }
+    }
+}
+
+void srcnn_stream_run(const srcnn_model_t  *model,
+                      int                   h,
+                      int                   w,
+                      srcnn_mode_t          mode,
+                      FILE                 *input,
+                      FILE                 *output,
+                      int                   depth,
+                      srcnn_stream_stats_t *stats,
+                      thread_pool          *pool)
+{
+    if (!input || depth < 1)
+        throw std::runtime_error("Invalid SRCNN stream input or depth");
+
+    long pixels = (long) h*w;
+    srcnn_ctx_t *ctx = srcnn_ctx_create(model, h, w, mode, pool);
+
+    // depth input and depth output frames, in one allocation
+    std::vector<ftmap_t> buffers((size_t) 2*depth*pixels);
+    stream_link_t decoded(depth), upscaled(depth);
+    for (int i = 0; i < depth; i++) {
+        stream_frame_t in = { &buffers[(size_t) i*pixels], -1 };
+        stream_frame_t out = { &buffers[(size_t) (depth + i)*pixels], -1 };
+        decoded.empty.try_push(in);
+        upscaled.empty.try_push(out);
+    }
+
+    srcnn_stream_stats_t local = {};
+    stream_state_t state;
+    state.abort.store(false);
+    state.sleeping.store(0);
+
+    stream_clock::time_point start = stream_clock::now();
+    std::thread reader([&]() {
+        stream_stage(&state, SRCNN_STREAM_READ, [&]() {
+            stream_read(input, pixels, &decoded, &state, &local.stage[SRCNN_STREAM_READ]);
+        });
+    });
+    std::thread writer([&]() {
+        stream_stage(&state, SRCNN_STREAM_WRITE, [&]() {
+            stream_write(output, pixels, &upscaled, &state, &local.stage[SRCNN_STREAM_WRITE]);
+        });
+    });
+    stream_stage(&state, SRCNN_STREAM_INFER, [&]() {
+        stream_infer(ctx, &decoded, &upscaled, &state, &local.stage[SRCNN_STREAM_INFER]);
+    });
+    reader.join();
+    writer.join();
+    srcnn_ctx_destroy(ctx);
+
+    local.frames = local.stage[SRCNN_STREAM_WRITE].frames;
+    local.seconds = elapsed_ms(start)/1000;
+    local.fps = local.seconds > 0 ? local.frames/local.seconds : 0;
+    if (stats)
+        *stats = local;
+
+    for (int s = 0; s < SRCNN_STREAM_STAGES; s++)
+        if (state.error[s])
+            std::rethrow_exception(state.error[s]);
+}
@@ -0,0 +1,65 @@
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include <stdio.h>
+
+#include "srcnn.h"
+#include "engine.h"
+
+// Video streaming: upscales a raw sequence of u8 Y-plane frames (h x w bytes
+// each, back to back, no header) read from a file or pipe, frame by frame,
+// into the same format. Three stages run on their own threads:
+//
+//   read   reads a frame and normalizes it to [0, 1] floats
+//   infer  runs a srcnn_ctx_t on it
+//   write  quantizes the output to u8 (as test/util's ftmap_to_u8) and writes it
+//
+// Each pair of stages passes frame buffers through a bounded lock-free SPSC
+// queue and gets them back through another, so with depth buffers per link
+// (2: double buffering) a stage works on one frame while its neighbours
+// fill or drain the others, and reading and writing overlap inference.
+
+enum srcnn_stream_stage_id_t {
+    SRCNN_STREAM_READ = 0,
+    SRCNN_STREAM_INFER,
+    SRCNN_STREAM_WRITE,
+    SRCNN_STREAM_STAGES
+};
+
+// short lower-case name of a stage ("read", "infer", "write")
+const char *srcnn_stream_stage_name(srcnn_stream_stage_id_t stage);
+
+// time a stage spent working and waiting. starved_ms waits for a frame from
+// the stage before; blocked_ms waits for a free buffer the stage after has
+// not handed back yet (backpressure). stalls counts waits of either kind.
+struct srcnn_stream_stage_t {
+    long   frames;
+    double busy_ms;
+    double starved_ms;
+    double blocked_ms;
+    long   stalls;
+};
+
+struct srcnn_stream_stats_t {
+    long                 frames;
+    double               seconds;   // wall time from the first read to the last write
+    double               fps;       // sustained frames per second
+    srcnn_stream_stage_t stage[SRCNN_STREAM_STAGES];
+};
+
+// streams every frame of input to output (NULL discards the frames) with
+// depth buffers per link, through a context of the given mode; pool is
+// passed to srcnn_ctx_create(). Throws std::runtime_error on invalid
+// arguments, read or write errors, or a trailing partial frame. A read
+// error still writes the frames before it; other errors stop every stage.
+void srcnn_stream_run(const srcnn_model_t  *model,
+                      int                   h,
+                      int                   w,
+                      srcnn_mode_t          mode,
+                      FILE                 *input,
+                      FILE                 *output,
+                      int                   depth = 2,
+                      srcnn_stream_stats_t *stats = NULL,
+                      thread_pool          *pool = NULL);
+
+#endif /* _STREAM_H_ */
@@ -0,0 +1,69 @@
+#ifndef _STREAM_COMPAT_H_
+#define _STREAM_COMPAT_H_
+
+// hls::stream for the dataflow implementation (srcnn_dataflow.cpp). Vitis
+// HLS synthesis and C simulation use the real one; plain g++ builds without
+// the Vitis headers get the software stand-in below, which follows the C
+// simulation semantics: an unbounded FIFO whose writes never block, where
+// reading an empty stream is an error (C simulation would hang instead).
+#if !defined(__SYNTHESIS__) && defined(__has_include)
+#if !__has_include(<hls_stream.h>)
+#define STREAM_COMPAT_SOFTWARE
+#endif
+#endif
+
+#ifndef STREAM_COMPAT_SOFTWARE
+#include <hls_stream.h>
+#else
+#include <stddef.h>
+
+#include <deque>
+#include <stdexcept>
+#include <string>
+
+namespace hls {
+
+template <typename T>
+class stream {
+public:
+	stream() : name_("stream") {}
+	explicit stream(const char *name) : name_(name) {}
+
+	stream(const stream &) = delete;
+	stream &operator=(const stream &) = delete;
+
+	bool   empty() const { return fifo_.empty(); }
+	bool   full() const { return false; }
+	size_t size() const { return fifo_.size(); }
+
+	void write(const T &value) { fifo_.push_back(value); }
+	bool write_nb(const T &value) { write(value); return true; }
+	void operator<<(const T &value) { write(value); }
+
+	T read()
+	{
+		if (fifo_.empty())
+			throw std::runtime_error("Read from empty stream " + name_);
+		T value = fifo_.front();
+		fifo_.pop_front();
+		return value;
+	}
+	void read(T &value) { value = read(); }
+	void operator>>(T &value) { value = read(); }
+	bool read_nb(T &value)
+	{
+		if (fifo_.empty())
+			return false;
+		value = read();
+		return true;
+	}
+
+private:
+	std::string   name_;
+	std::deque<T> fifo_;
+};
+
+} // namespace hls
+#endif
+
+#endif /* _STREAM_COMPAT_H_ */
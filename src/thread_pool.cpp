@@ -0,0 +1,152 @@
+#include <stdlib.h>
+
+#include "thread_pool.h"
+
+// pool whose tasks the calling thread is running, and its index there, so a
+// nested parallel_for() on that pool runs inline instead of deadlocking
+static thread_local const thread_pool *task_pool = NULL;
+static thread_local int task_worker = 0;
+
+thread_pool::thread_pool(int threads)
+    : generation_(0), stop_(false)
+{
+    if (threads <= 0)
+        threads = (int) std::thread::hardware_concurrency();
+    if (threads <= 0)
+        threads = 1;
+
+    queues_.resize(threads);
+    for (int i = 1; i < threads; i++)
+        workers_.emplace_back(&thread_pool::worker, this, i);
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread &t : workers_)
+        t.join();
+}
+
+// own deque is LIFO for locality, other deques are robbed FIFO
+bool thread_pool::pop(int self, task_t *task)
+{
+    int n = size();
+    for (int i = 0; i < n; i++) {
+        queue_t &q = queues_[(self + i)%n];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (q.head == q.tasks.size())
+            continue;
+        if (i == 0) {
+            *task = q.tasks.back();
+            q.tasks.pop_back();
+        } else {
+            *task = q.tasks[q.head++];
+        }
+        return true;
+    }
+    return false;
+}
+
+void thread_pool::run(int self)
+{
+    const thread_pool *outer_pool = task_pool;
+    int outer_worker = task_worker;
+    task_pool = this;
+    task_worker = self;
+
+    task_t task;
+    while (pop(self, &task)) {
+        // an exception must not skip the count below, the caller's round
+        // would be unwound while other threads still run its tasks
+        try {
+            (*task.fn)(task.index, self);
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(task.round->lock);
+            if (!task.round->error)
+                task.round->error = std::current_exception();
+        }
+        if (task.round->pending.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> guard(lock_);
+            done_.notify_all();
+        }
+    }
+
+    task_pool = outer_pool;
+    task_worker = outer_worker;
+}
+
+void thread_pool::worker(int self)
+{
+    unsigned seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+            wake_.wait(guard, [&] { return stop_ || generation_ != seen; });
+            if (stop_)
+                return;
+            seen = generation_;
+        }
+        run(self);
+    }
+}
+
+void thread_pool::parallel_for(int count, const std::function<void(int)> &task)
+{
+    // the wrapper only captures a pointer, so it does not allocate either
+    const std::function<void(int)> *fn = &task;
+    parallel_for_worker(count, [fn](int index, int) { (*fn)(index); });
+}
+
+void thread_pool::parallel_for_worker(int count, const std::function<void(int, int)> &task)
+{
+    if (count <= 0)
+        return;
+
+    // called from one of our own tasks: the other threads may all be busy
+    // with the outer round, and submit_lock_ is held by it
+    if (task_pool == this) {
+        for (int i = 0; i < count; i++)
+            task(i, task_worker);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit(submit_lock_);
+    round_t round;
+    round.pending.store(count);
+
+    // tasks carry their own function and round, so a worker that is late
+    // leaving the previous round can never run them against stale state
+    int n = size();
+    for (int q = 0; q < n; q++) {
+        std::lock_guard<std::mutex> guard(queues_[q].lock);
+        queues_[q].tasks.clear();
+        queues_[q].head = 0;
+        for (int i = q; i < count; i += n)
+            queues_[q].tasks.push_back(task_t { &task, i, &round });
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        generation_++;
+    }
+    wake_.notify_all();
+
+    run(0);
+
+    {
+        std::unique_lock<std::mutex> guard(lock_);
+        done_.wait(guard, [&] { return round.pending.load() == 0; });
+    }
+    if (round.error)
+        std::rethrow_exception(round.error);
+}
+
+thread_pool &thread_pool_default()
+{
+    static thread_pool pool(getenv("SRCNN_THREADS") ? atoi(getenv("SRCNN_THREADS")) : 0);
+    return pool;
+}
@@ -0,0 +1,85 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// reusable work-stealing thread pool
+//
+// parallel_for() deals the task indices round-robin onto one queue per
+// thread (the calling thread owns queue 0 and works too). Each thread pops
+// from the back of its own queue and, once that is empty, steals from the
+// front of the others, so uneven tasks (e.g. border bands) balance out.
+// Queues keep their capacity between rounds, so after the first call
+// parallel_for() does not allocate. If tasks throw, the remaining tasks
+// still run and parallel_for() rethrows the first exception on the caller.
+class thread_pool {
+public:
+    // threads <= 0 uses every hardware thread
+    explicit thread_pool(int threads = 0);
+    ~thread_pool();
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    // number of threads running tasks, including the caller
+    int size() const { return (int) queues_.size(); }
+
+    // runs task(i) for every i in [0, count) and returns when all are done.
+    // A call made from inside a task of this pool does not fan out again: it
+    // runs its tasks in order on the calling thread.
+    void parallel_for(int count, const std::function<void(int)> &task);
+
+    // as parallel_for(), also passing the index in [0, size()) of the thread
+    // running each task, e.g. to pick per-thread scratch buffers (a nested
+    // call passes the index of the outer task, whose scratch it shares)
+    void parallel_for_worker(int count, const std::function<void(int task, int worker)> &task);
+
+private:
+    // state of one parallel_for() call, on its caller's stack
+    struct round_t {
+        std::atomic<int>    pending;    // tasks not finished yet
+        std::mutex          lock;       // guards error
+        std::exception_ptr  error;      // first exception a task threw
+    };
+
+    struct task_t {
+        const std::function<void(int, int)> *fn;
+        int                              index;
+        round_t                         *round;
+    };
+
+    // tasks [head, tasks.size()) are still to run
+    struct queue_t {
+        std::mutex           lock;
+        std::vector<task_t>  tasks;
+        size_t               head;
+
+        queue_t() : head(0) {}
+    };
+
+    bool pop(int self, task_t *task);
+    void run(int self);
+    void worker(int self);
+
+    std::vector<std::thread>  workers_;
+    std::deque<queue_t>       queues_;
+    std::mutex                lock_;        // guards generation_ and stop_
+    std::condition_variable   wake_;
+    std::condition_variable   done_;
+    unsigned                  generation_;
+    bool                      stop_;
+    std::mutex                submit_lock_; // one parallel_for at a time
+};
+
+// process-wide pool sized by the SRCNN_THREADS environment variable
+// (default: every hardware thread), created on first use
+thread_pool &thread_pool_default();
+
+#endif /* _THREAD_POOL_H_ */
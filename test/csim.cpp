@@ -1,6 +1,25 @@
 // top-level C simulation file to run SRCNN testbenches
 void tb_conv1();
 void tb_srcnn();
+void tb_fused();
+void tb_gemm();
+void tb_fft();
+void tb_layout();
+void tb_simd();
+void tb_parallel();
+void tb_context();
+void tb_tiled();
+void tb_quant();
+void tb_half();
+void tb_sparse();
+void tb_stream();
+void tb_incremental();
+void tb_adaptive();
+void tb_color();
+void tb_dataflow();
+void tb_metrics();
+void tb_model();
+void tb_io();
 void tb_set14();
 
 int main()
@@ -8,6 +27,25 @@ int main()
     // run SRCNN testbenches
     tb_conv1();
     tb_srcnn();
+    tb_fused();
+    tb_gemm();
+    tb_fft();
+    tb_layout();
+    tb_simd();
+    tb_parallel();
+    tb_context();
+    tb_tiled();
+    tb_quant();
+    tb_half();
+    tb_sparse();
+    tb_stream();
+    tb_incremental();
+    tb_adaptive();
+    tb_color();
+    tb_dataflow();
+    tb_metrics();
+    tb_model();
+    tb_io();
 
     // uncomment to run set14 tests
     tb_set14();
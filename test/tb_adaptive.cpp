@@ -0,0 +1,164 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <chrono>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "util.h"
+
+using namespace std;
+
+#define ADAPTIVE_IMAGES 13
+#define ADAPTIVE_BUDGET 0.05    // PSNR loss (dB) of the suggested operating point
+#define ADAPTIVE_RUNS 5         // timed passes over the sweep, each image scored by its best
+
+static const char *adaptive_images[ADAPTIVE_IMAGES] = {
+    "baboon", "barbara", "bridge", "coastguard", "face", "flowers", "foreman",
+    "lenna", "man", "monarch", "pepper", "ppt3", "zebra",
+};
+
+// deviation thresholds of the sweep, 0 computes every block
+static const float adaptive_flat[] = { 0, 0.002f, 0.004f, 0.008f, 0.016f, 0.032f, 0.064f };
+
+#define ADAPTIVE_STEPS ((int) (sizeof(adaptive_flat)/sizeof(adaptive_flat[0])))
+
+ftmap_t img_LR_adaptive[ADAPTIVE_IMAGES][N0][H][W];  // Set14 inputs (bicubic upscaled)
+ftmap_t img_GT_adaptive[ADAPTIVE_IMAGES][N3][H][W];  // Set14 ground truth
+ftmap_t img_HR_tiled_adaptive[N3][H][W];             // tiled output
+ftmap_t img_HR_adaptive[N3][H][W];                   // adaptive output
+
+// time in ms of one run of ctx
+static double adaptive_time(srcnn_ctx_t *ctx, const ftmap_t *input, ftmap_t *output)
+{
+    auto start = chrono::steady_clock::now();
+    srcnn_ctx_run(ctx, input, output);
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// content-adaptive testbench and tuner: sweeps the flat-block threshold of
+// the adaptive mode on Set14 and reports the computed area, the throughput
+// and the PSNR lost against computing every block, then suggests the
+// largest threshold within ADAPTIVE_BUDGET dB. Each timed pass runs the
+// tiled mode and every threshold on each image in turn, so a slow spell of
+// the machine hits all of them, and each image counts its best pass.
+int tb_adaptive()
+{
+    const srcnn_model_t *model = test_model();
+
+    double bicubic_psnr = 0;
+    for (int i = 0; i < ADAPTIVE_IMAGES; i++) {
+        load_image(string("./set14/") + adaptive_images[i] + "_3x_LR_u8.bin", &img_LR_adaptive[i][0][0][0], N0*H*W);
+        load_image(string("./set14/") + adaptive_images[i] + "_3x_GT_u8.bin", &img_GT_adaptive[i][0][0][0], N3*H*W);
+        bicubic_psnr += calculate_PSNR(&img_GT_adaptive[i][0][0][0], &img_LR_adaptive[i][0][0][0], H*W)/ADAPTIVE_IMAGES;
+    }
+
+    cout << "***** SRCNN Content-Adaptive Skipping *****" << endl;
+
+    // the tiled mode on every image is the baseline
+    srcnn_ctx_t *tiled = srcnn_ctx_create(model, H, W, SRCNN_MODE_TILED);
+    srcnn_ctx_t *ctx = srcnn_ctx_create(model, H, W, SRCNN_MODE_ADAPTIVE);
+    double tiled_psnr = 0;
+    bool exact = true;
+    for (int i = 0; i < ADAPTIVE_IMAGES; i++) {
+        srcnn_ctx_run(tiled, &img_LR_adaptive[i][0][0][0], &img_HR_tiled_adaptive[0][0][0]);
+        tiled_psnr += calculate_PSNR(&img_GT_adaptive[i][0][0][0], &img_HR_tiled_adaptive[0][0][0], H*W)/ADAPTIVE_IMAGES;
+
+        // threshold 0 computes every block exactly as the tiled mode does
+        srcnn_ctx_run(ctx, &img_LR_adaptive[i][0][0][0], &img_HR_adaptive[0][0][0]);
+        exact = exact && srcnn_ctx_recomputed(ctx) == 1 &&
+                memcmp(img_HR_adaptive, img_HR_tiled_adaptive, sizeof(img_HR_adaptive)) == 0;
+    }
+
+    // best time of each image in the tiled mode (step -1) and at each step
+    vector<double> best_ms((size_t) (ADAPTIVE_STEPS + 1)*ADAPTIVE_IMAGES, 0);
+    for (int r = 0; r < ADAPTIVE_RUNS; r++)
+        for (int i = 0; i < ADAPTIVE_IMAGES; i++)
+            for (int s = -1; s < ADAPTIVE_STEPS; s++) {
+                double ms;
+                if (s < 0) {
+                    ms = adaptive_time(tiled, &img_LR_adaptive[i][0][0][0], &img_HR_tiled_adaptive[0][0][0]);
+                } else {
+                    srcnn_ctx_set_flat(ctx, adaptive_flat[s]);
+                    ms = adaptive_time(ctx, &img_LR_adaptive[i][0][0][0], &img_HR_adaptive[0][0][0]);
+                }
+                double &best = best_ms[(size_t) (s + 1)*ADAPTIVE_IMAGES + i];
+                best = r == 0 || ms < best ? ms : best;
+            }
+    double tiled_ms = 0;
+    for (int i = 0; i < ADAPTIVE_IMAGES; i++)
+        tiled_ms += best_ms[i];
+    srcnn_ctx_destroy(tiled);
+    cout << "  - Set14 mean PSNR: bicubic " << bicubic_psnr << " dB, tiled " << tiled_psnr << " dB in "
+         << tiled_ms << " ms, " << ADAPTIVE_IMAGES*1000/tiled_ms << " images/s" << endl;
+    cout << "  - Threshold 0 identical to the tiled mode: " << (exact ? "yes" : "NO") << endl;
+
+    // the sweep
+    cout << "  " << setw(11) << left << "Threshold"
+         << setw(11) << left << "Computed"
+         << setw(11) << left << "ppt3"
+         << setw(11) << left << "face"
+         << setw(12) << left << "Mean PSNR"
+         << setw(12) << left << "Loss (dB)"
+         << setw(12) << left << "Time (ms)"
+         << setw(10) << left << "Images/s"
+         << setw(10) << left << "Speed-up" << endl;
+    bool monotonic = true;
+    double last_computed = 2;
+    float suggested = 0;
+    double suggested_speedup = 1;
+    for (int s = 0; s < ADAPTIVE_STEPS; s++) {
+        srcnn_ctx_set_flat(ctx, adaptive_flat[s]);
+        double psnr = 0, ms = 0, computed = 0, ppt3 = 0, face = 0;
+        for (int i = 0; i < ADAPTIVE_IMAGES; i++) {
+            srcnn_ctx_run(ctx, &img_LR_adaptive[i][0][0][0], &img_HR_adaptive[0][0][0]);
+            ms += best_ms[(size_t) (s + 1)*ADAPTIVE_IMAGES + i];
+            psnr += calculate_PSNR(&img_GT_adaptive[i][0][0][0], &img_HR_adaptive[0][0][0], H*W)/ADAPTIVE_IMAGES;
+            double c = srcnn_ctx_recomputed(ctx);
+            computed += c/ADAPTIVE_IMAGES;
+            if (strcmp(adaptive_images[i], "ppt3") == 0)
+                ppt3 = c;
+            if (strcmp(adaptive_images[i], "face") == 0)
+                face = c;
+        }
+        double loss = tiled_psnr - psnr;
+        if (loss <= ADAPTIVE_BUDGET) {
+            suggested = adaptive_flat[s];
+            suggested_speedup = tiled_ms/ms;
+        }
+        monotonic = monotonic && computed <= last_computed;
+        last_computed = computed;
+
+        cout << "  " << setw(11) << left << adaptive_flat[s]
+             << setw(11) << left << computed
+             << setw(11) << left << ppt3
+             << setw(11) << left << face
+             << setw(12) << left << psnr
+             << setw(12) << left << round(loss*1e4)/1e4
+             << setw(12) << left << ms
+             << setw(10) << left << ADAPTIVE_IMAGES*1000/ms
+             << setw(10) << left << tiled_ms/ms << endl;
+    }
+    cout << "  - Suggested threshold for a " << ADAPTIVE_BUDGET << " dB budget: " << suggested
+         << " (speed-up " << suggested_speedup << ")" << endl;
+
+    // a flat image is passed through untouched
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++)
+            img_LR_adaptive[0][0][y][x] = 0.25f + 0.001f*((x + y) % 2);
+    srcnn_ctx_set_flat(ctx, 0.01f);
+    srcnn_ctx_run(ctx, &img_LR_adaptive[0][0][0][0], &img_HR_adaptive[0][0][0]);
+    bool passed = srcnn_ctx_recomputed(ctx) == 0 &&
+                  memcmp(img_HR_adaptive, img_LR_adaptive[0], sizeof(img_HR_adaptive)) == 0;
+    cout << "  - Flat image passed through: " << (passed ? "yes" : "NO") << endl;
+    srcnn_ctx_destroy(ctx);
+
+    bool ok = exact && monotonic && passed;
+    cout << "  - Within tolerance: " << (ok ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return ok ? 0 : 1;
+}
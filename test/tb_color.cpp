@@ -0,0 +1,222 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <chrono>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "kernels.h"
+#include "simd.h"
+#include "color.h"
+#include "util.h"
+
+using namespace std;
+
+#define COLOR_IMAGES 14
+#define COLOR_RUNS   3
+#define LH (H/UP)           // low resolution height
+#define LW (W/UP)           // low resolution width
+
+// butterfly from Set5, then Set14
+static const char *color_images[COLOR_IMAGES] = {
+    "set5/butterfly",
+    "set14/baboon", "set14/barbara", "set14/bridge", "set14/coastguard", "set14/face",
+    "set14/flowers", "set14/foreman", "set14/lenna", "set14/man", "set14/monarch",
+    "set14/pepper", "set14/ppt3", "set14/zebra",
+};
+
+ftmap_t img_GT_color[N3][H][W];         // ground truth luma
+ftmap_t img_LR_color[N0][H][W];         // MATLAB bicubic upscaled luma
+ftmap_t img_HR_color[N3][H][W];         // luma of an output
+
+// cubic convolution kernel with a = -0.5
+static double color_cubic(double x)
+{
+    x = fabs(x);
+    if (x <= 1)
+        return (1.5*x - 2.5)*x*x + 1;
+    if (x < 2)
+        return ((-0.5*x + 2.5)*x - 4)*x + 2;
+    return 0;
+}
+
+static int color_mirror(int i, int n)
+{
+    int period = 2*n;
+    i %= period;
+    if (i < 0)
+        i += period;
+    return i < n ? i : period - 1 - i;
+}
+
+// separable resize of an h x w plane to oh x ow as imresize does, in double
+// precision: upscaling interpolates, downscaling widens the kernel by the
+// factor (antialiasing) and normalizes the taps
+static vector<double> color_resize(const vector<double> &in, int h, int w, int oh, int ow)
+{
+    vector<double> rows((size_t) oh*w), out((size_t) oh*ow);
+    for (int pass = 0; pass < 2; pass++) {
+        int n = pass ? w : h, on = pass ? ow : oh, lines = pass ? oh : w;
+        double s = (double) on/n, k = s < 1 ? s : 1;
+        for (int o = 0; o < on; o++) {
+            double u = (o + 0.5)/s - 0.5, sum = 0;
+            vector<pair<int, double>> taps;
+            for (int j = (int) floor(u - 2/k); j <= (int) ceil(u + 2/k); j++) {
+                double wt = color_cubic(k*(u - j));
+                taps.push_back(make_pair(color_mirror(j, n), wt));
+                sum += wt;
+            }
+            for (int l = 0; l < lines; l++) {
+                double acc = 0;
+                for (const pair<int, double> &t : taps)
+                    acc += t.second/sum*(pass ? rows[(long) l*w + t.first] : in[(long) t.first*w + l]);
+                (pass ? out[(long) l*ow + o] : rows[(long) o*w + l]) = acc;
+            }
+        }
+    }
+    return out;
+}
+
+// bicubic_upscale() against color_resize() on the current ISA
+static double upscale_error(int h, int w, int scale)
+{
+    vector<double> ref((size_t) h*w);
+    vector<ftmap_t> in((size_t) h*w), out((size_t) h*scale*w*scale);
+    for (long i = 0; i < (long) h*w; i++)
+        ref[i] = in[i] = (ftmap_t) ((i*73) % 256)/255;
+    vector<double> expected = color_resize(ref, h, w, h*scale, w*scale);
+    bicubic_upscale(&in[0], h, w, scale, &out[0]);
+
+    double err = 0;
+    for (size_t i = 0; i < out.size(); i++)
+        err = max(err, fabs(out[i] - expected[i]));
+    return err;
+}
+
+static uint8_t color_u8(double v)
+{
+    v = floor(v*255 + 0.5);
+    return (uint8_t) (v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// best of runs wall-clock milliseconds of body
+template <typename B>
+static double best_ms(B body)
+{
+    double best = 1e30;
+    for (int r = 0; r < COLOR_RUNS; r++) {
+        auto start = chrono::steady_clock::now();
+        body();
+        best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+// colour front / back end testbench: the SIMD bicubic upscaler against a
+// double precision imresize on every ISA and against the MATLAB-made Set14
+// inputs, then raw low-resolution RGB images through srcnn_color_run()
+// against the same steps run one after the other, with the luma quality
+int tb_color()
+{
+    const srcnn_model_t *model = test_model();
+
+    cout << "***** SRCNN Colour Front / Back End *****" << endl;
+
+    // the upscaler on every ISA, on unaligned and tiny sizes too
+    simd_isa_t isa = simd_isa();
+    double upscale_err = 0;
+    for (int i = 0; i <= simd_detect(); i++) {
+        simd_set_isa((simd_isa_t) i);
+        for (int scale : { 2, 3, 4 })
+            upscale_err = max(upscale_err, max(max(upscale_error(LH, LW, scale), upscale_error(7, 5, scale)),
+                                               upscale_error(1, 3, scale)));
+    }
+    simd_set_isa(isa);
+    cout << "  - Bicubic upscale max error against imresize on every ISA: " << upscale_err << endl;
+
+    // the ground truth luma downscaled and upscaled as the Set14 inputs were
+    double matlab_psnr = 0;
+    long matlab_same = 0;
+    vector<double> plane((size_t) H*W);
+    vector<ftmap_t> small((size_t) LH*LW);
+    for (int i = 0; i < COLOR_IMAGES; i++) {
+        load_image(string("./") + color_images[i] + "_3x_GT_u8.bin", &img_GT_color[0][0][0], N3*H*W);
+        load_image(string("./") + color_images[i] + "_3x_LR_u8.bin", &img_LR_color[0][0][0], N0*H*W);
+        for (long p = 0; p < (long) H*W; p++)
+            plane[p] = (&img_GT_color[0][0][0])[p];
+        vector<double> down = color_resize(plane, H, W, LH, LW);
+        for (long p = 0; p < (long) LH*LW; p++)
+            small[p] = (ftmap_t) color_u8(down[p])/255;
+        bicubic_upscale(&small[0], LH, LW, UP, &img_HR_color[0][0][0]);
+        for (long p = 0; p < (long) H*W; p++) {
+            uint8_t v = color_u8((&img_HR_color[0][0][0])[p]);
+            matlab_same += v == (uint8_t) ((&img_LR_color[0][0][0])[p]*255 + 0.5f);
+            (&img_HR_color[0][0][0])[p] = (ftmap_t) v/255;
+        }
+        matlab_psnr += calculate_PSNR(&img_LR_color[0][0][0], &img_HR_color[0][0][0], H*W)/COLOR_IMAGES;
+    }
+    double matlab_share = (double) matlab_same/((long) COLOR_IMAGES*H*W);
+    cout << "  - Against the MATLAB bicubic inputs: mean PSNR " << matlab_psnr << " dB, "
+         << matlab_share*100 << "% of the pixels identical" << endl;
+
+    // colour images: the ground truth luma with smooth synthetic chroma,
+    // downscaled per RGB channel to the raw low-resolution input
+    srcnn_color_t *color = srcnn_color_create(model, LH, LW);
+    srcnn_ctx_t *ctx = srcnn_ctx_create(model, H, W, SRCNN_MODE_SIMD);
+    vector<ftmap_t> cb((size_t) H*W), cr((size_t) H*W), y_small((size_t) LH*LW), c_small((size_t) 2*LH*LW);
+    vector<ftmap_t> y_large((size_t) H*W), c_large((size_t) 2*H*W), gt_y((size_t) H*W), out_cb((size_t) H*W);
+    vector<uint8_t> rgb_gt((size_t) 3*H*W), rgb_lr((size_t) 3*LH*LW), rgb_hr((size_t) 3*H*W),
+                    rgb_serial((size_t) 3*H*W);
+    bool identical = true;
+    double sr_psnr = 0, bicubic_psnr = 0, serial_ms = 0, color_ms = 0;
+    for (int i = 0; i < COLOR_IMAGES; i++) {
+        load_image(string("./") + color_images[i] + "_3x_GT_u8.bin", &img_GT_color[0][0][0], N3*H*W);
+        for (int y = 0; y < H; y++)
+            for (int x = 0; x < W; x++) {
+                cb[(long) y*W + x] = (ftmap_t) ((128 + 40*sin(0.02*x + i))/255);
+                cr[(long) y*W + x] = (ftmap_t) ((128 + 40*cos(0.03*y - i))/255);
+            }
+        ycbcr_to_rgb(&img_GT_color[0][0][0], &cb[0], &cr[0], (long) H*W, &rgb_gt[0]);
+        for (int c = 0; c < 3; c++) {
+            for (long p = 0; p < (long) H*W; p++)
+                plane[p] = rgb_gt[3*p + c]/255.0;
+            vector<double> down = color_resize(plane, H, W, LH, LW);
+            for (long p = 0; p < (long) LH*LW; p++)
+                rgb_lr[3*p + c] = color_u8(down[p]);
+        }
+        rgb_to_ycbcr(&rgb_gt[0], (long) H*W, &gt_y[0], &cb[0], &cr[0]);
+
+        // the steps one after the other
+        serial_ms += best_ms([&]() {
+            rgb_to_ycbcr(&rgb_lr[0], (long) LH*LW, &y_small[0], &c_small[0], &c_small[LH*LW]);
+            bicubic_upscale(&y_small[0], LH, LW, UP, &y_large[0]);
+            bicubic_upscale(&c_small[0], LH, LW, UP, &c_large[0]);
+            bicubic_upscale(&c_small[LH*LW], LH, LW, UP, &c_large[H*W]);
+            srcnn_ctx_run(ctx, &y_large[0], &img_HR_color[0][0][0]);
+            ycbcr_to_rgb(&img_HR_color[0][0][0], &c_large[0], &c_large[H*W], (long) H*W, &rgb_serial[0]);
+        });
+        color_ms += best_ms([&]() {
+            srcnn_color_run(color, &rgb_lr[0], &rgb_hr[0]);
+        });
+        identical = identical && rgb_hr == rgb_serial;
+
+        bicubic_psnr += calculate_PSNR(&gt_y[0], &y_large[0], H*W)/COLOR_IMAGES;
+        rgb_to_ycbcr(&rgb_hr[0], (long) H*W, &img_HR_color[0][0][0], &out_cb[0], &cr[0]);
+        sr_psnr += calculate_PSNR(&gt_y[0], &img_HR_color[0][0][0], H*W)/COLOR_IMAGES;
+    }
+    srcnn_color_destroy(color);
+    srcnn_ctx_destroy(ctx);
+    cout << "  - RGB " << LH << "x" << LW << " to " << H << "x" << W << ": serial " << serial_ms/COLOR_IMAGES
+         << " ms, overlapped " << color_ms/COLOR_IMAGES << " ms per image" << endl;
+    cout << "  - Output identical to the serial steps: " << (identical ? "yes" : "NO") << endl;
+    cout << "  - Mean luma PSNR: bicubic " << bicubic_psnr << " dB, SRCNN " << sr_psnr << " dB" << endl;
+
+    bool ok = upscale_err < 1e-5 && matlab_psnr > 40 && identical && sr_psnr > bicubic_psnr;
+    cout << "  - Within tolerance: " << (ok ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return ok ? 0 : 1;
+}
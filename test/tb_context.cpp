@@ -0,0 +1,126 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <thread>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "util.h"
+
+using namespace std;
+
+// cropped image size, deliberately not a multiple of any band or block size
+#define CROP_H 100
+#define CROP_W 77
+
+ftmap_t img_LR_context[2][N0][H][W];        // two low resolution input images
+ftmap_t img_HR_ref_context[2][N3][H][W];    // srcnn() outputs
+ftmap_t img_HR_seq_context[2][N3][H][W];    // one context, images in turn
+ftmap_t img_HR_rerun_context[N3][H][W];     // same context, first image again
+ftmap_t img_HR_conc_context[2][N3][H][W];   // two contexts on two threads
+ftmap_t img_crop_context[N0][CROP_H][CROP_W];
+ftmap_t img_crop_ref_context[N3][CROP_H][CROP_W];
+ftmap_t img_crop_HR_context[N3][CROP_H][CROP_W];
+
+// returns the largest absolute difference between two feature maps
+static double max_abs_diff(ftmap_t *a, ftmap_t *b, int count)
+{
+    double diff = 0;
+    for (int i = 0; i < count; i++)
+        diff = fmax(diff, fabs((double) a[i] - b[i]));
+    return diff;
+}
+
+// inference context testbench: workspace reuse, concurrent contexts and
+// runtime image sizes for every engine mode
+int tb_context()
+{
+    const test_params_t &params = test_params();
+    load_image("./set5/butterfly_3x_LR_u8.bin", &img_LR_context[0][0][0][0], N0*H*W);
+    load_image("./set14/baboon_3x_LR_u8.bin", &img_LR_context[1][0][0][0], N0*H*W);
+
+    for (int i = 0; i < 2; i++)
+        srcnn(img_LR_context[i],
+              params.conv1_weights, params.conv1_biases,
+              params.conv2_weights, params.conv2_biases,
+              params.conv3_weights, params.conv3_biases,
+              img_HR_ref_context[i]);
+
+    for (int y = 0; y < CROP_H; y++)
+        for (int x = 0; x < CROP_W; x++)
+            img_crop_context[0][y][x] = img_LR_context[0][0][y][x];
+
+    const srcnn_model_t *model = test_model();
+
+    // the reference context at the cropped size is the baseline for the others
+    srcnn_ctx_t *crop_ref = srcnn_ctx_create(model, CROP_H, CROP_W, SRCNN_MODE_REFERENCE);
+    srcnn_ctx_run(crop_ref, &img_crop_context[0][0][0], &img_crop_ref_context[0][0][0]);
+    srcnn_ctx_destroy(crop_ref);
+
+    cout << "***** SRCNN Inference Contexts *****" << endl;
+    cout << "  " << setw(13) << left << "Mode"
+         << setw(16) << left << "Workspace (KB)"
+         << setw(8) << left << "Reuse"
+         << setw(12) << left << "Concurrent"
+         << setw(16) << left << "Max err"
+         << setw(16) << left << "Crop max err" << endl;
+
+    bool ok = true;
+    for (int m = 0; m < SRCNN_MODE_COUNT; m++) {
+        srcnn_mode_t mode = (srcnn_mode_t) m;
+
+        // one context, reused for both images
+        srcnn_ctx_t *ctx = srcnn_ctx_create(model, H, W, mode);
+        for (int i = 0; i < 2; i++)
+            srcnn_ctx_run(ctx, &img_LR_context[i][0][0][0], &img_HR_seq_context[i][0][0][0]);
+        srcnn_ctx_run(ctx, &img_LR_context[0][0][0][0], &img_HR_rerun_context[0][0][0]);
+        bool reuse = memcmp(img_HR_rerun_context, img_HR_seq_context[0], sizeof(img_HR_rerun_context)) == 0;
+        srcnn_ctx_destroy(ctx);
+
+        // one context per thread, both running at the same time
+        srcnn_ctx_t *ctxs[2];
+        thread threads[2];
+        for (int i = 0; i < 2; i++) {
+            ctxs[i] = srcnn_ctx_create(model, H, W, mode);
+            threads[i] = thread(srcnn_ctx_run, ctxs[i],
+                                &img_LR_context[i][0][0][0], &img_HR_conc_context[i][0][0][0]);
+        }
+        for (int i = 0; i < 2; i++) {
+            threads[i].join();
+            srcnn_ctx_destroy(ctxs[i]);
+        }
+        bool concurrent = memcmp(img_HR_conc_context, img_HR_seq_context, sizeof(img_HR_seq_context)) == 0;
+
+        // runtime image size
+        ctx = srcnn_ctx_create(model, CROP_H, CROP_W, mode);
+        srcnn_ctx_run(ctx, &img_crop_context[0][0][0], &img_crop_HR_context[0][0][0]);
+        srcnn_ctx_destroy(ctx);
+
+        double err = fmax(max_abs_diff(&img_HR_seq_context[0][0][0][0], &img_HR_ref_context[0][0][0][0], N3*H*W),
+                          max_abs_diff(&img_HR_seq_context[1][0][0][0], &img_HR_ref_context[1][0][0][0], N3*H*W));
+        double crop_err = max_abs_diff(&img_crop_HR_context[0][0][0], &img_crop_ref_context[0][0][0], N3*CROP_H*CROP_W);
+
+        cout << "  " << setw(13) << left << srcnn_mode_name(mode)
+             << setw(16) << left << srcnn_workspace_bytes(H, W, mode)/1024
+             << setw(8) << left << (reuse ? "yes" : "NO")
+             << setw(12) << left << (concurrent ? "yes" : "NO")
+             << setw(16) << left << err
+             << setw(16) << left << crop_err << endl;
+
+        // the scalar modes are exact, the others only differ by FMA rounding,
+        // or by the rounding of their 16-bit maps (see tb_half)
+        double tolerance = mode == SRCNN_MODE_REFERENCE || mode == SRCNN_MODE_FUSED ? 0 : 1e-4;
+        if (mode == SRCNN_MODE_FP16)
+            tolerance = 2e-3;
+        if (mode == SRCNN_MODE_BF16)
+            tolerance = 2e-2;
+        ok = ok && reuse && concurrent && err <= tolerance && crop_err <= tolerance;
+    }
+
+    cout << "  - All modes consistent: " << (ok ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return ok ? 0 : 1;
+}
@@ -2,6 +2,7 @@
 #include <string>
 
 #include "srcnn.h"
+#include "kernels.h"
 #include "util.h"
 
 using namespace std;
@@ -9,6 +10,7 @@ using namespace std;
 ftmap_t input_ftmap[N0][H][W];    // low resolution input image
 ftmap_t output_ftmap[N1][H][W];   // output feature map
 ftmap_t golden_ftmap[N1][H][W];   // golden reference output feature map
+ftmap_t gemm_ftmap[N1][H][W];     // implicit GEMM output feature map
 
 // parameter dimensions
 //   weights: output features x input features x kernel height x kernel width
@@ -47,8 +49,19 @@ int tb_conv1()
                                &output_ftmap[0][0][0],
                                N1*H*W);
     
+    // apply implicit GEMM conv1 to the same input
+    conv1_gemm(&input_ftmap[0][0][0],
+               &weights[0][0][0][0],
+               biases,
+               H, W,
+               &gemm_ftmap[0][0][0]);
+    double mse_gemm = calculate_mse(&golden_ftmap[0][0][0],
+                                    &gemm_ftmap[0][0][0],
+                                    N1*H*W);
+
     cout << "***** CONV1 Golden Reference *****" << endl;
     cout << "  - Butterfly MSE: " << mse << endl;
+    cout << "  - Butterfly MSE (gemm): " << mse_gemm << endl;
     cout << endl;
     return 0;
 }
@@ -0,0 +1,145 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <stdexcept>
+
+#include "srcnn.h"
+#include "dataflow.h"
+#include "stream_compat.h"
+#include "util.h"
+
+using namespace std;
+
+// floating-point multiply-accumulate units of a Kria K26 (xck26): 1248
+// DSP48E2 slices at 5 per single-precision MAC (3 for fmul, 2 for fadd)
+#define DF_K26_MACS  (1248/5)
+#define DF_CLOCK_MHZ 300
+
+ftmap_t img_LR_df[N0][H][W];        // low resolution input image
+ftmap_t img_HR_df[N3][H][W];        // dataflow output
+ftmap_t img_HR_layered_df[N3][H][W];// layer-by-layer output
+ftmap_t img_HR_profile_df[N3][H][W];// output of the throughput model
+ftmap_t img_GR_df[N3][H][W];        // high-resolution golden reference
+
+// srcnn_dataflow() and srcnn() on image, bit for bit
+static bool dataflow_matches(ftmap_t image[N0][H][W])
+{
+    const test_params_t &params = test_params();
+    srcnn_dataflow(image,
+                   params.conv1_weights, params.conv1_biases,
+                   params.conv2_weights, params.conv2_biases,
+                   params.conv3_weights, params.conv3_biases,
+                   img_HR_df);
+    srcnn(image,
+          params.conv1_weights, params.conv1_biases,
+          params.conv2_weights, params.conv2_biases,
+          params.conv3_weights, params.conv3_biases,
+          img_HR_layered_df);
+    return memcmp(img_HR_df, img_HR_layered_df, sizeof(img_HR_df)) == 0;
+}
+
+// runs the throughput model of config, prints its estimate and checks the
+// output and the FIFO bounds
+static bool profile_config(const char *name, const srcnn_df_config_t &config, srcnn_df_profile_t &profile)
+{
+    const test_params_t &params = test_params();
+    srcnn_dataflow_profile(img_LR_df,
+                           params.conv1_weights, params.conv1_biases,
+                           params.conv2_weights, params.conv2_biases,
+                           params.conv3_weights, params.conv3_biases,
+                           img_HR_profile_df, &config, &profile);
+
+    double ms = profile.interval/(DF_CLOCK_MHZ*1e3);
+    cout << "  - " << name << ": interval " << profile.interval << " cycles (" << ms << " ms, "
+         << 1000/ms << " fps at " << DF_CLOCK_MHZ << " MHz), latency " << profile.latency
+         << " cycles, bottleneck " << srcnn_df_stage_name((srcnn_df_stage_id_t) profile.bottleneck) << endl;
+    for (int s = 0; s < SRCNN_DF_STAGES; s++) {
+        const srcnn_df_stage_t &stage = profile.stage[s];
+        cout << "      " << setw(7) << left << srcnn_df_stage_name((srcnn_df_stage_id_t) s)
+             << "II " << setw(4) << left << config.ii[s]
+             << "loop " << setw(9) << left << stage.iterations*config.ii[s]
+             << "starved " << setw(9) << left << stage.starved
+             << "blocked " << setw(9) << left << stage.blocked;
+        if (s < SRCNN_DF_FIFOS) {
+            const srcnn_df_fifo_t &fifo = profile.fifo[s];
+            cout << "FIFO depth " << config.depth[s] << ", max " << fifo.max
+                 << ", mean " << fifo.mean << ", full " << fifo.full << " cycles";
+        }
+        cout << endl;
+    }
+
+    // no stage can beat its own loop, and no FIFO exceeds its depth
+    bool ok = memcmp(img_HR_profile_df, img_HR_df, sizeof(img_HR_df)) == 0;
+    for (int s = 0; s < SRCNN_DF_STAGES; s++)
+        ok = ok && profile.interval >= profile.stage[s].iterations*config.ii[s];
+    for (int f = 0; f < SRCNN_DF_FIFOS; f++)
+        ok = ok && profile.fifo[f].max <= config.depth[f] && profile.fifo[f].tokens == (long) H*W;
+    return ok;
+}
+
+// SRCNN dataflow pipeline testbench: srcnn_dataflow() against the golden
+// reference and srcnn(), then its throughput model on the K26 budget, with
+// deeper FIFOs, and with unlimited MAC units
+int tb_dataflow()
+{
+    string fname_LR = "./set5/butterfly_3x_LR_u8.bin";
+    string fname_GR = "./set5/butterfly_3x_GR_flp.bin";
+
+    // a step edge and a 2-pixel checkerboard drive conv3 below zero, which
+    // natural images such as butterfly never do
+    cout << "***** SRCNN Dataflow Pipeline *****" << endl;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++)
+            img_LR_df[0][y][x] = x < W/2 ? 0.0f : 1.0f;
+    bool edges = dataflow_matches(img_LR_df);
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++)
+            img_LR_df[0][y][x] = (x/2 + y/2) % 2 ? 1.0f : 0.0f;
+    edges = dataflow_matches(img_LR_df) && edges;
+    cout << "  - Bit-identical to layer-by-layer on a step edge and a checkerboard: "
+         << (edges ? "yes" : "NO") << endl;
+
+    // leaves the butterfly output in img_HR_df for the throughput model
+    load_image(fname_LR, &img_LR_df[0][0][0], N0*H*W);
+    bool identical = dataflow_matches(img_LR_df);
+    load_ftmap(fname_GR, &img_GR_df[0][0][0], N3*H*W);
+
+    double mse = calculate_mse(&img_GR_df[0][0][0], &img_HR_df[0][0][0], N3*H*W);
+    cout << "  - Butterfly MSE: " << mse << endl;
+    cout << "  - Bit-identical to layer-by-layer: " << (identical ? "yes" : "NO") << endl;
+    identical = identical && edges;
+
+#ifdef STREAM_COMPAT_SOFTWARE
+    // the stand-in reports a read the producers never wrote
+    hls::stream<int> fifo("fifo");
+    fifo.write(1);
+    bool underflow = false;
+    try {
+        fifo.read();
+        fifo.read();
+    } catch (const runtime_error &e) {
+        underflow = true;
+    }
+    cout << "  - Software stream stand-in, empty read rejected: " << (underflow ? "yes" : "NO") << endl;
+    identical = identical && underflow;
+#endif
+
+    srcnn_df_profile_t profile;
+    srcnn_df_config_t config = srcnn_df_balanced_config(DF_K26_MACS);
+    bool ok = profile_config("K26, FIFO depth 2", config, profile);
+    long k26_interval = profile.interval;
+
+    config = srcnn_df_balanced_config(DF_K26_MACS, 64);
+    ok = profile_config("K26, FIFO depth 64", config, profile) && ok;
+    ok = ok && profile.interval <= k26_interval;
+
+    config = srcnn_df_balanced_config(1 << 20);
+    ok = profile_config("Unlimited MACs", config, profile) && ok;
+
+    ok = ok && identical && mse < 1e-6;
+    cout << "  - Within tolerance: " << (ok ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return ok ? 0 : 1;
+}
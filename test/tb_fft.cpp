@@ -0,0 +1,158 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cmath>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "kernels.h"
+#include "simd.h"
+#include "util.h"
+
+using namespace std;
+
+#define CROP_Y0 37
+#define CROP_X0 101
+#define CROP_H  100
+#define CROP_W  77
+#define STRIP_Y0 100        // thin strip the FFT mode runs through GEMM
+#define STRIP_H  8
+#define STRIP_W  200
+
+ftmap_t img_LR_fft[N0][H][W];       // low resolution input image
+ftmap_t layer1_ref_fft[N1][H][W];   // reference conv1 output
+ftmap_t layer1_fft[N1][H][W];       // FFT conv1 output
+ftmap_t crop_ref_fft[N1][CROP_H][CROP_W];
+ftmap_t crop_fft[N1][CROP_H][CROP_W];
+ftmap_t strip_fft[N0][STRIP_H][STRIP_W];
+ftmap_t strip_ref_fft[N3][STRIP_H][STRIP_W];
+ftmap_t strip_HR_fft[N3][STRIP_H][STRIP_W];
+
+// returns the largest absolute difference between two feature maps
+static double max_abs_diff(ftmap_t *a, ftmap_t *b, int count)
+{
+    double diff = 0;
+    for (int i = 0; i < count; i++)
+        diff = fmax(diff, fabs((double) a[i] - b[i]));
+    return diff;
+}
+
+// best of runs wall-clock milliseconds
+static double best_ms(int runs, const function<void()> &body)
+{
+    double best = 1e30;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        body();
+        best = fmin(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+// FFT conv1 testbench: results against the reference loops on every ISA, the
+// FFT mode on a thin strip, where it picks GEMM, and the image sizes where the
+// FFT overtakes the direct and GEMM kernels
+int tb_fft()
+{
+    const srcnn_model_t *model = test_model();
+    const test_params_t &params = test_params();
+    load_image("./set5/butterfly_3x_LR_u8.bin", &img_LR_fft[0][0][0], N0*H*W);
+
+    conv1(img_LR_fft, params.conv1_weights, params.conv1_biases, layer1_ref_fft);
+
+    conv_layer_t layer1 = { N0, N1, F1, model->conv1_weights, model->conv1_biases };
+    vector<float> spectra(conv1_fft_spectra_size());
+    vector<float> workspace(conv1_fft_workspace_size());
+    conv1_fft_prepare(model->conv1_weights, &spectra[0]);
+
+    // a crop read through a strided view edge extends at the crop border
+    ftmap_view_t crop = { &img_LR_fft[0][CROP_Y0][CROP_X0], (long) H*W, W, 0, 0 };
+    conv_direct_scalar(&layer1, crop, CROP_H, CROP_W, ftmap_view(&crop_ref_fft[0][0][0], CROP_H, CROP_W),
+                       0, N1, 0, CROP_H, 0, CROP_W);
+
+    cout << "***** FFT Conv1 (" << CONV1_FFT_TILE << "x" << CONV1_FFT_TILE << " tiles, "
+         << conv1_fft_spectra_size()*sizeof(float)/1024 << " KB of spectra) *****" << endl;
+
+    simd_isa_t isa = simd_isa();
+    bool ok = true;
+    for (int i = 0; i <= simd_detect(); i++) {
+        simd_set_isa((simd_isa_t) i);
+        conv1_fft(ftmap_view(&img_LR_fft[0][0][0], H, W), &spectra[0], params.conv1_biases, H, W,
+                  ftmap_view(&layer1_fft[0][0][0], H, W), &workspace[0]);
+        conv1_fft(crop, &spectra[0], params.conv1_biases, CROP_H, CROP_W,
+                  ftmap_view(&crop_fft[0][0][0], CROP_H, CROP_W));
+        double err = max_abs_diff(&layer1_ref_fft[0][0][0], &layer1_fft[0][0][0], N1*H*W);
+        double crop_err = max_abs_diff(&crop_ref_fft[0][0][0], &crop_fft[0][0][0], N1*CROP_H*CROP_W);
+        cout << "  - " << setw(8) << left << simd_isa_name((simd_isa_t) i)
+             << "max err " << err << ", " << CROP_H << "x" << CROP_W << " crop " << crop_err << endl;
+        ok = ok && err <= 1e-5 && crop_err <= 1e-5;
+    }
+    simd_set_isa(isa);
+
+    // a strip read in place from the image, so strided, against the simd mode
+    for (int y = 0; y < STRIP_H; y++)
+        for (int x = 0; x < STRIP_W; x++)
+            strip_fft[0][y][x] = img_LR_fft[0][STRIP_Y0 + y][x];
+    srcnn_ctx_t *simd = srcnn_ctx_create(model, STRIP_H, STRIP_W, SRCNN_MODE_SIMD);
+    srcnn_ctx_run(simd, &strip_fft[0][0][0], &strip_ref_fft[0][0][0]);
+    srcnn_ctx_destroy(simd);
+    srcnn_ctx_t *fft = srcnn_ctx_create(model, STRIP_H, STRIP_W, SRCNN_MODE_FFT);
+    srcnn_ctx_run_strided(fft, &img_LR_fft[0][STRIP_Y0][0], W, &strip_HR_fft[0][0][0], STRIP_W);
+    srcnn_ctx_destroy(fft);
+    double strip_err = max_abs_diff(&strip_ref_fft[0][0][0], &strip_HR_fft[0][0][0], N3*STRIP_H*STRIP_W);
+    cout << "  - FFT mode on a " << STRIP_H << "x" << STRIP_W << " strip (conv1 by GEMM) max err " << strip_err << endl;
+    ok = ok && conv1_preferred(STRIP_H, STRIP_W) == CONV1_GEMM && strip_err <= 1e-4;
+
+    // crossover: conv1 time per kernel on strips and squares tiled from the input
+    const int sizes[][2] = { { 8, 255 }, { 16, 255 }, { 24, 24 }, { 32, 32 }, { 64, 64 }, { 96, 96 },
+                             { 128, 128 }, { 192, 192 }, { 255, 255 }, { 384, 384 }, { 512, 512 } };
+    vector<float> panels(conv1_gemm_weights_size());
+    conv_gemm_weights_t packed = conv1_gemm_pack(model->conv1_weights, &panels[0]);
+
+    cout << "  Crossover on " << simd_isa_name(isa) << " (best of runs, ms):" << endl;
+    cout << "  " << setw(10) << left << "Size"
+         << setw(10) << left << "direct"
+         << setw(10) << left << "gemm"
+         << setw(10) << left << "fft"
+         << setw(10) << left << "fastest"
+         << "preferred" << endl;
+    for (const int *size : sizes) {
+        int h = size[0];
+        int w = size[1];
+        vector<float> input((size_t) h*w);
+        vector<float> output((size_t) N1*h*w);
+        vector<float> scratch(conv1_gemm_workspace_size(h, w));
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++)
+                input[(size_t) y*w + x] = img_LR_fft[0][y % H][x % W];
+        ftmap_view_t in = ftmap_view(&input[0], h, w);
+        ftmap_view_t out = ftmap_view(&output[0], h, w);
+
+        int runs = (long) h*w <= 128*128 ? 7 : 3;
+        double ms[3] = {
+            best_ms(runs, [&]() { conv_direct(&layer1, in, h, w, out, 0, N1, 0, h, 0, w); }),
+            best_ms(runs, [&]() { conv1_gemm(&input[0], model->conv1_weights, model->conv1_biases,
+                                             h, w, &output[0], &scratch[0], &packed); }),
+            best_ms(runs, [&]() { conv1_fft(in, &spectra[0], params.conv1_biases, h, w, out, &workspace[0]); }),
+        };
+        const char *names[3] = { "direct", "gemm", "fft" };   // in conv1_kernel_t order
+        int fastest = 0;
+        for (int k = 1; k < 3; k++)
+            if (ms[k] < ms[fastest])
+                fastest = k;
+        cout << "  " << setw(10) << left << (to_string(h) + "x" + to_string(w))
+             << setw(10) << left << ms[0]
+             << setw(10) << left << ms[1]
+             << setw(10) << left << ms[2]
+             << setw(10) << left << names[fastest]
+             << names[conv1_preferred(h, w)] << endl;
+    }
+
+    cout << "  - Within tolerance: " << (ok ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "kernels.h"
+#include "simd.h"
+#include "util.h"
+
+using namespace std;
+
+ftmap_t img_LR_fused[N0][H][W];     // low resolution input image
+ftmap_t img_HR_fused[N3][H][W];     // fused pipeline output
+ftmap_t img_HR_layered[N3][H][W];   // layer-by-layer output
+ftmap_t img_GR_fused[N3][H][W];     // high-resolution golden reference
+ftmap_t img_HR_fused23[N3][H][W];   // conv2+conv3 fused per pixel
+
+// returns the largest absolute difference between two feature maps
+static double max_abs_diff(ftmap_t *a, ftmap_t *b, int count)
+{
+    double diff = 0;
+    for (int i = 0; i < count; i++)
+        diff = fmax(diff, fabs((double) a[i] - b[i]));
+    return diff;
+}
+
+// conv23_fused() against conv2 and conv3 run layer by layer on a crop of
+// h x w pixels at (y0, x0) of the conv1 map, on the current ISA
+static double fused23_crop_err(ftmap_t *layer1, int y0, int x0, int h, int w)
+{
+    const srcnn_model_t *model = test_model();
+    conv_layer_t layer2 = { N1, N2, F2, model->conv2_weights, model->conv2_biases };
+    conv_layer_t layer3 = { N2, N3, F3, model->conv3_weights, model->conv3_biases };
+    ftmap_view_t crop = { layer1 + (long) y0*W + x0, (long) H*W, W, 0, 0 };
+    vector<ftmap_t> map2((size_t) N2*h*w), layered((size_t) h*w), fused((size_t) h*w);
+
+    conv_direct(&layer2, crop, h, w, ftmap_view(&map2[0], h, w), 0, N2, 0, h, 0, w);
+    conv_direct(&layer3, ftmap_view(&map2[0], h, w), h, w, ftmap_view(&layered[0], h, w), 0, N3, 0, h, 0, w);
+    conv23_fused(crop, model->conv2_weights, model->conv2_biases,
+                 model->conv3_weights, model->conv3_biases, h, w, ftmap_view(&fused[0], h, w));
+    return max_abs_diff(&layered[0], &fused[0], h*w);
+}
+
+// SRCNN fused row-streaming pipeline testbench
+int tb_fused()
+{
+    string fname_LR = "./set5/butterfly_3x_LR_u8.bin";
+    string fname_GR = "./set5/butterfly_3x_GR_flp.bin";
+
+    load_image(fname_LR, &img_LR_fused[0][0][0], N0*H*W);
+    const test_params_t &params = test_params();
+
+    // run both pipelines on the same input
+    srcnn(img_LR_fused,
+          params.conv1_weights, params.conv1_biases,
+          params.conv2_weights, params.conv2_biases,
+          params.conv3_weights, params.conv3_biases,
+          img_HR_layered);
+    srcnn_fused(img_LR_fused,
+                params.conv1_weights, params.conv1_biases,
+                params.conv2_weights, params.conv2_biases,
+                params.conv3_weights, params.conv3_biases,
+                img_HR_fused);
+
+    load_ftmap(fname_GR, &img_GR_fused[0][0][0], N3*H*W);
+
+    double mse = calculate_mse(&img_GR_fused[0][0][0],
+                               &img_HR_fused[0][0][0],
+                               N3*H*W);
+    bool identical = memcmp(img_HR_fused, img_HR_layered, sizeof(img_HR_fused)) == 0;
+
+    cout << "***** SRCNN Fused Pipeline *****" << endl;
+    cout << "  - Butterfly MSE: " << mse << endl;
+    cout << "  - Bit-identical to layer-by-layer: " << (identical ? "yes" : "NO") << endl;
+
+    // conv2+conv3 fused per pixel, through the mode switch of srcnn_run()
+    srcnn_run(SRCNN_MODE_FUSED23, img_LR_fused,
+              params.conv1_weights, params.conv1_biases,
+              params.conv2_weights, params.conv2_biases,
+              params.conv3_weights, params.conv3_biases,
+              img_HR_fused23);
+    double err23 = max_abs_diff(&img_HR_layered[0][0][0], &img_HR_fused23[0][0][0], N3*H*W);
+
+    // every ISA on crops down to fewer rows than the ring holds
+    vector<ftmap_t> layer1((size_t) N1*H*W);
+    conv1(img_LR_fused, params.conv1_weights, params.conv1_biases, (ftmap_t (*)[H][W]) &layer1[0]);
+    const int crops[][4] = { { 0, 0, H, W }, { 37, 101, 100, 77 }, { 200, 3, 3, 19 }, { 11, 250, 1, 5 } };
+    simd_isa_t isa = simd_isa();
+    double crop_err = 0;
+    for (int i = 0; i <= simd_detect(); i++) {
+        simd_set_isa((simd_isa_t) i);
+        for (const int *c : crops)
+            crop_err = fmax(crop_err, fused23_crop_err(&layer1[0], c[0], c[1], c[2], c[3]));
+    }
+    simd_set_isa(isa);
+
+    size_t map2_bytes = (size_t) N2*H*W*sizeof(ftmap_t);
+    size_t ring_bytes = conv23_fused_workspace_size(W)*sizeof(float);
+    bool fused23_ok = err23 <= 1e-4 && crop_err <= 1e-5;
+    cout << "  - Fused conv2+conv3 max err: " << err23 << " end to end, " << crop_err
+         << " on crops; conv2 map of " << map2_bytes/1024 << " KB replaced by a "
+         << ring_bytes/1024 << " KB ring: " << (fused23_ok ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return identical && fused23_ok ? 0 : 1;
+}
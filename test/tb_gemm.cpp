@@ -0,0 +1,82 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+
+#include "srcnn.h"
+#include "kernels.h"
+#include "simd.h"
+#include "util.h"
+
+using namespace std;
+
+ftmap_t img_LR_gemm[N0][H][W];       // low resolution input image
+ftmap_t layer1_gemm[N1][H][W];       // conv1 output feeding conv2
+ftmap_t layer1_nhwc_gemm[H][W][N1];  // conv1 output, channel-last
+ftmap_t layer2_ref_gemm[N2][H][W];   // reference conv2 output
+ftmap_t layer2_gemm[N2][H][W];       // SGEMM conv2 output
+ftmap_t layer2_nhwc_gemm[H][W][N2];  // SGEMM conv2 output, channel-last
+ftmap_t layer1_out_gemm[N1][H][W];   // implicit GEMM conv1 output
+ftmap_t layer3_ref_gemm[N3][H][W];   // reference conv3 output
+ftmap_t layer3_gemm[N3][H][W];       // implicit GEMM conv3 output
+
+// GEMM-based conv layer testbench
+int tb_gemm()
+{
+    const test_params_t &params = test_params();
+    string fname_LR = "./set5/butterfly_3x_LR_u8.bin";
+
+    load_image(fname_LR, &img_LR_gemm[0][0][0], N0*H*W);
+
+    // bit-identity only holds for the portable micro-kernel (no FMA)
+    simd_isa_t isa = simd_isa();
+    simd_set_isa(SIMD_ISA_SCALAR);
+
+    conv1(img_LR_gemm, params.conv1_weights, params.conv1_biases, layer1_gemm);
+    conv2(layer1_gemm, params.conv2_weights, params.conv2_biases, layer2_ref_gemm);
+    conv3(layer2_ref_gemm, params.conv3_weights, params.conv3_biases, layer3_ref_gemm);
+
+    // implicit GEMM conv1
+    conv1_gemm(&img_LR_gemm[0][0][0],
+               &params.conv1_weights[0][0][0][0],
+               params.conv1_biases,
+               H, W,
+               &layer1_out_gemm[0][0][0]);
+    bool conv1_identical = memcmp(layer1_out_gemm, layer1_gemm, sizeof(layer1_gemm)) == 0;
+
+    // planar SGEMM
+    conv2_gemm(&layer1_gemm[0][0][0],
+               &params.conv2_weights[0][0][0][0],
+               params.conv2_biases,
+               H, W,
+               &layer2_gemm[0][0][0]);
+    bool conv2_identical = memcmp(layer2_gemm, layer2_ref_gemm, sizeof(layer2_gemm)) == 0;
+
+    // channel-last SGEMM
+    ftmap_to_nhwc(&layer1_gemm[0][0][0], N1, H, W, &layer1_nhwc_gemm[0][0][0]);
+    conv2_gemm_nhwc(&layer1_nhwc_gemm[0][0][0],
+                    &params.conv2_weights[0][0][0][0],
+                    params.conv2_biases,
+                    H, W,
+                    &layer2_nhwc_gemm[0][0][0]);
+    ftmap_to_nchw(&layer2_nhwc_gemm[0][0][0], N2, H, W, &layer2_gemm[0][0][0]);
+    bool conv2_nhwc_identical = memcmp(layer2_gemm, layer2_ref_gemm, sizeof(layer2_gemm)) == 0;
+
+    // implicit GEMM conv3
+    conv3_gemm(&layer2_ref_gemm[0][0][0],
+               &params.conv3_weights[0][0][0][0],
+               params.conv3_biases,
+               H, W,
+               &layer3_gemm[0][0][0]);
+    bool conv3_identical = memcmp(layer3_gemm, layer3_ref_gemm, sizeof(layer3_gemm)) == 0;
+
+    simd_set_isa(isa);
+
+    cout << "***** GEMM Conv Layers *****" << endl;
+    cout << "  - CONV1 implicit GEMM bit-identical: " << (conv1_identical ? "yes" : "NO") << endl;
+    cout << "  - CONV2 SGEMM (NCHW) bit-identical: " << (conv2_identical ? "yes" : "NO") << endl;
+    cout << "  - CONV2 SGEMM (NHWC) bit-identical: " << (conv2_nhwc_identical ? "yes" : "NO") << endl;
+    cout << "  - CONV3 implicit GEMM bit-identical: " << (conv3_identical ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return conv1_identical && conv2_identical && conv2_nhwc_identical && conv3_identical ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cmath>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "kernels.h"
+#include "simd.h"
+#include "util.h"
+
+using namespace std;
+
+#define HALF_IMAGES 14
+#define HALF_RUNS   5
+
+// butterfly from Set5, then Set14 in the order of the MATLAB tables
+static const char *half_images[HALF_IMAGES] = {
+    "set5/butterfly",
+    "set14/baboon", "set14/barbara", "set14/bridge", "set14/coastguard", "set14/face",
+    "set14/flowers", "set14/foreman", "set14/lenna", "set14/man", "set14/monarch",
+    "set14/pepper", "set14/ppt3", "set14/zebra",
+};
+
+// the engine modes compared, float blocked maps first
+static const srcnn_mode_t half_modes[3] = { SRCNN_MODE_BLOCKED, SRCNN_MODE_FP16, SRCNN_MODE_BF16 };
+
+ftmap_t img_LR_half[N0][H][W];          // low resolution input image
+ftmap_t img_GT_half[N3][H][W];          // ground truth
+ftmap_t layer1_ref_half[N1][H][W];      // reference conv1 output
+ftmap_t layer2_ref_half[N2][H][W];      // reference conv2 output
+ftmap_t img_HR_ref_half[N3][H][W];      // reference conv3 output
+ftmap_t img_HR_half[N3][H][W];          // output of each mode
+
+// largest difference between two feature maps relative to the largest
+// magnitude of the first
+static double max_rel_diff(const ftmap_t *ref, const ftmap_t *x, long count)
+{
+    double diff = 0, range = 0;
+    for (long i = 0; i < count; i++) {
+        diff = fmax(diff, fabs((double) ref[i] - x[i]));
+        range = fmax(range, fabs((double) ref[i]));
+    }
+    return range > 0 ? diff/range : diff;
+}
+
+// each layer with its 16-bit maps against the float reference on the
+// current ISA: inputs are the reference maps rounded to format, outputs are
+// widened back to planar float
+static double half_layer_err(ftmap_format_t format)
+{
+    const srcnn_model_t *model = test_model();
+    const ftmap_layout_t layout = FTMAP_NCHW16C;
+    long count1 = (long) N1*H*W, count2 = (long) N2*H*W;
+    vector<ftmap_t> blocked1(count1), blocked2(count2), planar1(count1), planar2(count2), out((size_t) N3*H*W);
+    vector<uint16_t> map1(count1), map2(count2);
+
+    conv1_layout(ftmap_view(&img_LR_half[0][0][0], H, W), model->conv1_weights, model->conv1_biases,
+                 H, W, &map1[0], layout, format);
+    ftmap_from_format(&map1[0], format, count1, &blocked1[0]);
+    ftmap_from_layout(&blocked1[0], layout, N1, H, W, &planar1[0]);
+    double err = max_rel_diff(&layer1_ref_half[0][0][0], &planar1[0], count1);
+
+    ftmap_to_layout(&layer1_ref_half[0][0][0], N1, H, W, layout, &blocked1[0]);
+    ftmap_to_format(&blocked1[0], count1, format, &map1[0]);
+    conv2_layout(&map1[0], layout, model->conv2_weights, model->conv2_biases,
+                 H, W, &map2[0], layout, format);
+    ftmap_from_format(&map2[0], format, count2, &blocked2[0]);
+    ftmap_from_layout(&blocked2[0], layout, N2, H, W, &planar2[0]);
+    err = fmax(err, max_rel_diff(&layer2_ref_half[0][0][0], &planar2[0], count2));
+
+    ftmap_to_layout(&layer2_ref_half[0][0][0], N2, H, W, layout, &blocked2[0]);
+    ftmap_to_format(&blocked2[0], count2, format, &map2[0]);
+    conv3_layout(&map2[0], layout, model->conv3_weights, model->conv3_biases,
+                 H, W, ftmap_view(&out[0], H, W), format);
+    return fmax(err, max_rel_diff(&img_HR_ref_half[0][0][0], &out[0], (long) N3*H*W));
+}
+
+// mixed-precision testbench: layers storing their maps as IEEE half or
+// bfloat16 on every ISA, and the PSNR and time they cost or save against
+// float maps on Set5 and Set14
+int tb_half()
+{
+    const test_params_t &params = test_params();
+
+    const srcnn_model_t *model = test_model();
+
+    load_image("./set5/butterfly_3x_LR_u8.bin", &img_LR_half[0][0][0], N0*H*W);
+    conv1(img_LR_half, params.conv1_weights, params.conv1_biases, layer1_ref_half);
+    conv2(layer1_ref_half, params.conv2_weights, params.conv2_biases, layer2_ref_half);
+    conv3(layer2_ref_half, params.conv3_weights, params.conv3_biases, img_HR_ref_half);
+
+    cout << "***** SRCNN Half-Precision Feature Maps *****" << endl;
+
+    // one rounding of a map costs 2^-11 (fp16) or 2^-8 (bf16) relative error;
+    // the tolerances leave room for the few roundings a layer adds up
+    const double tolerance[FTMAP_FORMAT_COUNT] = { 1e-5, 2e-3, 1.6e-2 };
+    simd_isa_t isa = simd_isa();
+    bool ok = true;
+    for (int i = 0; i <= simd_detect(); i++) {
+        simd_set_isa((simd_isa_t) i);
+        cout << "  - " << setw(8) << left << simd_isa_name((simd_isa_t) i) << "max rel err";
+        for (int f = FTMAP_FP16; f < FTMAP_FORMAT_COUNT; f++) {
+            double err = half_layer_err((ftmap_format_t) f);
+            cout << " " << ftmap_format_name((ftmap_format_t) f) << " " << err;
+            ok = ok && err <= tolerance[f];
+        }
+        cout << endl;
+    }
+    simd_set_isa(isa);
+    cout << "  - Conversions: f16c " << (simd_f16c() ? "yes" : "no")
+         << ", avx512bf16 " << (simd_bf16() ? "yes" : "no") << endl;
+
+    // PSNR of each mode against the ground truth
+    srcnn_ctx_t *ctxs[3];
+    for (int m = 0; m < 3; m++)
+        ctxs[m] = srcnn_ctx_create(model, H, W, half_modes[m]);
+
+    cout << "  " << setw(12) << left << "Image";
+    for (int m = 0; m < 3; m++)
+        cout << setw(12) << left << srcnn_mode_name(half_modes[m]);
+    cout << endl;
+
+    double mean_psnr[3] = { 0, 0, 0 }, worst_drop[3] = { 0, 0, 0 };
+    for (int i = 0; i < HALF_IMAGES; i++) {
+        load_image(string("./") + half_images[i] + "_3x_LR_u8.bin", &img_LR_half[0][0][0], N0*H*W);
+        load_image(string("./") + half_images[i] + "_3x_GT_u8.bin", &img_GT_half[0][0][0], N3*H*W);
+        cout << "  " << setw(12) << left << string(half_images[i]).substr(string(half_images[i]).find('/') + 1);
+        double psnr[3];
+        for (int m = 0; m < 3; m++) {
+            srcnn_ctx_run(ctxs[m], &img_LR_half[0][0][0], &img_HR_half[0][0][0]);
+            psnr[m] = calculate_PSNR(&img_GT_half[0][0][0], &img_HR_half[0][0][0], H*W);
+            mean_psnr[m] += psnr[m]/HALF_IMAGES;
+            worst_drop[m] = fmax(worst_drop[m], psnr[0] - psnr[m]);
+            cout << setw(12) << left << psnr[m];
+        }
+        cout << endl;
+    }
+    for (int m = 1; m < 3; m++)
+        cout << "  - " << srcnn_mode_name(half_modes[m]) << ": mean PSNR delta "
+             << mean_psnr[m] - mean_psnr[0] << " dB, worst drop " << worst_drop[m] << " dB" << endl;
+
+    // per-frame time against float blocked maps, all modes on the same image
+    double ms[3] = { 0, 0, 0 };
+    for (int r = 0; r < HALF_RUNS; r++) {
+        for (int m = 0; m < 3; m++) {
+            auto start = chrono::steady_clock::now();
+            srcnn_ctx_run(ctxs[m], &img_LR_half[0][0][0], &img_HR_half[0][0][0]);
+            ms[m] += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()/HALF_RUNS;
+        }
+    }
+    cout << "  - Time per frame on " << simd_isa_name(isa) << ":";
+    for (int m = 0; m < 3; m++)
+        cout << " " << srcnn_mode_name(half_modes[m]) << " " << ms[m] << " ms";
+    cout << endl;
+    cout << "  - Speedup against blocked: fp16 " << ms[0]/ms[1] << "x, bf16 " << ms[0]/ms[2] << "x" << endl;
+    cout << "  - Workspace:";
+    for (int m = 0; m < 3; m++)
+        cout << " " << srcnn_mode_name(half_modes[m]) << " " << srcnn_workspace_bytes(H, W, half_modes[m])/1024 << " KB";
+    cout << endl;
+
+    for (int m = 0; m < 3; m++)
+        srcnn_ctx_destroy(ctxs[m]);
+
+    // IEEE half keeps 11 bits, far more than 8-bit output images resolve;
+    // bfloat16 keeps 8 and costs a little more on smooth images
+    bool quality = mean_psnr[0] - mean_psnr[1] < 0.01 && worst_drop[1] < 0.05 &&
+                   mean_psnr[0] - mean_psnr[2] < 0.1 && worst_drop[2] < 0.5;
+    cout << "  - Within tolerance: " << (ok && quality ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return ok && quality ? 0 : 1;
+}
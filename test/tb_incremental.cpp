@@ -0,0 +1,173 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <vector>
+#include <chrono>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "kernels.h"
+#include "simd.h"
+#include "util.h"
+
+using namespace std;
+
+#define INCR_FRAMES 12
+#define INCR_PATCH  24      // side of the object moving over the background
+#define INCR_RUNS   3
+
+ftmap_t img_background_incr[N0][H][W];  // static camera background
+ftmap_t img_object_incr[N0][H][W];      // source of the moving object
+ftmap_t img_cut_incr[N0][H][W];         // frame after the scene cut
+ftmap_t img_LR_incr[N0][H][W];          // current frame
+ftmap_t img_HR_full_incr[N3][H][W];     // tiled output of the frame
+ftmap_t img_HR_incr[N3][H][W];          // incremental output of the frame
+
+// builds frame i of the clip: the background, an unchanged repeat, an object
+// moving diagonally, a caption appearing along the bottom rows and a scene cut
+static const char *incr_frame(int i, ftmap_t frame[N0][H][W])
+{
+    if (i == INCR_FRAMES - 1) {
+        memcpy(frame, img_cut_incr, sizeof(img_cut_incr));
+        return "scene cut";
+    }
+    memcpy(frame, img_background_incr, sizeof(img_background_incr));
+    if (i < 2)
+        return i == 0 ? "first frame" : "unchanged";
+    int p = 20 + (i - 2)*12;
+    for (int y = 0; y < INCR_PATCH; y++)
+        for (int x = 0; x < INCR_PATCH; x++)
+            frame[0][p + y][p + x] = img_object_incr[0][100 + y][100 + x];
+    if (i < INCR_FRAMES - 3)
+        return "moving object";
+    for (int y = H - 20; y < H - 8; y++)
+        for (int x = 16; x < W - 16; x++)
+            frame[0][y][x] = (x/6 + i) % 3 ? 1.0f : 0.0f;
+    return "object + caption";
+}
+
+// block flags and the updated previous frame of ftmap_diff_update() against
+// a plain loop, on changes at block corners, a lone -0.0 and unaligned widths
+static bool diff_matches(int h, int w, int block)
+{
+    int bw = (w + block - 1)/block;
+    int bh = (h + block - 1)/block;
+    vector<ftmap_t> image((size_t) h*w), previous((size_t) h*w);
+    vector<uint8_t> changed((size_t) bh*bw, 7), expected((size_t) bh*bw, 0);
+    for (long i = 0; i < (long) h*w; i++)
+        image[i] = previous[i] = (ftmap_t) ((i*37) % 255)/255;
+
+    const int points[][2] = { { 0, 0 }, { block - 1, block }, { h - 1, w - 1 }, { h/2, 2*block - 1 } };
+    for (const int *pt : points) {
+        image[(long) pt[0]*w + pt[1]] += 0.5f;
+        expected[(pt[0]/block)*bw + pt[1]/block] = 1;
+    }
+    previous[(long) (h - 1)*w] = 0.0f;
+    image[(long) (h - 1)*w] = -0.0f;
+    expected[(bh - 1)*bw] = 1;
+
+    ftmap_diff_update(ftmap_view(&image[0], h, w), ftmap_view(&previous[0], h, w), h, w, block, &changed[0]);
+    return changed == expected && memcmp(&image[0], &previous[0], image.size()*sizeof(ftmap_t)) == 0;
+}
+
+// best of runs wall-clock milliseconds of body, which runs after setup
+template <typename S, typename B>
+static double best_ms(S setup, B body)
+{
+    double best = 1e30;
+    for (int r = 0; r < INCR_RUNS; r++) {
+        setup();
+        auto start = chrono::steady_clock::now();
+        body();
+        best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+// incremental execution testbench: a static-camera clip through the
+// incremental mode against the tiled mode, frame by frame, with the area
+// each frame recomputes and the time it saves
+int tb_incremental()
+{
+    load_image("./set14/lenna_3x_LR_u8.bin", &img_background_incr[0][0][0], N0*H*W);
+    load_image("./set14/baboon_3x_LR_u8.bin", &img_object_incr[0][0][0], N0*H*W);
+    load_image("./set14/barbara_3x_LR_u8.bin", &img_cut_incr[0][0][0], N0*H*W);
+
+    const srcnn_model_t *model = test_model();
+
+    cout << "***** SRCNN Incremental Execution *****" << endl;
+
+    // the block diff on every ISA
+    simd_isa_t isa = simd_isa();
+    bool diff_ok = true;
+    for (int i = 0; i <= simd_detect(); i++) {
+        simd_set_isa((simd_isa_t) i);
+        diff_ok = diff_ok && diff_matches(H, W, 16) && diff_matches(37, 53, 16) && diff_matches(20, 21, 5);
+    }
+    simd_set_isa(isa);
+    cout << "  - Block diff matches the plain loop on every ISA: " << (diff_ok ? "yes" : "NO") << endl;
+
+    // the clip: the incremental context sees every frame once, in order, and
+    // is timed on a second context brought to the previous frame first
+    srcnn_ctx_t *full = srcnn_ctx_create(model, H, W, SRCNN_MODE_TILED);
+    srcnn_ctx_t *incr = srcnn_ctx_create(model, H, W, SRCNN_MODE_INCREMENTAL);
+    srcnn_ctx_t *timed = srcnn_ctx_create(model, H, W, SRCNN_MODE_INCREMENTAL);
+    vector<ftmap_t> prev((size_t) N0*H*W), scratch((size_t) N3*H*W);
+    cout << "  " << setw(7) << left << "Frame"
+         << setw(18) << left << "Change"
+         << setw(12) << left << "Recomputed"
+         << setw(11) << left << "Full (ms)"
+         << setw(18) << left << "Incremental (ms)"
+         << setw(10) << left << "Speed-up" << endl;
+    bool identical = true;
+    double recomputed[INCR_FRAMES];
+    double total_full = 0, total_incr = 0;
+    for (int i = 0; i < INCR_FRAMES; i++) {
+        const char *change = incr_frame(i, img_LR_incr);
+        srcnn_ctx_run(incr, &img_LR_incr[0][0][0], &img_HR_incr[0][0][0]);
+        recomputed[i] = srcnn_ctx_recomputed(incr);
+        srcnn_ctx_run(full, &img_LR_incr[0][0][0], &img_HR_full_incr[0][0][0]);
+        identical = identical && memcmp(img_HR_incr, img_HR_full_incr, sizeof(img_HR_incr)) == 0;
+
+        double full_ms = best_ms([]() {}, [&]() {
+            srcnn_ctx_run(full, &img_LR_incr[0][0][0], &img_HR_full_incr[0][0][0]);
+        });
+        double incr_ms = best_ms([&]() {
+            if (i == 0)
+                srcnn_ctx_set_model(timed, model);
+            else
+                srcnn_ctx_run(timed, &prev[0], &scratch[0]);
+        }, [&]() {
+            srcnn_ctx_run(timed, &img_LR_incr[0][0][0], &img_HR_incr[0][0][0]);
+        });
+        memcpy(&prev[0], img_LR_incr, sizeof(img_LR_incr));
+        total_full += full_ms;
+        total_incr += incr_ms;
+
+        cout << "  " << setw(7) << left << i
+             << setw(18) << left << change
+             << setw(12) << left << recomputed[i]
+             << setw(11) << left << full_ms
+             << setw(18) << left << incr_ms
+             << setw(10) << left << full_ms/incr_ms << endl;
+    }
+    srcnn_ctx_destroy(full);
+    srcnn_ctx_destroy(incr);
+    srcnn_ctx_destroy(timed);
+    cout << "  - Whole clip: " << total_full << " ms tiled, " << total_incr << " ms incremental, speed-up "
+         << total_full/total_incr << endl;
+    cout << "  - Outputs identical to the tiled mode: " << (identical ? "yes" : "NO") << endl;
+
+    // everything on the first frame and the cut, nothing on a repeat, and
+    // only the neighbourhood of the moving object in between
+    bool areas = recomputed[0] == 1 && recomputed[1] == 0 && recomputed[INCR_FRAMES - 1] == 1;
+    for (int i = 2; i < INCR_FRAMES - 3; i++)
+        areas = areas && recomputed[i] > 0 && recomputed[i] < 0.25;
+
+    bool ok = diff_ok && identical && areas;
+    cout << "  - Within tolerance: " << (ok ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <vector>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "util.h"
+
+using namespace std;
+
+#define IO_IMAGES 13
+#define IO_STRIDE (W + 7)
+
+static const char *io_images[IO_IMAGES] = {
+    "baboon", "barbara", "bridge", "coastguard", "face", "flowers", "foreman",
+    "lenna", "man", "monarch", "pepper", "ppt3", "zebra",
+};
+
+ftmap_t img_bulk_io[N0][H][W];          // loaded by load_image()
+ftmap_t img_stream_io[N0][H][W];        // loaded a byte at a time
+ftmap_t img_HR_io[N3][H][W];
+ftmap_t img_HR_strided_io[N3][H][IO_STRIDE];
+ftmap_t img_raw_io[N3][H][W];
+
+// the byte-at-a-time loader load_image() used to be
+static void load_image_stream(string fname, ftmap_t *image, int count)
+{
+    uint8_t p;
+    ifstream ifs(fname, ios::in | ios::binary);
+    for (int i = 0; i < count; i++) {
+        ifs.read((char *) &p, sizeof(uint8_t));
+        image[i] = (ftmap_t) (((float) p)/255);
+    }
+}
+
+// reads a whole file into bytes
+static vector<uint8_t> read_bytes(const string &fname)
+{
+    mapped_file_t file = map_file(fname);
+    vector<uint8_t> bytes(file.data, file.data + file.size);
+    unmap_file(file);
+    return bytes;
+}
+
+// bulk image I/O testbench: same values as the element-wise loaders, writers
+// that stream from strided inference buffers
+int tb_io()
+{
+    cout << "***** SRCNN Image I/O *****" << endl;
+
+    // loading Set14 in bulk and element by element gives the same images
+    vector<string> paths;
+    for (int i = 0; i < IO_IMAGES; i++) {
+        paths.push_back(string("./set14/") + io_images[i] + "_3x_LR_u8.bin");
+        paths.push_back(string("./set14/") + io_images[i] + "_3x_GT_u8.bin");
+    }
+    readahead_files(paths);
+
+    bool loads = true;
+    double bulk_ms = 0, stream_ms = 0;
+    for (size_t n = 0; n < paths.size(); n++) {
+        auto start = chrono::steady_clock::now();
+        load_image_stream(paths[n], &img_stream_io[0][0][0], N0*H*W);
+        auto middle = chrono::steady_clock::now();
+        load_image(paths[n], &img_bulk_io[0][0][0], N0*H*W);
+        auto stop = chrono::steady_clock::now();
+        stream_ms += chrono::duration<double, milli>(middle - start).count();
+        bulk_ms += chrono::duration<double, milli>(stop - middle).count();
+        loads = loads && memcmp(img_bulk_io, img_stream_io, sizeof(img_bulk_io)) == 0;
+    }
+    cout << "  - " << paths.size() << " Set14 images: byte-at-a-time " << stream_ms
+         << " ms, bulk " << bulk_ms << " ms, identical: " << (loads ? "yes" : "NO") << endl;
+
+    // write an inference result from a strided buffer and packed, as u8 and raw floats
+    const srcnn_model_t *model = test_model();
+
+    load_image("./set5/butterfly_3x_LR_u8.bin", &img_bulk_io[0][0][0], N0*H*W);
+    srcnn_ctx_t *ctx = srcnn_ctx_create(model, H, W, SRCNN_MODE_SIMD);
+    srcnn_ctx_run(ctx, &img_bulk_io[0][0][0], &img_HR_io[0][0][0]);
+    srcnn_ctx_run_strided(ctx, &img_bulk_io[0][0][0], W, &img_HR_strided_io[0][0][0], IO_STRIDE);
+    srcnn_ctx_destroy(ctx);
+
+    write_bin("./tb_io_packed.bin", &img_HR_io[0][0][0], N3*H*W);
+    image_writer writer("./tb_io_strided.bin");
+    writer.write(&img_HR_strided_io[0][0][0], H, W, IO_STRIDE);
+    writer.close();
+    image_writer raw("./tb_io_raw.bin");
+    raw.write_raw(&img_HR_io[0][0][0], N3*H*W);
+    raw.close();
+
+    vector<uint8_t> packed = read_bytes("./tb_io_packed.bin");
+    vector<uint8_t> strided = read_bytes("./tb_io_strided.bin");
+    bool quantized = packed.size() == (size_t) N3*H*W;
+    for (int i = 0; quantized && i < N3*H*W; i++) {
+        float v = (&img_HR_io[0][0][0])[i]*255;
+        quantized = packed[i] == (uint8_t) (v > 255 ? 255 : v);
+    }
+    bool writes = quantized && strided == packed;
+    load_ftmap("./tb_io_raw.bin", &img_raw_io[0][0][0], N3*H*W);
+    bool raws = memcmp(img_raw_io, img_HR_io, sizeof(img_HR_io)) == 0;
+    remove("./tb_io_packed.bin");
+    remove("./tb_io_strided.bin");
+    remove("./tb_io_raw.bin");
+    cout << "  - Strided u8 writes match packed: " << (writes ? "yes" : "NO")
+         << ", raw float round trip exact: " << (raws ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return loads && writes && raws ? 0 : 1;
+}
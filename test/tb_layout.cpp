@@ -0,0 +1,164 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cmath>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "kernels.h"
+#include "simd.h"
+#include "util.h"
+
+using namespace std;
+
+ftmap_t img_LR_layout[N0][H][W];        // low resolution input image
+ftmap_t layer1_ref_layout[N1][H][W];    // reference conv1 output
+ftmap_t layer2_ref_layout[N2][H][W];    // reference conv2 output
+ftmap_t img_HR_ref_layout[N3][H][W];    // reference conv3 output
+ftmap_t img_HR_layout[N3][H][W];        // blocked engine mode output
+
+// returns the largest absolute difference between two feature maps
+static double max_abs_diff(const ftmap_t *a, const ftmap_t *b, long count)
+{
+    double diff = 0;
+    for (long i = 0; i < count; i++)
+        diff = fmax(diff, fabs((double) a[i] - b[i]));
+    return diff;
+}
+
+// best of runs wall-clock milliseconds
+static double best_ms(int runs, const function<void()> &body)
+{
+    double best = 1e30;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        body();
+        best = fmin(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+// every layer in every layout against the reference maps on the current ISA:
+// the layers read reference inputs transformed into their layout, and their
+// outputs are transformed back to planar
+static double layout_err(ftmap_layout_t layout)
+{
+    const srcnn_model_t *model = test_model();
+    vector<ftmap_t> map1((size_t) N1*H*W), map2((size_t) N2*H*W);
+    vector<ftmap_t> planar1((size_t) N1*H*W), planar2((size_t) N2*H*W), out((size_t) N3*H*W);
+
+    conv1_layout(ftmap_view(&img_LR_layout[0][0][0], H, W), model->conv1_weights,
+                 model->conv1_biases, H, W, &map1[0], layout);
+    ftmap_from_layout(&map1[0], layout, N1, H, W, &planar1[0]);
+    double err = max_abs_diff(&layer1_ref_layout[0][0][0], &planar1[0], (long) N1*H*W);
+
+    for (int l = 0; l < FTMAP_LAYOUT_COUNT; l++) {
+        ftmap_to_layout(&layer1_ref_layout[0][0][0], N1, H, W, (ftmap_layout_t) l, &map1[0]);
+        conv2_layout(&map1[0], (ftmap_layout_t) l, model->conv2_weights, model->conv2_biases,
+                     H, W, &map2[0], layout);
+        ftmap_from_layout(&map2[0], layout, N2, H, W, &planar2[0]);
+        err = fmax(err, max_abs_diff(&layer2_ref_layout[0][0][0], &planar2[0], (long) N2*H*W));
+    }
+
+    ftmap_to_layout(&layer2_ref_layout[0][0][0], N2, H, W, layout, &map2[0]);
+    conv3_layout(&map2[0], layout, model->conv3_weights, model->conv3_biases,
+                 H, W, ftmap_view(&out[0], H, W));
+    return fmax(err, max_abs_diff(&img_HR_ref_layout[0][0][0], &out[0], (long) N3*H*W));
+}
+
+// blocked and channel-last feature-map layouts testbench: each layer in each
+// layout against the reference on every ISA, and the per-layer times that
+// pick the fastest layout pair for the two intermediate maps
+int tb_layout()
+{
+    const srcnn_model_t *model = test_model();
+    const test_params_t &params = test_params();
+    load_image("./set5/butterfly_3x_LR_u8.bin", &img_LR_layout[0][0][0], N0*H*W);
+
+    conv1(img_LR_layout, params.conv1_weights, params.conv1_biases, layer1_ref_layout);
+    conv2(layer1_ref_layout, params.conv2_weights, params.conv2_biases, layer2_ref_layout);
+    conv3(layer2_ref_layout, params.conv3_weights, params.conv3_biases, img_HR_ref_layout);
+
+    cout << "***** Feature-Map Layouts *****" << endl;
+
+    simd_isa_t isa = simd_isa();
+    bool ok = true;
+    for (int i = 0; i <= simd_detect(); i++) {
+        simd_set_isa((simd_isa_t) i);
+        cout << "  - " << setw(8) << left << simd_isa_name((simd_isa_t) i) << "max err";
+        for (int l = 0; l < FTMAP_LAYOUT_COUNT; l++) {
+            double err = layout_err((ftmap_layout_t) l);
+            cout << " " << ftmap_layout_name((ftmap_layout_t) l) << " " << err;
+            ok = ok && err <= 1e-5;
+        }
+        cout << endl;
+    }
+    simd_set_isa(isa);
+
+    // the engine mode chaining the layers on blocked maps
+    srcnn_run(SRCNN_MODE_BLOCKED, img_LR_layout,
+              params.conv1_weights, params.conv1_biases,
+              params.conv2_weights, params.conv2_biases,
+              params.conv3_weights, params.conv3_biases,
+              img_HR_layout);
+    double mode_err = max_abs_diff(&img_HR_ref_layout[0][0][0], &img_HR_layout[0][0][0], (long) N3*H*W);
+    cout << "  - Blocked mode max err: " << mode_err << endl;
+    ok = ok && mode_err <= 1e-4;
+
+    // per-layer times: conv1 by output layout, conv2 by input x output
+    // layout, conv3 by input layout
+    vector<ftmap_t> map1((size_t) N1*H*W), map2((size_t) N2*H*W), out((size_t) N3*H*W);
+    ftmap_view_t input = ftmap_view(&img_LR_layout[0][0][0], H, W);
+    ftmap_view_t output = ftmap_view(&out[0], H, W);
+    double conv1_ms[FTMAP_LAYOUT_COUNT], conv2_ms[FTMAP_LAYOUT_COUNT][FTMAP_LAYOUT_COUNT];
+    double conv3_ms[FTMAP_LAYOUT_COUNT];
+    const int runs = 3;
+    for (int l = 0; l < FTMAP_LAYOUT_COUNT; l++) {
+        ftmap_layout_t layout = (ftmap_layout_t) l;
+        conv1_ms[l] = best_ms(runs, [&]() {
+            conv1_layout(input, model->conv1_weights, model->conv1_biases, H, W, &map1[0], layout);
+        });
+        for (int m = 0; m < FTMAP_LAYOUT_COUNT; m++)
+            conv2_ms[l][m] = best_ms(runs, [&]() {
+                conv2_layout(&map1[0], layout, model->conv2_weights, model->conv2_biases,
+                             H, W, &map2[0], (ftmap_layout_t) m);
+            });
+        conv3_ms[l] = best_ms(runs, [&]() {
+            conv3_layout(&map2[0], layout, model->conv3_weights, model->conv3_biases,
+                         H, W, output);
+        });
+    }
+
+    cout << "  Per layer on " << simd_isa_name(isa) << " (best of " << runs << ", ms):" << endl;
+    cout << "  " << setw(10) << left << "Layout"
+         << setw(10) << left << "conv1"
+         << setw(10) << left << "conv3";
+    for (int m = 0; m < FTMAP_LAYOUT_COUNT; m++)
+        cout << setw(16) << left << (string("conv2->") + ftmap_layout_name((ftmap_layout_t) m));
+    cout << endl;
+    int best1 = 0, best2 = 0;
+    for (int l = 0; l < FTMAP_LAYOUT_COUNT; l++) {
+        cout << "  " << setw(10) << left << ftmap_layout_name((ftmap_layout_t) l)
+             << setw(10) << left << conv1_ms[l]
+             << setw(10) << left << conv3_ms[l];
+        for (int m = 0; m < FTMAP_LAYOUT_COUNT; m++) {
+            cout << setw(16) << left << conv2_ms[l][m];
+            if (conv1_ms[l] + conv2_ms[l][m] + conv3_ms[m] < conv1_ms[best1] + conv2_ms[best1][best2] + conv3_ms[best2]) {
+                best1 = l;
+                best2 = m;
+            }
+        }
+        cout << endl;
+    }
+    cout << "  - Fastest layouts: conv1 map " << ftmap_layout_name((ftmap_layout_t) best1)
+         << ", conv2 map " << ftmap_layout_name((ftmap_layout_t) best2) << ", "
+         << conv1_ms[best1] + conv2_ms[best1][best2] + conv3_ms[best2] << " ms against "
+         << conv1_ms[0] + conv2_ms[0][0] + conv3_ms[0] << " ms planar" << endl;
+    cout << "  - Within tolerance: " << (ok ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,270 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <chrono>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "metrics.h"
+#include "simd.h"
+#include "util.h"
+
+using namespace std;
+
+#define METRICS_IMAGES 13
+#define METRICS_RUNS   3
+
+static const char *metrics_images[METRICS_IMAGES] = {
+    "baboon", "barbara", "bridge", "coastguard", "face", "flowers", "foreman",
+    "lenna", "man", "monarch", "pepper", "ppt3", "zebra",
+};
+
+ftmap_t img_LR_metrics[METRICS_IMAGES][N0][H][W];   // Set14 inputs (bicubic upscaled)
+ftmap_t img_GT_metrics[METRICS_IMAGES][N3][H][W];   // Set14 ground truth
+ftmap_t img_HR_metrics[METRICS_IMAGES][N3][H][W];   // simd outputs
+ftmap_t img_HR_scored_metrics[N3][H][W];            // output of a scored run
+
+// u8 value of a pixel as the metrics quantize it
+static double metrics_u8(ftmap_t v)
+{
+    float u = v*255;
+    return (int) (u < 0 ? 0 : (u > 255 ? 255 : u));
+}
+
+// mean SSIM straight from its definition, window by window in double precision
+static double ssim_reference(const ftmap_t *image, const ftmap_t *reference, int h, int w)
+{
+    double g[METRICS_WINDOW][METRICS_WINDOW], sum = 0;
+    for (int i = 0; i < METRICS_WINDOW; i++)
+        for (int j = 0; j < METRICS_WINDOW; j++) {
+            double di = i - METRICS_WINDOW/2, dj = j - METRICS_WINDOW/2;
+            sum += g[i][j] = exp(-(di*di + dj*dj)/(2*1.5*1.5));
+        }
+    const double c1 = pow(0.01*255, 2), c2 = pow(0.03*255, 2);
+
+    double ssim = 0;
+    for (int y = 0; y + METRICS_WINDOW <= h; y++)
+        for (int x = 0; x + METRICS_WINDOW <= w; x++) {
+            double mx = 0, my = 0, xx = 0, yy = 0, xy = 0;
+            for (int i = 0; i < METRICS_WINDOW; i++)
+                for (int j = 0; j < METRICS_WINDOW; j++) {
+                    double a = metrics_u8(image[(long) (y + i)*w + x + j]);
+                    double b = metrics_u8(reference[(long) (y + i)*w + x + j]);
+                    double wt = g[i][j]/sum;
+                    mx += wt*a;
+                    my += wt*b;
+                    xx += wt*a*a;
+                    yy += wt*b*b;
+                    xy += wt*a*b;
+                }
+            ssim += (2*mx*my + c1)*(2*(xy - mx*my) + c2)/((mx*mx + my*my + c1)*(xx - mx*mx + yy - my*my + c2));
+        }
+    return ssim/((long) (h - METRICS_WINDOW + 1)*(w - METRICS_WINDOW + 1));
+}
+
+// mean SSIM the usual way, as separate scalar passes over whole planes: the
+// five statistics planes, each filtered along x and then y, then the map
+static double ssim_planes(const ftmap_t *image, const ftmap_t *reference, int h, int w)
+{
+    int oh = h - METRICS_WINDOW + 1, ow = w - METRICS_WINDOW + 1;
+    float g[METRICS_WINDOW], sum = 0;
+    for (int t = 0; t < METRICS_WINDOW; t++)
+        sum += g[t] = exp(-(t - METRICS_WINDOW/2)*(t - METRICS_WINDOW/2)/(2*1.5f*1.5f));
+    for (int t = 0; t < METRICS_WINDOW; t++)
+        g[t] /= sum;
+    vector<float> planes[5], along_x((size_t) h*ow), filtered[5];
+    for (int k = 0; k < 5; k++) {
+        planes[k].resize((size_t) h*w);
+        filtered[k].resize((size_t) oh*ow);
+    }
+    for (long i = 0; i < (long) h*w; i++) {
+        float a = metrics_u8(image[i]), b = metrics_u8(reference[i]);
+        planes[0][i] = a;
+        planes[1][i] = b;
+        planes[2][i] = a*a;
+        planes[3][i] = b*b;
+        planes[4][i] = a*b;
+    }
+    for (int k = 0; k < 5; k++) {
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < ow; x++) {
+                float acc = 0;
+                for (int t = 0; t < METRICS_WINDOW; t++)
+                    acc += g[t]*planes[k][(long) y*w + x + t];
+                along_x[(long) y*ow + x] = acc;
+            }
+        for (int y = 0; y < oh; y++)
+            for (int x = 0; x < ow; x++) {
+                float acc = 0;
+                for (int t = 0; t < METRICS_WINDOW; t++)
+                    acc += g[t]*along_x[(long) (y + t)*ow + x];
+                filtered[k][(long) y*ow + x] = acc;
+            }
+    }
+    const float c1 = 6.5025f, c2 = 58.5225f;
+    double ssim = 0;
+    for (long i = 0; i < (long) oh*ow; i++) {
+        float mx = filtered[0][i], my = filtered[1][i];
+        ssim += (2*mx*my + c1)*(2*(filtered[4][i] - mx*my) + c2)/
+                ((mx*mx + my*my + c1)*(filtered[2][i] - mx*mx + filtered[3][i] - my*my + c2));
+    }
+    return ssim/((long) oh*ow);
+}
+
+static bool same_metrics(const image_metrics_t &a, const image_metrics_t &b)
+{
+    return a.mse == b.mse && a.psnr == b.psnr && a.ssim == b.ssim;
+}
+
+// best of runs wall-clock milliseconds of body
+template <typename B>
+static double best_ms(B body)
+{
+    double best = 1e30;
+    for (int r = 0; r < METRICS_RUNS; r++) {
+        auto start = chrono::steady_clock::now();
+        body();
+        best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+// quality metrics testbench: the one-pass MSE / PSNR / SSIM engine against
+// calculate_mse(), calculate_PSNR() and a direct SSIM on every ISA, its cost
+// against the separate scalar passes of tb_set14, and scoring fused into
+// inference, per context and per batch, against scoring afterwards
+int tb_metrics()
+{
+    const srcnn_model_t *model = test_model();
+
+    cout << "***** SRCNN Quality Metrics *****" << endl;
+
+    srcnn_ctx_t *ctx = srcnn_ctx_create(model, H, W, SRCNN_MODE_SIMD);
+    for (int i = 0; i < METRICS_IMAGES; i++) {
+        load_image(string("./set14/") + metrics_images[i] + "_3x_LR_u8.bin", &img_LR_metrics[i][0][0][0], N0*H*W);
+        load_image(string("./set14/") + metrics_images[i] + "_3x_GT_u8.bin", &img_GT_metrics[i][0][0][0], N3*H*W);
+        srcnn_ctx_run(ctx, &img_LR_metrics[i][0][0][0], &img_HR_metrics[i][0][0][0]);
+    }
+
+    // the engine on every ISA against the scalar passes and the direct SSIM
+    vector<double> ssim_ref(METRICS_IMAGES);
+    for (int i = 0; i < METRICS_IMAGES; i++)
+        ssim_ref[i] = ssim_reference(&img_HR_metrics[i][0][0][0], &img_GT_metrics[i][0][0][0], H, W);
+    // calculate_PSNR() wraps values outside [0, 1] where the engine
+    // saturates them, so PSNR is compared on outputs clamped to [0, 1]
+    vector<ftmap_t> clamped((size_t) H*W);
+    simd_isa_t isa = simd_isa();
+    double mse_err = 0, psnr_err = 0, ssim_err = 0, mean_ssim = 0;
+    for (int s = 0; s <= simd_detect(); s++) {
+        simd_set_isa((simd_isa_t) s);
+        for (int i = 0; i < METRICS_IMAGES; i++) {
+            ftmap_t *hr = &img_HR_metrics[i][0][0][0], *gt = &img_GT_metrics[i][0][0][0];
+            image_metrics_t m = image_metrics(hr, gt, H, W);
+            double mse = calculate_mse(gt, hr, H*W);
+            mse_err = max(mse_err, fabs(m.mse - mse)/mse);
+            for (long p = 0; p < (long) H*W; p++)
+                clamped[p] = hr[p] < 0 ? 0 : (hr[p] > 1 ? 1 : hr[p]);
+            psnr_err = max(psnr_err, fabs(image_metrics(&clamped[0], gt, H, W).psnr - calculate_PSNR(gt, &clamped[0], H*W)));
+            ssim_err = max(ssim_err, fabs(m.ssim - ssim_ref[i]));
+            mean_ssim += m.ssim/METRICS_IMAGES/(simd_detect() + 1);
+        }
+    }
+    simd_set_isa(isa);
+    cout << "  - Against the scalar passes on every ISA: MSE relative error " << mse_err
+         << ", PSNR error " << psnr_err << " dB, SSIM error " << ssim_err << " (Set14 mean SSIM "
+         << mean_ssim << ")" << endl;
+
+    // tb_set14's four scalar passes per image, with SSIM of the output and
+    // the input as separate passes too, against two engine passes
+    double scalar_ms = best_ms([&]() {
+        for (int i = 0; i < METRICS_IMAGES; i++) {
+            ftmap_t *hr = &img_HR_metrics[i][0][0][0], *gt = &img_GT_metrics[i][0][0][0];
+            calculate_PSNR(gt, hr, H*W);
+            calculate_PSNR(gt, &img_LR_metrics[i][0][0][0], H*W);
+            calculate_mse(gt, hr, N3*H*W);
+            calculate_PSNR(gt, hr, H*W);
+        }
+    });
+    double planes_ms = best_ms([&]() {
+        for (int i = 0; i < METRICS_IMAGES; i++) {
+            ssim_planes(&img_HR_metrics[i][0][0][0], &img_GT_metrics[i][0][0][0], H, W);
+            ssim_planes(&img_LR_metrics[i][0][0][0], &img_GT_metrics[i][0][0][0], H, W);
+        }
+    });
+    double engine_ms = best_ms([&]() {
+        for (int i = 0; i < METRICS_IMAGES; i++) {
+            image_metrics(&img_HR_metrics[i][0][0][0], &img_GT_metrics[i][0][0][0], H, W);
+            image_metrics(&img_LR_metrics[i][0][0][0], &img_GT_metrics[i][0][0][0], H, W);
+        }
+    });
+    double planes_ssim = ssim_planes(&img_HR_metrics[0][0][0][0], &img_GT_metrics[0][0][0][0], H, W);
+    ssim_err = max(ssim_err, fabs(planes_ssim - ssim_ref[0]));
+    cout << "  - Set14 scoring: scalar MSE/PSNR passes " << scalar_ms << " ms + SSIM planes " << planes_ms
+         << " ms, one-pass engine " << engine_ms << " ms, speed-up " << (scalar_ms + planes_ms)/engine_ms << endl;
+
+    // scored runs: fused into conv3's output in the simd and tiled modes,
+    // after the run in the others
+    srcnn_ctx_destroy(ctx);
+    cout << "  " << setw(11) << left << "Mode"
+         << setw(12) << left << "Run (ms)"
+         << setw(16) << left << "Run+score (ms)"
+         << setw(14) << left << "Scored (ms)" << endl;
+    bool fused_ok = true;
+    for (srcnn_mode_t mode : { SRCNN_MODE_SIMD, SRCNN_MODE_TILED, SRCNN_MODE_FUSED }) {
+        ctx = srcnn_ctx_create(model, H, W, mode);
+        image_metrics_t m;
+        for (int i = 0; i < METRICS_IMAGES; i++) {
+            srcnn_ctx_run_scored(ctx, &img_LR_metrics[i][0][0][0], &img_HR_scored_metrics[0][0][0],
+                                 &img_GT_metrics[i][0][0][0], &m);
+            fused_ok = fused_ok && same_metrics(m, image_metrics(&img_HR_scored_metrics[0][0][0],
+                                                                 &img_GT_metrics[i][0][0][0], H, W));
+        }
+        double run_ms = best_ms([&]() {
+            srcnn_ctx_run(ctx, &img_LR_metrics[0][0][0][0], &img_HR_scored_metrics[0][0][0]);
+        });
+        double separate_ms = best_ms([&]() {
+            srcnn_ctx_run(ctx, &img_LR_metrics[0][0][0][0], &img_HR_scored_metrics[0][0][0]);
+            image_metrics(&img_HR_scored_metrics[0][0][0], &img_GT_metrics[0][0][0][0], H, W);
+        });
+        double scored_ms = best_ms([&]() {
+            srcnn_ctx_run_scored(ctx, &img_LR_metrics[0][0][0][0], &img_HR_scored_metrics[0][0][0],
+                                 &img_GT_metrics[0][0][0][0], &m);
+        });
+        srcnn_ctx_destroy(ctx);
+        cout << "  " << setw(11) << left << srcnn_mode_name(mode)
+             << setw(12) << left << run_ms
+             << setw(16) << left << separate_ms
+             << setw(14) << left << scored_ms << endl;
+    }
+    cout << "  - Scored runs match scoring the output afterwards: " << (fused_ok ? "yes" : "NO") << endl;
+
+    // a whole batch at once, inference and scoring, and scoring alone
+    const ftmap_t *inputs[METRICS_IMAGES], *references[METRICS_IMAGES], *outputs_c[METRICS_IMAGES];
+    ftmap_t *outputs[METRICS_IMAGES];
+    vector<ftmap_t> batch_out((size_t) METRICS_IMAGES*H*W);
+    image_metrics_t scored[METRICS_IMAGES], alone[METRICS_IMAGES];
+    for (int i = 0; i < METRICS_IMAGES; i++) {
+        inputs[i] = &img_LR_metrics[i][0][0][0];
+        references[i] = &img_GT_metrics[i][0][0][0];
+        outputs[i] = &batch_out[(size_t) i*H*W];
+        outputs_c[i] = outputs[i];
+    }
+    srcnn_batch_t *batch = srcnn_batch_create(model, H, W, SRCNN_MODE_SIMD);
+    srcnn_batch_run_scored(batch, METRICS_IMAGES, inputs, outputs, references, scored);
+    srcnn_batch_destroy(batch);
+    image_metrics_batch(METRICS_IMAGES, outputs_c, references, H, W, alone);
+    bool batch_ok = true;
+    for (int i = 0; i < METRICS_IMAGES; i++)
+        batch_ok = batch_ok && same_metrics(scored[i], alone[i]) &&
+                   memcmp(outputs[i], img_HR_metrics[i], sizeof(img_HR_metrics[i])) == 0;
+    cout << "  - Batch scoring matches scoring each output: " << (batch_ok ? "yes" : "NO") << endl;
+
+    bool ok = mse_err < 1e-5 && psnr_err < 1e-3 && ssim_err < 1e-4 && fused_ok && batch_ok;
+    cout << "  - Within tolerance: " << (ok ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return ok ? 0 : 1;
+}
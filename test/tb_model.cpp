@@ -0,0 +1,141 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "model_file.h"
+#include "util.h"
+
+using namespace std;
+
+ftmap_t img_LR_model[N0][H][W];
+ftmap_t img_HR_bin_model[N3][H][W];     // output with the .bin parameters
+ftmap_t img_HR_mapped_model[N3][H][W];  // output with the mapped model file
+
+param_t conv1_weights_model[N1][N0][F1][F1];
+param_t conv1_biases_model[N1];
+param_t conv2_weights_model[N2][N1][F2][F2];
+param_t conv2_biases_model[N2];
+param_t conv3_weights_model[N3][N2][F3][F3];
+param_t conv3_biases_model[N3];
+
+// writes bytes to fname, truncated to size
+static void write_file(const char *fname, const char *bytes, size_t size)
+{
+    FILE *fp = fopen(fname, "wb");
+    if (!fp)
+        throw runtime_error(string("Cannot create ") + fname);
+    fwrite(bytes, 1, size, fp);
+    fclose(fp);
+}
+
+// returns whether opening fname is rejected
+static bool rejected(const char *fname, bool verify)
+{
+    try {
+        srcnn_model_close(srcnn_model_open(fname, verify));
+    } catch (const runtime_error &) {
+        return true;
+    }
+    return false;
+}
+
+// model file testbench: the mapped container must hold exactly the .bin parameters
+int tb_model()
+{
+    load_image("./set5/butterfly_3x_LR_u8.bin", &img_LR_model[0][0][0], N0*H*W);
+
+    auto start = chrono::steady_clock::now();
+    load_param("./weights/conv1_weights_3x_flp.bin",
+               &conv1_weights_model[0][0][0][0],
+               N1*N0*F1*F1);
+    load_param("./weights/conv1_biases_3x_flp.bin",
+               &conv1_biases_model[0],
+               N1);
+    load_param("./weights/conv2_weights_3x_flp.bin",
+               &conv2_weights_model[0][0][0][0],
+               N2*N1*F2*F2);
+    load_param("./weights/conv2_biases_3x_flp.bin",
+               &conv2_biases_model[0],
+               N2);
+    load_param("./weights/conv3_weights_3x_flp.bin",
+               &conv3_weights_model[0][0][0][0],
+               N3*N2*F3*F3);
+    load_param("./weights/conv3_biases_3x_flp.bin",
+               &conv3_biases_model[0],
+               N3);
+    auto middle = chrono::steady_clock::now();
+    srcnn_model_file_t *file = srcnn_model_open("./weights/srcnn_3x.model");
+    auto stop = chrono::steady_clock::now();
+
+    cout << "***** SRCNN Model File *****" << endl;
+    cout << "  - Six load_param calls: " << chrono::duration<double, milli>(middle - start).count()
+         << " ms, mapping srcnn_3x.model with checksum: " << chrono::duration<double, milli>(stop - middle).count()
+         << " ms" << endl;
+
+    srcnn_model_t model = {
+        &conv1_weights_model[0][0][0][0], conv1_biases_model,
+        &conv2_weights_model[0][0][0][0], conv2_biases_model,
+        &conv3_weights_model[0][0][0][0], conv3_biases_model,
+    };
+    const srcnn_model_t *mapped = srcnn_model_get(file);
+
+    // same values, every array aligned for vector loads
+    bool same = memcmp(mapped->conv1_weights, model.conv1_weights, sizeof(conv1_weights_model)) == 0 &&
+                memcmp(mapped->conv1_biases, model.conv1_biases, sizeof(conv1_biases_model)) == 0 &&
+                memcmp(mapped->conv2_weights, model.conv2_weights, sizeof(conv2_weights_model)) == 0 &&
+                memcmp(mapped->conv2_biases, model.conv2_biases, sizeof(conv2_biases_model)) == 0 &&
+                memcmp(mapped->conv3_weights, model.conv3_weights, sizeof(conv3_weights_model)) == 0 &&
+                memcmp(mapped->conv3_biases, model.conv3_biases, sizeof(conv3_biases_model)) == 0;
+    const param_t *arrays[6] = { mapped->conv1_weights, mapped->conv1_biases, mapped->conv2_weights,
+                                 mapped->conv2_biases, mapped->conv3_weights, mapped->conv3_biases };
+    bool aligned = true;
+    for (int i = 0; i < 6; i++)
+        aligned = aligned && (size_t) arrays[i] % SRCNN_MODEL_ALIGN == 0;
+    cout << "  - Mapped parameters match the .bin files: " << (same ? "yes" : "NO")
+         << ", " << SRCNN_MODEL_ALIGN << "-byte aligned: " << (aligned ? "yes" : "NO") << endl;
+
+    // a context runs straight from the mapping
+    srcnn_ctx_t *ctx = srcnn_ctx_create(&model, H, W, SRCNN_MODE_SIMD);
+    srcnn_ctx_run(ctx, &img_LR_model[0][0][0], &img_HR_bin_model[0][0][0]);
+    srcnn_ctx_set_model(ctx, mapped);
+    srcnn_ctx_run(ctx, &img_LR_model[0][0][0], &img_HR_mapped_model[0][0][0]);
+    srcnn_ctx_destroy(ctx);
+    bool outputs = memcmp(img_HR_bin_model, img_HR_mapped_model, sizeof(img_HR_bin_model)) == 0;
+    cout << "  - Output with the mapped model identical: " << (outputs ? "yes" : "NO") << endl;
+
+    // the writer reproduces the shipped file, and damaged copies are rejected
+    const char *copy = "./srcnn_3x_tb.model";
+    srcnn_model_write(copy, &model);
+    srcnn_model_file_t *written = srcnn_model_open(copy);
+    bool reproducible = srcnn_model_header(written)->checksum == srcnn_model_header(file)->checksum;
+    srcnn_model_close(written);
+
+    const char *bytes = (const char *) srcnn_model_header(file);
+    size_t size = srcnn_model_header(file)->file_size;
+    vector<char> damaged(bytes, bytes + size);
+    damaged[size - 100] ^= 1;
+    write_file(copy, &damaged[0], size);
+    bool checksum = rejected(copy, true) && !rejected(copy, false);
+    write_file(copy, bytes, size - SRCNN_MODEL_ALIGN);
+    bool truncated = rejected(copy, false);
+    damaged.assign(bytes, bytes + size);
+    ((srcnn_model_header_t *) &damaged[0])->upscale = UP + 1;
+    write_file(copy, &damaged[0], size);
+    bool upscale = rejected(copy, false);
+    remove(copy);
+    cout << "  - Converter output reproducible: " << (reproducible ? "yes" : "NO")
+         << ", rejects corrupt: " << (checksum ? "yes" : "NO")
+         << ", truncated: " << (truncated ? "yes" : "NO")
+         << ", wrong upscale: " << (upscale ? "yes" : "NO") << endl;
+    cout << endl;
+
+    srcnn_model_close(file);
+
+    return same && aligned && outputs && reproducible && checksum && truncated && upscale ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <atomic>
+#include <stdexcept>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "thread_pool.h"
+#include "util.h"
+
+using namespace std;
+
+ftmap_t img_LR_parallel[N0][H][W];     // low resolution input image
+ftmap_t img_HR_serial[N3][H][W];       // serial simd output
+ftmap_t img_HR_parallel[N3][H][W];     // parallel output
+
+// multi-threaded engine testbench: output must not depend on the thread count
+int tb_parallel()
+{
+    const test_params_t &params = test_params();
+    string fname_LR = "./set5/butterfly_3x_LR_u8.bin";
+
+    load_image(fname_LR, &img_LR_parallel[0][0][0], N0*H*W);
+
+    srcnn_run(SRCNN_MODE_SIMD,
+              img_LR_parallel,
+              params.conv1_weights, params.conv1_biases,
+              params.conv2_weights, params.conv2_biases,
+              params.conv3_weights, params.conv3_biases,
+              img_HR_serial);
+
+    const srcnn_model_t *model = test_model();
+
+    cout << "***** SRCNN Parallel Engine *****" << endl;
+
+    bool ok = true;
+    int thread_counts[] = { 1, 2, 3, 16 };
+    for (int threads : thread_counts) {
+        thread_pool pool(threads);
+        srcnn_ctx_t *ctx = srcnn_ctx_create(model, H, W, SRCNN_MODE_PARALLEL, &pool);
+        memset(img_HR_parallel, 0, sizeof(img_HR_parallel));
+        srcnn_ctx_run(ctx, &img_LR_parallel[0][0][0], &img_HR_parallel[0][0][0]);
+        srcnn_ctx_destroy(ctx);
+
+        bool identical = memcmp(img_HR_parallel, img_HR_serial, sizeof(img_HR_serial)) == 0;
+        cout << "  - " << threads << " thread(s) bit-identical to serial: " << (identical ? "yes" : "NO") << endl;
+
+        // a parallel_for inside a task runs inline rather than deadlocking
+        atomic<int> runs(0);
+        pool.parallel_for(8, [&](int) {
+            pool.parallel_for(8, [&](int) { runs++; });
+        });
+        cout << "  - " << threads << " thread(s) nested parallel_for completed: "
+             << (runs == 64 ? "yes" : "NO") << endl;
+
+        // a throwing task reaches the caller once the others have run, and
+        // the pool stays usable
+        atomic<int> done(0);
+        bool thrown = false;
+        try {
+            pool.parallel_for(16, [&](int i) {
+                if (i == 5)
+                    throw runtime_error("task 5");
+                done++;
+            });
+        } catch (const runtime_error &) {
+            thrown = true;
+        }
+        pool.parallel_for(4, [&](int) { done++; });
+        bool rethrown = thrown && done == 19;
+        cout << "  - " << threads << " thread(s) task exception rethrown to the caller: "
+             << (rethrown ? "yes" : "NO") << endl;
+        ok = ok && identical && runs == 64 && rethrown;
+    }
+    cout << endl;
+
+    return ok ? 0 : 1;
+}
@@ -3,7 +3,14 @@
 #include <iomanip>
 #include <dirent.h>
 #include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
 #include "srcnn.h"
+#include "engine.h"
+#include "metrics.h"
 #include "util.h"
 
 using namespace std;
@@ -54,6 +61,13 @@ double software_HR_mse[] = {
 0.001711344
 };
 
+// nearest-rank percentile of sorted values
+static double percentile(const vector<double> &sorted, double p)
+{
+    int rank = (int) ceil(p/100*sorted.size());
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
 int tb_set14()
 {
 
@@ -86,47 +100,13 @@ int tb_set14()
     int i=0;
 
     // Open the directory
+    vector<string> LR_filenames;
     if ((dir = opendir(directoryPath.c_str())) != nullptr) {
-        // Read files from the directory
-
-        // print headers for table
-        std::cout << std::setw(15) << std::left << "Image Name"
-                  << std::setw(20) << std::left << "PSNR GT vs HR (dB)"
-                  << std::setw(27) << std::left << "PSNR GT vs HR MATLAB (dB)"
-			      << std::setw(20) << std::left << "PSNR GT vs LR (dB)" 
-                  << std::setw(15) << std::left << "MSE GT vs HR" 
-                  << std::setw(27) << std::left << "MSE GT vs HR MATLAB" << std::endl;
-
+        // Read files from the directory, only keep 'LR' entries
         while ((ent = readdir(dir)) != nullptr) {
-        	string filename(ent->d_name);
-        	size_t LR_pos = filename.find("LR") ; // check if LR is present in the filename string
-
-            // Skip '.' and '..' entries and 'GT' entries, only work on 'LR' entries
-            if (strcmp(ent->d_name, ".") != 0 && strcmp(ent->d_name, "..") != 0 && LR_pos != string::npos) {
-				load_image(directoryPath + filename, &img_LR_set14[0][0][0], N0*H*W);
-
-				std::string GT_filename(ent->d_name);
-				GT_filename.replace(LR_pos, 2, "GT");
-
-				load_image(directoryPath + GT_filename, &img_GT_set14[0][0][0], N3*H*W);
-
-				srcnn(img_LR_set14,
-					  conv1_weights_set14,
-					  conv1_biases_set14,
-					  conv2_weights_set14,
-					  conv2_biases_set14,
-					  conv3_weights_set14,
-					  conv3_biases_set14,
-					  img_HR_set14);
-
-                std::cout << std::setw(15) << std::left << filename.substr(0,(filename).find("_")) 
-                    << std::setw(20) << std::left <<  calculate_PSNR(&img_GT_set14[0][0][0], &img_HR_set14[0][0][0], H*W)
-                    << std::setw(27) << std::left <<  software_HR_psnr[i]
-                    << std::setw(20) << std::left <<  calculate_PSNR(&img_GT_set14[0][0][0], &img_LR_set14[0][0][0], H*W) 
-                    << std::setw(15) << std::left <<  calculate_mse(&img_GT_set14[0][0][0],&img_HR_set14[0][0][0],N3*H*W) 
-                    << std::setw(27) << std::left <<  software_HR_mse[i] << std::endl;
-                i++;
-            }
+            string filename(ent->d_name);
+            if (strcmp(ent->d_name, ".") != 0 && strcmp(ent->d_name, "..") != 0 && filename.find("LR") != string::npos)
+                LR_filenames.push_back(filename);
         }
         // Close the directory
         closedir(dir);
@@ -135,6 +115,118 @@ int tb_set14()
         perror("Error opening directory");
         return EXIT_FAILURE;
     }
+
+    // readdir order is unspecified, the MATLAB tables above are alphabetical
+    sort(LR_filenames.begin(), LR_filenames.end());
+
+    // start reading every image the loop below loads
+    vector<string> image_paths;
+    for (size_t n = 0; n < LR_filenames.size(); n++) {
+        string GT_filename = LR_filenames[n];
+        GT_filename.replace(GT_filename.find("LR"), 2, "GT");
+        image_paths.push_back(directoryPath + LR_filenames[n]);
+        image_paths.push_back(directoryPath + GT_filename);
+    }
+    readahead_files(image_paths);
+
+    // print headers for table
+    std::cout << std::setw(15) << std::left << "Image Name"
+              << std::setw(20) << std::left << "PSNR GT vs HR (dB)"
+              << std::setw(27) << std::left << "PSNR GT vs HR MATLAB (dB)"
+              << std::setw(20) << std::left << "PSNR GT vs LR (dB)"
+              << std::setw(15) << std::left << "MSE GT vs HR"
+              << std::setw(22) << std::left << "MSE GT vs HR MATLAB"
+              << std::setw(15) << std::left << "SSIM GT vs HR" << std::endl;
+
+    int count = (int) LR_filenames.size();
+    vector<ftmap_t> LR_images((size_t) count*N0*H*W);
+    vector<ftmap_t> GT_images((size_t) count*N3*H*W);
+    vector<double> HR_psnr(count);
+
+    for (const string &filename : LR_filenames) {
+        size_t LR_pos = filename.find("LR");
+        load_image(directoryPath + filename, &img_LR_set14[0][0][0], N0*H*W);
+
+        std::string GT_filename(filename);
+        GT_filename.replace(LR_pos, 2, "GT");
+
+        load_image(directoryPath + GT_filename, &img_GT_set14[0][0][0], N3*H*W);
+
+        srcnn(img_LR_set14,
+              conv1_weights_set14,
+              conv1_biases_set14,
+              conv2_weights_set14,
+              conv2_biases_set14,
+              conv3_weights_set14,
+              conv3_biases_set14,
+              img_HR_set14);
+
+        // every metric of an image in one pass, see metrics.h
+        image_metrics_t HR = image_metrics(&img_HR_set14[0][0][0], &img_GT_set14[0][0][0], H, W);
+        image_metrics_t LR = image_metrics(&img_LR_set14[0][0][0], &img_GT_set14[0][0][0], H, W);
+        HR_psnr[i] = HR.psnr;
+        std::cout << std::setw(15) << std::left << filename.substr(0,(filename).find("_"))
+            << std::setw(20) << std::left <<  HR.psnr
+            << std::setw(27) << std::left <<  software_HR_psnr[i]
+            << std::setw(20) << std::left <<  LR.psnr
+            << std::setw(15) << std::left <<  HR.mse
+            << std::setw(22) << std::left <<  software_HR_mse[i]
+            << std::setw(15) << std::left <<  HR.ssim << std::endl;
+
+        // keep the images for the batch run below
+        memcpy(&LR_images[(size_t) i*N0*H*W], img_LR_set14, sizeof(img_LR_set14));
+        memcpy(&GT_images[(size_t) i*N3*H*W], img_GT_set14, sizeof(img_GT_set14));
+        i++;
+    }
+    std::cout << std::endl;
+
+    // batch mode: every image at once through the batch API, in the engine
+    // mode named by SRCNN_MODE (default simd)
+    srcnn_mode_t mode = SRCNN_MODE_SIMD;
+    if (getenv("SRCNN_MODE") && !srcnn_mode_parse(getenv("SRCNN_MODE"), &mode))
+        std::cout << "Unknown SRCNN_MODE " << getenv("SRCNN_MODE") << ", using simd" << std::endl;
+
+    srcnn_model_t model = {
+        &conv1_weights_set14[0][0][0][0], conv1_biases_set14,
+        &conv2_weights_set14[0][0][0][0], conv2_biases_set14,
+        &conv3_weights_set14[0][0][0][0], conv3_biases_set14,
+    };
+    vector<ftmap_t> HR_images((size_t) count*N3*H*W);
+    vector<const ftmap_t *> inputs(count);
+    vector<ftmap_t *> outputs(count);
+    vector<const ftmap_t *> references(count);
+    for (int n = 0; n < count; n++) {
+        inputs[n] = &LR_images[(size_t) n*N0*H*W];
+        outputs[n] = &HR_images[(size_t) n*N3*H*W];
+        references[n] = &GT_images[(size_t) n*N3*H*W];
+    }
+    vector<image_metrics_t> metrics(count);
+    vector<double> latency_ms(count);
+
+    srcnn_batch_t *batch = srcnn_batch_create(&model, H, W, mode);
+    srcnn_batch_run(batch, count, inputs.data(), outputs.data());   // warm up the workspaces
+    auto start = std::chrono::steady_clock::now();
+    srcnn_batch_run_scored(batch, count, inputs.data(), outputs.data(), references.data(), metrics.data(),
+                           latency_ms.data());
+    double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    srcnn_batch_destroy(batch);
+
+    double psnr_diff = 0;
+    for (int n = 0; n < count; n++)
+        psnr_diff = fmax(psnr_diff, fabs(metrics[n].psnr - HR_psnr[n]));
+    sort(latency_ms.begin(), latency_ms.end());
+
+    cout << "***** SRCNN - Set14 Batch (" << srcnn_mode_name(mode) << ", "
+         << thread_pool_default().size() << " thread(s)) *****" << endl;
+    cout << "  - Images: " << count << ", wall time: " << wall_ms << " ms, "
+         << count/(wall_ms/1000) << " images/s" << endl;
+    cout << "  - Latency per image (ms): p50 " << percentile(latency_ms, 50)
+         << ", p90 " << percentile(latency_ms, 90)
+         << ", p99 " << percentile(latency_ms, 99)
+         << ", max " << latency_ms.back() << endl;
+    cout << "  - Max PSNR difference to the srcnn() run: " << psnr_diff << " dB" << endl;
+    cout << endl;
+
 //    write_bin(" ", &img_HR[0][0][0], H*W);
 	return 0;
 }
@@ -0,0 +1,105 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cmath>
+
+#include "srcnn.h"
+#include "kernels.h"
+#include "simd.h"
+#include "util.h"
+
+using namespace std;
+
+ftmap_t img_LR_simd[N0][H][W];     // low resolution input image
+ftmap_t layer1_ref_simd[N1][H][W]; // reference layer outputs
+ftmap_t layer2_ref_simd[N2][H][W];
+ftmap_t layer3_ref_simd[N3][H][W];
+ftmap_t layer1_simd[N1][H][W];     // dispatched kernel outputs
+ftmap_t layer2_simd[N2][H][W];
+ftmap_t layer3_simd[N3][H][W];
+
+// returns the largest absolute difference between two feature maps
+static double max_abs_diff(ftmap_t *a, ftmap_t *b, int count)
+{
+    double diff = 0;
+    for (int i = 0; i < count; i++)
+        diff = fmax(diff, fabs((double) a[i] - b[i]));
+    return diff;
+}
+
+// SIMD kernel testbench: every ISA the CPU supports against the reference loops
+int tb_simd()
+{
+    const test_params_t &params = test_params();
+    string fname_LR = "./set5/butterfly_3x_LR_u8.bin";
+
+    load_image(fname_LR, &img_LR_simd[0][0][0], N0*H*W);
+
+    conv1(img_LR_simd, params.conv1_weights, params.conv1_biases, layer1_ref_simd);
+    conv2(layer1_ref_simd, params.conv2_weights, params.conv2_biases, layer2_ref_simd);
+    conv3(layer2_ref_simd, params.conv3_weights, params.conv3_biases, layer3_ref_simd);
+
+    conv_layer_t layer1 = { N0, N1, F1, &params.conv1_weights[0][0][0][0], params.conv1_biases };
+    conv_layer_t layer2 = { N1, N2, F2, &params.conv2_weights[0][0][0][0], params.conv2_biases };
+    conv_layer_t layer3 = { N2, N3, F3, &params.conv3_weights[0][0][0][0], params.conv3_biases };
+
+    cout << "***** SIMD Kernels (detected: " << simd_isa_name(simd_detect()) << ") *****" << endl;
+    cout << "  " << setw(8) << left << "ISA"
+         << setw(14) << left << "Kernel"
+         << setw(14) << left << "CONV1 max err"
+         << setw(14) << left << "CONV2 max err"
+         << setw(14) << left << "CONV3 max err" << endl;
+
+    // kernels run layer by layer on the reference inputs so errors do not compound
+    simd_isa_t isa = simd_isa();
+    bool ok = true;
+    for (int i = 0; i <= simd_detect(); i++) {
+        simd_set_isa((simd_isa_t) i);
+
+        conv_direct(&layer1, ftmap_view(&img_LR_simd[0][0][0], H, W), H, W,
+                    ftmap_view(&layer1_simd[0][0][0], H, W), 0, N1, 0, H, 0, W);
+        conv_direct(&layer2, ftmap_view(&layer1_ref_simd[0][0][0], H, W), H, W,
+                    ftmap_view(&layer2_simd[0][0][0], H, W), 0, N2, 0, H, 0, W);
+        conv_direct(&layer3, ftmap_view(&layer2_ref_simd[0][0][0], H, W), H, W,
+                    ftmap_view(&layer3_simd[0][0][0], H, W), 0, N3, 0, H, 0, W);
+        double direct_err[3] = {
+            max_abs_diff(&layer1_ref_simd[0][0][0], &layer1_simd[0][0][0], N1*H*W),
+            max_abs_diff(&layer2_ref_simd[0][0][0], &layer2_simd[0][0][0], N2*H*W),
+            max_abs_diff(&layer3_ref_simd[0][0][0], &layer3_simd[0][0][0], N3*H*W),
+        };
+
+        conv1_gemm(&img_LR_simd[0][0][0], &params.conv1_weights[0][0][0][0], params.conv1_biases,
+                   H, W, &layer1_simd[0][0][0]);
+        conv2_gemm(&layer1_ref_simd[0][0][0], &params.conv2_weights[0][0][0][0], params.conv2_biases,
+                   H, W, &layer2_simd[0][0][0]);
+        conv3_gemm(&layer2_ref_simd[0][0][0], &params.conv3_weights[0][0][0][0], params.conv3_biases,
+                   H, W, &layer3_simd[0][0][0]);
+        double gemm_err[3] = {
+            max_abs_diff(&layer1_ref_simd[0][0][0], &layer1_simd[0][0][0], N1*H*W),
+            max_abs_diff(&layer2_ref_simd[0][0][0], &layer2_simd[0][0][0], N2*H*W),
+            max_abs_diff(&layer3_ref_simd[0][0][0], &layer3_simd[0][0][0], N3*H*W),
+        };
+
+        cout << "  " << setw(8) << left << simd_isa_name((simd_isa_t) i)
+             << setw(14) << left << "direct"
+             << setw(14) << left << direct_err[0]
+             << setw(14) << left << direct_err[1]
+             << setw(14) << left << direct_err[2] << endl;
+        cout << "  " << setw(8) << left << simd_isa_name((simd_isa_t) i)
+             << setw(14) << left << gemm_kernel()->name
+             << setw(14) << left << gemm_err[0]
+             << setw(14) << left << gemm_err[1]
+             << setw(14) << left << gemm_err[2] << endl;
+
+        // FMA kernels only differ by rounding; the scalar ones must be exact
+        double tolerance = i == SIMD_ISA_SCALAR ? 0 : 1e-5;
+        for (int l = 0; l < 3; l++)
+            ok = ok && direct_err[l] <= tolerance && gemm_err[l] <= tolerance;
+    }
+    simd_set_isa(isa);
+
+    cout << "  - Within tolerance: " << (ok ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cmath>
+#include <vector>
+#include <chrono>
+#include <functional>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "kernels.h"
+#include "simd.h"
+#include "util.h"
+
+using namespace std;
+
+#define SPARSE_IMAGES 14
+#define SPARSE_RUNS   3
+
+// butterfly from Set5, then Set14 in the order of the MATLAB tables
+static const char *sparse_images[SPARSE_IMAGES] = {
+    "set5/butterfly",
+    "set14/baboon", "set14/barbara", "set14/bridge", "set14/coastguard", "set14/face",
+    "set14/flowers", "set14/foreman", "set14/lenna", "set14/man", "set14/monarch",
+    "set14/pepper", "set14/ppt3", "set14/zebra",
+};
+
+// pruning tolerances of the sweep, 0 keeps every weight
+static const float sparse_prune[] = { 0, 1e-3f, 3e-3f, 1e-2f };
+
+ftmap_t img_LR_sparse[N0][H][W];        // low resolution input image
+ftmap_t img_GT_sparse[N3][H][W];        // ground truth
+ftmap_t layer1_ref_sparse[N1][H][W];    // reference conv1 output
+ftmap_t layer2_ref_sparse[N2][H][W];    // reference conv2 output
+ftmap_t img_HR_ref_sparse[N3][H][W];    // reference conv3 output
+ftmap_t img_HR_sparse[N3][H][W];        // sparse output
+
+// returns the largest absolute difference between two feature maps
+static double max_abs_diff(const ftmap_t *a, const ftmap_t *b, long count)
+{
+    double diff = 0;
+    for (long i = 0; i < count; i++)
+        diff = fmax(diff, fabs((double) a[i] - b[i]));
+    return diff;
+}
+
+// best of runs wall-clock milliseconds
+static double best_ms(int runs, const function<void()> &body)
+{
+    double best = 1e30;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        body();
+        best = fmin(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+// sparse conv2 and conv3 against the reference maps on the current ISA, and
+// conv2's output masks against the masks of its output
+static double sparse_layer_err(const conv_sparse_weights_t *packed, bool *masks_ok)
+{
+    const test_params_t &params = test_params();
+    long pixels = (long) H*W;
+    vector<ftmap_t> map1((size_t) N1*pixels), map2((size_t) N2*pixels), planar2((size_t) N2*pixels), out(pixels);
+    vector<ftmap_mask_t> masks(pixels), expected(pixels);
+
+    ftmap_to_nhwc(&layer1_ref_sparse[0][0][0], N1, H, W, &map1[0]);
+    conv2_sparse(&map1[0], packed, params.conv2_biases, H, W, &map2[0], &masks[0]);
+    ftmap_nonzero_masks(&map2[0], N2, pixels, &expected[0]);
+    *masks_ok = masks == expected;
+    ftmap_to_nchw(&map2[0], N2, H, W, &planar2[0]);
+    double err = max_abs_diff(&layer2_ref_sparse[0][0][0], &planar2[0], N2*pixels);
+
+    ftmap_to_nhwc(&layer2_ref_sparse[0][0][0], N2, H, W, &map2[0]);
+    ftmap_nonzero_masks(&map2[0], N2, pixels, &masks[0]);
+    conv3_sparse(&map2[0], &masks[0], packed, params.conv3_biases, H, W, ftmap_view(&out[0], H, W));
+    return fmax(err, max_abs_diff(&img_HR_ref_sparse[0][0][0], &out[0], pixels));
+}
+
+// sparse mode against the simd mode on a crop of h x w pixels at (0, 0)
+static double sparse_crop_err(const srcnn_model_t *model, int h, int w)
+{
+    vector<ftmap_t> crop((size_t) h*w), dense((size_t) h*w), sparse((size_t) h*w);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            crop[(long) y*w + x] = img_LR_sparse[0][y][x];
+
+    srcnn_ctx_t *ctx = srcnn_ctx_create(model, h, w, SRCNN_MODE_SIMD);
+    srcnn_ctx_run(ctx, &crop[0], &dense[0]);
+    srcnn_ctx_destroy(ctx);
+    ctx = srcnn_ctx_create(model, h, w, SRCNN_MODE_SPARSE);
+    srcnn_ctx_run(ctx, &crop[0], &sparse[0]);
+    srcnn_ctx_destroy(ctx);
+    return max_abs_diff(&dense[0], &sparse[0], (long) h*w);
+}
+
+// activation-sparsity testbench: sparse conv2/conv3 on every ISA, measured
+// ReLU output density per layer on Set5 and Set14, the time skipping zeros
+// saves, and what pruning small weights costs in PSNR
+int tb_sparse()
+{
+    const test_params_t &params = test_params();
+
+    const srcnn_model_t *model = test_model();
+
+    load_image("./set5/butterfly_3x_LR_u8.bin", &img_LR_sparse[0][0][0], N0*H*W);
+    conv1(img_LR_sparse, params.conv1_weights, params.conv1_biases, layer1_ref_sparse);
+    conv2(layer1_ref_sparse, params.conv2_weights, params.conv2_biases, layer2_ref_sparse);
+    conv3(layer2_ref_sparse, params.conv3_weights, params.conv3_biases, img_HR_ref_sparse);
+
+    cout << "***** SRCNN Activation Sparsity *****" << endl;
+
+    vector<conv_sparse_weights_t> packed(1);
+    conv_sparse_pack(model->conv2_weights, model->conv3_weights, 0, &packed[0]);
+
+    // every ISA, on the whole image and on crops down to a single row
+    const int crops[][2] = { { 100, 77 }, { 3, 19 }, { 1, 5 } };
+    simd_isa_t isa = simd_isa();
+    bool ok = true;
+    for (int i = 0; i <= simd_detect(); i++) {
+        simd_set_isa((simd_isa_t) i);
+        bool masks_ok;
+        double err = sparse_layer_err(&packed[0], &masks_ok);
+        double crop_err = 0;
+        for (const int *c : crops)
+            crop_err = fmax(crop_err, sparse_crop_err(model, c[0], c[1]));
+        cout << "  - " << setw(8) << left << simd_isa_name((simd_isa_t) i) << "max err " << err
+             << ", crops " << crop_err << ", conv2 masks " << (masks_ok ? "match" : "DIFFER") << endl;
+        ok = ok && err <= 1e-5 && crop_err <= 1e-4 && masks_ok;
+    }
+    simd_set_isa(isa);
+
+    // measured density of the ReLU outputs each sparse layer reads
+    long pixels = (long) H*W;
+    vector<ftmap_t> map1((size_t) N1*pixels), map2((size_t) N2*pixels), out(pixels);
+    vector<ftmap_mask_t> masks1(pixels), masks2(pixels);
+    cout << "  " << setw(12) << left << "Image"
+         << setw(14) << left << "conv1 density"
+         << setw(14) << left << "conv2 density" << endl;
+    double density1 = 0, density2 = 0;
+    for (int i = 0; i < SPARSE_IMAGES; i++) {
+        load_image(string("./") + sparse_images[i] + "_3x_LR_u8.bin", &img_LR_sparse[0][0][0], N0*H*W);
+        conv1_layout(ftmap_view(&img_LR_sparse[0][0][0], H, W), model->conv1_weights,
+                     model->conv1_biases, H, W, &map1[0], FTMAP_NHWC);
+        ftmap_nonzero_masks(&map1[0], N1, pixels, &masks1[0]);
+        conv2_sparse(&map1[0], &packed[0], params.conv2_biases, H, W, &map2[0], &masks2[0]);
+        double d1 = ftmap_mask_density(&masks1[0], N1, pixels);
+        double d2 = ftmap_mask_density(&masks2[0], N2, pixels);
+        density1 += d1/SPARSE_IMAGES;
+        density2 += d2/SPARSE_IMAGES;
+        cout << "  " << setw(12) << left << string(sparse_images[i]).substr(string(sparse_images[i]).find('/') + 1)
+             << setw(14) << left << d1
+             << setw(14) << left << d2 << endl;
+    }
+    cout << "  - Mean density: conv1 output " << density1 << ", conv2 output " << density2 << endl;
+
+    // dense channel-last layers against the sparse ones, on the last image
+    double dense2 = best_ms(SPARSE_RUNS, [&]() {
+        conv2_layout(&map1[0], FTMAP_NHWC, model->conv2_weights, model->conv2_biases,
+                     H, W, &map2[0], FTMAP_NHWC);
+    });
+    double dense3 = best_ms(SPARSE_RUNS, [&]() {
+        conv3_layout(&map2[0], FTMAP_NHWC, model->conv3_weights, model->conv3_biases,
+                     H, W, ftmap_view(&out[0], H, W));
+    });
+    vector<float> ring(conv3_sparse_workspace_size(W));
+    double sparse2 = best_ms(SPARSE_RUNS, [&]() {
+        conv2_sparse(&map1[0], &packed[0], params.conv2_biases, H, W, &map2[0], &masks2[0]);
+    });
+    double sparse3 = best_ms(SPARSE_RUNS, [&]() {
+        conv3_sparse(&map2[0], &masks2[0], &packed[0], params.conv3_biases, H, W, ftmap_view(&out[0], H, W), &ring[0]);
+    });
+    cout << "  - Per layer on " << simd_isa_name(isa) << " (best of " << SPARSE_RUNS << ", ms): conv2 dense "
+         << dense2 << ", sparse " << sparse2 << "; conv3 dense " << dense3 << ", sparse " << sparse3 << endl;
+
+    // pruning sweep: weights pruned, channels left and PSNR against float
+    srcnn_ctx_t *ctx = srcnn_ctx_create(model, H, W, SRCNN_MODE_SPARSE);
+    srcnn_ctx_t *blocked = srcnn_ctx_create(model, H, W, SRCNN_MODE_BLOCKED);
+    cout << "  " << setw(12) << left << "Prune"
+         << setw(10) << left << "Pruned"
+         << setw(14) << left << "Live conv2"
+         << setw(14) << left << "Live conv3"
+         << setw(12) << left << "Mean PSNR"
+         << setw(12) << left << "Time (ms)" << endl;
+    double dense_psnr = 0, exact_psnr = 0;
+    for (int i = 0; i < SPARSE_IMAGES; i++) {
+        load_image(string("./") + sparse_images[i] + "_3x_LR_u8.bin", &img_LR_sparse[0][0][0], N0*H*W);
+        load_image(string("./") + sparse_images[i] + "_3x_GT_u8.bin", &img_GT_sparse[0][0][0], N3*H*W);
+        srcnn_ctx_run(blocked, &img_LR_sparse[0][0][0], &img_HR_sparse[0][0][0]);
+        dense_psnr += calculate_PSNR(&img_GT_sparse[0][0][0], &img_HR_sparse[0][0][0], H*W)/SPARSE_IMAGES;
+    }
+    for (float tolerance : sparse_prune) {
+        long pruned = srcnn_ctx_set_prune(ctx, tolerance);
+        conv_sparse_pack(model->conv2_weights, model->conv3_weights, tolerance, &packed[0]);
+        double psnr = 0;
+        for (int i = 0; i < SPARSE_IMAGES; i++) {
+            load_image(string("./") + sparse_images[i] + "_3x_LR_u8.bin", &img_LR_sparse[0][0][0], N0*H*W);
+            load_image(string("./") + sparse_images[i] + "_3x_GT_u8.bin", &img_GT_sparse[0][0][0], N3*H*W);
+            srcnn_ctx_run(ctx, &img_LR_sparse[0][0][0], &img_HR_sparse[0][0][0]);
+            psnr += calculate_PSNR(&img_GT_sparse[0][0][0], &img_HR_sparse[0][0][0], H*W)/SPARSE_IMAGES;
+        }
+        if (tolerance == 0)
+            exact_psnr = psnr;
+        double ms = best_ms(SPARSE_RUNS, [&]() {
+            srcnn_ctx_run(ctx, &img_LR_sparse[0][0][0], &img_HR_sparse[0][0][0]);
+        });
+        cout << "  " << setw(12) << left << tolerance
+             << setw(10) << left << pruned
+             << setw(14) << left << __builtin_popcountll(packed[0].live2)
+             << setw(14) << left << __builtin_popcountll(packed[0].live3)
+             << setw(12) << left << psnr
+             << setw(12) << left << ms << endl;
+    }
+    double blocked_ms = best_ms(SPARSE_RUNS, [&]() {
+        srcnn_ctx_run(blocked, &img_LR_sparse[0][0][0], &img_HR_sparse[0][0][0]);
+    });
+    cout << "  - Blocked mode " << blocked_ms << " ms, mean PSNR " << dense_psnr << endl;
+    srcnn_ctx_destroy(ctx);
+    srcnn_ctx_destroy(blocked);
+
+    // without pruning the sparse mode only skips exact zeros
+    ok = ok && fabs(exact_psnr - dense_psnr) < 1e-3;
+    cout << "  - Within tolerance: " << (ok ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return ok ? 0 : 1;
+}
@@ -1,7 +1,9 @@
 #include <iostream>
 #include <string>
+#include <cstring>
 
 #include "srcnn.h"
+#include "engine.h"
 #include "util.h"
 
 using namespace std;
@@ -9,6 +11,8 @@ using namespace std;
 ftmap_t img_LR[N0][H][W];  // low resolution input image
 ftmap_t img_HR[N0][H][W];  // high-resolution output image
 ftmap_t img_GR[N0][H][W];  // high-resolution golden reference
+ftmap_t img_HR_mode[N0][H][W];  // high-resolution output of the other engine modes
+ftmap_t img_HR_fresh[N0][H][W]; // output of a context created for the current weights
 
 // parameter dimensions
 //   weights: output features x input features x kernel height x kernel width
@@ -69,7 +73,55 @@ int tb_srcnn()
 
     cout << "***** SRCNN Golden Reference *****" << endl;
     cout << "  - Butterfly MSE: " << mse << endl;
+
+    // repeat with every other execution mode of the native engine
+    for (int m = SRCNN_MODE_REFERENCE + 1; m < SRCNN_MODE_COUNT; m++) {
+        srcnn_mode_t mode = (srcnn_mode_t) m;
+        srcnn_run(mode,
+                  img_LR,
+                  conv1_weights,
+                  conv1_biases,
+                  conv2_weights,
+                  conv2_biases,
+                  conv3_weights,
+                  conv3_biases,
+                  img_HR_mode);
+
+        double mse_mode = calculate_mse(&img_GR[0][0][0],
+                                        &img_HR_mode[0][0][0],
+                                        N3*H*W);
+        cout << "  - Butterfly MSE (" << srcnn_mode_name(mode) << "): " << mse_mode << endl;
+    }
+
+    // weights changed in place between two srcnn_run() calls are picked up
+    // by the modes that keep packed copies of them
+    srcnn_model_t model = {
+        &conv1_weights[0][0][0][0], conv1_biases,
+        &conv2_weights[0][0][0][0], conv2_biases,
+        &conv3_weights[0][0][0][0], conv3_biases,
+    };
+    param_t saved[3] = { conv1_weights[5][0][4][4], conv2_weights[3][7][0][0], conv3_weights[0][9][2][2] };
+    conv1_weights[5][0][4][4] += 0.5f;
+    conv2_weights[3][7][0][0] -= 0.5f;
+    conv3_weights[0][9][2][2] += 0.25f;
+    bool updated = true;
+    srcnn_mode_t packed_modes[3] = { SRCNN_MODE_GEMM, SRCNN_MODE_FFT, SRCNN_MODE_SPARSE };
+    for (srcnn_mode_t mode : packed_modes) {
+        srcnn_run(mode, img_LR,
+                  conv1_weights, conv1_biases,
+                  conv2_weights, conv2_biases,
+                  conv3_weights, conv3_biases,
+                  img_HR_mode);
+        srcnn_ctx_t *ctx = srcnn_ctx_create(&model, H, W, mode);
+        srcnn_ctx_run(ctx, &img_LR[0][0][0], &img_HR_fresh[0][0][0]);
+        srcnn_ctx_destroy(ctx);
+        updated = updated && memcmp(img_HR_mode, img_HR_fresh, sizeof(img_HR_mode)) == 0;
+    }
+    conv1_weights[5][0][4][4] = saved[0];
+    conv2_weights[3][7][0][0] = saved[1];
+    conv3_weights[0][9][2][2] = saved[2];
+    cout << "  - Weights changed in place used by gemm, fft and sparse: " << (updated ? "yes" : "NO") << endl;
     cout << endl;
 
-    return 0;
+    return updated ? 0 : 1;
 }
@@ -0,0 +1,147 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cmath>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "stream.h"
+#include "util.h"
+
+using namespace std;
+
+#define STREAM_FRAMES 14
+
+// butterfly from Set5, then Set14, as one 14-frame clip
+static const char *stream_images[STREAM_FRAMES] = {
+    "set5/butterfly",
+    "set14/baboon", "set14/barbara", "set14/bridge", "set14/coastguard", "set14/face",
+    "set14/flowers", "set14/foreman", "set14/lenna", "set14/man", "set14/monarch",
+    "set14/pepper", "set14/ppt3", "set14/zebra",
+};
+
+ftmap_t img_LR_stream[N0][H][W];        // low resolution input frame
+ftmap_t img_GT_stream[N3][H][W];        // ground truth frame
+ftmap_t img_HR_stream[N3][H][W];        // streamed output frame, dequantized
+
+// streams the clip from fp (closed here) into a file and returns its bytes
+static vector<uint8_t> stream_clip(const srcnn_model_t *model, FILE *fp, bool piped, int depth,
+                                   srcnn_stream_stats_t *stats)
+{
+    FILE *out = fopen("./tb_stream_out.bin", "wb");
+    try {
+        srcnn_stream_run(model, H, W, SRCNN_MODE_SIMD, fp, out, depth, stats);
+    } catch (...) {
+        piped ? pclose(fp) : fclose(fp);
+        fclose(out);
+        remove("./tb_stream_out.bin");
+        throw;
+    }
+    piped ? pclose(fp) : fclose(fp);
+    fclose(out);
+
+    vector<uint8_t> bytes;
+    FILE *in = fopen("./tb_stream_out.bin", "rb");
+    for (int c; (c = fgetc(in)) != EOF;)
+        bytes.push_back((uint8_t) c);
+    fclose(in);
+    remove("./tb_stream_out.bin");
+    return bytes;
+}
+
+static void print_stats(const char *name, const srcnn_stream_stats_t &stats, double serial_fps)
+{
+    cout << "  - " << name << ": " << stats.frames << " frames in " << stats.seconds << " s, "
+         << stats.fps << " fps, " << stats.fps/serial_fps << "x the serial loop" << endl;
+    for (int s = 0; s < SRCNN_STREAM_STAGES; s++) {
+        const srcnn_stream_stage_t &stage = stats.stage[s];
+        cout << "      " << setw(6) << left << srcnn_stream_stage_name((srcnn_stream_stage_id_t) s)
+             << "busy " << setw(9) << left << stage.busy_ms
+             << "starved " << setw(9) << left << stage.starved_ms
+             << "blocked " << setw(9) << left << stage.blocked_ms
+             << "stalls " << stage.stalls << endl;
+    }
+}
+
+// video streaming testbench: the overlapped read / infer / write pipeline
+// from a file and from a pipe against serial inference and quantization,
+// frame for frame, its sustained frame rate against the serial loop, and
+// how it reports a truncated stream
+int tb_stream()
+{
+    const srcnn_model_t *model = test_model();
+
+    cout << "***** SRCNN Video Streaming *****" << endl;
+
+    // the clip as one raw file, and the serial read / infer / quantize loop
+    long pixels = (long) H*W;
+    vector<uint8_t> serial((size_t) STREAM_FRAMES*pixels);
+    FILE *clip = fopen("./tb_stream_clip.bin", "wb");
+    srcnn_ctx_t *ctx = srcnn_ctx_create(model, H, W, SRCNN_MODE_SIMD);
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < STREAM_FRAMES; i++) {
+        mapped_file_t file = map_file(string("./") + stream_images[i] + "_3x_LR_u8.bin");
+        if (file.size < (size_t) pixels)
+            throw runtime_error(string("Unexpected size of ") + stream_images[i]);
+        fwrite(file.data, 1, pixels, clip);
+        u8_to_ftmap(file.data, &img_LR_stream[0][0][0], N0*H*W);
+        unmap_file(file);
+        srcnn_ctx_run(ctx, &img_LR_stream[0][0][0], &img_HR_stream[0][0][0]);
+        ftmap_to_u8(&img_HR_stream[0][0][0], &serial[(size_t) i*pixels], N3*H*W);
+    }
+    double serial_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    srcnn_ctx_destroy(ctx);
+    fclose(clip);
+    double serial_fps = STREAM_FRAMES/serial_s;
+    cout << "  - Serial loop: " << STREAM_FRAMES << " frames in " << serial_s << " s, "
+         << serial_fps << " fps" << endl;
+
+    // from the file with double buffering, and through a pipe with one
+    // buffer per link (no overlap between neighbouring stages) and with four
+    srcnn_stream_stats_t stats;
+    vector<uint8_t> streamed = stream_clip(model, fopen("./tb_stream_clip.bin", "rb"), false, 2, &stats);
+    print_stats("File, depth 2", stats, serial_fps);
+    bool ok = streamed == serial && stats.frames == STREAM_FRAMES;
+    for (int depth : { 1, 4 }) {
+        streamed = stream_clip(model, popen("cat ./tb_stream_clip.bin", "r"), true, depth, &stats);
+        print_stats(depth == 1 ? "Pipe, depth 1" : "Pipe, depth 4", stats, serial_fps);
+        ok = ok && streamed == serial && stats.frames == STREAM_FRAMES;
+    }
+    cout << "  - Frames identical to the serial loop: " << (ok ? "yes" : "NO") << endl;
+
+    // quality of the streamed frames, from their u8 values
+    double psnr = 0;
+    for (int i = 0; i < STREAM_FRAMES; i++) {
+        load_image(string("./") + stream_images[i] + "_3x_GT_u8.bin", &img_GT_stream[0][0][0], N3*H*W);
+        u8_to_ftmap(&streamed[(size_t) i*pixels], &img_HR_stream[0][0][0], N3*H*W);
+        psnr += calculate_PSNR(&img_GT_stream[0][0][0], &img_HR_stream[0][0][0], H*W)/STREAM_FRAMES;
+    }
+    cout << "  - Mean PSNR of the streamed frames: " << psnr << " dB" << endl;
+
+    // a clip cut in the middle of a frame fails after writing the complete ones
+    FILE *cut = fopen("./tb_stream_clip.bin", "rb");
+    FILE *partial = fopen("./tb_stream_partial.bin", "wb");
+    vector<uint8_t> head(pixels*2 + pixels/2);
+    size_t got = fread(&head[0], 1, head.size(), cut);
+    fwrite(&head[0], 1, got, partial);
+    fclose(cut);
+    fclose(partial);
+    bool rejected = false;
+    try {
+        stream_clip(model, fopen("./tb_stream_partial.bin", "rb"), false, 2, &stats);
+    } catch (const runtime_error &e) {
+        rejected = true;
+        cout << "  - Partial frame: " << e.what() << " after " << stats.frames << " frames" << endl;
+    }
+    ok = ok && rejected && stats.frames == 2;
+    remove("./tb_stream_partial.bin");
+    remove("./tb_stream_clip.bin");
+
+    cout << "  - Within tolerance: " << (ok ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return ok ? 0 : 1;
+}
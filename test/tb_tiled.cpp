@@ -0,0 +1,93 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "util.h"
+
+using namespace std;
+
+// 2 x 2 mosaic of Set14 images, with rows padded to a stride wider than the image
+#define MOSAIC_H (2*H)
+#define MOSAIC_W (2*W)
+#define MOSAIC_STRIDE (MOSAIC_W + 13)
+
+ftmap_t img_LR_tiled[N0][H][W];                         // one tile of the mosaic
+ftmap_t img_mosaic_tiled[N0][MOSAIC_H][MOSAIC_STRIDE];  // strided mosaic input
+ftmap_t img_mosaic_packed_tiled[N0][MOSAIC_H][MOSAIC_W];
+ftmap_t img_HR_whole_tiled[N3][MOSAIC_H][MOSAIC_W];     // whole-image simd output
+ftmap_t img_HR_tiled[N3][MOSAIC_H][MOSAIC_STRIDE];      // tiled output, strided
+ftmap_t img_HR_strided_tiled[N3][H][W + 5];             // strided output of each mode
+ftmap_t img_HR_packed_tiled[N3][H][W];                  // packed output of each mode
+ftmap_t img_LR_strided_tiled[N0][H][W + 3];
+
+// tiled execution testbench: seams must match whole-image processing exactly
+int tb_tiled()
+{
+    const char *mosaic[4] = { "baboon", "barbara", "lenna", "zebra" };
+
+    for (int i = 0; i < 4; i++) {
+        load_image(string("./set14/") + mosaic[i] + "_3x_LR_u8.bin", &img_LR_tiled[0][0][0], N0*H*W);
+        for (int y = 0; y < H; y++)
+            for (int x = 0; x < W; x++) {
+                img_mosaic_tiled[0][i/2*H + y][i%2*W + x] = img_LR_tiled[0][y][x];
+                img_mosaic_packed_tiled[0][i/2*H + y][i%2*W + x] = img_LR_tiled[0][y][x];
+            }
+    }
+
+    const srcnn_model_t *model = test_model();
+
+    cout << "***** SRCNN Tiled Execution *****" << endl;
+
+    // whole image against tiles read from and written to strided buffers
+    srcnn_ctx_t *whole = srcnn_ctx_create(model, MOSAIC_H, MOSAIC_W, SRCNN_MODE_SIMD);
+    srcnn_ctx_run(whole, &img_mosaic_packed_tiled[0][0][0], &img_HR_whole_tiled[0][0][0]);
+    srcnn_ctx_destroy(whole);
+
+    srcnn_ctx_t *tiled = srcnn_ctx_create(model, MOSAIC_H, MOSAIC_W, SRCNN_MODE_TILED);
+    srcnn_ctx_run_strided(tiled, &img_mosaic_tiled[0][0][0], MOSAIC_STRIDE,
+                          &img_HR_tiled[0][0][0], MOSAIC_STRIDE);
+    srcnn_ctx_destroy(tiled);
+
+    bool seams = true;
+    for (int y = 0; y < MOSAIC_H; y++)
+        seams = seams && memcmp(img_HR_tiled[0][y], img_HR_whole_tiled[0][y], MOSAIC_W*sizeof(ftmap_t)) == 0;
+    cout << "  - " << MOSAIC_H << "x" << MOSAIC_W << " tiled bit-identical to whole image: "
+         << (seams ? "yes" : "NO") << endl;
+
+    // the tiled workspace is bounded by the tile size, not the image size
+    int sizes[3][2] = { { MOSAIC_H, MOSAIC_W }, { 1080, 1920 }, { 2160, 3840 } };
+    for (int i = 0; i < 3; i++)
+        cout << "  - Workspace at " << setw(4) << right << sizes[i][0] << "x" << setw(4) << left << sizes[i][1]
+             << ": tiled " << srcnn_workspace_bytes(sizes[i][0], sizes[i][1], SRCNN_MODE_TILED)/1024
+             << " KB, whole image " << srcnn_workspace_bytes(sizes[i][0], sizes[i][1], SRCNN_MODE_SIMD)/1024
+             << " KB" << endl;
+    bool bounded = srcnn_workspace_bytes(2160, 3840, SRCNN_MODE_TILED) ==
+                   srcnn_workspace_bytes(1080, 1920, SRCNN_MODE_TILED);
+
+    // every mode reads and writes strided images like packed ones
+    bool strides = true;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++)
+            img_LR_strided_tiled[0][y][x] = img_LR_tiled[0][y][x];
+    for (int m = 0; m < SRCNN_MODE_COUNT; m++) {
+        srcnn_ctx_t *ctx = srcnn_ctx_create(model, H, W, (srcnn_mode_t) m);
+        srcnn_ctx_run(ctx, &img_LR_tiled[0][0][0], &img_HR_packed_tiled[0][0][0]);
+        srcnn_ctx_run_strided(ctx, &img_LR_strided_tiled[0][0][0], W + 3,
+                              &img_HR_strided_tiled[0][0][0], W + 5);
+        srcnn_ctx_destroy(ctx);
+
+        bool identical = true;
+        for (int y = 0; y < H; y++)
+            identical = identical && memcmp(img_HR_strided_tiled[0][y], img_HR_packed_tiled[0][y], W*sizeof(ftmap_t)) == 0;
+        if (!identical)
+            cout << "  - Strided " << srcnn_mode_name((srcnn_mode_t) m) << " differs from packed" << endl;
+        strides = strides && identical;
+    }
+    cout << "  - Strided images match packed ones in every mode: " << (strides ? "yes" : "NO") << endl;
+    cout << endl;
+
+    return seams && bounded && strides ? 0 : 1;
+}
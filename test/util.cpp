@@ -1,47 +1,134 @@
-#include <fstream>
 #include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "util.h"
+#include "engine.h"
+#include "model_file.h"
 
+// 8-lane vectors for the conversion loops; GCC and Clang lower them to
+// whatever SIMD the target has (SSE pairs, AVX, NEON)
+typedef float   util_v8f __attribute__((vector_size(32)));
+typedef int32_t util_v8i __attribute__((vector_size(32)));
+typedef uint8_t util_v8b __attribute__((vector_size(8)));
 
-// load image from uint8_t file and normalize to interval [0, 1]
-void load_image(std::string  fname,
-                ftmap_t     *image,
-                int          count)
+mapped_file_t map_file(const std::string &fname)
 {
-    uint8_t p;
-    float   p_flp;
-
-    std::ifstream ifs(fname, std::ios::in | std::ios::binary);
-    if (!ifs)
+    mapped_file_t file = { NULL, 0 };
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
         throw std::runtime_error("File not found");
 
-    for (int i = 0; i < count; i++) {
-        ifs.read((char *) &p, sizeof(uint8_t));
-        p_flp = ((float) p) / 255;
-        image[i] = (ftmap_t) p_flp;
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            // loaders read a file once, front to back
+            madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+            file.data = (const unsigned char *) data;
+            file.size = (size_t) st.st_size;
+        }
     }
+    close(fd);
+    if (!file.data && st.st_size > 0)
+        throw std::runtime_error("Cannot map " + fname);
+    return file;
+}
 
-    ifs.close();
+void unmap_file(mapped_file_t &file)
+{
+    if (file.data)
+        munmap((void *) file.data, file.size);
+    file.data = NULL;
+    file.size = 0;
 }
 
-// load feature map from single precision FLP file
-void load_ftmap(std::string  fname,
-                ftmap_t     *ftmap,
-                int          count)
+void readahead_files(const std::vector<std::string> &fnames)
 {
-    float f;
+    for (size_t i = 0; i < fnames.size(); i++) {
+        int fd = open(fnames[i].c_str(), O_RDONLY);
+        if (fd < 0)
+            continue;
+#ifdef POSIX_FADV_WILLNEED
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+        close(fd);
+    }
+}
 
-    std::ifstream ifs(fname, std::ios::in | std::ios::binary);
-    if (!ifs)
-        throw std::runtime_error("File not found");
+void u8_to_ftmap(const uint8_t *pixels,
+                 ftmap_t       *image,
+                 int            count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        util_v8b p;
+        memcpy(&p, pixels + i, sizeof(p));
+        // a division, not a multiply by 1/255, to keep the rounding of the old loaders
+        util_v8f v = __builtin_convertvector(p, util_v8f)/255.0f;
+        for (int j = 0; j < 8; j++)
+            image[i + j] = (ftmap_t) v[j];
+    }
+    for (; i < count; i++)
+        image[i] = (ftmap_t) (((float) pixels[i])/255);
+}
 
-    for (int i = 0; i < count; i++) {
-        ifs.read((char *) &f, sizeof(float));
-        ftmap[i] = (ftmap_t) f;
+void ftmap_to_u8(const ftmap_t *image,
+                 uint8_t       *pixels,
+                 int            count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        util_v8f v;
+        for (int j = 0; j < 8; j++)
+            v[j] = (float) image[i + j]*255;
+        v = v < 0.0f ? 0.0f : v;
+        v = v > 255.0f ? 255.0f : v;
+        util_v8b p = __builtin_convertvector(__builtin_convertvector(v, util_v8i), util_v8b);
+        memcpy(pixels + i, &p, sizeof(p));
     }
+    for (; i < count; i++) {
+        float v = (float) image[i]*255;
+        pixels[i] = (uint8_t) (v < 0 ? 0 : (v > 255 ? 255 : v));
+    }
+}
+
+// maps fname and checks that it holds at least bytes bytes
+static mapped_file_t map_at_least(const std::string &fname, size_t bytes)
+{
+    mapped_file_t file = map_file(fname);
+    if (file.size < bytes) {
+        unmap_file(file);
+        throw std::runtime_error("File too short: " + fname);
+    }
+    return file;
+}
 
-    ifs.close();
+// load image from uint8_t file and normalize to interval [0, 1]
+void load_image(std::string  fname,
+                ftmap_t     *image,
+                int          count)
+{
+    mapped_file_t file = map_at_least(fname, (size_t) count);
+    u8_to_ftmap(file.data, image, count);
+    unmap_file(file);
+}
+
+// load feature map from single precision FLP file
+void load_ftmap(std::string  fname,
+                ftmap_t     *ftmap,
+                int          count)
+{
+    mapped_file_t file = map_at_least(fname, (size_t) count*sizeof(float));
+    const float *values = (const float *) file.data;
+    for (int i = 0; i < count; i++)
+        ftmap[i] = (ftmap_t) values[i];
+    unmap_file(file);
 }
 
 // load conv layer parameters from flp file
@@ -49,18 +136,73 @@ void load_param(std::string  fname,
                 param_t     *param,
                 int          count)
 {
-    float p;
+    mapped_file_t file = map_at_least(fname, (size_t) count*sizeof(float));
+    const float *values = (const float *) file.data;
+    for (int i = 0; i < count; i++)
+        param[i] = (param_t) values[i];
+    unmap_file(file);
+}
 
-    std::ifstream ifs(fname, std::ios::in | std::ios::binary);
-    if (!ifs)
-        throw std::runtime_error("File not found");
+const srcnn_model_t *test_model()
+{
+    static srcnn_model_file_t *file = srcnn_model_open("./weights/srcnn_3x.model");
+    return srcnn_model_get(file);
+}
 
-    for (int i = 0; i < count; i++) {
-        ifs.read((char *) &p, sizeof(float));
-        param[i] = (param_t) p;
-    }
+const test_params_t &test_params()
+{
+    // the mapping is read-only; the HLS entry points only read through these
+    static const srcnn_model_t *model = test_model();
+    static const test_params_t params = {
+        (param_t (*)[N0][F1][F1]) model->conv1_weights, (param_t *) model->conv1_biases,
+        (param_t (*)[N1][F2][F2]) model->conv2_weights, (param_t *) model->conv2_biases,
+        (param_t (*)[N2][F3][F3]) model->conv3_weights, (param_t *) model->conv3_biases,
+    };
+    return params;
+}
 
-    ifs.close();
+image_writer::image_writer(const std::string &fname)
+{
+    fp_ = fopen(fname.c_str(), "wb");
+    if (!fp_)
+        throw std::runtime_error("Error writing to output bin file");
+}
+
+image_writer::~image_writer()
+{
+    if (fp_)
+        fclose(fp_);
+}
+
+void image_writer::write(const ftmap_t *ftmap,
+                         int            rows,
+                         int            cols,
+                         int            stride)
+{
+    // rows go out in chunks through a small buffer, never a whole image copy
+    for (int y = 0; y < rows; y++)
+        for (int x = 0; x < cols; x += IMAGE_WRITER_CHUNK) {
+            int n = cols - x < IMAGE_WRITER_CHUNK ? cols - x : IMAGE_WRITER_CHUNK;
+            ftmap_to_u8(ftmap + (long) y*stride + x, chunk_, n);
+            if (fwrite(chunk_, 1, n, fp_) != (size_t) n)
+                throw std::runtime_error("Error writing to output bin file");
+        }
+}
+
+void image_writer::write_raw(const ftmap_t *ftmap,
+                             int            count)
+{
+    if (fwrite(ftmap, sizeof(ftmap_t), count, fp_) != (size_t) count)
+        throw std::runtime_error("Error writing to output bin file");
+}
+
+void image_writer::close()
+{
+    if (fp_ && fclose(fp_) != 0) {
+        fp_ = NULL;
+        throw std::runtime_error("Error writing to output bin file");
+    }
+    fp_ = NULL;
 }
 
 // returns MSE between two images
@@ -98,17 +240,7 @@ void write_bin(std::string    fname,
 			   ftmap_t       *ftmap,
 			   int            count)
 {
-    std::ofstream outputFile(fname, std::ios::binary);
-    // Check if the file is successfully opened
-    if (outputFile.is_open()) {
-        // Write uint8_t data to the file
-        for (int i = 0; i < count; i++) {
-            outputFile.put(static_cast<char>((uint8_t)(ftmap[i]*255)));
-        }
-
-        outputFile.close();
-    } else {
-        throw std::runtime_error("Error writing to output bin file");
-    }
-
-}
\ No newline at end of file
+    image_writer writer(fname);
+    writer.write(ftmap, 1, count, count);
+    writer.close();
+}
@@ -1,10 +1,39 @@
 #ifndef _UTIL_H_
 #define _UTIL_H_
 
+#include <cstdio>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #include "srcnn.h"
 
+struct srcnn_model_t;
+
+// whole file mapped read-only, with a hint that it is read front to back
+struct mapped_file_t {
+    const unsigned char *data;
+    size_t               size;
+};
+
+mapped_file_t map_file(const std::string &fname);
+
+void unmap_file(mapped_file_t &file);
+
+// asks the OS to start reading files that will be loaded next, e.g. every
+// image found by a directory scan, so the loads overlap with computation
+void readahead_files(const std::vector<std::string> &fnames);
+
+// normalizes u8 pixels to [0, 1] (pixel/255), 8 at a time
+void u8_to_ftmap(const uint8_t *pixels,
+                 ftmap_t       *image,
+                 int            count);
+
+// quantizes [0, 1] values to u8 (truncating value*255, saturated), 8 at a time
+void ftmap_to_u8(const ftmap_t *image,
+                 uint8_t       *pixels,
+                 int            count);
+
 // load image from uint8_t file and normalize to interval [0, 1]
 void load_image(std::string  fname,
                 ftmap_t     *image,
@@ -20,6 +49,22 @@ void load_param(std::string  fname,
                 param_t     *param,
                 int          count);
 
+// the 3x model of ./weights/srcnn_3x.model, mapped on first use and kept
+// for the whole run; testbenches share it instead of loading the .bin files
+const srcnn_model_t *test_model();
+
+// the same parameters as arrays, for the HLS entry points that take them
+struct test_params_t {
+    param_t (*conv1_weights)[N0][F1][F1];
+    param_t  *conv1_biases;
+    param_t (*conv2_weights)[N1][F2][F2];
+    param_t  *conv2_biases;
+    param_t (*conv3_weights)[N2][F3][F3];
+    param_t  *conv3_biases;
+};
+
+const test_params_t &test_params();
+
 // returns MSE between two images
 double calculate_mse(ftmap_t *img1,
                      ftmap_t *img2,
@@ -35,4 +80,34 @@ void write_bin(std::string    fname,
 			   ftmap_t       *ftmap,
 			   int            count);
 
+#define IMAGE_WRITER_CHUNK 4096    // pixels quantized per fwrite
+
+// streams images into one file: u8 images quantized chunk by chunk straight
+// from (possibly strided) inference buffers, or raw floats with no copy at all
+class image_writer {
+public:
+    explicit image_writer(const std::string &fname);
+    ~image_writer();
+
+    image_writer(const image_writer &) = delete;
+    image_writer &operator=(const image_writer &) = delete;
+
+    // appends rows x cols values, rows stride elements apart, as u8
+    void write(const ftmap_t *ftmap,
+               int            rows,
+               int            cols,
+               int            stride);
+
+    // appends count values as float
+    void write_raw(const ftmap_t *ftmap,
+                   int            count);
+
+    // flushes and closes the file, throwing if anything failed to write
+    void close();
+
+private:
+    FILE    *fp_;
+    uint8_t  chunk_[IMAGE_WRITER_CHUNK];
+};
+
 #endif
@@ -0,0 +1,397 @@
+// Native SRCNN benchmark: times every layer and the end-to-end pipeline of
+// each implementation and prints the results as JSON.
+//
+//   g++ -O2 -I src tools/bench.cpp src/*.cpp -o bench -lpthread
+//   ./bench [--runs N] [--warmup N] [--filter TEXT] [--isa scalar|avx2|avx512]
+//           [--model src/weights/srcnn_3x.model] [--image test/set5/butterfly_3x_LR_u8.bin]
+//           [--prune TOLERANCE] [--flat THRESHOLD]
+//
+// Each benchmark runs warmup untimed iterations, then runs timed ones and
+// reports min/median/p99 latency. GFLOP/s counts 2 flops per multiply-add of
+// the N/F constants in srcnn.h at the median latency. bytes is the
+// compulsory DRAM traffic: maps a layer reads and writes plus its weights;
+// pipelines that keep intermediates on chip (fused, tiled) only count the
+// input image, the output image and the weights, and fused23 keeps only the
+// conv2 map on chip. End-to-end results also report traffic_reduction, the
+// fraction of the layer-by-layer float pipeline's bytes they avoid. --prune
+// drops conv2/conv3 weights of at most that magnitude from the sparse
+// kernels when the model is loaded (0 keeps every weight). --flat passes
+// blocks of input deviation below THRESHOLD through in the adaptive mode
+// (0, the default, computes every block; see tb_adaptive). The incremental
+// mode runs the same image every time, so it only times the path of an
+// unchanged frame: the diff and the output copy.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "srcnn.h"
+#include "kernels.h"
+#include "engine.h"
+#include "simd.h"
+#include "quant.h"
+#include "model_file.h"
+
+struct bench_options_t {
+    int         runs;
+    int         warmup;
+    std::string filter;
+    std::string model;
+    std::string image;
+    float       prune;
+    float       flat;
+};
+
+struct bench_result_t {
+    std::string         name;       // "conv1", ..., "srcnn"
+    std::string         impl;       // "reference", "simd", ...
+    double              flops;
+    double              bytes;
+    std::vector<double> ms;         // sorted latencies of the timed runs
+};
+
+// multiply-adds of a layer over the whole image
+static double layer_macs(int nin, int nout, int f)
+{
+    return (double) H*W*nout*nin*f*f;
+}
+
+// compulsory bytes of a float layer: input map, weights and biases, output map
+static double layer_bytes(int nin, int nout, int f)
+{
+    return ((double) nin*H*W + (double) nout*nin*f*f + nout + (double) nout*H*W)*sizeof(float);
+}
+
+static double pipeline_flops()
+{
+    return 2*(layer_macs(N0, N1, F1) + layer_macs(N1, N2, F2) + layer_macs(N2, N3, F3));
+}
+
+// bytes of a pipeline whose conv1 and conv2 maps are each written and read
+// back through memory with the given element size, or stay on chip if it is 0
+static double pipeline_bytes(size_t layer1_size, size_t layer2_size)
+{
+    double weights = ((double) N1*N0*F1*F1 + N1 + (double) N2*N1*F2*F2 + N2 + (double) N3*N2*F3*F3 + N3)*sizeof(param_t);
+    double maps = ((double) N0*H*W + (double) N3*H*W)*sizeof(ftmap_t);
+    return weights + maps + 2.0*H*W*(N1*layer1_size + N2*layer2_size);
+}
+
+// pipeline_bytes() with both maps in memory at the same element size
+static double pipeline_bytes(size_t intermediate_size)
+{
+    return pipeline_bytes(intermediate_size, intermediate_size);
+}
+
+// nearest-rank percentile of sorted values
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    int rank = (int) ((p/100)*sorted.size() + 0.999999);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// times fn; setup runs once beforehand, untimed, to fill the inputs fn
+// reads, so a bench does not depend on which ran before it
+static void bench(const bench_options_t         &opts,
+                  std::vector<bench_result_t>   &results,
+                  const char                    *name,
+                  const char                    *impl,
+                  double                         flops,
+                  double                         bytes,
+                  const std::function<void()>   &setup,
+                  const std::function<void()>   &fn)
+{
+    std::string label = std::string(impl) + "/" + name;
+    if (!opts.filter.empty() && label.find(opts.filter) == std::string::npos)
+        return;
+
+    setup();
+    for (int i = 0; i < opts.warmup; i++)
+        fn();
+    bench_result_t result = { name, impl, flops, bytes, std::vector<double>() };
+    for (int i = 0; i < opts.runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        result.ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(result.ms.begin(), result.ms.end());
+    results.push_back(result);
+    fprintf(stderr, "%-22s median %9.3f ms\n", label.c_str(), percentile(result.ms, 50));
+}
+
+// bench() of fn reading only the input image
+static void bench(const bench_options_t         &opts,
+                  std::vector<bench_result_t>   &results,
+                  const char                    *name,
+                  const char                    *impl,
+                  double                         flops,
+                  double                         bytes,
+                  const std::function<void()>   &fn)
+{
+    bench(opts, results, name, impl, flops, bytes, []() {}, fn);
+}
+
+static void print_json(const bench_options_t &opts, const std::vector<bench_result_t> &results)
+{
+    printf("{\n");
+    printf("  \"height\": %d,\n  \"width\": %d,\n", H, W);
+    printf("  \"isa\": \"%s\",\n  \"vnni\": %s,\n", simd_isa_name(simd_isa()), simd_vnni() ? "true" : "false");
+    printf("  \"threads\": %d,\n  \"runs\": %d,\n  \"warmup\": %d,\n", thread_pool_default().size(), opts.runs, opts.warmup);
+    printf("  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const bench_result_t &r = results[i];
+        double median = percentile(r.ms, 50);
+        std::string traffic;
+        if (r.name == "srcnn") {
+            char field[64];
+            snprintf(field, sizeof(field), ", \"traffic_reduction\": %.3f", 1 - r.bytes/pipeline_bytes(sizeof(ftmap_t)));
+            traffic = field;
+        }
+        printf("    {\"name\": \"%s\", \"impl\": \"%s\", \"flops\": %.0f, \"bytes\": %.0f%s, "
+               "\"min_ms\": %.4f, \"median_ms\": %.4f, \"p99_ms\": %.4f, \"gflops\": %.3f, \"gbytes_per_s\": %.3f}%s\n",
+               r.name.c_str(), r.impl.c_str(), r.flops, r.bytes, traffic.c_str(),
+               r.ms.front(), median, percentile(r.ms, 99),
+               r.flops/(median*1e6), r.bytes/(median*1e6),
+               i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+static void load_u8_image(const std::string &fname, ftmap_t *image, int count)
+{
+    std::vector<unsigned char> bytes(count);
+    FILE *fp = fopen(fname.c_str(), "rb");
+    if (!fp || fread(&bytes[0], 1, count, fp) != (size_t) count) {
+        if (fp)
+            fclose(fp);
+        throw std::runtime_error("Cannot read image " + fname);
+    }
+    fclose(fp);
+    for (int i = 0; i < count; i++)
+        image[i] = (ftmap_t) (((float) bytes[i])/255);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [--runs N] [--warmup N] [--filter TEXT] [--isa NAME] [--model FILE] [--image FILE] [--prune TOLERANCE] [--flat THRESHOLD]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t opts = { 10, 2, "", "src/weights/srcnn_3x.model", "test/set5/butterfly_3x_LR_u8.bin", 0, 0 };
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--runs")
+            opts.runs = std::max(1, atoi(value.c_str()));
+        else if (arg == "--warmup")
+            opts.warmup = std::max(0, atoi(value.c_str()));
+        else if (arg == "--filter")
+            opts.filter = value;
+        else if (arg == "--model")
+            opts.model = value;
+        else if (arg == "--image")
+            opts.image = value;
+        else if (arg == "--prune")
+            opts.prune = (float) atof(value.c_str());
+        else if (arg == "--flat")
+            opts.flat = (float) atof(value.c_str());
+        else if (arg == "--isa") {
+            int isa = 0;
+            while (isa < SIMD_ISA_COUNT && value != simd_isa_name((simd_isa_t) isa))
+                isa++;
+            if (isa == SIMD_ISA_COUNT) {
+                usage(argv[0]);
+                return 2;
+            }
+            simd_set_isa((simd_isa_t) isa);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    try {
+        srcnn_model_file_t *file = srcnn_model_open(opts.model.c_str());
+        const srcnn_model_t *model = srcnn_model_get(file);
+
+        // the HLS entry points take fixed-size arrays
+        std::vector<ftmap_t> input((size_t) N0*H*W), layer1((size_t) N1*H*W);
+        std::vector<ftmap_t> layer2((size_t) N2*H*W), output((size_t) N3*H*W);
+        load_u8_image(opts.image, &input[0], N0*H*W);
+        ftmap_t (*in)[H][W] = (ftmap_t (*)[H][W]) &input[0];
+        ftmap_t (*l1)[H][W] = (ftmap_t (*)[H][W]) &layer1[0];
+        ftmap_t (*l2)[H][W] = (ftmap_t (*)[H][W]) &layer2[0];
+        ftmap_t (*out)[H][W] = (ftmap_t (*)[H][W]) &output[0];
+        param_t (*w1)[N0][F1][F1] = (param_t (*)[N0][F1][F1]) model->conv1_weights;
+        param_t (*w2)[N1][F2][F2] = (param_t (*)[N1][F2][F2]) model->conv2_weights;
+        param_t (*w3)[N2][F3][F3] = (param_t (*)[N2][F3][F3]) model->conv3_weights;
+        param_t *b1 = (param_t *) model->conv1_biases;
+        param_t *b2 = (param_t *) model->conv2_biases;
+        param_t *b3 = (param_t *) model->conv3_biases;
+
+        std::vector<bench_result_t> results;
+        double flops1 = 2*layer_macs(N0, N1, F1), bytes1 = layer_bytes(N0, N1, F1);
+        double flops2 = 2*layer_macs(N1, N2, F2), bytes2 = layer_bytes(N1, N2, F2);
+        double flops3 = 2*layer_macs(N2, N3, F3), bytes3 = layer_bytes(N2, N3, F3);
+
+        conv_layer_t layers[3] = {
+            { N0, N1, F1, model->conv1_weights, model->conv1_biases },
+            { N1, N2, F2, model->conv2_weights, model->conv2_biases },
+            { N2, N3, F3, model->conv3_weights, model->conv3_biases },
+        };
+        ftmap_t *maps[4] = { &input[0], &layer1[0], &layer2[0], &output[0] };
+
+        // setup of a planar bench of layer l: its input map, from the image
+        // through the SIMD kernels of the layers before it
+        auto planar_input = [&](int l) {
+            return [&, l]() {
+                for (int k = 0; k < l; k++)
+                    conv_direct(&layers[k], ftmap_view(maps[k], H, W), H, W, ftmap_view(maps[k + 1], H, W),
+                                0, layers[k].nout, 0, H, 0, W);
+            };
+        };
+
+        // per layer: HLS reference loops, SIMD direct kernels, GEMM kernels
+        bench(opts, results, "conv1", "reference", flops1, bytes1, [&]() { conv1(in, w1, b1, l1); });
+        bench(opts, results, "conv2", "reference", flops2, bytes2, planar_input(1), [&]() { conv2(l1, w2, b2, l2); });
+        bench(opts, results, "conv3", "reference", flops3, bytes3, planar_input(2), [&]() { conv3(l2, w3, b3, out); });
+
+        const char *names[3] = { "conv1", "conv2", "conv3" };
+        double flops[3] = { flops1, flops2, flops3 }, bytes[3] = { bytes1, bytes2, bytes3 };
+        for (int l = 0; l < 3; l++)
+            bench(opts, results, names[l], "simd", flops[l], bytes[l], planar_input(l), [&]() {
+                conv_direct(&layers[l], ftmap_view(maps[l], H, W), H, W, ftmap_view(maps[l + 1], H, W),
+                            0, layers[l].nout, 0, H, 0, W);
+            });
+
+        size_t ws = std::max(conv1_gemm_workspace_size(H, W),
+                             std::max(conv2_gemm_workspace_size(H, W), conv3_gemm_workspace_size(H, W)));
+        std::vector<float> workspace(ws);
+        std::vector<float> panels1(conv1_gemm_weights_size()), panels2(conv2_gemm_weights_size()), panels3(conv3_gemm_weights_size());
+        conv_gemm_weights_t packed1 = conv1_gemm_pack(model->conv1_weights, &panels1[0]);
+        conv_gemm_weights_t packed2 = conv2_gemm_pack(model->conv2_weights, &panels2[0]);
+        conv_gemm_weights_t packed3 = conv3_gemm_pack(model->conv3_weights, &panels3[0]);
+        bench(opts, results, "conv1", "gemm", flops1, bytes1, [&]() {
+            conv1_gemm(&input[0], model->conv1_weights, model->conv1_biases, H, W, &layer1[0], &workspace[0], &packed1);
+        });
+        bench(opts, results, "conv2", "gemm", flops2, bytes2, planar_input(1), [&]() {
+            conv2_gemm(&layer1[0], model->conv2_weights, model->conv2_biases, H, W, &layer2[0], &workspace[0], &packed2);
+        });
+        bench(opts, results, "conv3", "gemm", flops3, bytes3, planar_input(2), [&]() {
+            conv3_gemm(&layer2[0], model->conv3_weights, model->conv3_biases, H, W, &output[0], &workspace[0], &packed3);
+        });
+
+        // FFT conv1; its GFLOP/s counts the direct multiply-adds it replaces
+        std::vector<float> spectra(conv1_fft_spectra_size()), fft_workspace(conv1_fft_workspace_size());
+        conv1_fft_prepare(model->conv1_weights, &spectra[0]);
+        bench(opts, results, "conv1", "fft", flops1, bytes1, [&]() {
+            conv1_fft(ftmap_view(&input[0], H, W), &spectra[0], model->conv1_biases, H, W,
+                      ftmap_view(&layer1[0], H, W), &fft_workspace[0]);
+        });
+
+        // every layer in every feature-map layout (see ftmap_layout_t); conv2
+        // variants are named by input then output layout
+        for (int l = 0; l < FTMAP_LAYOUT_COUNT; l++) {
+            ftmap_layout_t layout = (ftmap_layout_t) l;
+            std::string name = std::string("layout_") + ftmap_layout_name(layout);
+            bench(opts, results, "conv1", name.c_str(), flops1, bytes1, [&]() {
+                conv1_layout(ftmap_view(&input[0], H, W), model->conv1_weights, model->conv1_biases, H, W,
+                             &layer1[0], layout);
+            });
+            auto layout_layer1 = [&]() {
+                conv1_layout(ftmap_view(&input[0], H, W), model->conv1_weights, model->conv1_biases, H, W,
+                             &layer1[0], layout);
+            };
+            for (int m = 0; m < FTMAP_LAYOUT_COUNT; m++) {
+                ftmap_layout_t to = (ftmap_layout_t) m;
+                std::string conv2_name = name + "_" + ftmap_layout_name(to);
+                bench(opts, results, "conv2", conv2_name.c_str(), flops2, bytes2, layout_layer1, [&]() {
+                    conv2_layout(&layer1[0], layout, model->conv2_weights, model->conv2_biases, H, W, &layer2[0], to);
+                });
+            }
+            bench(opts, results, "conv3", name.c_str(), flops3, bytes3, [&]() {
+                layout_layer1();
+                conv2_layout(&layer1[0], layout, model->conv2_weights, model->conv2_biases, H, W, &layer2[0], layout);
+            }, [&]() {
+                conv3_layout(&layer2[0], layout, model->conv3_weights, model->conv3_biases, H, W,
+                             ftmap_view(&output[0], H, W));
+            });
+        }
+
+        // conv2/conv3 skipping zero activations on channel-last maps; their
+        // GFLOP/s counts the dense multiply-adds
+        std::vector<conv_sparse_weights_t> sparse(1);
+        std::vector<ftmap_mask_t> masks((size_t) H*W);
+        std::vector<float> ring(conv3_sparse_workspace_size(W));
+        conv_sparse_pack(model->conv2_weights, model->conv3_weights, opts.prune, &sparse[0]);
+        auto sparse_layer1 = [&]() {
+            conv1_layout(ftmap_view(&input[0], H, W), model->conv1_weights, model->conv1_biases, H, W,
+                         &layer1[0], FTMAP_NHWC);
+        };
+        auto sparse_conv2 = [&]() {
+            conv2_sparse(&layer1[0], &sparse[0], model->conv2_biases, H, W, &layer2[0], &masks[0]);
+        };
+        bench(opts, results, "conv2", "sparse", flops2, bytes2, sparse_layer1, sparse_conv2);
+        bench(opts, results, "conv3", "sparse", flops3, bytes3, [&]() {
+            sparse_layer1();
+            sparse_conv2();
+        }, [&]() {
+            conv3_sparse(&layer2[0], &masks[0], &sparse[0], model->conv3_biases, H, W,
+                         ftmap_view(&output[0], H, W), &ring[0]);
+        });
+
+        // end to end: the HLS top functions and every engine mode
+        double flops_all = pipeline_flops();
+        bench(opts, results, "srcnn", "hls", flops_all, pipeline_bytes(sizeof(ftmap_t)), [&]() {
+            srcnn(in, w1, b1, w2, b2, w3, b3, out);
+        });
+        bench(opts, results, "srcnn", "hls_fused", flops_all, pipeline_bytes(0), [&]() {
+            srcnn_fused(in, w1, b1, w2, b2, w3, b3, out);
+        });
+        for (int m = 0; m < SRCNN_MODE_COUNT; m++) {
+            srcnn_mode_t mode = (srcnn_mode_t) m;
+            bool on_chip = mode == SRCNN_MODE_FUSED || mode == SRCNN_MODE_TILED;
+            double bytes = pipeline_bytes(on_chip ? 0 : sizeof(ftmap_t));
+            if (mode == SRCNN_MODE_FUSED23)
+                bytes = pipeline_bytes(sizeof(ftmap_t), 0);
+            if (mode == SRCNN_MODE_FP16 || mode == SRCNN_MODE_BF16)
+                bytes = pipeline_bytes(sizeof(uint16_t));
+            srcnn_ctx_t *ctx = srcnn_ctx_create(model, H, W, mode);
+            srcnn_ctx_set_prune(ctx, opts.prune);
+            srcnn_ctx_set_flat(ctx, opts.flat);
+            bench(opts, results, "srcnn", srcnn_mode_name(mode), flops_all, bytes, [&]() {
+                srcnn_ctx_run(ctx, &input[0], &output[0]);
+            });
+            srcnn_ctx_destroy(ctx);
+        }
+
+        // 8-bit intermediates, calibrated on the benchmark image itself
+        quant_calib_t calib;
+        quant_calib_init(&calib);
+        quant_calibrate(&calib, model, &input[0], H, W);
+        quant_model_t *qmodel = quant_model_create(model, &calib);
+        std::vector<char> qworkspace(quant_workspace_bytes(H, W));
+        bench(opts, results, "srcnn", "int8", flops_all, pipeline_bytes(sizeof(uint8_t)), [&]() {
+            quant_run(qmodel, &input[0], H, W, &output[0], &qworkspace[0]);
+        });
+        quant_model_destroy(qmodel);
+
+        print_json(opts, results);
+        srcnn_model_close(file);
+    } catch (const std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Converts the six per-layer *_<UP>x_flp.bin weight files into one packed
+// model file (see src/model_file.h).
+//
+//   g++ -O2 -I src tools/convert_model.cpp src/model_file.cpp -o convert_model
+//   ./convert_model src/weights src/weights/srcnn_3x.model
+
+#include <stdio.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "srcnn.h"
+#include "model_file.h"
+
+// reads exactly count floats from a .bin file in one call
+static void read_floats(const std::string &fname, std::vector<param_t> &values, size_t count)
+{
+    values.resize(count);
+    FILE *fp = fopen(fname.c_str(), "rb");
+    if (!fp)
+        throw std::runtime_error("File not found: " + fname);
+    size_t got = fread(&values[0], sizeof(param_t), count, fp);
+    bool extra = fgetc(fp) != EOF;
+    fclose(fp);
+    if (got != count || extra)
+        throw std::runtime_error("Unexpected size of " + fname + ", expected " + std::to_string(count) + " floats");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <weights directory> <output model file>\n", argv[0]);
+        return 2;
+    }
+
+    std::string dir = std::string(argv[1]) + "/";
+    std::string suffix = "_" + std::to_string(UP) + "x_flp.bin";
+    std::vector<param_t> params[6];
+
+    try {
+        read_floats(dir + "conv1_weights" + suffix, params[0], N1*N0*F1*F1);
+        read_floats(dir + "conv1_biases" + suffix, params[1], N1);
+        read_floats(dir + "conv2_weights" + suffix, params[2], N2*N1*F2*F2);
+        read_floats(dir + "conv2_biases" + suffix, params[3], N2);
+        read_floats(dir + "conv3_weights" + suffix, params[4], N3*N2*F3*F3);
+        read_floats(dir + "conv3_biases" + suffix, params[5], N3);
+
+        srcnn_model_t model = {
+            &params[0][0], &params[1][0],
+            &params[2][0], &params[3][0],
+            &params[4][0], &params[5][0],
+        };
+        srcnn_model_write(argv[2], &model);
+
+        // read the result back through the same checks as every user
+        srcnn_model_file_t *file = srcnn_model_open(argv[2]);
+        const srcnn_model_header_t *header = srcnn_model_header(file);
+        printf("%s: version %u, %ux upscale, %llu bytes, checksum %016llx\n",
+               argv[2], header->version, header->upscale,
+               (unsigned long long) header->file_size, (unsigned long long) header->checksum);
+        for (int l = 0; l < SRCNN_MODEL_LAYERS; l++)
+            printf("  conv%d: %u -> %u, %ux%u\n", l + 1,
+                   header->layer[l].nin, header->layer[l].nout, header->layer[l].f, header->layer[l].f);
+        srcnn_model_close(file);
+    } catch (const std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+// Upscales a raw u8 Y-plane video, frame after frame, with the overlapped
+// read / infer / write pipeline of src/stream.h, and prints the sustained
+// frame rate and the per-stage busy and stall times to stderr.
+//
+//   g++ -O2 -I src tools/stream.cpp src/*.cpp -o stream -lpthread
+//   ./stream [--model src/weights/srcnn_3x.model] [--size 255x255] [--mode simd]
+//            [--depth 2] [--isa scalar|avx2|avx512] [INPUT|-] [OUTPUT|-]
+//
+// INPUT and OUTPUT default to stdin and stdout, so the tool sits in a pipe,
+// e.g. behind ffmpeg -pix_fmt gray -f rawvideo. Frames are height x width
+// bytes back to back; the output has the same size since SRCNN runs on the
+// bicubic-upscaled luma.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "srcnn.h"
+#include "engine.h"
+#include "simd.h"
+#include "model_file.h"
+#include "stream.h"
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [--model FILE] [--size HxW] [--mode NAME] [--depth N] [--isa NAME] [INPUT|-] [OUTPUT|-]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    std::string model_path = "src/weights/srcnn_3x.model";
+    std::string paths[2] = { "-", "-" };
+    int h = H, w = W, depth = 2, npaths = 0;
+    srcnn_mode_t mode = SRCNN_MODE_SIMD;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            if (npaths == 2) {
+                usage(argv[0]);
+                return 2;
+            }
+            paths[npaths++] = arg;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        std::string value = argv[++i];
+        bool ok = true;
+        if (arg == "--model")
+            model_path = value;
+        else if (arg == "--size")
+            ok = sscanf(value.c_str(), "%dx%d", &h, &w) == 2 && h > 0 && w > 0;
+        else if (arg == "--mode")
+            ok = srcnn_mode_parse(value.c_str(), &mode);
+        else if (arg == "--depth")
+            ok = (depth = atoi(value.c_str())) >= 1;
+        else if (arg == "--isa") {
+            int isa = 0;
+            while (isa < SIMD_ISA_COUNT && value != simd_isa_name((simd_isa_t) isa))
+                isa++;
+            ok = isa < SIMD_ISA_COUNT;
+            if (ok)
+                simd_set_isa((simd_isa_t) isa);
+        } else
+            ok = false;
+        if (!ok) {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    FILE *input = paths[0] == "-" ? stdin : fopen(paths[0].c_str(), "rb");
+    FILE *output = paths[1] == "-" ? stdout : fopen(paths[1].c_str(), "wb");
+    if (!input || !output) {
+        fprintf(stderr, "Cannot open %s\n", (!input ? paths[0] : paths[1]).c_str());
+        return 1;
+    }
+
+    try {
+        srcnn_model_file_t *file = srcnn_model_open(model_path.c_str());
+        srcnn_stream_stats_t stats;
+        srcnn_stream_run(srcnn_model_get(file), h, w, mode, input, output, depth, &stats);
+        srcnn_model_close(file);
+        if (fflush(output) != 0)
+            throw std::runtime_error("Cannot write SRCNN stream output");
+
+        fprintf(stderr, "%ld frames of %dx%d in %.3f s: %.2f fps (%s, %s, depth %d)\n",
+                stats.frames, h, w, stats.seconds, stats.fps, srcnn_mode_name(mode),
+                simd_isa_name(simd_isa()), depth);
+        for (int s = 0; s < SRCNN_STREAM_STAGES; s++) {
+            const srcnn_stream_stage_t &stage = stats.stage[s];
+            fprintf(stderr, "  %-6s busy %9.1f ms, starved %9.1f ms, blocked %9.1f ms, %ld stalls\n",
+                    srcnn_stream_stage_name((srcnn_stream_stage_id_t) s),
+                    stage.busy_ms, stage.starved_ms, stage.blocked_ms, stage.stalls);
+        }
+    } catch (const std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    if (input != stdin)
+        fclose(input);
+    if (output != stdout)
+        fclose(output);
+    return 0;
+}